@@ -0,0 +1,53 @@
+/* MIT License
+
+Copyright (c) 2021 SAFARI Research Group at ETH Zürich
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#ifndef _MRAM_MANAGEMENT_H_
+#define _MRAM_MANAGEMENT_H_
+#include <dpu.h>
+
+#define DPU_CAPACITY (64 << 20) // A DPU's capacity is 64 MiB
+#define PRINT_ERROR(fmt, ...) fprintf(stderr, "\033[0;31mERROR:\033[0m   " fmt "\n", ##__VA_ARGS__)
+#define ROUND_UP_MULTIPLE_8(x) ((((x) + 7) / 8) * 8)
+
+struct mram_heap_allocator_t
+{
+    uint32_t totalAllocated;
+};
+
+static void init_allocator(struct mram_heap_allocator_t *allocator)
+{
+    allocator->totalAllocated = 0;
+}
+
+static uint32_t mram_heap_alloc(struct mram_heap_allocator_t *allocator, uint32_t size)
+{
+    uint32_t ret = allocator->totalAllocated;
+    allocator->totalAllocated += ROUND_UP_MULTIPLE_8(size);
+    if (allocator->totalAllocated > DPU_CAPACITY)
+    {
+        PRINT_ERROR("        Total memory allocated is %d bytes which exceeds the DPU capacity (%d bytes)!", allocator->totalAllocated, DPU_CAPACITY);
+        exit(0);
+    }
+    return ret;
+}
+
+#endif
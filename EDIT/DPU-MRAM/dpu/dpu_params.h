@@ -0,0 +1,26 @@
+#ifndef DPU_PARAMS_H_
+#define DPU_PARAMS_H_
+
+#include "common.h"
+
+// Parameters of the current launch, copied from the MRAM by tasklet 0 before the tasklets start aligning
+extern DPUParams dpu_params;
+
+// The alignment parameters are read at launch so that a binary serves every dataset, the -D values only set the defaults of the host
+#undef READ_SIZE
+#define READ_SIZE ((int)dpu_params.readSize)
+#undef MAX_SCORE
+#define MAX_SCORE ((int)dpu_params.maxScore)
+#undef WRAM_SEGMENT
+#define WRAM_SEGMENT (dpu_params.wramSegment)
+
+#undef MATCH
+#define MATCH (dpu_params.penalties.match)
+#undef MISMATCH
+#define MISMATCH (dpu_params.penalties.mismatch)
+#undef GAP_I
+#define GAP_I (dpu_params.penalties.gap_i)
+#undef GAP_D
+#define GAP_D (dpu_params.penalties.gap_d)
+
+#endif
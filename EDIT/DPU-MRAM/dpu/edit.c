@@ -0,0 +1,381 @@
+/* MIT License
+
+Copyright (c) 2021 SAFARI Research Group at ETH Zürich
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "../common/common.h"
+#include "dpu_allocator_wram.h"
+#include "dpu_allocator_mram.h"
+#include <barrier.h>
+#include <mutex.h>
+#include <perfcounter.h>
+#include "dpu_profile.h"
+#include "dpu_params.h"
+
+// Transfers a column between the WRAM and the MRAM, DMA transfers must be less than 2048
+void edit_column_read(uint32_t column_m, edit_word_t *column, int size)
+{
+    for (int segment = 0; segment < size; segment += 2048)
+        mram_read((__mram_ptr void const *)(column_m + segment), (char *)column + segment, MIN(2048, size - segment));
+}
+
+void edit_column_write(edit_word_t *column, uint32_t column_m, int size)
+{
+    for (int segment = 0; segment < size; segment += 2048)
+        mram_write((char *)column + segment, (__mram_ptr void *)(column_m + segment), MIN(2048, size - segment));
+}
+
+void edit_cigar_allocate(
+    edit_cigar_t *edit_cigar,
+    int pattern_length,
+    int text_length)
+{
+    edit_cigar->max_operations = pattern_length + text_length;
+    edit_cigar->begin_offset = edit_cigar->max_operations - 1;
+    edit_cigar->end_offset = edit_cigar->max_operations;
+    edit_cigar->score = 0;
+}
+
+// Sets the bits of the bases of the pattern equal to each symbol, the EDIT_SYMBOLS words of a block are contiguous
+void edit_pattern_bits(char *pattern, int pattern_length, edit_word_t *peq)
+{
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    memset(peq, 0, EDIT_BLOCKS(pattern_length) * EDIT_SYMBOLS * sizeof(edit_word_t));
+    for (int v = 0; v < pattern_length; ++v)
+        peq[(v / EDIT_WORD_BITS) * EDIT_SYMBOLS + PACKED_BASE(pattern, pattern_mask, v)] |= (edit_word_t)1 << (v % EDIT_WORD_BITS);
+}
+
+// Advances a block of a column to the next base of the text (Hyyrö's formulation of Myers' step). h_in is the horizontal
+// difference entering the first row of the block, the one leaving the row of last_bit is returned
+static inline int edit_advance_block(edit_word_t *pv, edit_word_t *mv, edit_word_t eq, edit_word_t last_bit, int h_in)
+{
+    edit_word_t xv = eq | *mv;
+    if (h_in < 0)
+        eq |= 1;
+    edit_word_t xh = (((eq & *pv) + *pv) ^ *pv) | eq;
+    edit_word_t ph = *mv | ~(xh | *pv);
+    edit_word_t mh = *pv & xh;
+    int h_out = (ph & last_bit) ? 1 : (mh & last_bit) ? -1 : 0;
+    ph <<= 1;
+    mh <<= 1;
+    if (h_in < 0)
+        mh |= 1;
+    else if (h_in > 0)
+        ph |= 1;
+    *pv = mh | ~(xv | ph);
+    *mv = ph & xv;
+    return h_out;
+}
+
+// Cell v of the column h, the first row of the DP-table holds h and the differences of the column add up to the cell
+static inline int edit_cell(edit_word_t *column, int h, int v)
+{
+    int score = h;
+    int b = 0;
+    for (; b < v / EDIT_WORD_BITS; ++b)
+        score += __builtin_popcount(column[2 * b]) - __builtin_popcount(column[2 * b + 1]);
+    edit_word_t mask = ((edit_word_t)1 << (v % EDIT_WORD_BITS)) - 1;
+    if (mask != 0)
+        score += __builtin_popcount(column[2 * b] & mask) - __builtin_popcount(column[2 * b + 1] & mask);
+    return score;
+}
+
+// Follows the same choices as the traceback of NW, the columns h and h - 1 are read back from the MRAM and their cells rebuilt
+// from their differences
+void edit_traceback(int pattern_length, int text_length, edit_cigar_t *cigar, uint32_t matrix_offset, edit_word_t *column, edit_word_t *left_column)
+{
+    int column_size = EDIT_COLUMN_SIZE(pattern_length);
+    char *const operations = cigar->operations;
+    int op_sentinel = cigar->end_offset - 1;
+    int h = text_length;
+    int v = pattern_length;
+    int score = cigar->score;
+
+    if (h > 0 && v > 0)
+    {
+        edit_column_read(matrix_offset + h * column_size, column, column_size);
+        edit_column_read(matrix_offset + (h - 1) * column_size, left_column, column_size);
+    }
+    while (h > 0 && v > 0)
+    {
+        // A +1 vertical difference is a deletion
+        if (column[2 * ((v - 1) / EDIT_WORD_BITS)] & ((edit_word_t)1 << ((v - 1) % EDIT_WORD_BITS)))
+        {
+            operations[op_sentinel--] = 'D';
+            --v;
+            --score;
+            continue;
+        }
+        int left = edit_cell(left_column, h - 1, v);
+        if (score == left + 1)
+        {
+            operations[op_sentinel--] = 'I';
+            --h;
+            score = left;
+        }
+        else
+        {
+            int diag = edit_cell(left_column, h - 1, v - 1);
+            operations[op_sentinel--] = (score == diag + 1) ? 'X' : 'M';
+            --h;
+            --v;
+            score = diag;
+        }
+        // The traceback moved to the column h - 1
+        if (h > 0 && v > 0)
+        {
+            edit_word_t *tmp = column;
+            column = left_column;
+            left_column = tmp;
+            edit_column_read(matrix_offset + (h - 1) * column_size, left_column, column_size);
+        }
+    }
+    while (h > 0)
+    {
+        operations[op_sentinel--] = 'I';
+        --h;
+    }
+    while (v > 0)
+    {
+        operations[op_sentinel--] = 'D';
+        --v;
+    }
+    cigar->begin_offset = op_sentinel + 1;
+}
+
+// Computes the columns of the DP-table one base of the text at a time, each block of the pattern in a few word operations. The
+// column is updated in place in the WRAM, and written to the MRAM for the backtrace
+void edit_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, dpu_alloc_mram_t *dpu_alloc_mram, edit_word_t *peq,
+                  edit_word_t *column, edit_word_t *left_column)
+{
+    int nb_blocks = EDIT_BLOCKS(pattern_length);
+#ifdef BACKTRACE
+    int column_size = EDIT_COLUMN_SIZE(pattern_length);
+    uint32_t matrix_offset = (uint32_t)DPU_MRAM_HEAP_POINTER + dpu_alloc_mram->CUR_PTR_MRAM;
+    PROFILE_MRAM_USED((text_length + 1) * column_size);
+#endif
+    // The last block ends on the last base of the pattern
+    edit_word_t last_bit = (edit_word_t)1 << ((pattern_length + EDIT_WORD_BITS - 1) % EDIT_WORD_BITS);
+    const edit_word_t high_bit = (edit_word_t)1 << (EDIT_WORD_BITS - 1);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    edit_pattern_bits(pattern, pattern_length, peq);
+
+    // The first column holds v, only +1 differences
+    for (int b = 0; b < nb_blocks; ++b)
+    {
+        column[2 * b] = ~(edit_word_t)0;
+        column[2 * b + 1] = 0;
+    }
+#ifdef BACKTRACE
+    if (nb_blocks > 0)
+        edit_column_write(column, matrix_offset, column_size);
+#endif
+    int score = pattern_length;
+    for (int h = 1; h <= text_length; ++h)
+    {
+        edit_word_t *eq = peq + PACKED_BASE(text, text_mask, h - 1);
+        // The first row holds h, its horizontal difference is +1
+        int h_diff = 1;
+        for (int b = 0; b < nb_blocks; ++b)
+            h_diff = edit_advance_block(&column[2 * b], &column[2 * b + 1], eq[b * EDIT_SYMBOLS], (b == nb_blocks - 1) ? last_bit : high_bit, h_diff);
+        // The last cell of the column, h for an empty pattern
+        score += h_diff;
+#ifdef BACKTRACE
+        if (nb_blocks > 0)
+            edit_column_write(column, matrix_offset + h * column_size, column_size);
+#endif
+    }
+    cigar->score = score;
+#ifdef BACKTRACE
+    edit_traceback(pattern_length, text_length, cigar, matrix_offset, column, left_column);
+#endif
+}
+
+// Reads a packed sequence from the MRAM, DMA transfers must be less than 2048
+void read_packed_sequence(uint32_t sequence_m, char *sequence, int length)
+{
+    int size = PACKED_SIZE(length);
+    for (int segment = 0; segment < size; segment += 2048)
+        mram_read((__mram_ptr void const *)(sequence_m + segment), &sequence[segment], MIN(2048, size - segment));
+}
+
+// Index of the next read of the batch to align, shared by the tasklets
+uint32_t next_read;
+MUTEX_INIT(next_read_mutex);
+// Offset of the next CIGAR in the CIGARs of the batch, shared by the tasklets
+uint32_t next_cigar;
+MUTEX_INIT(next_cigar_mutex);
+BARRIER_INIT(start_barrier, NR_TASKLETS);
+
+// Parameters of the current launch
+DPUParams dpu_params;
+
+// Statistics of the tasklets of the current launch
+tasklet_stats_t tasklet_stats[NR_TASKLETS];
+
+// Claims the next read of the batch, all the reads are claimed once it returns nb_reads_per_dpu or more
+uint32_t claim_read()
+{
+    mutex_lock(next_read_mutex);
+    uint32_t read_idx = next_read++;
+    mutex_unlock(next_read_mutex);
+    return read_idx;
+}
+
+#ifdef BACKTRACE
+// Claims size bytes of the CIGARs of the batch, returns their offset
+uint32_t claim_cigar(uint32_t size)
+{
+    mutex_lock(next_cigar_mutex);
+    uint32_t cigar_offset = next_cigar;
+    next_cigar += ROUND_UP_MULTIPLE_8(size);
+    mutex_unlock(next_cigar_mutex);
+    return cigar_offset;
+}
+
+// Replaces the operations of the alignment by their runs at the beginning of its operations buffer, returns the number of runs.
+// A run is written after the operations it encodes are read, and before the operations of the next runs
+uint32_t cigar_encode(edit_cigar_t *cigar)
+{
+    uint8_t *runs = (uint8_t *)cigar->operations;
+    uint32_t nb_runs = 0;
+    int i = cigar->begin_offset;
+    while (i < cigar->end_offset)
+    {
+        char op = cigar->operations[i];
+        int length = 1;
+        while (i + length < cigar->end_offset && cigar->operations[i + length] == op && length < CIGAR_RUN_MAX)
+            ++length;
+        runs[nb_runs++] = CIGAR_RUN(op, length);
+        i += length;
+    }
+    return nb_runs;
+}
+
+// Writes the CIGAR of the alignment run-length encoded after the CIGARs of the previous pairs, DMA transfers must be less than 2048
+void store_cigar(edit_cigar_t *cigar, uint32_t cigars_m, result_t *result)
+{
+    uint32_t size = cigar_encode(cigar);
+    result->cigar_offset = claim_cigar(size);
+    result->cigar_length = size;
+    for (uint32_t segment = 0; segment < size; segment += 2048)
+        mram_write(&cigar->operations[segment], (__mram_ptr void *)(cigars_m + result->cigar_offset + segment), MIN(2048, ROUND_UP_MULTIPLE_8(size - segment)));
+}
+#endif
+
+int main()
+{
+    mem_reset();
+    uint32_t tasklet_id = me();
+    memset(&tasklet_stats[tasklet_id], 0, sizeof(tasklet_stats_t));
+
+    // Load parameters
+    uint32_t params_m = (uint32_t)DPU_MRAM_HEAP_POINTER;
+    DPUParams params_w;
+    mram_read((__mram_ptr void const *)params_m, &params_w, ROUND_UP_MULTIPLE_8(sizeof(DPUParams)));
+    uint32_t nb_reads_per_dpu = params_w.dpuNumReads;
+
+    if (nb_reads_per_dpu <= 0)
+        return 0;
+
+    // Tasklet 0 shares the parameters of the launch and resets the read and CIGAR counters of the previous launch and the cycle counter
+    if (tasklet_id == 0)
+    {
+        dpu_params = params_w;
+        next_read = 0;
+        next_cigar = 0;
+        perfcounter_config(COUNT_CYCLES, true);
+    }
+    barrier_wait(&start_barrier);
+
+    // Base address of the MRAM region holding the batch
+    uint32_t dpuBuffer_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuActiveBuffer * params_w.dpuBufferSize;
+    uint32_t dpuRequests_m = dpuBuffer_m + params_w.dpuRequests_m;
+    uint32_t dpuResults_m = dpuBuffer_m + params_w.dpuResults_m;
+    uint32_t dpuSequences_m = dpuBuffer_m + params_w.dpuSequences_m;
+#ifdef BACKTRACE
+    uint32_t dpuOperations_m = dpuBuffer_m + params_w.dpuOperations_m;
+#endif
+
+    request_t *request_w = (request_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(request_t)));
+    result_t *result_w = (result_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(result_t)));
+
+    edit_cigar_t *cigar;
+    cigar = (edit_cigar_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(edit_cigar_t)));
+
+    char *pattern = (char *)mem_alloc(PACKED_READ_SIZE);
+    char *text = (char *)mem_alloc(PACKED_READ_SIZE);
+
+    dpu_alloc_mram_t dpu_alloc_mram;
+    // Get the base address of the columns in the MRAM
+    dpu_alloc_mram.HEAD_PTR_MRAM = MRAM_TASKLET_SEGMENT(READ_SIZE, MAX_SCORE, dpu_params.penalties) * tasklet_id + params_w.mramTotalAllocated;
+    dpu_alloc_mram.CUR_PTR_MRAM = dpu_alloc_mram.HEAD_PTR_MRAM;
+    dpu_alloc_mram.mem_used_mram = 0;
+
+    // The bits of the pattern and the current column are kept in the WRAM, the backtrace reads two columns back from the MRAM
+    edit_word_t *peq = (edit_word_t *)mem_alloc(ROUND_UP_MULTIPLE_8(EDIT_BLOCKS(READ_SIZE) * EDIT_SYMBOLS * sizeof(edit_word_t)));
+    edit_word_t *column = (edit_word_t *)mem_alloc(EDIT_COLUMN_SIZE(READ_SIZE));
+#ifdef BACKTRACE
+    edit_word_t *left_column = (edit_word_t *)mem_alloc(EDIT_COLUMN_SIZE(READ_SIZE));
+#else
+    edit_word_t *left_column = NULL;
+#endif
+
+#ifdef BACKTRACE
+    cigar->operations = (char *)mem_alloc(2 * READ_SIZE);
+    // initialize traceback operations segment
+    memset(cigar->operations, 'M', 2 * READ_SIZE);
+#endif
+
+    // The tasklets claim the reads one at a time, so a divergent pair only delays the tasklet aligning it
+    uint64_t tasklet_nb_reads = 0;
+    uint32_t read_idx;
+    while ((read_idx = claim_read()) < nb_reads_per_dpu)
+    {
+#ifdef PROFILE
+        perfcounter_t pair_start = perfcounter_get();
+#endif
+        mram_read((__mram_ptr void const *)(dpuRequests_m + read_idx * (sizeof(request_t))), request_w, ROUND_UP_MULTIPLE_8(sizeof(request_t)));
+
+        // The packed text follows the packed pattern
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset, pattern, request_w->pattern_len);
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset + PACKED_SIZE(request_w->pattern_len), text, request_w->text_len);
+        edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len);
+
+        edit_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, &dpu_alloc_mram, peq, column, left_column);
+
+        result_w->idx = request_w->idx;
+#ifdef BACKTRACE
+        store_cigar(cigar, dpuOperations_m, result_w);
+#endif
+        result_w->score = cigar->score;
+
+#ifdef PROFILE
+        result_w->cycles = perfcounter_get() - pair_start;
+#endif
+        mram_write(result_w, (__mram_ptr void *)(dpuResults_m + read_idx * (sizeof(result_t))), sizeof(result_t));
+        ++tasklet_nb_reads;
+    }
+    // Number of reads aligned by the tasklet and cycles until it finished
+    tasklet_stats[tasklet_id].nb_reads = tasklet_nb_reads;
+    tasklet_stats[tasklet_id].cycles = perfcounter_get();
+    mram_write(&tasklet_stats[tasklet_id], (__mram_ptr void *)(dpuBuffer_m + params_w.dpuTaskletStats_m + tasklet_id * sizeof(tasklet_stats_t)), sizeof(tasklet_stats_t));
+    return 0;
+}
\ No newline at end of file
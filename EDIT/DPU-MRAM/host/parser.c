@@ -0,0 +1,996 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include "parser.h"
+
+typedef struct index_args_t
+{
+    const char *data;
+    uint64_t *lines;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t first_line;
+    uint64_t nb_lines;
+} index_args_t;
+
+typedef struct batch_args_t
+{
+    input_t *input;
+    request_t **dpu_requests;
+    char **dpu_sequences;
+    uint32_t *dpu_nb_reads;
+    uint32_t nr_of_dpus;
+    uint32_t thread_id;
+} batch_args_t;
+
+// Estimated cost and packed size of a read pair of a batch
+typedef struct pair_info_t
+{
+    uint64_t cost;
+    uint32_t size;
+} pair_info_t;
+
+typedef struct cost_args_t
+{
+    input_t *input;
+    pair_info_t *pairs;
+    uint64_t first_pair;
+    uint32_t begin;
+    uint32_t end;
+} cost_args_t;
+
+// Records the reason the input couldn't be opened, the first one is kept
+static void set_error(char *error, const char *format, ...)
+{
+    if (error[0] != '\0')
+        return;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error, INPUT_ERROR_SIZE, format, args);
+    va_end(args);
+}
+
+// Counts the lines ending in a chunk of the file
+static void *count_lines(void *arg)
+{
+    index_args_t *args = (index_args_t *)arg;
+    const char *cur = args->data + args->begin;
+    const char *end = args->data + args->end;
+    uint64_t nb_lines = 0;
+    while (cur < end && (cur = memchr(cur, '\n', end - cur)) != NULL)
+    {
+        ++nb_lines;
+        ++cur;
+    }
+    args->nb_lines = nb_lines;
+    return NULL;
+}
+
+// Stores the beginning of the lines following the line endings of a chunk of the file
+static void *index_lines(void *arg)
+{
+    index_args_t *args = (index_args_t *)arg;
+    const char *data = args->data;
+    const char *cur = data + args->begin;
+    const char *end = data + args->end;
+    uint64_t line = args->first_line;
+    while (cur < end && (cur = memchr(cur, '\n', end - cur)) != NULL)
+    {
+        ++cur;
+        args->lines[++line] = cur - data;
+    }
+    return NULL;
+}
+
+// 2-bit code of each character, 4 for the bases stored as N
+static uint8_t base_codes[256];
+
+static void init_base_codes()
+{
+    memset(base_codes, 4, sizeof(base_codes));
+    base_codes['A'] = base_codes['a'] = 0;
+    base_codes['C'] = base_codes['c'] = 1;
+    base_codes['G'] = base_codes['g'] = 2;
+    base_codes['T'] = base_codes['t'] = 3;
+}
+
+// Packs a sequence in 2 bits per base followed by its N-mask
+static void pack_sequence(const char *sequence, int length, uint8_t *packed)
+{
+    uint8_t *mask = packed + PACKED_BASES_SIZE(length);
+    memset(packed, 0, PACKED_SIZE(length));
+    for (int i = 0; i < length; ++i)
+    {
+        uint8_t code = base_codes[(uint8_t)sequence[i]];
+        packed[i >> 2] |= (code & 3) << ((i & 3) << 1);
+        mask[i >> 3] |= (code >> 2) << (i & 7);
+    }
+}
+
+// Lengths of the sequences of a read pair
+static void pair_lengths(input_t *input, uint64_t pair, int *pattern_length, int *text_length)
+{
+    *pattern_length = input->pairs[pair].pattern_length;
+    *text_length = input->pairs[pair].text_length;
+}
+
+// Packs the read pairs placed on the DPUs assigned to a thread back to back, each request holds the offset of its sequences
+static void *fill_batch(void *arg)
+{
+    batch_args_t *args = (batch_args_t *)arg;
+    input_t *input = args->input;
+    for (uint32_t dpu = args->thread_id; dpu < args->nr_of_dpus; dpu += input->nb_threads)
+    {
+        request_t *requests = args->dpu_requests[dpu];
+        char *sequences = args->dpu_sequences[dpu];
+        uint32_t offset = 0;
+        for (uint32_t i = 0; i < args->dpu_nb_reads[dpu]; ++i)
+        {
+            uint64_t pair = requests[i].idx;
+            int pattern_length, text_length;
+            pair_lengths(input, pair, &pattern_length, &text_length);
+            requests[i].pattern_len = pattern_length;
+            requests[i].text_len = text_length;
+            requests[i].sequence_offset = offset;
+            pack_sequence(&input->patterns[input->pairs[pair].pattern_offset], pattern_length, (uint8_t *)&sequences[offset]);
+            offset += PACKED_SIZE(pattern_length);
+            pack_sequence(&input->texts[input->pairs[pair].text_offset], text_length, (uint8_t *)&sequences[offset]);
+            offset += PACKED_SIZE(text_length);
+        }
+    }
+    return NULL;
+}
+
+// Lower bound of the edit distance of a read pair from the q-gram lemma: an edit destroys at most one of the non-overlapping
+// q-grams of the pattern, so every q-gram that doesn't occur in the text around its diagonal counts as one edit
+static inline int qgram_edits(input_t *input, uint64_t pair, int pattern_length, int text_length)
+{
+    const char *pattern = &input->patterns[input->pairs[pair].pattern_offset];
+    const char *text = &input->texts[input->pairs[pair].text_offset];
+    int length_difference = ABS(text_length - pattern_length);
+    int band = length_difference + COST_QGRAM_SIZE;
+    int edits = 0;
+    for (int p = 0; p + COST_QGRAM_SIZE <= pattern_length; p += COST_QGRAM_SIZE)
+    {
+        uint64_t qgram, word;
+        memcpy(&qgram, &pattern[p], COST_QGRAM_SIZE);
+        bool found = false;
+        for (int t = MAX(0, p - band); t <= MIN(text_length - COST_QGRAM_SIZE, p + band) && !found; ++t)
+        {
+            memcpy(&word, &text[t], COST_QGRAM_SIZE);
+            found = (word == qgram);
+        }
+        edits += !found;
+    }
+    return MAX(edits, length_difference);
+}
+
+// Estimates the cost and the packed size of a range of pairs of the batch
+static void *estimate_costs(void *arg)
+{
+    cost_args_t *args = (cost_args_t *)arg;
+    for (uint32_t k = args->begin; k < args->end; ++k)
+    {
+        uint64_t pair = args->first_pair + k;
+        int pattern_length, text_length;
+        pair_lengths(args->input, pair, &pattern_length, &text_length);
+        // The edits are only estimated if the cost model of the algorithm uses them
+        args->pairs[k].cost = PAIR_COST(pattern_length, text_length, qgram_edits(args->input, pair, pattern_length, text_length));
+        args->pairs[k].size = PACKED_SIZE(pattern_length) + PACKED_SIZE(text_length);
+    }
+    return NULL;
+}
+
+static int compare_costs(const void *a, const void *b, void *arg)
+{
+    const pair_info_t *pairs = (const pair_info_t *)arg;
+    uint64_t cost_a = pairs[*(const uint32_t *)a].cost;
+    uint64_t cost_b = pairs[*(const uint32_t *)b].cost;
+    return (cost_a < cost_b) - (cost_a > cost_b);
+}
+
+// Min-heap of DPUs ordered by their estimated cost
+static void heap_sift_down(uint32_t *heap, uint32_t heap_size, uint32_t i, const uint64_t *dpu_cost)
+{
+    while (2 * i + 1 < heap_size)
+    {
+        uint32_t child = 2 * i + 1;
+        if (child + 1 < heap_size && dpu_cost[heap[child + 1]] < dpu_cost[heap[child]])
+            ++child;
+        if (dpu_cost[heap[i]] <= dpu_cost[heap[child]])
+            break;
+        uint32_t tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
+    }
+}
+
+static void heap_sift_up(uint32_t *heap, uint32_t i, const uint64_t *dpu_cost)
+{
+    while (i > 0 && dpu_cost[heap[(i - 1) / 2]] > dpu_cost[heap[i]])
+    {
+        uint32_t tmp = heap[i];
+        heap[i] = heap[(i - 1) / 2];
+        heap[(i - 1) / 2] = tmp;
+        i = (i - 1) / 2;
+    }
+}
+
+// Places the pairs of the batch, the most costly first, on the DPU with the lowest estimated cost that still has room for them.
+// Returns false if a pair doesn't fit in any DPU
+static bool place_pairs(pair_info_t *pairs, uint32_t nb_pairs, uint64_t first_pair, request_t **dpu_requests, const uint32_t *dpu_max_reads,
+                        uint32_t *dpu_nb_reads, uint32_t *dpu_sequences_size, uint64_t *dpu_cost, pair_slot_t *batch_order,
+                        uint32_t sequences_capacity, uint32_t nr_of_dpus)
+{
+    uint32_t *sorted = (uint32_t *)malloc(nb_pairs * sizeof(uint32_t));
+    for (uint32_t k = 0; k < nb_pairs; ++k)
+        sorted[k] = k;
+    qsort_r(sorted, nb_pairs, sizeof(uint32_t), compare_costs, pairs);
+
+    uint32_t heap[nr_of_dpus];
+    uint32_t heap_size = nr_of_dpus;
+    // DPUs whose sequences can't hold the current pair, they are put back in the heap once it is placed
+    uint32_t set_aside[nr_of_dpus];
+    for (uint32_t dpu = 0; dpu < nr_of_dpus; ++dpu)
+    {
+        heap[dpu] = dpu;
+        dpu_nb_reads[dpu] = 0;
+        dpu_sequences_size[dpu] = 0;
+        dpu_cost[dpu] = 0;
+    }
+    bool placed = true;
+    for (uint32_t j = 0; j < nb_pairs && placed; ++j)
+    {
+        uint32_t k = sorted[j];
+        uint32_t nb_set_aside = 0;
+        while (heap_size != 0)
+        {
+            uint32_t dpu = heap[0];
+            if (dpu_nb_reads[dpu] < dpu_max_reads[dpu] && dpu_sequences_size[dpu] + pairs[k].size <= sequences_capacity)
+                break;
+            // A DPU without free requests is full for the rest of the batch
+            if (dpu_nb_reads[dpu] < dpu_max_reads[dpu])
+                set_aside[nb_set_aside++] = dpu;
+            heap[0] = heap[--heap_size];
+            heap_sift_down(heap, heap_size, 0, dpu_cost);
+        }
+        if (heap_size == 0)
+        {
+            placed = false;
+        }
+        else
+        {
+            uint32_t dpu = heap[0];
+            uint32_t slot = dpu_nb_reads[dpu]++;
+            dpu_requests[dpu][slot].idx = first_pair + k;
+            batch_order[k] = (pair_slot_t){dpu, slot};
+            dpu_sequences_size[dpu] += pairs[k].size;
+            dpu_cost[dpu] += pairs[k].cost;
+            heap_sift_down(heap, heap_size, 0, dpu_cost);
+        }
+        for (uint32_t i = 0; i < nb_set_aside; ++i)
+        {
+            heap[heap_size++] = set_aside[i];
+            heap_sift_up(heap, heap_size - 1, dpu_cost);
+        }
+    }
+    free(sorted);
+    return placed;
+}
+
+// Places the pairs of the batch in order, dpu_nb_reads[dpu] consecutive pairs on each DPU
+static void place_pairs_in_order(pair_info_t *pairs, uint64_t first_pair, request_t **dpu_requests, uint32_t *dpu_nb_reads,
+                                 uint32_t *dpu_sequences_size, uint64_t *dpu_cost, pair_slot_t *batch_order, uint32_t nr_of_dpus)
+{
+    uint32_t k = 0;
+    for (uint32_t dpu = 0; dpu < nr_of_dpus; ++dpu)
+    {
+        dpu_sequences_size[dpu] = 0;
+        dpu_cost[dpu] = 0;
+        for (uint32_t slot = 0; slot < dpu_nb_reads[dpu]; ++slot, ++k)
+        {
+            dpu_requests[dpu][slot].idx = first_pair + k;
+            batch_order[k] = (pair_slot_t){dpu, slot};
+            dpu_sequences_size[dpu] += pairs[k].size;
+            dpu_cost[dpu] += pairs[k].cost;
+        }
+    }
+}
+
+// Block of a bgzip file, a gzip member holding at most 64 KB of the decompressed file
+typedef struct bgzf_block_t
+{
+    uint64_t in_offset;  /* Offset of the deflated data in the file */
+    uint64_t out_offset; /* Offset of the decompressed data */
+    uint32_t in_size;
+    uint32_t out_size;
+} bgzf_block_t;
+
+typedef struct inflate_args_t
+{
+    const uint8_t *in;
+    uint8_t *out;
+    const bgzf_block_t *blocks;
+    uint64_t nb_blocks;
+    uint32_t thread_id;
+    uint32_t nb_threads;
+    bool corrupted;
+} inflate_args_t;
+
+typedef struct load_args_t
+{
+    input_file_t *file;
+    const char *path;
+    uint32_t nb_threads;
+    char error[INPUT_ERROR_SIZE];
+} load_args_t;
+
+// Sequence of a file, its bases are contiguous
+typedef struct sequence_t
+{
+    uint64_t offset;
+    uint32_t length;
+} sequence_t;
+
+typedef enum input_format_t
+{
+    INPUT_PAIRS,
+    INPUT_FASTA,
+    INPUT_FASTQ,
+    INPUT_UNKNOWN,
+} input_format_t;
+
+// Indexes the blocks of a bgzip file, every member of the file must have the 'BC' extra subfield giving its size. Returns NULL if
+// the file is a plain gzip file
+static bgzf_block_t *bgzf_blocks(const uint8_t *in, size_t in_size, uint64_t *nb_blocks, uint64_t *out_size)
+{
+    uint64_t capacity = 1024, nb = 0, out = 0;
+    bgzf_block_t *blocks = (bgzf_block_t *)malloc(capacity * sizeof(bgzf_block_t));
+    size_t offset = 0;
+    while (offset < in_size)
+    {
+        // Fixed header with FEXTRA, the extra field holds a 'BC' subfield with the size of the member minus 1
+        const uint8_t *header = in + offset;
+        if (in_size - offset < 18 || header[0] != 0x1f || header[1] != 0x8b || !(header[3] & 4))
+            break;
+        uint32_t xlen = header[10] | header[11] << 8;
+        uint32_t member_size = 0;
+        for (uint32_t x = 12; x + 4 <= 12 + xlen && offset + x + 4 <= in_size; x += 4 + (header[x + 2] | header[x + 3] << 8))
+            if (header[x] == 'B' && header[x + 1] == 'C' && (header[x + 2] | header[x + 3] << 8) == 2)
+                member_size = (header[x + 4] | header[x + 5] << 8) + 1;
+        if (member_size < 12 + xlen + 8 || offset + member_size > in_size)
+            break;
+        if (nb == capacity)
+        {
+            capacity *= 2;
+            blocks = (bgzf_block_t *)realloc(blocks, capacity * sizeof(bgzf_block_t));
+        }
+        const uint8_t *trailer = in + offset + member_size - 4;
+        uint32_t isize = trailer[0] | trailer[1] << 8 | trailer[2] << 16 | (uint32_t)trailer[3] << 24;
+        blocks[nb++] = (bgzf_block_t){offset + 12 + xlen, out, member_size - 12 - xlen - 8, isize};
+        out += isize;
+        offset += member_size;
+    }
+    if (offset != in_size)
+    {
+        free(blocks);
+        return NULL;
+    }
+    *nb_blocks = nb;
+    *out_size = out;
+    return blocks;
+}
+
+// Inflates the bgzip blocks assigned to a thread at their offset in the decompressed file
+static void *inflate_blocks(void *arg)
+{
+    inflate_args_t *args = (inflate_args_t *)arg;
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    inflateInit2(&stream, -15);
+    for (uint64_t b = args->thread_id; b < args->nb_blocks; b += args->nb_threads)
+    {
+        const bgzf_block_t *block = &args->blocks[b];
+        inflateReset(&stream);
+        stream.next_in = (uint8_t *)args->in + block->in_offset;
+        stream.avail_in = block->in_size;
+        stream.next_out = args->out + block->out_offset;
+        stream.avail_out = block->out_size;
+        if (inflate(&stream, Z_FINISH) != Z_STREAM_END || stream.avail_out != 0)
+        {
+            args->corrupted = true;
+            break;
+        }
+    }
+    inflateEnd(&stream);
+    return NULL;
+}
+
+// Inflates the members of a gzip file one after the other, returns NULL if the file is corrupted
+static char *inflate_members(const uint8_t *in, size_t in_size, size_t *out_size)
+{
+    size_t capacity = 4 * in_size + (1 << 20);
+    char *out = (char *)malloc(capacity);
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    inflateInit2(&stream, 15 + 32);
+    stream.next_in = (uint8_t *)in;
+    stream.avail_in = in_size;
+    size_t size = 0;
+    int status = Z_OK;
+    while (status != Z_STREAM_END || stream.avail_in != 0)
+    {
+        // A concatenated member starts after the end of the previous one
+        if (status == Z_STREAM_END)
+            inflateReset(&stream);
+        if (size == capacity)
+        {
+            capacity *= 2;
+            out = (char *)realloc(out, capacity);
+        }
+        stream.next_out = (uint8_t *)out + size;
+        stream.avail_out = capacity - size;
+        status = inflate(&stream, Z_NO_FLUSH);
+        size = capacity - stream.avail_out;
+        if (status != Z_OK && status != Z_STREAM_END && !(status == Z_BUF_ERROR && stream.avail_out == 0))
+        {
+            inflateEnd(&stream);
+            free(out);
+            return NULL;
+        }
+    }
+    inflateEnd(&stream);
+    *out_size = size;
+    return out;
+}
+
+// Maps a file of the input, a gzip file is decompressed, by all the threads if it is a bgzip file. The reason the file couldn't be
+// loaded is set in args->error
+static void *load_file(void *arg)
+{
+    load_args_t *args = (load_args_t *)arg;
+    input_file_t *file = args->file;
+    int fd = open(args->path, O_RDONLY);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) == -1)
+    {
+        set_error(args->error, "Input file '%s' couldn't be opened", args->path);
+        if (fd != -1)
+            close(fd);
+        return NULL;
+    }
+    file->file_size = st.st_size;
+    file->file_mtime = st.st_mtime;
+    file->size = st.st_size;
+    file->data = NULL;
+    file->mapped = true;
+    file->moved = false;
+    // The mapping is private and writable, the lines of a FASTA sequence are unwrapped in place
+    if (file->size != 0)
+    {
+        file->data = (char *)mmap(NULL, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (file->data == MAP_FAILED)
+        {
+            file->data = NULL;
+            close(fd);
+            set_error(args->error, "Input file '%s' couldn't be mapped", args->path);
+            return NULL;
+        }
+        madvise(file->data, file->size, MADV_SEQUENTIAL | MADV_WILLNEED);
+    }
+    close(fd);
+
+    const uint8_t *in = (const uint8_t *)file->data;
+    if (file->size < 2 || in[0] != 0x1f || in[1] != 0x8b)
+        return NULL;
+    uint64_t nb_blocks, out_size;
+    bgzf_block_t *blocks = bgzf_blocks(in, file->size, &nb_blocks, &out_size);
+    char *out;
+    if (blocks != NULL)
+    {
+        out = (char *)malloc(MAX(out_size, 1));
+        uint32_t nb_threads = MAX(MIN(args->nb_threads, nb_blocks), 1);
+        pthread_t threads[nb_threads];
+        inflate_args_t inflate_args[nb_threads];
+        for (uint32_t t = 0; t < nb_threads; ++t)
+        {
+            inflate_args[t] = (inflate_args_t){in, (uint8_t *)out, blocks, nb_blocks, t, nb_threads, false};
+            pthread_create(&threads[t], NULL, inflate_blocks, &inflate_args[t]);
+        }
+        for (uint32_t t = 0; t < nb_threads; ++t)
+        {
+            pthread_join(threads[t], NULL);
+            if (inflate_args[t].corrupted)
+                set_error(args->error, "Input file '%s' has a corrupted bgzip block", args->path);
+        }
+        free(blocks);
+    }
+    else
+    {
+        size_t size = 0;
+        out = inflate_members(in, file->size, &size);
+        out_size = size;
+        if (out == NULL)
+            set_error(args->error, "Input file '%s' couldn't be decompressed", args->path);
+    }
+    // The compressed file stays mapped until the input is closed
+    if (args->error[0] != '\0')
+    {
+        free(out);
+        return NULL;
+    }
+    munmap(file->data, file->size);
+    file->data = out;
+    file->size = out_size;
+    file->mapped = false;
+    file->moved = true;
+    return NULL;
+}
+
+// Beginning of each line of a file, lines[nb_lines] is one past the line break of the last line
+static uint64_t *file_lines(const input_file_t *file, uint32_t nb_threads, uint64_t *nb_file_lines)
+{
+    // Count the lines of each chunk, then store the beginning of the lines at the offset given by the previous chunks
+    pthread_t threads[nb_threads];
+    index_args_t args[nb_threads];
+    for (uint32_t t = 0; t < nb_threads; ++t)
+    {
+        args[t].data = file->data;
+        args[t].begin = file->size * t / nb_threads;
+        args[t].end = file->size * (t + 1) / nb_threads;
+        pthread_create(&threads[t], NULL, count_lines, &args[t]);
+    }
+    uint64_t nb_lines = 0;
+    for (uint32_t t = 0; t < nb_threads; ++t)
+    {
+        pthread_join(threads[t], NULL);
+        args[t].first_line = nb_lines;
+        nb_lines += args[t].nb_lines;
+    }
+    // The last line may not end with a line break
+    int unterminated = file->size != 0 && file->data[file->size - 1] != '\n';
+    uint64_t *lines = (uint64_t *)malloc((nb_lines + 2) * sizeof(uint64_t));
+    lines[0] = 0;
+    for (uint32_t t = 0; t < nb_threads; ++t)
+    {
+        args[t].lines = lines;
+        pthread_create(&threads[t], NULL, index_lines, &args[t]);
+    }
+    for (uint32_t t = 0; t < nb_threads; ++t)
+        pthread_join(threads[t], NULL);
+    if (unterminated)
+        lines[++nb_lines] = file->size + 1;
+    *nb_file_lines = nb_lines;
+    return lines;
+}
+
+// Length of a line without its line break
+static inline uint32_t line_length(const char *data, const uint64_t *lines, uint64_t line)
+{
+    uint64_t end = lines[line + 1] - 1;
+    while (end > lines[line] && data[end - 1] == '\r')
+        --end;
+    return end - lines[line];
+}
+
+// Pairs file when its second line is a text line, FASTA or FASTQ file otherwise
+static input_format_t file_format(const input_file_t *file)
+{
+    const char *data = file->data;
+    if (file->size == 0)
+        return INPUT_PAIRS;
+    if (data[0] == '@')
+        return INPUT_FASTQ;
+    if (data[0] == '>')
+    {
+        const char *line_break = memchr(data, '\n', file->size);
+        if (line_break == NULL || line_break + 1 == data + file->size || line_break[1] == '<')
+            return INPUT_PAIRS;
+        return INPUT_FASTA;
+    }
+    return INPUT_UNKNOWN;
+}
+
+// Indexes the sequences of a file in their order, the lines of a FASTA sequence are moved after its first line so that its bases are
+// contiguous. Returns the number of sequences, the reason the file isn't valid is set in error
+static uint64_t index_sequences(input_file_t *file, const char *path, uint32_t nb_threads, input_format_t *format, sequence_t **file_sequences,
+                                char *error)
+{
+    *format = file_format(file);
+    if (*format == INPUT_UNKNOWN)
+    {
+        set_error(error, "Input file '%s' isn't a file of pairs, a FASTA or a FASTQ file", path);
+        return 0;
+    }
+    uint64_t nb_lines;
+    uint64_t *lines = file_lines(file, nb_threads, &nb_lines);
+    char *data = file->data;
+    // There is at most one sequence per line
+    sequence_t *sequences = (sequence_t *)malloc(MAX(nb_lines, 1) * sizeof(sequence_t));
+    uint64_t nb_sequences = 0;
+    uint64_t line = 0;
+    while (line < nb_lines)
+    {
+        uint32_t length = line_length(data, lines, line);
+        // Empty lines between the records are skipped
+        if (length == 0)
+        {
+            ++line;
+            continue;
+        }
+        char first = data[lines[line]];
+        if (*format == INPUT_PAIRS)
+        {
+            // A pattern line '>' or a text line '<' alternate, the sequence follows the first character
+            if (first != (nb_sequences % 2 == 0 ? '>' : '<'))
+            {
+                set_error(error, "Line %lu of '%s' should be a %s line", line + 1, path, nb_sequences % 2 == 0 ? "pattern" : "text");
+                break;
+            }
+            sequences[nb_sequences++] = (sequence_t){lines[line] + 1, length - 1};
+            ++line;
+        }
+        else if (*format == INPUT_FASTQ)
+        {
+            // A header line '@', the sequence line, a separator line '+' and the quality line
+            if (first != '@' || line + 2 >= nb_lines || data[lines[line + 2]] != '+')
+            {
+                set_error(error, "Line %lu of '%s' isn't the beginning of a FASTQ record", line + 1, path);
+                break;
+            }
+            sequences[nb_sequences++] = (sequence_t){lines[line + 1], line_length(data, lines, line + 1)};
+            line += 4;
+        }
+        else
+        {
+            // A header line '>' followed by the lines of the sequence until the next header
+            if (first != '>')
+            {
+                set_error(error, "Line %lu of '%s' isn't a FASTA header", line + 1, path);
+                break;
+            }
+            ++line;
+            uint64_t offset = line < nb_lines ? lines[line] : file->size;
+            uint64_t sequence_length = 0;
+            for (; line < nb_lines && data[lines[line]] != '>'; ++line)
+            {
+                uint32_t part = line_length(data, lines, line);
+                if (lines[line] != offset + sequence_length && part != 0)
+                {
+                    memmove(&data[offset + sequence_length], &data[lines[line]], part);
+                    file->moved = true;
+                }
+                sequence_length += part;
+            }
+            if (sequence_length > UINT32_MAX)
+            {
+                set_error(error, "A sequence of '%s' is too long", path);
+                break;
+            }
+            sequences[nb_sequences++] = (sequence_t){offset, sequence_length};
+        }
+    }
+    free(lines);
+    if (error[0] != '\0')
+    {
+        free(sequences);
+        return 0;
+    }
+    *file_sequences = sequences;
+    return nb_sequences;
+}
+
+// Loads the index of the pairs from index_path, returns false if it doesn't exist or, with the reason in input->error, if it can't be
+// loaded. The bases are the ones stored in the index, or the ones of the input files otherwise
+static bool load_index(input_t *input, const char *index_path, const char **paths)
+{
+    int fd = open(index_path, O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(index_header_t))
+    {
+        set_error(input->error, "Index file '%s' is truncated", index_path);
+        close(fd);
+        return false;
+    }
+    input->index_size = st.st_size;
+    input->index_map = (uint8_t *)mmap(NULL, input->index_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (input->index_map == MAP_FAILED)
+    {
+        input->index_map = NULL;
+        set_error(input->error, "Index file '%s' couldn't be mapped", index_path);
+        return false;
+    }
+
+    const index_header_t *header = (const index_header_t *)input->index_map;
+    if (memcmp(header->magic, INDEX_MAGIC, sizeof(header->magic)) != 0 || header->nb_files != input->nb_files ||
+        sizeof(index_header_t) + header->nb_pairs * sizeof(pair_index_t) + header->sequences_size[0] + header->sequences_size[1] > input->index_size)
+    {
+        set_error(input->error, "Index file '%s' isn't an index of the %u input file(s)", index_path, input->nb_files);
+        return false;
+    }
+    for (uint32_t f = 0; f < input->nb_files; ++f)
+    {
+        if (stat(paths[f], &st) == -1)
+        {
+            set_error(input->error, "Input file '%s' couldn't be opened", paths[f]);
+            return false;
+        }
+        if ((uint64_t)st.st_size != header->file_size[f] || st.st_mtime != header->file_mtime[f])
+        {
+            set_error(input->error, "Index file '%s' was built from another version of '%s', remove it to index the input again", index_path, paths[f]);
+            return false;
+        }
+    }
+    input->pairs = (pair_index_t *)(input->index_map + sizeof(index_header_t));
+    input->nb_pairs = header->nb_pairs;
+    input->nb_bases = header->nb_bases;
+    input->size = header->input_size;
+    if (header->flags & INDEX_SEQUENCES)
+    {
+        input->patterns = (const char *)(input->pairs + input->nb_pairs);
+        input->texts = input->patterns + header->sequences_size[0];
+        return true;
+    }
+    for (uint32_t f = 0; f < input->nb_files; ++f)
+    {
+        load_args_t args = {&input->files[f], paths[f], input->nb_threads, ""};
+        load_file(&args);
+        set_error(input->error, "%s", args.error);
+    }
+    input->patterns = input->files[0].data;
+    input->texts = input->files[input->nb_files - 1].data;
+    return input->error[0] == '\0';
+}
+
+// Writes the index of the pairs to index_path. When the bases were moved from their place in the files, the bases of the patterns and of
+// the texts are written after the pairs and the offsets of the pairs refer to them. The reason the index couldn't be written is set in
+// input->error
+static void write_index(input_t *input, const char *index_path)
+{
+    index_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.nb_files = input->nb_files;
+    header.nb_pairs = input->nb_pairs;
+    header.nb_bases = input->nb_bases;
+    header.input_size = input->size;
+    for (uint32_t f = 0; f < input->nb_files; ++f)
+    {
+        header.file_size[f] = input->files[f].file_size;
+        header.file_mtime[f] = input->files[f].file_mtime;
+        if (input->files[f].moved)
+            header.flags = INDEX_SEQUENCES;
+    }
+    FILE *file = fopen(index_path, "w");
+    if (file == NULL)
+    {
+        set_error(input->error, "Index file '%s' couldn't be created", index_path);
+        return;
+    }
+    bool written;
+    if (header.flags & INDEX_SEQUENCES)
+    {
+        pair_index_t *pairs = (pair_index_t *)malloc(MAX(input->nb_pairs, 1) * sizeof(pair_index_t));
+        for (uint64_t p = 0; p < input->nb_pairs; ++p)
+        {
+            pairs[p] = input->pairs[p];
+            pairs[p].pattern_offset = header.sequences_size[0];
+            pairs[p].text_offset = header.sequences_size[1];
+            header.sequences_size[0] += pairs[p].pattern_length;
+            header.sequences_size[1] += pairs[p].text_length;
+        }
+        written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(pairs, sizeof(pair_index_t), input->nb_pairs, file) == input->nb_pairs;
+        for (uint64_t p = 0; p < input->nb_pairs && written; ++p)
+            written = fwrite(&input->patterns[input->pairs[p].pattern_offset], 1, input->pairs[p].pattern_length, file) == input->pairs[p].pattern_length;
+        for (uint64_t p = 0; p < input->nb_pairs && written; ++p)
+            written = fwrite(&input->texts[input->pairs[p].text_offset], 1, input->pairs[p].text_length, file) == input->pairs[p].text_length;
+        free(pairs);
+    }
+    else
+    {
+        written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(input->pairs, sizeof(pair_index_t), input->nb_pairs, file) == input->nb_pairs;
+    }
+    if (fclose(file) != 0 || !written)
+        set_error(input->error, "Index file '%s' couldn't be written", index_path);
+}
+
+static void init_input(input_t *input, uint32_t read_size)
+{
+    memset(input, 0, sizeof(*input));
+    input->read_size = read_size;
+    init_base_codes();
+
+    input->nb_threads = NR_HOST_THREADS;
+    if (input->nb_threads == 0)
+        input->nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (input->nb_threads == 0)
+        input->nb_threads = 1;
+}
+
+// Loads the files of the input and indexes their pairs, the reason they couldn't be indexed is set in input->error
+static void index_files(input_t *input, const char **paths)
+{
+    // The files are loaded in the background in parallel, then their sequences are indexed
+    pthread_t threads[2];
+    load_args_t args[2];
+    for (uint32_t f = 0; f < input->nb_files; ++f)
+    {
+        args[f] = (load_args_t){&input->files[f], paths[f], input->nb_threads, ""};
+        pthread_create(&threads[f], NULL, load_file, &args[f]);
+    }
+    for (uint32_t f = 0; f < input->nb_files; ++f)
+    {
+        pthread_join(threads[f], NULL);
+        set_error(input->error, "%s", args[f].error);
+    }
+    sequence_t *sequences[2] = {NULL, NULL};
+    uint64_t nb_sequences[2] = {0, 0};
+    input_format_t formats[2] = {INPUT_PAIRS, INPUT_PAIRS};
+    for (uint32_t f = 0; f < input->nb_files && input->error[0] == '\0'; ++f)
+    {
+        nb_sequences[f] = index_sequences(&input->files[f], paths[f], input->nb_threads, &formats[f], &sequences[f], input->error);
+        input->size += input->files[f].size;
+    }
+
+    // The patterns and the texts alternate in a single file, they are the sequences of the same rank in two files
+    uint32_t stride = 2;
+    input->nb_pairs = nb_sequences[0] / 2;
+    if (input->nb_files == 2 && input->error[0] == '\0')
+    {
+        if (formats[0] == INPUT_PAIRS || formats[1] == INPUT_PAIRS)
+            set_error(input->error, "The patterns and the texts of separate input files must be in FASTA or FASTQ files");
+        else if (nb_sequences[0] != nb_sequences[1])
+            set_error(input->error, "Input files '%s' and '%s' don't have the same number of sequences", paths[0], paths[1]);
+        stride = 1;
+        input->nb_pairs = nb_sequences[0];
+    }
+    if (input->error[0] != '\0')
+    {
+        for (uint32_t f = 0; f < input->nb_files; ++f)
+            free(sequences[f]);
+        input->nb_pairs = 0;
+        return;
+    }
+    const sequence_t *texts = input->nb_files == 2 ? sequences[1] : sequences[0] + 1;
+    input->pairs = (pair_index_t *)malloc(MAX(input->nb_pairs, 1) * sizeof(pair_index_t));
+    for (uint64_t p = 0; p < input->nb_pairs; ++p)
+    {
+        const sequence_t *pattern = &sequences[0][stride * p];
+        const sequence_t *text = &texts[stride * p];
+        input->pairs[p] = (pair_index_t){pattern->offset, text->offset, pattern->length, text->length};
+        input->nb_bases += pattern->length + text->length;
+    }
+    for (uint32_t f = 0; f < input->nb_files; ++f)
+        free(sequences[f]);
+    input->patterns = input->files[0].data;
+    input->texts = input->files[input->nb_files - 1].data;
+}
+
+bool open_input(input_t *input, const char *path, const char *texts_path, const char *index_path, uint32_t read_size)
+{
+    init_input(input, read_size);
+
+    const char *paths[2] = {path, texts_path};
+    input->nb_files = texts_path != NULL ? 2 : 1;
+    if ((index_path == NULL || !load_index(input, index_path, paths)) && input->error[0] == '\0')
+    {
+        index_files(input, paths);
+        if (index_path != NULL && input->error[0] == '\0')
+            write_index(input, index_path);
+    }
+
+    // The reads are checked before the first batch, so that a job fails before it writes any pair
+    for (uint64_t p = 0; p < input->nb_pairs && input->error[0] == '\0'; ++p)
+        if (input->pairs[p].pattern_length > read_size || input->pairs[p].text_length > read_size)
+            set_error(input->error, "Read pair %lu is longer than the read size %u", p, read_size);
+    if (input->error[0] == '\0')
+        return true;
+    close_input(input);
+    return false;
+}
+
+void get_input_batch(input_t *input, request_t **dpu_requests, char **dpu_sequences, uint32_t *dpu_nb_reads, uint32_t *dpu_sequences_size,
+                     uint64_t *dpu_cost, pair_slot_t *batch_order, uint32_t sequences_capacity, uint32_t nr_of_dpus)
+{
+    // The batch holds the pairs that fit when they are assigned in order, a DPU takes pairs until it has dpu_nb_reads[dpu] pairs
+    // or its sequences are full
+    uint64_t first_pair = input->next_pair;
+    uint32_t dpu_max_reads[nr_of_dpus];
+    for (uint32_t dpu = 0; dpu < nr_of_dpus; ++dpu)
+    {
+        dpu_max_reads[dpu] = dpu_nb_reads[dpu];
+        uint32_t nb_reads = 0;
+        uint32_t size = 0;
+        while (nb_reads < dpu_nb_reads[dpu] && input->next_pair < input->nb_pairs)
+        {
+            int pattern_length, text_length;
+            pair_lengths(input, input->next_pair, &pattern_length, &text_length);
+            uint32_t pair_size = PACKED_SIZE(pattern_length) + PACKED_SIZE(text_length);
+            if (size + pair_size > sequences_capacity)
+                break;
+            size += pair_size;
+            ++nb_reads;
+            ++input->next_pair;
+        }
+        dpu_nb_reads[dpu] = nb_reads;
+    }
+    uint32_t nb_pairs = input->next_pair - first_pair;
+
+    // The costs are estimated in parallel, then the pairs are balanced between the DPUs.
+    // In the rare case the balanced placement doesn't fit in the sequences of the DPUs, the pairs are placed in order
+    pair_info_t *pairs = (pair_info_t *)malloc(MAX(nb_pairs, 1) * sizeof(pair_info_t));
+    uint32_t nb_cost_threads = input->nb_threads;
+    pthread_t cost_threads[nb_cost_threads];
+    cost_args_t cost_args[nb_cost_threads];
+    for (uint32_t t = 0; t < nb_cost_threads; ++t)
+    {
+        cost_args[t] = (cost_args_t){input, pairs, first_pair, (uint64_t)nb_pairs * t / nb_cost_threads, (uint64_t)nb_pairs * (t + 1) / nb_cost_threads};
+        pthread_create(&cost_threads[t], NULL, estimate_costs, &cost_args[t]);
+    }
+    for (uint32_t t = 0; t < nb_cost_threads; ++t)
+        pthread_join(cost_threads[t], NULL);
+    uint32_t dpu_in_order_reads[nr_of_dpus];
+    memcpy(dpu_in_order_reads, dpu_nb_reads, sizeof(dpu_in_order_reads));
+    if (!COST_PLACEMENT || !place_pairs(pairs, nb_pairs, first_pair, dpu_requests, dpu_max_reads, dpu_nb_reads, dpu_sequences_size, dpu_cost,
+                                        batch_order, sequences_capacity, nr_of_dpus))
+    {
+        memcpy(dpu_nb_reads, dpu_in_order_reads, sizeof(dpu_in_order_reads));
+        place_pairs_in_order(pairs, first_pair, dpu_requests, dpu_nb_reads, dpu_sequences_size, dpu_cost, batch_order, nr_of_dpus);
+    }
+    free(pairs);
+
+    uint32_t nb_threads = MIN(input->nb_threads, nr_of_dpus);
+    pthread_t threads[nb_threads];
+    batch_args_t args[nb_threads];
+    for (uint32_t t = 0; t < nb_threads; ++t)
+    {
+        args[t] = (batch_args_t){input, dpu_requests, dpu_sequences, dpu_nb_reads, nr_of_dpus, t};
+        pthread_create(&threads[t], NULL, fill_batch, &args[t]);
+    }
+    for (uint32_t t = 0; t < nb_threads; ++t)
+        pthread_join(threads[t], NULL);
+}
+
+void open_memory_input(input_t *input, const char *patterns, const char *texts, pair_index_t *pairs, uint64_t nb_pairs, uint32_t read_size)
+{
+    init_input(input, read_size);
+    input->patterns = patterns;
+    input->texts = texts;
+    input->pairs = pairs;
+    input->nb_pairs = nb_pairs;
+    for (uint64_t p = 0; p < nb_pairs; ++p)
+        input->nb_bases += pairs[p].pattern_length + pairs[p].text_length;
+    input->size = input->nb_bases;
+}
+
+uint64_t input_bytes_read(input_t *input)
+{
+    return input->nb_pairs != 0 ? input->size * input->next_pair / input->nb_pairs : 0;
+}
+
+void close_input(input_t *input)
+{
+    for (uint32_t f = 0; f < input->nb_files; ++f)
+    {
+        if (input->files[f].mapped && input->files[f].data != NULL)
+            munmap(input->files[f].data, input->files[f].size);
+        else if (!input->files[f].mapped)
+            free(input->files[f].data);
+    }
+    if (input->index_map != NULL)
+        munmap(input->index_map, input->index_size);
+    else
+        free(input->pairs);
+}
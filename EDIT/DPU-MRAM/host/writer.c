@@ -0,0 +1,465 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "writer.h"
+
+// Longest line of a pair without its CIGAR in any format, and longest text of a run of its CIGAR
+#define OUTPUT_LINE_SIZE 256
+#define OUTPUT_RUN_SIZE 12
+
+// Operations of the CIGARs of the text format, and of the SAM and PAF formats where the pattern is the query: an insertion in the text
+// is a deletion from the query
+#define TEXT_CIGAR_OPS "MXID"
+#define SAM_CIGAR_OPS "=XDI"
+
+typedef struct format_args_t
+{
+    output_t *output;
+    request_t **dpu_requests;
+    result_t **dpu_results;
+    uint8_t **dpu_cigars;
+    const pair_slot_t *batch_order;
+    uint32_t begin;
+    uint32_t end;
+    uint32_t thread_id;
+    uint64_t cigar_offset; /* Offset in the CIGARs of the binary output of the CIGARs of the range */
+    size_t failed_size;    /* Size of the buffer of the thread that couldn't be allocated */
+} format_args_t;
+
+// Records the reason the output couldn't be opened or written
+static void set_error(output_t *output, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(output->error, sizeof(output->error), format, args);
+    va_end(args);
+}
+
+// Writes the decimal digits of value at out, returns the end of the digits
+static inline char *format_int(char *out, int value)
+{
+    char digits[12];
+    int nb_digits = 0;
+    uint32_t magnitude = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+    if (value < 0)
+        *out++ = '-';
+    do
+    {
+        digits[nb_digits++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude != 0);
+    while (nb_digits > 0)
+        *out++ = digits[--nb_digits];
+    return out;
+}
+
+static inline char *format_field(char *out, int value)
+{
+    out = format_int(out, value);
+    *out++ = ',';
+    *out++ = ' ';
+    return out;
+}
+
+static inline char *format_column(char *out, int value)
+{
+    out = format_int(out, value);
+    *out++ = '\t';
+    return out;
+}
+
+static inline char *format_string(char *out, const char *s)
+{
+    size_t length = strlen(s);
+    memcpy(out, s, length);
+    return out + length;
+}
+
+// Writes the operations of a CIGAR named by ops, the consecutive runs of an operation are merged
+static inline char *format_cigar(char *out, const uint8_t *runs, uint32_t nb_runs, const char *ops)
+{
+    uint32_t r = 0;
+    while (r < nb_runs)
+    {
+        int code = runs[r] & 3;
+        int length = 0;
+        for (; r < nb_runs && (runs[r] & 3) == code; ++r)
+            length += CIGAR_RUN_LENGTH(runs[r]);
+        out = format_int(out, length);
+        *out++ = ops[code];
+    }
+    return out;
+}
+
+// Record of the alignment of a pair, the span is the whole sequences for global alignments
+static inline output_record_t make_record(const output_t *output, const request_t *request, const result_t *result)
+{
+    output_record_t record = {result->idx, result->score, 0, request->pattern_len, 0, request->text_len, 0, 0, 0};
+    if (output->span)
+    {
+        record.pattern_begin = result->pattern_begin;
+        record.pattern_end = result->pattern_end;
+        record.text_begin = result->text_begin;
+        record.text_end = result->text_end;
+    }
+    if (output->cigar)
+        record.cigar_length = result->cigar_length;
+    if (SCORE_REJECTED(result->score, output->max_score))
+        record.flags |= OUTPUT_RECORD_REJECTED;
+    return record;
+}
+
+// PAF line: query and reference names, lengths and spans, matches, alignment length, mapping quality and the edits, score and CIGAR
+// tags. The score is negated so that higher is better
+static char *format_paf(char *out, const output_record_t *record, const request_t *request, const uint8_t *runs)
+{
+    int matches = 0, length = 0;
+    for (uint32_t r = 0; r < record->cigar_length; ++r)
+    {
+        length += CIGAR_RUN_LENGTH(runs[r]);
+        if (CIGAR_RUN_OP(runs[r]) == 'M')
+            matches += CIGAR_RUN_LENGTH(runs[r]);
+    }
+    out = format_column(out, (int)record->idx);
+    out = format_column(out, request->pattern_len);
+    out = format_column(out, record->pattern_begin);
+    out = format_column(out, record->pattern_end);
+    out = format_string(out, "+\t");
+    out = format_column(out, (int)record->idx);
+    out = format_column(out, request->text_len);
+    out = format_column(out, record->text_begin);
+    out = format_column(out, record->text_end);
+    out = format_column(out, matches);
+    out = format_column(out, length);
+    out = format_string(out, "255\tNM:i:");
+    out = format_int(out, length - matches);
+    out = format_string(out, "\tAS:i:");
+    out = format_int(out, -record->score);
+    out = format_string(out, "\tcg:Z:");
+    out = format_cigar(out, runs, record->cigar_length, SAM_CIGAR_OPS);
+    *out++ = '\n';
+    return out;
+}
+
+// SAM record without the sequences, the bases of the pattern out of the alignment are soft-clipped. A pair above the max score is unmapped
+static char *format_sam(char *out, const output_record_t *record, const request_t *request, const uint8_t *runs)
+{
+    out = format_column(out, (int)record->idx);
+    if (record->flags & OUTPUT_RECORD_REJECTED)
+    {
+        out = format_string(out, "4\t*\t0\t0\t*\t*\t0\t0\t*\t*\n");
+        return out;
+    }
+    int edits = 0;
+    for (uint32_t r = 0; r < record->cigar_length; ++r)
+        if (CIGAR_RUN_OP(runs[r]) != 'M')
+            edits += CIGAR_RUN_LENGTH(runs[r]);
+    out = format_string(out, "0\t");
+    out = format_column(out, (int)record->idx);
+    out = format_column(out, record->text_begin + 1);
+    out = format_string(out, "255\t");
+    if (record->pattern_begin > 0)
+    {
+        out = format_int(out, record->pattern_begin);
+        *out++ = 'S';
+    }
+    out = format_cigar(out, runs, record->cigar_length, SAM_CIGAR_OPS);
+    if (record->pattern_end < request->pattern_len)
+    {
+        out = format_int(out, request->pattern_len - record->pattern_end);
+        *out++ = 'S';
+    }
+    out = format_string(out, "\t*\t0\t0\t*\t*\tNM:i:");
+    out = format_int(out, edits);
+    out = format_string(out, "\tAS:i:");
+    out = format_int(out, -record->score);
+    *out++ = '\n';
+    return out;
+}
+
+// Formats the lines of the pairs [begin, end) of the batch into the buffer of the thread
+static void *format_results(void *arg)
+{
+    format_args_t *args = (format_args_t *)arg;
+    output_t *output = args->output;
+    uint32_t t = args->thread_id;
+    size_t size = 0;
+    for (uint32_t k = args->begin; k < args->end; ++k)
+    {
+        const request_t *request = &args->dpu_requests[args->batch_order[k].dpu][args->batch_order[k].slot];
+        const result_t *result = &args->dpu_results[args->batch_order[k].dpu][args->batch_order[k].slot];
+        output_record_t record = make_record(output, request, result);
+        const uint8_t *runs = output->cigar ? &args->dpu_cigars[args->batch_order[k].dpu][result->cigar_offset] : NULL;
+        // PAF has no line for the pairs above the max score
+        if (output->format == OUTPUT_PAF && (record.flags & OUTPUT_RECORD_REJECTED))
+            continue;
+        size_t line_size = OUTPUT_LINE_SIZE + (size_t)record.cigar_length * OUTPUT_RUN_SIZE;
+        if (size + line_size > output->capacities[t])
+        {
+            size_t capacity = MAX(2 * output->capacities[t], size + line_size);
+            char *buffer = (char *)realloc(output->buffers[t], capacity);
+            if (buffer == NULL)
+            {
+                args->failed_size = capacity;
+                break;
+            }
+            output->buffers[t] = buffer;
+            output->capacities[t] = capacity;
+        }
+        char *out = output->buffers[t] + size;
+        if (output->format == OUTPUT_PAF)
+            out = format_paf(out, &record, request, runs);
+        else if (output->format == OUTPUT_SAM)
+            out = format_sam(out, &record, request, runs);
+        else
+        {
+            // The span of the alignment is only written when it isn't the whole sequences
+            out = format_field(out, (int)record.idx);
+            out = format_field(out, record.score);
+            if (output->span)
+            {
+                out = format_field(out, record.pattern_begin);
+                out = format_field(out, record.pattern_end);
+                out = format_field(out, record.text_begin);
+                out = format_field(out, record.text_end);
+            }
+            *out++ = '\n';
+            if (output->cigar)
+            {
+                out = format_cigar(out, runs, record.cigar_length, TEXT_CIGAR_OPS);
+                *out++ = '\n';
+            }
+        }
+        size = out - output->buffers[t];
+    }
+    output->sizes[t] = size;
+    return NULL;
+}
+
+// Writes the records of the pairs [begin, end) of the batch at their index, and their CIGARs from the offset of the range
+static void *format_records(void *arg)
+{
+    format_args_t *args = (format_args_t *)arg;
+    output_t *output = args->output;
+    output_record_t *records = (output_record_t *)(output->map + sizeof(output_header_t));
+    uint8_t *cigars = output->map + output->cigars_offset;
+    uint64_t cigar_offset = args->cigar_offset;
+    for (uint32_t k = args->begin; k < args->end; ++k)
+    {
+        const request_t *request = &args->dpu_requests[args->batch_order[k].dpu][args->batch_order[k].slot];
+        const result_t *result = &args->dpu_results[args->batch_order[k].dpu][args->batch_order[k].slot];
+        output_record_t record = make_record(output, request, result);
+        record.cigar_offset = cigar_offset;
+        records[record.idx] = record;
+        if (record.cigar_length != 0)
+            memcpy(&cigars[cigar_offset], &args->dpu_cigars[args->batch_order[k].dpu][result->cigar_offset], record.cigar_length);
+        cigar_offset += record.cigar_length;
+    }
+    return NULL;
+}
+
+bool parse_output_format(const char *arg, output_format_t *format)
+{
+    const char *names[] = {"text", "paf", "sam", "binary"};
+    for (int f = OUTPUT_TEXT; f <= OUTPUT_BINARY; ++f)
+    {
+        if (strcmp(arg, names[f]) == 0)
+        {
+            *format = (output_format_t)f;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Grows the binary output file and its mapping to at least size bytes, returns false if it can't be grown
+static bool grow_binary_output(output_t *output, size_t size)
+{
+    if (size <= output->map_size)
+        return true;
+    size_t map_size = MAX(2 * output->map_size, size);
+    if (ftruncate(output->fd, map_size) != 0)
+    {
+        set_error(output, "Output file couldn't be grown to %zu bytes", map_size);
+        return false;
+    }
+    uint8_t *map = (uint8_t *)mremap(output->map, output->map_size, map_size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED)
+    {
+        set_error(output, "Output file of %zu bytes couldn't be mapped", map_size);
+        return false;
+    }
+    output->map = map;
+    output->map_size = map_size;
+    return true;
+}
+
+bool open_output(output_t *output, const char *path, output_format_t format, bool span, bool cigar, uint32_t max_score, const pair_index_t *pairs,
+                 uint64_t nb_records)
+{
+    output->format = format;
+    output->span = span;
+    output->cigar = cigar;
+    output->max_score = max_score;
+    output->bytes_written = 0;
+    output->nb_threads = NR_HOST_THREADS;
+    if (output->nb_threads == 0)
+        output->nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (output->nb_threads == 0)
+        output->nb_threads = 1;
+    output->file = NULL;
+    output->map = NULL;
+    output->buffers = NULL;
+    output->capacities = NULL;
+    output->sizes = NULL;
+    output->error[0] = '\0';
+    if (format == OUTPUT_BINARY)
+    {
+        // The records are at the index of their pair, so the file is sized for all of them and the CIGARs grow it
+        output->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (output->fd < 0)
+        {
+            set_error(output, "Output file '%s' couldn't be opened", path);
+            return false;
+        }
+        output->nb_records = nb_records;
+        output->cigars_offset = sizeof(output_header_t) + nb_records * sizeof(output_record_t);
+        output->cigars_size = 0;
+        output->map_size = output->cigars_offset;
+        if (ftruncate(output->fd, output->map_size) != 0)
+        {
+            set_error(output, "Output file '%s' couldn't be sized to %zu bytes", path, output->map_size);
+            close(output->fd);
+            return false;
+        }
+        output->map = (uint8_t *)mmap(NULL, output->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, output->fd, 0);
+        if (output->map == MAP_FAILED)
+        {
+            set_error(output, "Output file '%s' couldn't be mapped", path);
+            close(output->fd);
+            return false;
+        }
+        return true;
+    }
+
+    output->file = fopen(path, "w");
+    if (output->file == NULL)
+    {
+        set_error(output, "Output file '%s' couldn't be opened", path);
+        return false;
+    }
+    output->buffers = (char **)malloc(output->nb_threads * sizeof(char *));
+    output->capacities = (size_t *)malloc(output->nb_threads * sizeof(size_t));
+    output->sizes = (size_t *)malloc(output->nb_threads * sizeof(size_t));
+    for (uint32_t t = 0; t < output->nb_threads; ++t)
+    {
+        output->capacities[t] = OUTPUT_BUFFER_SIZE;
+        output->buffers[t] = (char *)malloc(OUTPUT_BUFFER_SIZE);
+    }
+    if (format == OUTPUT_SAM)
+    {
+        // The text of each pair is a reference named after the number of the pair
+        output->bytes_written += fprintf(output->file, "@HD\tVN:1.6\tSO:unsorted\n");
+        for (uint64_t p = 0; p < nb_records; ++p)
+            output->bytes_written += fprintf(output->file, "@SQ\tSN:%lu\tLN:%u\n", p, pairs[p].text_length);
+        output->bytes_written += fprintf(output->file, "@PG\tID:aim\tPN:aim\n");
+    }
+    return true;
+}
+
+bool write_output_batch(output_t *output, request_t **dpu_requests, result_t **dpu_results, uint8_t **dpu_cigars, const pair_slot_t *batch_order,
+                        uint32_t batch_nb_reads)
+{
+    // Each thread formats a contiguous range of the batch, so the buffers are written in the order of the threads
+    uint32_t nb_threads = MIN(output->nb_threads, batch_nb_reads);
+    pthread_t threads[nb_threads];
+    format_args_t args[nb_threads];
+    uint64_t cigars_size = 0;
+    for (uint32_t t = 0; t < nb_threads; ++t)
+    {
+        args[t] = (format_args_t){output, dpu_requests, dpu_results, dpu_cigars, batch_order, (uint64_t)batch_nb_reads * t / nb_threads,
+                                  (uint64_t)batch_nb_reads * (t + 1) / nb_threads, t, output->cigars_size + cigars_size, 0};
+        if (output->format != OUTPUT_BINARY)
+            continue;
+        for (uint32_t k = args[t].begin; k < args[t].end; ++k)
+        {
+            const result_t *result = &dpu_results[batch_order[k].dpu][batch_order[k].slot];
+            if (result->idx >= output->nb_records)
+            {
+                set_error(output, "Pair %u is past the %lu records of the output", result->idx, output->nb_records);
+                return false;
+            }
+            if (output->cigar)
+                cigars_size += result->cigar_length;
+        }
+    }
+    if (output->format == OUTPUT_BINARY)
+    {
+        // The CIGARs of the batch follow the ones of the previous batches, the file is grown before the threads write them
+        if (!grow_binary_output(output, output->cigars_offset + output->cigars_size + cigars_size))
+            return false;
+        for (uint32_t t = 0; t < nb_threads; ++t)
+            pthread_create(&threads[t], NULL, format_records, &args[t]);
+        for (uint32_t t = 0; t < nb_threads; ++t)
+            pthread_join(threads[t], NULL);
+        output->cigars_size += cigars_size;
+        output->bytes_written += (uint64_t)batch_nb_reads * sizeof(output_record_t) + cigars_size;
+        return true;
+    }
+
+    for (uint32_t t = 0; t < nb_threads; ++t)
+        pthread_create(&threads[t], NULL, format_results, &args[t]);
+    for (uint32_t t = 0; t < nb_threads; ++t)
+        pthread_join(threads[t], NULL);
+    for (uint32_t t = 0; t < nb_threads; ++t)
+    {
+        if (args[t].failed_size != 0)
+        {
+            set_error(output, "Output buffer of %zu bytes couldn't be allocated", args[t].failed_size);
+            return false;
+        }
+    }
+    for (uint32_t t = 0; t < nb_threads; ++t)
+    {
+        if (fwrite(output->buffers[t], 1, output->sizes[t], output->file) != output->sizes[t])
+        {
+            set_error(output, "Output file couldn't be written");
+            return false;
+        }
+        output->bytes_written += output->sizes[t];
+    }
+    return true;
+}
+
+void close_output(output_t *output)
+{
+    if (output->format == OUTPUT_BINARY)
+    {
+        // The header is written last with the size of the CIGARs, and the file is cut to its content
+        output_header_t header = {{0}, sizeof(output_record_t), 0, output->nb_records, output->cigars_offset, output->cigars_size};
+        memcpy(header.magic, OUTPUT_BINARY_MAGIC, sizeof(header.magic));
+        if (output->span)
+            header.flags |= OUTPUT_BINARY_SPAN;
+        if (output->cigar)
+            header.flags |= OUTPUT_BINARY_CIGAR;
+        memcpy(output->map, &header, sizeof(output_header_t));
+        output->bytes_written += sizeof(output_header_t);
+        munmap(output->map, output->map_size);
+        if (ftruncate(output->fd, output->cigars_offset + output->cigars_size) != 0)
+            fprintf(stderr, "Output file couldn't be cut to its content\n");
+        close(output->fd);
+        return;
+    }
+    for (uint32_t t = 0; t < output->nb_threads; ++t)
+        free(output->buffers[t]);
+    free(output->buffers);
+    free(output->capacities);
+    free(output->sizes);
+    fclose(output->file);
+}
@@ -0,0 +1,128 @@
+import argparse
+from curses import echo
+import math
+import os
+
+ap = argparse.ArgumentParser()
+ap.add_argument("-i", "--input", type=str, required=True,
+                help="Input read pairs file path")
+ap.add_argument("-o", "--output", type=str,
+                help="Output alignment file path", default="./out")
+ap.add_argument("-l", "--read_length", required=True,
+                type=int, help="Read Length")
+ap.add_argument("-e", "--error", type=float, required=True,
+                help="Percentage error per read length")
+ap.add_argument("-n", "--number_reads", type=int, required=True,
+                help="Number of read pairs to be aligned")
+ap.add_argument("-b", "--backtrace", action='store_true',
+                help="Enable backtracing")
+ap.add_argument("-F", "--format", type=str, default="text",
+                help="Format of the output file: text, paf, sam (with -b) or binary")
+ap.add_argument("-T", "--texts", type=str,
+                help="FASTA or FASTQ file of the texts, the input file then holds the patterns (optional)")
+ap.add_argument("-X", "--index", type=str,
+                help="Index file of the pairs, written on the first run and loaded by the next ones (optional)")
+ap.add_argument("-t", "--nr_of_tasklets", type=int,
+                help="NR_TASKLETS (optional)")
+ap.add_argument("-d", "--nr_of_dpus", type=int,
+                help="NR_DPUs to allocate (default=1)")
+args = vars(ap.parse_args())
+
+if args["format"] not in ["text", "paf", "sam", "binary"] or (args["format"] in ["paf", "sam"] and not args["backtrace"]):
+    print("Wrong format " + args["format"] + ", it must be text, binary, or paf or sam with -b\n")
+    exit(-1)
+
+
+read_length = args["read_length"]
+if read_length <= 0:
+    print("Undefined input read length")
+    exit(-1)
+
+number_reads = args["number_reads"]
+if number_reads <= 0:
+    print("Undefined number of input reads")
+    exit(-1)
+
+# The edit distance has unit costs
+nr_of_wrong_bases = read_length * args["error"]
+max_score = math.ceil(nr_of_wrong_bases)
+
+read_length = math.ceil((((read_length + nr_of_wrong_bases) + 7)/8))*8
+# patterns and texts are 2-bit packed and followed by a 1-bit N-mask
+packed_length = math.ceil(read_length/32)*8 + math.ceil(read_length/64)*8 + 8
+
+# A column of the DP-table holds two 32-bit words per block of 32 bases of the pattern, and the bits of the pattern 5 words per block
+blocks = math.ceil(read_length/32)
+column = blocks*8
+pattern_bits = math.ceil(blocks*20/8)*8
+
+# WRAM used memory upper limit, the current column and the column left of it for the backtrace
+memory_upper_limit = 100 + 2*packed_length + pattern_bits + (2 if args["backtrace"] else 1)*column
+if args["backtrace"]:
+    memory_upper_limit = memory_upper_limit + 2 * read_length
+memory_upper_limit = int(math.ceil((((memory_upper_limit) + 7)/8))*8)
+
+# MRAM used memory upper limit, a tasklet stores the (read_length + 1) columns of the DP-table for the backtrace
+dp_table_mram = (read_length + 1)*column if args["backtrace"] else 0
+memory_upper_limit_mram = (number_reads/args["nr_of_dpus"])*2*packed_length + (
+    number_reads/args["nr_of_dpus"])*76
+if args["backtrace"]:
+    memory_upper_limit_mram = memory_upper_limit_mram + \
+        (number_reads/args["nr_of_dpus"])*2*read_length
+
+# Estimated stack memory size is 1024
+for NR_TASKLETS in range(1, 21):
+    if NR_TASKLETS * memory_upper_limit >= (62000 - NR_TASKLETS*1024):
+        NR_TASKLETS = NR_TASKLETS-1
+        break
+
+# Check if it exceeds the MRAM capacity
+while NR_TASKLETS > 0 and memory_upper_limit_mram + dp_table_mram*NR_TASKLETS >= 64000000:
+    NR_TASKLETS = NR_TASKLETS-1
+memory_upper_limit_mram = memory_upper_limit_mram + dp_table_mram*max(NR_TASKLETS, 1)
+
+if NR_TASKLETS == 0:
+    if memory_upper_limit >= (62000 - 1024) or memory_upper_limit_mram >= 64000000:
+        print("Data doesn't fit in the WRAM")
+        exit(-1)
+    if memory_upper_limit_mram >= 64000000:
+        print("Data doesn't fit in the MRAM")
+        exit(-1)
+    NR_TASKLETS = 1
+
+
+print("Estimated NR of tasklets: ", str(NR_TASKLETS))
+print("Estimated nr of bytes per tasklets (WRAM): ", str(memory_upper_limit))
+
+
+# If the number of tasklets is overrided in the command line
+if args["nr_of_tasklets"] is not None:
+    if args["nr_of_tasklets"] <= NR_TASKLETS and args["nr_of_tasklets"] >= 1:
+        NR_TASKLETS = args["nr_of_tasklets"]
+        memory_upper_limit = (62000 - NR_TASKLETS*1024) / NR_TASKLETS
+        memory_upper_limit = int(math.ceil((((memory_upper_limit) + 7)/8))*8)
+
+if memory_upper_limit >= 62000:
+    memory_upper_limit = 62000
+
+print("Number of allocated tasklets: ", str(NR_TASKLETS))
+print("Number of allocated bytes per tasklets: ", str(memory_upper_limit))
+
+options = ""
+if args["backtrace"]:
+    options = options + " -DBACKTRACE"
+NR_DPUs = 1
+if args["nr_of_dpus"]:
+    NR_DPUs = args["nr_of_dpus"]
+
+
+# The DPU binaries only depend on the number of tasklets and the build flags, they are built once and the alignment parameters are passed at run time
+cmd = "make prebuilt PREBUILT_TASKLETS="+str(NR_TASKLETS)+" FLAGS=\""+options.strip()+"\""
+
+os.system("echo "+str(cmd))
+os.system(cmd)
+
+
+cmd = "./build/host -t "+str(NR_TASKLETS)+" -d "+str(NR_DPUs)+" -l "+str(int(read_length))+" -s "+str(int(max_score))+" -w "+str(memory_upper_limit) + \
+    " -p 0,1,1,1 -f "+args["format"]+(" -T "+args["texts"] if args["texts"] else "")+(" -x "+args["index"] if args["index"] else "")+" " + args["input"] + " " + args["output"] + " " + str(number_reads)
+os.system(cmd)
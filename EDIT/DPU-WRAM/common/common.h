@@ -0,0 +1,206 @@
+/* MIT License
+
+Copyright (c) 2021 SAFARI Research Group at ETH Zürich
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+#ifndef COMMON_H__
+#define COMMON_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define DPU_CAPACITY (64 << 20)
+
+// MRAM heap shared by the host buffers and the working memory of the tasklets
+#define MRAM_HEAP_SIZE 64000000
+
+// WRAM of a DPU, the stack of each tasklet is reserved in it and the working memory of the tasklets is allocated from the rest
+#define WRAM_SIZE (64 << 10)
+#define WRAM_STACK_SIZE 1024
+
+// Default alignment parameters of the host, the kernels compute the unit-cost edit distance
+#ifndef MATCH
+#define MATCH 0
+#endif
+
+#ifndef MISMATCH
+#define MISMATCH 1
+#endif
+
+#ifndef GAP_I
+#define GAP_I 1
+#endif
+
+#ifndef GAP_D
+#define GAP_D 1
+#endif
+
+#ifndef MAX_SCORE
+#define MAX_SCORE 40
+#endif
+
+#ifndef READ_SIZE
+#define READ_SIZE 56
+#endif
+
+#ifndef WRAM_SEGMENT
+#define WRAM_SEGMENT 1024
+#endif
+
+#define MIN(a, b) (((a) <= (b)) ? (a) : (b))
+#define MAX(a, b) (((a) >= (b)) ? (a) : (b))
+#define ABS(a) (((a) >= 0) ? (a) : -1 * (a))
+
+#define ROUND_UP_MULTIPLE_8(x) ((((x) + 7) / 8) * 8)
+
+// Myers' bit-vector algorithm encodes a column of the DP-table by the differences between its consecutive cells, +1 in a Pv word
+// and -1 in an Mv word, with one bit per base of the pattern. The pattern is split in blocks of EDIT_WORD_BITS bases, the width of
+// the ALU of the DPU
+typedef uint32_t edit_word_t;
+#define EDIT_WORD_BITS 32
+#define EDIT_BLOCKS(len) (((len) + EDIT_WORD_BITS - 1) / EDIT_WORD_BITS)
+// Symbols of the packed bases, A, C, G, T and N
+#define EDIT_SYMBOLS 5
+// Size of a column, the Pv and Mv words of each block
+#define EDIT_COLUMN_SIZE(len) (EDIT_BLOCKS(len) * 2 * sizeof(edit_word_t))
+
+// The kernels only compute the unit-cost edit distance, the penalties of the host must be the unit costs
+#define UNIT_PENALTIES_VALID(penalties) ((penalties).match == 0 && (penalties).mismatch == 1 && (penalties).gap_i == 1 && (penalties).gap_d == 1)
+
+// The columns of the DP-table are stored in the WRAM
+#define MRAM_TASKLET_SEGMENT(read_size, max_score, penalties) 0
+
+// Bits of the pattern, one word per block for each symbol
+#define EDIT_PEQ_SIZE(read_size) ROUND_UP_MULTIPLE_8(EDIT_BLOCKS(read_size) * EDIT_SYMBOLS * sizeof(edit_word_t))
+
+// WRAM allocated by each tasklet: the request, the result and the CIGAR of a pair, its packed sequences, the bits of the pattern, and
+// every column of the DP-table and the operations of the CIGAR for the backtrace, or the current column otherwise
+#define WRAM_PAIR_SIZE (ROUND_UP_MULTIPLE_8(sizeof(request_t)) + ROUND_UP_MULTIPLE_8(sizeof(result_t)) + ROUND_UP_MULTIPLE_8(sizeof(edit_cigar_t)))
+#ifdef BACKTRACE
+#define WRAM_TASKLET_SEGMENT(read_size, max_score, penalties, wram_segment) \
+    (WRAM_PAIR_SIZE + 2 * PACKED_SIZE(read_size) + EDIT_PEQ_SIZE(read_size) + ((uint64_t)(read_size) + 1) * EDIT_COLUMN_SIZE(read_size) + ROUND_UP_MULTIPLE_8(2 * (read_size)))
+#else
+#define WRAM_TASKLET_SEGMENT(read_size, max_score, penalties, wram_segment) \
+    (WRAM_PAIR_SIZE + 2 * PACKED_SIZE(read_size) + EDIT_PEQ_SIZE(read_size) + EDIT_COLUMN_SIZE(read_size))
+#endif
+
+typedef struct
+{
+    int max_operations;
+    char *operations;
+    int begin_offset;
+    int end_offset;
+    int score;
+} edit_cigar_t;
+
+// Sequences are 2-bit packed, 4 bases per byte (A=0, C=1, G=2, T=3), and followed by an N-mask with 1 bit per base.
+// Any base other than A, C, G and T is stored as an N
+#define PACKED_BASES_SIZE(len) ROUND_UP_MULTIPLE_8(((len) + 3) / 4)
+#define PACKED_MASK_SIZE(len) ROUND_UP_MULTIPLE_8(((len) + 7) / 8)
+#define PACKED_SIZE(len) (PACKED_BASES_SIZE(len) + PACKED_MASK_SIZE(len))
+#define PACKED_READ_SIZE PACKED_SIZE(READ_SIZE)
+
+// 2-bit code of the base i of a packed sequence
+#define PACKED_CODE(bases, i) ((((const uint8_t *)(bases))[(i) >> 2] >> (((i)&3) << 1)) & 3)
+// Base i of a packed sequence, N bases are returned as 4 so that they only match N bases
+#define PACKED_BASE(bases, mask, i) (PACKED_CODE(bases, i) | (((((const uint8_t *)(mask))[(i) >> 3] >> ((i)&7)) & 1) << 2))
+
+// Estimated cost of aligning a read pair, used by the host to balance the work of the DPUs.
+// Every block of the pattern is advanced once per base of the text, so the edits estimate isn't used (and isn't evaluated by the macro)
+#define PAIR_COST(pattern_len, text_len, edits) ((uint64_t)EDIT_BLOCKS(pattern_len) * (text_len))
+
+typedef struct request_t
+{
+    int pattern_len;
+    int text_len;
+    uint32_t sequence_offset; /* Offset of the packed pattern in the sequences of the DPU, the packed text follows it */
+    uint32_t idx;
+} request_t;
+
+// With BACKTRACE, the kernels write the CIGAR of a pair run-length encoded after the CIGARs of the previous pairs of the batch. A byte
+// is a run of 1 to CIGAR_RUN_MAX operations, the length - 1 in its upper 6 bits and the operation in its lower 2 bits, so the CIGAR
+// of a pair is never longer than its operations. Longer runs take several bytes, the host merges them when it writes the CIGAR
+#define CIGAR_RUN_MAX 64
+#define CIGAR_OP_CODE(op) (((op) == 'M') ? 0 : ((op) == 'X') ? 1 : ((op) == 'I') ? 2 : 3)
+#define CIGAR_RUN(op, length) ((uint8_t)((((length)-1) << 2) | CIGAR_OP_CODE(op)))
+#define CIGAR_RUN_OP(run) ("MXID"[(run)&3])
+#define CIGAR_RUN_LENGTH(run) (((run) >> 2) + 1)
+// Bytes reserved for the CIGAR of a pair of reads of at most read_size bases
+#define CIGAR_CAPACITY(read_size) ROUND_UP_MULTIPLE_8(2 * (read_size))
+// The edit distance kernels score every pair
+#define SCORE_REJECTED(score, max_score) 0
+
+typedef struct result_t
+{
+    uint32_t cigar_offset; /* Offset of the CIGAR in the CIGARs of the batch */
+    uint32_t cigar_length; /* Number of runs of the CIGAR */
+    int score;
+    int pattern_begin; /* Span of the alignment, the begins are -1 when the kernel doesn't compute them */
+    int pattern_end;
+    int text_begin;
+    int text_end;
+    uint32_t idx;
+    uint64_t cycles; /* Cycles spent aligning the pair, filled with -DPROFILE */
+} result_t;
+
+// Statistics written by each tasklet at the end of a batch, the DMA and memory fields are only filled with -DPROFILE
+typedef struct tasklet_stats_t
+{
+    uint64_t nb_reads;    /* Number of reads aligned by the tasklet */
+    uint64_t cycles;      /* Cycles from the launch until the tasklet finished */
+    uint64_t dma_read;    /* Bytes read from the MRAM by the tasklet */
+    uint64_t dma_written; /* Bytes written to the MRAM by the tasklet */
+    uint32_t wram_peak;   /* WRAM high-water mark of the tasklet in bytes */
+    uint32_t mram_peak;   /* MRAM high-water mark of the working memory of the tasklet in bytes */
+} tasklet_stats_t;
+
+// Penalties of the alignment, passed in the DPU params as for NW
+typedef struct penalties_t
+{
+    int32_t match;
+    int32_t mismatch;
+    int32_t gap_i;
+    int32_t gap_d;
+} penalties_t;
+
+#define DEFAULT_PENALTIES {MATCH, MISMATCH, GAP_I, GAP_D}
+#define PENALTIES_USAGE "match,mismatch,gap_i,gap_d"
+
+typedef struct DPUParams
+{
+    uint32_t dpuNumReads;        /* Number of reads assigned to the DPU */
+    uint32_t dpuRequests_m;      /* Base address of the requests in the MRAM */
+    uint32_t dpuResults_m;       /* Base address of the results in the MRAM */
+    uint32_t dpuSequences_m;     /* Base address of the packed sequences in the MRAM */
+    uint32_t dpuOperations_m;    /* Base address of the CIGARs in the MRAM */
+    uint32_t mramTotalAllocated; /* Size of the MRAM memory allocated by the host */
+    uint32_t dpuActiveBuffer;    /* MRAM region of the batch to align (0 or 1) */
+    uint32_t dpuBufferSize;      /* Size of an MRAM region */
+    uint32_t dpuTaskletStats_m;  /* Base address of the statistics of the tasklets in the MRAM */
+    uint32_t readSize;           /* Length of the longest read */
+    uint32_t maxScore;           /* Highest alignment score computed */
+    uint32_t wramSegment;        /* Size of the WRAM segment of a tasklet */
+    penalties_t penalties;       /* Penalties of the alignment */
+} DPUParams;
+
+#endif
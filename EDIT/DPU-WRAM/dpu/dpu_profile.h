@@ -0,0 +1,26 @@
+#ifndef DPU_PROFILE_H_
+#define DPU_PROFILE_H_
+
+#include <defs.h>
+#include <mram.h>
+#include <alloc.h>
+#include "common.h"
+
+// Statistics of the tasklets of the current launch, written to the MRAM at the end of the batch
+extern tasklet_stats_t tasklet_stats[NR_TASKLETS];
+
+#ifdef PROFILE
+// Count the bytes moved by the DMA transfers of each tasklet, a macro is not expanded inside itself so the SDK functions are still called
+#define mram_read(from, to, size) (tasklet_stats[me()].dma_read += (size), mram_read(from, to, size))
+#define mram_write(from, to, size) (tasklet_stats[me()].dma_written += (size), mram_write(from, to, size))
+
+// Raise the MRAM high-water mark of the tasklet to the memory it is using
+#define PROFILE_MRAM_USED(bytes) (tasklet_stats[me()].mram_peak = MAX(tasklet_stats[me()].mram_peak, (uint32_t)(bytes)))
+
+// The kernel only allocates WRAM before its first alignment, so the allocations of a tasklet are its WRAM high-water mark
+#define mem_alloc(size) (tasklet_stats[me()].wram_peak += ROUND_UP_MULTIPLE_8(size), mem_alloc(size))
+#else
+#define PROFILE_MRAM_USED(bytes)
+#endif
+
+#endif
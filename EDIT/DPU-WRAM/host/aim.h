@@ -0,0 +1,88 @@
+#ifndef _AIM_H_
+#define _AIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// libaim aligns read pairs on the DPUs from another program. The library of a directory runs the kernel of that directory with the
+// flags it was built with, the DPUs are allocated by aim_init and kept until aim_finalize. The batches are aligned in the order they
+// were submitted by a thread of the library, so that the caller keeps working (seeding the next pairs) while the DPUs align
+
+// Kernels of the directories, the algorithm of the options must be the one of the library
+typedef enum aim_algorithm_t
+{
+    AIM_NW,   /* Needleman-Wunsch, linear gap costs */
+    AIM_SWG,  /* Smith-Waterman-Gotoh, affine gap costs */
+    AIM_WFA,  /* Wavefront alignment, affine gap costs */
+    AIM_EDIT, /* Edit distance */
+} aim_algorithm_t;
+
+// Options of the library, a field left at 0 or NULL takes the value of the build. The strings have the syntax of the options of the
+// host: the penalties of -p, the span of -a and the heuristic of -H of WFA
+typedef struct aim_options_t
+{
+    aim_algorithm_t algorithm;
+    uint32_t nr_dpus;
+    uint32_t nr_tasklets;
+    uint32_t read_size;
+    uint32_t max_score;
+    const char *penalties;
+    const char *span;
+    const char *heuristic;
+    FILE *log; /* Progress and statistics of the batches, discarded when NULL */
+} aim_options_t;
+
+// A read pair, the bases are copied when its batch is submitted
+typedef struct aim_pair_t
+{
+    const char *pattern;
+    const char *text;
+    uint32_t pattern_length;
+    uint32_t text_length;
+} aim_pair_t;
+
+// Alignment of a read pair, the span is the whole sequences unless the alignment is ends-free or local. The CIGAR is only known with
+// BACKTRACE, each byte is a run decoded by AIM_CIGAR_OP and AIM_CIGAR_LENGTH. A pair above the max score is rejected, without CIGAR
+typedef struct aim_result_t
+{
+    int32_t score;
+    int32_t pattern_begin;
+    int32_t pattern_end;
+    int32_t text_begin;
+    int32_t text_end;
+    uint32_t cigar_length;
+    bool rejected;
+    const uint8_t *cigar;
+} aim_result_t;
+
+#define AIM_CIGAR_OP(run) ("MXID"[(run)&3])
+#define AIM_CIGAR_LENGTH(run) (((run) >> 2) + 1)
+
+typedef struct aim_t aim_t;
+
+// Allocates the DPUs and loads the kernel, returns NULL after printing the reason when the options can't run
+aim_t *aim_init(const aim_options_t *options);
+
+// Queues a batch of n pairs, returns its id, or -1 after printing the reason when a pair is longer than the read size or the batch
+// can't be allocated
+int64_t aim_submit_batch(aim_t *aim, const aim_pair_t *pairs, uint32_t n);
+
+// Returns 1 when the batch is aligned, 0 when it is queued or running and -1 when it failed or the id isn't a batch of aim
+int aim_poll(aim_t *aim, int64_t batch);
+
+// Waits for the batch, returns its results in the order of its pairs, or NULL when it failed or the id isn't a batch of aim. The
+// results are kept until the batch is released
+const aim_result_t *aim_wait(aim_t *aim, int64_t batch);
+
+// Returns the reason a batch failed or isn't a batch of aim, or NULL when it is aligned, queued or running. The reason is kept until the
+// batch is released
+const char *aim_error(aim_t *aim, int64_t batch);
+
+// Frees the results of a batch, after waiting for it
+void aim_release(aim_t *aim, int64_t batch);
+
+// Waits for the submitted batches, then frees them and the DPUs
+void aim_finalize(aim_t *aim);
+
+#endif
@@ -0,0 +1,878 @@
+/*
+ *                             The MIT License
+ *
+ * Wavefront Alignments Algorithms
+ * Copyright (c) 2017 by Santiago Marco-Sola  <santiagomsola@gmail.com>
+ *
+ * This file is part of Wavefront Alignments Algorithms.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * PROJECT: Wavefront Alignments Algorithms
+ * AUTHOR(S): Santiago Marco-Sola <santiagomsola@gmail.com>
+ */
+/* MIT License
+
+Copyright (c) 2021 SAFARI Research Group at ETH Zürich
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include "timer.h"
+#include "common.h"
+#include "mram-management.h"
+#include "parser.h"
+#include "writer.h"
+#include "host.h"
+#include <time.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <libgen.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <dpu.h>
+
+#ifndef ENERGY
+#define ENERGY 0
+#endif
+#if ENERGY
+#include <dpu_probe.h>
+#endif
+#ifndef PHASE_TIMERS
+#define PHASE_TIMERS 0
+#endif
+
+// Adds the time of a phase of the pipeline. With PHASE_TIMERS the host waits for the transfers or the kernel of the phase, so that
+// the phases are timed apart, and the batches are no longer overlapped
+static void end_phase(struct dpu_set_t dpu_set, Timer *timer, float *time)
+{
+#if PHASE_TIMERS
+    DPU_ASSERT(dpu_sync(dpu_set));
+#endif
+    stopTimer(timer);
+    *time += getElapsedTime(*timer);
+}
+
+// Reads the next batch of read pairs into one set of host buffers, returns the number of read pairs of the batch
+// and the size of the largest sequences buffer of the batch in sequences_size
+uint32_t get_batch(input_t *input, struct DPUParams *dpuParams, request_t **dpu_requests, char **dpu_sequences, uint32_t *sequences_size,
+                   uint64_t *dpu_cost, pair_slot_t *batch_order, uint32_t nr_of_dpus, uint32_t nb_reads_per_dpu, uint32_t sequences_capacity,
+                   uint32_t total_nb_reads, int *nb_sent_requests)
+{
+    uint32_t dpu_nb_reads[nr_of_dpus];
+    uint32_t dpu_sequences_size[nr_of_dpus];
+    uint32_t nb_reads_left = total_nb_reads - *nb_sent_requests;
+    for (int dpu_idx = 0; dpu_idx < nr_of_dpus; ++dpu_idx)
+    {
+        dpu_nb_reads[dpu_idx] = nb_reads_per_dpu;
+        if (total_nb_reads != 0)
+        {
+            dpu_nb_reads[dpu_idx] = MIN(nb_reads_per_dpu, nb_reads_left);
+            nb_reads_left -= dpu_nb_reads[dpu_idx];
+        }
+    }
+    get_input_batch(input, dpu_requests, dpu_sequences, dpu_nb_reads, dpu_sequences_size, dpu_cost, batch_order, sequences_capacity, nr_of_dpus);
+
+    uint32_t batch_nb_reads = 0;
+    *sequences_size = 0;
+    for (int dpu_idx = 0; dpu_idx < nr_of_dpus; ++dpu_idx)
+    {
+        dpuParams[dpu_idx].dpuNumReads = dpu_nb_reads[dpu_idx];
+        batch_nb_reads += dpu_nb_reads[dpu_idx];
+        *sequences_size = MAX(*sequences_size, dpu_sequences_size[dpu_idx]);
+    }
+    *nb_sent_requests += batch_nb_reads;
+    return batch_nb_reads;
+}
+
+// Reason a job failed, the jobs of a host run one after the other
+static const char *job_error(const char *format, ...)
+{
+    static char error[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error, sizeof(error), format, args);
+    va_end(args);
+    return error;
+}
+
+// Whether a file can be written, or created in its directory when it doesn't exist
+static bool writable(const char *path)
+{
+    if (access(path, F_OK) == 0)
+        return access(path, W_OK) == 0;
+    char directory[strlen(path) + 1];
+    strcpy(directory, path);
+    return access(dirname(directory), W_OK | X_OK) == 0;
+}
+
+// Queues the transfer of a batch to the MRAM region selected by its DPU params
+void push_batch(struct dpu_set_t dpu_set, uint32_t dpuParams_m, struct DPUParams *dpuParams, request_t **dpu_requests, char **dpu_sequences, uint32_t nb_reads_per_dpu, uint32_t sequences_size)
+{
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    uint32_t dpuBuffer_m = dpuParams[0].dpuActiveBuffer * dpuParams[0].dpuBufferSize;
+    // Transfer DPU Params
+    DPU_FOREACH(dpu_set, dpu, each_dpu)
+    {
+        DPU_ASSERT(dpu_prepare_xfer(dpu, (uint8_t *)&dpuParams[each_dpu]));
+    }
+    DPU_ASSERT(dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, DPU_MRAM_HEAP_POINTER_NAME, dpuParams_m, ROUND_UP_MULTIPLE_8(sizeof(struct DPUParams)), DPU_XFER_ASYNC));
+    // Transfer the Requests
+    DPU_FOREACH(dpu_set, dpu, each_dpu)
+    {
+        DPU_ASSERT(dpu_prepare_xfer(dpu, (uint8_t *)dpu_requests[each_dpu]));
+    }
+    DPU_ASSERT(dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, DPU_MRAM_HEAP_POINTER_NAME, dpuBuffer_m + dpuParams[0].dpuRequests_m, nb_reads_per_dpu * ((sizeof(request_t))), DPU_XFER_ASYNC));
+    // Transfer the packed sequences, only the size used by the fullest DPU of the batch
+    DPU_FOREACH(dpu_set, dpu, each_dpu)
+    {
+        DPU_ASSERT(dpu_prepare_xfer(dpu, (uint8_t *)dpu_sequences[each_dpu]));
+    }
+    DPU_ASSERT(dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, DPU_MRAM_HEAP_POINTER_NAME, dpuBuffer_m + dpuParams[0].dpuSequences_m, sequences_size, DPU_XFER_ASYNC));
+}
+
+void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-t tasklets] [-d dpus] [-l read_size] [-s max_score] [-w wram_segment] [-p %s] [-f %s] [-T texts] [-x index] input output nb_reads\n", name, PENALTIES_USAGE, OUTPUT_FORMAT_USAGE);
+    fprintf(stderr, "       %s [-d dpus] [job options] -S socket\n", name);
+    exit(1);
+}
+
+bool parse_job(int argc, char *argv[], job_t *job, uint32_t *nr_dpus, const char **socket_path)
+{
+    int opt, p[4];
+    optind = 0;
+    while ((opt = getopt(argc, argv, "t:d:l:s:w:p:f:T:x:S:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            job->nr_tasklets = atoi(optarg);
+            break;
+        case 'd':
+            if (nr_dpus == NULL)
+                return false;
+            *nr_dpus = atoi(optarg);
+            break;
+        case 'l':
+            job->read_size = atoi(optarg);
+            break;
+        case 's':
+            job->max_score = atoi(optarg);
+            break;
+        case 'w':
+            job->wram_segment = ROUND_UP_MULTIPLE_8(atoi(optarg));
+            break;
+        case 'p':
+            if (sscanf(optarg, "%d,%d,%d,%d", &p[0], &p[1], &p[2], &p[3]) != 4)
+                return false;
+            job->penalties = (penalties_t){p[0], p[1], p[2], p[3]};
+            break;
+        case 'f':
+            if (!parse_output_format(optarg, &job->output_format))
+                return false;
+            break;
+        case 'T':
+            job->texts_path = optarg;
+            break;
+        case 'x':
+            job->index_path = optarg;
+            break;
+        case 'S':
+            if (socket_path == NULL)
+                return false;
+            *socket_path = optarg;
+            break;
+        default:
+            return false;
+        }
+    }
+    if (socket_path != NULL && *socket_path != NULL)
+        return argc == optind;
+    if (argc - optind != 3 || atoi(argv[optind + 2]) < 0)
+        return false;
+    job->in = argv[optind];
+    job->out = argv[optind + 1];
+    job->total_nb_reads = atoi(argv[optind + 2]);
+    return true;
+}
+
+uint32_t job_read_footprint(const job_t *job)
+{
+#ifdef BACKTRACE
+    return sizeof(request_t) + sizeof(result_t) + CIGAR_CAPACITY(job->read_size);
+#else
+    return sizeof(request_t) + sizeof(result_t);
+#endif
+}
+
+uint64_t job_mram_reserved(const job_t *job)
+{
+    return ROUND_UP_MULTIPLE_8(sizeof(struct DPUParams)) + (uint64_t)job->nr_tasklets * MRAM_TASKLET_SEGMENT(job->read_size, job->max_score, job->penalties) +
+           2 * job->nr_tasklets * sizeof(tasklet_stats_t);
+}
+
+const char *validate_job(job_t *job, uint32_t nr_dpus)
+{
+    static char error[256];
+    if (job->nr_tasklets == 0 || job->nr_tasklets > 24 || nr_dpus == 0 || job->read_size == 0 || job->max_score == 0)
+        return "Invalid number of tasklets, number of DPUs, read size or max score";
+#ifdef MAX_SCORE_LIMIT
+    if (job->max_score > MAX_SCORE_LIMIT)
+    {
+        snprintf(error, sizeof(error), "The cells of the build hold scores up to %d, rebuild with -DMAX_SCORE=%u", MAX_SCORE_LIMIT, job->max_score);
+        return error;
+    }
+#endif
+#if defined(CELL_SCORE_BOUND) && !defined(BANDED) && !defined(EARLY_TERMINATION)
+    // The full DP-table keeps the scores of whole reads, they must fit in its cells
+    if (CELL_SCORE_BOUND(job->read_size, job->penalties) > MAX_SCORE_LIMIT)
+    {
+        snprintf(error, sizeof(error), "The scores of reads of %u bases overflow the cells of the build, lower the read size or build with -DBANDED",
+                 job->read_size);
+        return error;
+    }
+#endif
+#ifdef UNIT_PENALTIES_VALID
+    if (!UNIT_PENALTIES_VALID(job->penalties))
+        return "The edit distance kernels have unit costs, the penalties must be 0,1,1,1";
+#endif
+#ifndef BACKTRACE
+    if (job->output_format == OUTPUT_PAF || job->output_format == OUTPUT_SAM)
+        return "The PAF and SAM formats describe an alignment by its CIGAR, they need BACKTRACE";
+#endif
+#ifdef WRAM_SEGMENT_MIN
+    // The buffers of a pair are allocated in the WRAM segment of the tasklet before its wavefronts
+    if (job->wram_segment <= WRAM_SEGMENT_MIN(job->read_size, job->max_score))
+    {
+        snprintf(error, sizeof(error), "The WRAM segment of %u bytes doesn't hold the buffers of a pair of reads of %u bases, raise it with -w",
+                 job->wram_segment, job->read_size);
+        return error;
+    }
+#endif
+    // Each tasklet has its stack and its working memory in the WRAM
+    if (job->nr_tasklets * (WRAM_STACK_SIZE + WRAM_TASKLET_SEGMENT(job->read_size, job->max_score, job->penalties, job->wram_segment)) > WRAM_SIZE)
+    {
+        snprintf(error, sizeof(error), "The working memory of %u tasklets doesn't fit in the WRAM", job->nr_tasklets);
+        return error;
+    }
+    if (job_mram_reserved(job) + 2 * (8 * job_read_footprint(job) + 2 * PACKED_SIZE(job->read_size)) > MRAM_HEAP_SIZE)
+    {
+        snprintf(error, sizeof(error), "The working memory of %u tasklets doesn't fit in the MRAM", job->nr_tasklets);
+        return error;
+    }
+
+    // The binaries of make prebuilt are named after their number of tasklets, the binary of make has the tasklets of the build
+    sprintf(job->dpu_binary, "%s_%u", DPU_BINARY, job->nr_tasklets);
+    if (access(job->dpu_binary, R_OK) != 0 && job->nr_tasklets == NR_TASKLETS)
+        sprintf(job->dpu_binary, "%s", DPU_BINARY);
+    if (access(job->dpu_binary, R_OK) != 0)
+    {
+        snprintf(error, sizeof(error), "DPU binary '%s' not found, build it with make prebuilt PREBUILT_TASKLETS=%u", job->dpu_binary, job->nr_tasklets);
+        return error;
+    }
+
+    // The files of a job are checked before the DPU binary is loaded. A file that then fails to be parsed or written, or a pair longer
+    // than the read size, fails the job before its first batch
+    const char *files[] = {job->in, job->texts_path};
+    for (int f = 0; f < 2; ++f)
+    {
+        if (files[f] != NULL && access(files[f], R_OK) != 0)
+        {
+            snprintf(error, sizeof(error), "Input file '%.200s' couldn't be opened", files[f]);
+            return error;
+        }
+    }
+    if (job->out != NULL && !writable(job->out))
+    {
+        snprintf(error, sizeof(error), "Output file '%.200s' couldn't be opened", job->out);
+        return error;
+    }
+    if (job->index_path != NULL && access(job->index_path, R_OK) != 0 && !writable(job->index_path))
+    {
+        snprintf(error, sizeof(error), "Index file '%.200s' couldn't be created", job->index_path);
+        return error;
+    }
+    if (job->total_nb_reads != 0 && job->total_nb_reads <= nr_dpus)
+        return "Allocated DPUs more than needed";
+    return NULL;
+}
+
+const char *run_job(struct dpu_set_t dpu_set, uint32_t nr_of_dpus, const job_t *job, FILE *dpu_file, job_stats_t *stats)
+{
+    // Timing and profiling
+    Timer timer, readTimer, phaseTimer, syncTimer, writeTimer;
+    float readTime = 0.0f, loadTime = 0.0f, dpuTime = 0.0f, retrieveTime = 0.0f, syncTime = 0.0f, writeTime = 0.0f, totalTime = 0.0f;
+#if ENERGY
+    struct dpu_probe_t probe;
+    DPU_ASSERT(dpu_probe_init("energy_probe", &probe));
+#endif
+
+    struct dpu_set_t dpu;
+    uint32_t nr_tasklets = job->nr_tasklets;
+    uint32_t read_size = job->read_size;
+    uint32_t max_score = job->max_score;
+    uint32_t wram_segment = job->wram_segment;
+    penalties_t penalties = job->penalties;
+    output_format_t output_format = job->output_format;
+    const char *out = job->out;
+    uint32_t total_nb_reads = job->total_nb_reads;
+
+    input_t input;
+    // The input is mapped and its lines are indexed by several threads, the pairs of the library are already in memory
+    startTimer(&readTimer);
+    bool opened = true;
+    if (job->input != NULL)
+        input = *job->input;
+    else
+        opened = open_input(&input, job->in, job->texts_path, job->index_path, read_size);
+    stopTimer(&readTimer);
+    readTime += getElapsedTime(readTimer);
+    if (!opened)
+        return job_error("%s", input.error);
+
+    // The lines of a batch are formatted by several threads, the span is only written when it isn't the whole sequences. The binary
+    // output is sized for the pairs to align
+    uint64_t nb_output_pairs = (total_nb_reads != 0) ? MIN(total_nb_reads, input.nb_pairs) : input.nb_pairs;
+    output_t output;
+    memset(&output, 0, sizeof(output));
+    if (out != NULL)
+    {
+#ifdef BACKTRACE
+        opened = open_output(&output, out, output_format, false, true, max_score, input.pairs, nb_output_pairs);
+#else
+        opened = open_output(&output, out, output_format, false, false, max_score, input.pairs, nb_output_pairs);
+#endif
+    }
+    if (!opened)
+    {
+        close_input(&input);
+        return job_error("%s", output.error);
+    }
+
+#ifdef PROFILE
+    // The profile is written next to the output, one line per tasklet and batch and one line per read pair
+    char profile_path[strlen(out) + 16];
+    sprintf(profile_path, "%s.tasklets.csv", out);
+    FILE *tasklets_file = fopen(profile_path, "w");
+    sprintf(profile_path, "%s.pairs.csv", out);
+    FILE *pairs_file = fopen(profile_path, "w");
+    if (tasklets_file == NULL || pairs_file == NULL)
+    {
+        if (tasklets_file != NULL)
+            fclose(tasklets_file);
+        if (pairs_file != NULL)
+            fclose(pairs_file);
+        close_output(&output);
+        close_input(&input);
+        return job_error("Profile files '%s.*.csv' couldn't be opened", out);
+    }
+    fprintf(tasklets_file, "batch,dpu,tasklet,reads,cycles,dma_read_bytes,dma_written_bytes,wram_peak_bytes,mram_peak_bytes\n");
+    fprintf(pairs_file, "pair,batch,dpu,pattern_length,text_length,score,cycles\n");
+    uint32_t wram_peak = 0, mram_peak = 0;
+#endif
+
+    // The input is streamed in batches, a batch fills one of the two MRAM regions left after reserving the tasklets' working memory
+    uint32_t read_footprint = job_read_footprint(job);
+    uint64_t mram_reserved = job_mram_reserved(job);
+    uint64_t region_size = (MRAM_HEAP_SIZE - mram_reserved) / 2;
+
+    // The sequences are packed back to back, the number of reads of a region is estimated from the mean read length of the input
+    uint32_t mean_length = read_size;
+    if (input.nb_pairs != 0)
+        mean_length = MIN(input.nb_bases / (2 * input.nb_pairs), read_size);
+    uint32_t max_reads_per_dpu = ((region_size - 2 * PACKED_SIZE(read_size)) / (read_footprint + 2 * PACKED_SIZE(mean_length))) & (-8);
+
+    uint32_t nb_reads_per_dpu = max_reads_per_dpu;
+    if (total_nb_reads != 0)
+        nb_reads_per_dpu = MIN(ROUND_UP_MULTIPLE_8(((total_nb_reads) / nr_of_dpus)), max_reads_per_dpu);
+    // The rest of the region holds the sequences, it fits at least one pair of the longest reads
+    uint32_t sequences_capacity = MIN(region_size - (uint64_t)nb_reads_per_dpu * read_footprint, (uint64_t)nb_reads_per_dpu * 2 * PACKED_SIZE(read_size)) & (-8);
+    fprintf(job->log, "NumReads per dpu = %u\n", nb_reads_per_dpu);
+    int nb_sent_requests = 0;
+
+    // Allocate Buffers, a batch is read in one set while the DPUs align the batch of the other set
+    struct DPUParams dpuParams[2][nr_of_dpus];
+    request_t *dpu_requests[2][nr_of_dpus];
+    char *dpu_sequences[2][nr_of_dpus];
+    result_t *dpuResults[2][nr_of_dpus];
+    tasklet_stats_t *dpuTaskletStats[2][nr_of_dpus];
+    uint64_t dpu_cost[2][nr_of_dpus];
+    pair_slot_t *batch_order[2];
+#ifdef BACKTRACE
+    uint8_t *dpuOperations[2][nr_of_dpus];
+#endif
+
+    for (int b = 0; b < 2; ++b)
+    {
+        for (int dpu_idx = 0; dpu_idx < nr_of_dpus; ++dpu_idx)
+        {
+            dpu_requests[b][dpu_idx] = (request_t *)malloc(nb_reads_per_dpu * (sizeof(request_t)));
+            dpu_sequences[b][dpu_idx] = (char *)malloc(sequences_capacity);
+            dpuResults[b][dpu_idx] = (result_t *)malloc(nb_reads_per_dpu * (sizeof(result_t)));
+            dpuTaskletStats[b][dpu_idx] = (tasklet_stats_t *)malloc(nr_tasklets * sizeof(tasklet_stats_t));
+#ifdef BACKTRACE
+            dpuOperations[b][dpu_idx] = (uint8_t *)malloc(nb_reads_per_dpu * CIGAR_CAPACITY(read_size));
+#endif
+        }
+        batch_order[b] = (pair_slot_t *)malloc((uint64_t)nr_of_dpus * nb_reads_per_dpu * sizeof(pair_slot_t));
+    }
+
+    // The MRAM holds two regions with the same layout, the DPU params select the region of the batch
+    uint32_t each_dpu;
+    uint32_t dpuParams_m = 0;
+    DPU_FOREACH(dpu_set, dpu, each_dpu)
+    {
+        // Allocate needed MRAM memory to store Read Pairs Requests and Results
+        struct mram_heap_allocator_t allocator;
+        init_allocator(&allocator);
+        dpuParams_m = mram_heap_alloc(&allocator, (sizeof(struct DPUParams)));
+        uint32_t dpuBuffer_m = allocator.totalAllocated;
+        uint32_t dpuRequests_m = mram_heap_alloc(&allocator, nb_reads_per_dpu * (sizeof(request_t)));
+        uint32_t dpuResults_m = mram_heap_alloc(&allocator, (nb_reads_per_dpu * (sizeof(result_t))));
+        uint32_t dpuSequences_m = mram_heap_alloc(&allocator, sequences_capacity);
+#ifdef BACKTRACE
+        uint32_t dpuOperations_m = mram_heap_alloc(&allocator, nb_reads_per_dpu * CIGAR_CAPACITY(read_size));
+#else
+        uint32_t dpuOperations_m = 0;
+#endif
+        uint32_t dpuTaskletStats_m = mram_heap_alloc(&allocator, nr_tasklets * sizeof(tasklet_stats_t));
+        uint32_t dpuBufferSize = allocator.totalAllocated - dpuBuffer_m;
+        mram_heap_alloc(&allocator, dpuBufferSize);
+        assert((sizeof(request_t)) % 8 == 0 && "Requests must be a multiple of 8 bytes!");
+        assert((sizeof(result_t)) % 8 == 0 && "Results must be a multiple of 8 bytes!");
+        assert(sequences_capacity % 8 == 0 && "Input sequences must be a multiple of 8 bytes!");
+        assert((sizeof(struct DPUParams)) % 8 == 0 && "DPUParams must be a multiple of 8 bytes!");
+
+        for (int b = 0; b < 2; ++b)
+        {
+            dpuParams[b][each_dpu].dpuRequests_m = dpuRequests_m;
+            dpuParams[b][each_dpu].dpuResults_m = dpuResults_m;
+            dpuParams[b][each_dpu].dpuSequences_m = dpuSequences_m;
+            dpuParams[b][each_dpu].dpuOperations_m = dpuOperations_m;
+            dpuParams[b][each_dpu].mramTotalAllocated = ROUND_UP_MULTIPLE_8(allocator.totalAllocated);
+            dpuParams[b][each_dpu].dpuActiveBuffer = b;
+            dpuParams[b][each_dpu].dpuBufferSize = dpuBufferSize;
+            dpuParams[b][each_dpu].dpuTaskletStats_m = dpuTaskletStats_m;
+            dpuParams[b][each_dpu].readSize = read_size;
+            dpuParams[b][each_dpu].maxScore = max_score;
+            dpuParams[b][each_dpu].wramSegment = wram_segment;
+            dpuParams[b][each_dpu].penalties = penalties;
+        }
+    }
+
+    // Pipeline: the next batch is read and queued behind the running kernel, then the results are retrieved
+    startTimer(&timer);
+#if ENERGY
+    DPU_ASSERT(dpu_probe_start(&probe));
+#endif
+    uint32_t nb_batches = 0;
+    uint64_t tasklet_nb_reads[nr_tasklets];
+    memset(tasklet_nb_reads, 0, sizeof(tasklet_nb_reads));
+    // Sums over the batches of the spread (max / mean) of the estimated costs and of the cycles of the DPUs
+    double predicted_spread = 0, actual_spread = 0;
+    uint32_t batch_nb_reads[2];
+    uint32_t batch_sequences_size[2];
+    uint32_t cur = 0;
+    // An output that fails to be written ends the pipeline, after the batch the DPUs are aligning
+    const char *error = NULL;
+    startTimer(&readTimer);
+    batch_nb_reads[cur] = get_batch(&input, dpuParams[cur], dpu_requests[cur], dpu_sequences[cur], &batch_sequences_size[cur], dpu_cost[cur], batch_order[cur], nr_of_dpus, nb_reads_per_dpu, sequences_capacity, total_nb_reads, &nb_sent_requests);
+    stopTimer(&readTimer);
+    readTime += getElapsedTime(readTimer);
+    if (batch_nb_reads[cur] != 0)
+    {
+        startTimer(&phaseTimer);
+        push_batch(dpu_set, dpuParams_m, dpuParams[cur], dpu_requests[cur], dpu_sequences[cur], nb_reads_per_dpu, batch_sequences_size[cur]);
+        end_phase(dpu_set, &phaseTimer, &loadTime);
+        startTimer(&phaseTimer);
+        DPU_ASSERT(dpu_launch(dpu_set, DPU_ASYNCHRONOUS));
+        end_phase(dpu_set, &phaseTimer, &dpuTime);
+    }
+    while (batch_nb_reads[cur] != 0)
+    {
+        ++nb_batches;
+        fprintf(job->log, "Batch %u: %u read pairs\n", nb_batches, batch_nb_reads[cur]);
+        uint32_t next = 1 - cur;
+
+        // Read the next batch while the DPUs align the current one
+        startTimer(&readTimer);
+        batch_nb_reads[next] = 0;
+        if (error == NULL && (total_nb_reads == 0 || nb_sent_requests < total_nb_reads))
+            batch_nb_reads[next] = get_batch(&input, dpuParams[next], dpu_requests[next], dpu_sequences[next], &batch_sequences_size[next], dpu_cost[next], batch_order[next], nr_of_dpus, nb_reads_per_dpu, sequences_capacity, total_nb_reads, &nb_sent_requests);
+        stopTimer(&readTimer);
+        readTime += getElapsedTime(readTimer);
+        if (batch_nb_reads[next] != 0)
+        {
+            startTimer(&phaseTimer);
+            push_batch(dpu_set, dpuParams_m, dpuParams[next], dpu_requests[next], dpu_sequences[next], nb_reads_per_dpu, batch_sequences_size[next]);
+            end_phase(dpu_set, &phaseTimer, &loadTime);
+        }
+
+        // DPU-CPU Transfers of the current batch
+        startTimer(&phaseTimer);
+        uint32_t dpuBuffer_m = cur * dpuParams[cur][0].dpuBufferSize;
+        DPU_FOREACH(dpu_set, dpu, each_dpu)
+        {
+            DPU_ASSERT(dpu_prepare_xfer(dpu, dpuResults[cur][each_dpu]));
+        }
+        DPU_ASSERT(dpu_push_xfer(dpu_set, DPU_XFER_FROM_DPU, DPU_MRAM_HEAP_POINTER_NAME, dpuBuffer_m + dpuParams[cur][0].dpuResults_m, nb_reads_per_dpu * ((sizeof(result_t))), DPU_XFER_ASYNC));
+        DPU_FOREACH(dpu_set, dpu, each_dpu)
+        {
+            DPU_ASSERT(dpu_prepare_xfer(dpu, dpuTaskletStats[cur][each_dpu]));
+        }
+        DPU_ASSERT(dpu_push_xfer(dpu_set, DPU_XFER_FROM_DPU, DPU_MRAM_HEAP_POINTER_NAME, dpuBuffer_m + dpuParams[cur][0].dpuTaskletStats_m, nr_tasklets * sizeof(tasklet_stats_t), DPU_XFER_ASYNC));
+        startTimer(&syncTimer);
+        DPU_ASSERT(dpu_sync(dpu_set));
+        stopTimer(&syncTimer);
+        syncTime += getElapsedTime(syncTimer);
+
+#ifdef BACKTRACE
+        // The CIGARs of a DPU are packed in the order its pairs were aligned, only the size used by the fullest DPU is transferred
+        uint32_t cigars_size = 0;
+        for (int dpu_idx = 0; dpu_idx < nr_of_dpus; ++dpu_idx)
+            for (uint32_t i = 0; i < dpuParams[cur][dpu_idx].dpuNumReads; ++i)
+                cigars_size = MAX(cigars_size, dpuResults[cur][dpu_idx][i].cigar_offset + ROUND_UP_MULTIPLE_8(dpuResults[cur][dpu_idx][i].cigar_length));
+        if (cigars_size != 0)
+        {
+            startTimer(&syncTimer);
+            DPU_FOREACH(dpu_set, dpu, each_dpu)
+            {
+                DPU_ASSERT(dpu_prepare_xfer(dpu, dpuOperations[cur][each_dpu]));
+            }
+            DPU_ASSERT(dpu_push_xfer(dpu_set, DPU_XFER_FROM_DPU, DPU_MRAM_HEAP_POINTER_NAME, dpuBuffer_m + dpuParams[cur][0].dpuOperations_m, cigars_size, DPU_XFER_DEFAULT));
+            stopTimer(&syncTimer);
+            syncTime += getElapsedTime(syncTimer);
+        }
+#endif
+        end_phase(dpu_set, &phaseTimer, &retrieveTime);
+
+        // The next batch is already in the MRAM, it is aligned while the results of the current one are written
+        if (batch_nb_reads[next] != 0)
+        {
+            startTimer(&phaseTimer);
+            DPU_ASSERT(dpu_launch(dpu_set, DPU_ASYNCHRONOUS));
+            end_phase(dpu_set, &phaseTimer, &dpuTime);
+        }
+
+        // A DPU takes the cycles of its slowest tasklet, the tasklets of a DPU without reads don't write their statistics
+        uint64_t max_cost = 0, sum_cost = 0, max_cycles = 0, sum_cycles = 0;
+        uint32_t nb_active_dpus = 0;
+        for (int dpu = 0; dpu < nr_of_dpus; ++dpu)
+        {
+            if (dpuParams[cur][dpu].dpuNumReads == 0)
+                continue;
+            ++nb_active_dpus;
+            uint64_t dpu_cycles = 0;
+            for (int t = 0; t < nr_tasklets; ++t)
+            {
+                tasklet_nb_reads[t] += dpuTaskletStats[cur][dpu][t].nb_reads;
+                dpu_cycles = MAX(dpu_cycles, dpuTaskletStats[cur][dpu][t].cycles);
+            }
+            max_cost = MAX(max_cost, dpu_cost[cur][dpu]);
+            sum_cost += dpu_cost[cur][dpu];
+            max_cycles = MAX(max_cycles, dpu_cycles);
+            sum_cycles += dpu_cycles;
+        }
+#ifdef PROFILE
+        for (int dpu = 0; dpu < nr_of_dpus; ++dpu)
+        {
+            if (dpuParams[cur][dpu].dpuNumReads == 0)
+                continue;
+            for (int t = 0; t < nr_tasklets; ++t)
+            {
+                tasklet_stats_t *stats = &dpuTaskletStats[cur][dpu][t];
+                fprintf(tasklets_file, "%u,%d,%d,%lu,%lu,%lu,%lu,%u,%u\n", nb_batches, dpu, t, stats->nb_reads, stats->cycles,
+                        stats->dma_read, stats->dma_written, stats->wram_peak, stats->mram_peak);
+                wram_peak = MAX(wram_peak, stats->wram_peak);
+                mram_peak = MAX(mram_peak, stats->mram_peak);
+            }
+        }
+#endif
+        predicted_spread += (sum_cost != 0) ? (double)max_cost * nb_active_dpus / sum_cost : 1;
+        actual_spread += (sum_cycles != 0) ? (double)max_cycles * nb_active_dpus / sum_cycles : 1;
+
+        // The results are written in the order of the input, or at the index of their pair in the binary output
+        startTimer(&writeTimer);
+#ifdef BACKTRACE
+        uint8_t **batch_cigars = dpuOperations[cur];
+#else
+        uint8_t **batch_cigars = NULL;
+#endif
+        if (job->write_batch != NULL)
+            job->write_batch(job->write_arg, dpu_requests[cur], dpuResults[cur], batch_cigars, batch_order[cur], batch_nb_reads[cur]);
+        else if (error == NULL && !write_output_batch(&output, dpu_requests[cur], dpuResults[cur], batch_cigars, batch_order[cur], batch_nb_reads[cur]))
+            error = job_error("%s", output.error);
+        stopTimer(&writeTimer);
+        writeTime += getElapsedTime(writeTimer);
+#ifdef PROFILE
+        for (uint32_t k = 0; k < batch_nb_reads[cur]; ++k)
+        {
+            uint32_t dpu = batch_order[cur][k].dpu;
+            uint32_t i = batch_order[cur][k].slot;
+            fprintf(pairs_file, "%u,%u,%u,%d,%d,%d,%lu\n", dpuResults[cur][dpu][i].idx, nb_batches, dpu, dpu_requests[cur][dpu][i].pattern_len,
+                    dpu_requests[cur][dpu][i].text_len, dpuResults[cur][dpu][i].score, dpuResults[cur][dpu][i].cycles);
+        }
+#endif
+        cur = next;
+    }
+#if ENERGY
+    DPU_ASSERT(dpu_probe_stop(&probe));
+    double energy;
+    DPU_ASSERT(dpu_probe_get(&probe, DPU_ENERGY, DPU_AVERAGE, &energy));
+    PRINT_INFO(p.verbosity >= 1, "    DPU Energy: %f J", energy);
+#endif
+    stopTimer(&timer);
+    totalTime = getElapsedTime(timer);
+    uint64_t input_bytes = input_bytes_read(&input);
+    close_input(&input);
+
+    // The transfers and the kernels are overlapped with the parsing and the writing, the host waits for the DPUs for the time they
+    // didn't hide. The phases are only timed apart with PHASE_TIMERS, their sum against the wait of a run without it is the hidden time
+    fprintf(job->log, "Aligned %d read pairs in %u batch(es)\n", nb_sent_requests, nb_batches);
+    fprintf(job->log, "Input Parsing: %f ms\n", readTime * 1e3);
+    fprintf(job->log, "Parsing Throughput: %f MB/s (%u threads)\n", input_bytes / (readTime * 1e6), input.nb_threads);
+#if PHASE_TIMERS
+    fprintf(job->log, "CPU-DPU: %f ms\n", loadTime * 1e3);
+    fprintf(job->log, "DPU Kernel: %f ms\n", dpuTime * 1e3);
+    fprintf(job->log, "DPU-CPU Time: %f ms\n", retrieveTime * 1e3);
+#endif
+    fprintf(job->log, "DPU Wait (transfers + DPU Kernel): %f ms\n", syncTime * 1e3);
+    fprintf(job->log, "Output Writing: %f ms\n", writeTime * 1e3);
+    if (out != NULL)
+        fprintf(job->log, "Writing Throughput: %f MB/s (%u threads)\n", output.bytes_written / (writeTime * 1e6), output.nb_threads);
+    fprintf(job->log, "Total: %f ms\n", totalTime * 1e3);
+    // The tasklets claim the reads dynamically, the counts show how the work was balanced
+    fprintf(job->log, "Reads per tasklet:");
+    for (int t = 0; t < nr_tasklets; ++t)
+        fprintf(job->log, " %lu", tasklet_nb_reads[t]);
+    fprintf(job->log, "\n");
+    if (nb_batches != 0)
+        fprintf(job->log, "DPU work spread (max / mean): predicted %f, actual cycles %f\n", predicted_spread / nb_batches, actual_spread / nb_batches);
+#ifdef PROFILE
+    fprintf(job->log, "Peak memory of a tasklet: WRAM %u B, MRAM %u B\n", wram_peak, mram_peak);
+    fprintf(job->log, "Profile written to %s.tasklets.csv and %s.pairs.csv\n", out, out);
+    fclose(tasklets_file);
+    fclose(pairs_file);
+#endif
+
+    // DPU Logs
+    // uint32_t dpuIdx;
+    // DPU_FOREACH(dpu_set, dpu, dpuIdx)
+    // {
+    //     fprintf(dpu_file, "DPU %u:", dpuIdx);
+    //     DPU_ASSERT(dpu_log_read(dpu, dpu_file));
+    //     ++dpuIdx;
+    // }
+
+    // Free
+    for (int b = 0; b < 2; ++b)
+    {
+        for (int dpu = 0; dpu < nr_of_dpus; ++dpu)
+        {
+            free(dpu_requests[b][dpu]);
+            free(dpu_sequences[b][dpu]);
+            free(dpuResults[b][dpu]);
+            free(dpuTaskletStats[b][dpu]);
+#ifdef BACKTRACE
+            free(dpuOperations[b][dpu]);
+#endif
+        }
+        free(batch_order[b]);
+    }
+    if (out != NULL)
+        close_output(&output);
+
+    stats->nb_pairs = nb_sent_requests;
+    stats->nb_batches = nb_batches;
+    stats->input_bytes = input_bytes;
+    stats->total_time = totalTime;
+    return error;
+}
+
+// Writes a line to the client of the server, a client that left doesn't stop the server
+void reply(int client, const char *format, ...)
+{
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    send(client, line, MIN(length, (int)sizeof(line) - 1), MSG_NOSIGNAL);
+}
+
+// Serves the jobs sent to a Unix socket with the DPUs allocated once. A job is a line of the options and the arguments of the host,
+// without -d and -S, over the options the server was started with, and is answered by a line with its latency and throughput or its
+// error. The DPU binary is only loaded when the number of tasklets of a job changes it. A "quit" line stops the server
+void serve(const char *socket_path, struct dpu_set_t dpu_set, uint32_t nr_of_dpus, const job_t *defaults, FILE *dpu_file)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server == -1 || strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Socket '%s' couldn't be created\n", socket_path);
+        exit(1);
+    }
+    strcpy(address.sun_path, socket_path);
+    unlink(socket_path);
+    if (bind(server, (struct sockaddr *)&address, sizeof(address)) == -1 || listen(server, 16) == -1)
+    {
+        fprintf(stderr, "Socket '%s' couldn't be bound\n", socket_path);
+        exit(1);
+    }
+    printf("Serving jobs on %s\n", socket_path);
+    fflush(stdout);
+
+    char loaded_binary[sizeof(DPU_BINARY) + 16] = "";
+    uint32_t nb_jobs = 0;
+    bool running = true;
+    while (running)
+    {
+        int client = accept(server, NULL, NULL);
+        if (client == -1)
+            continue;
+        // The jobs of a client are run in turn, the clients are served one after the other
+        FILE *requests = fdopen(client, "r");
+        char *line = NULL;
+        size_t capacity = 0;
+        while (running && getline(&line, &capacity, requests) != -1)
+        {
+            Timer latency;
+            startTimer(&latency);
+            char *args[64] = {"job"};
+            int nb_args = 1;
+            for (char *token = strtok(line, " \t\r\n"); token != NULL && nb_args < 63; token = strtok(NULL, " \t\r\n"))
+                args[nb_args++] = token;
+            if (nb_args == 1)
+                continue;
+            if (strcmp(args[1], "quit") == 0)
+            {
+                reply(client, "ok quit\n");
+                running = false;
+                break;
+            }
+
+            job_t job = *defaults;
+            const char *error = "Invalid job, expected [options] input output nb_reads";
+            if (parse_job(nb_args, args, &job, NULL, NULL))
+                error = validate_job(&job, nr_of_dpus);
+            if (error != NULL)
+            {
+                reply(client, "error %s\n", error);
+                continue;
+            }
+            bool loaded = strcmp(job.dpu_binary, loaded_binary) != 0;
+            if (loaded)
+            {
+                DPU_ASSERT(dpu_load(dpu_set, job.dpu_binary, NULL));
+                strcpy(loaded_binary, job.dpu_binary);
+            }
+            ++nb_jobs;
+            printf("Job %u: %s -> %s\n", nb_jobs, job.in, job.out);
+            job_stats_t stats;
+            error = run_job(dpu_set, nr_of_dpus, &job, dpu_file, &stats);
+            fflush(stdout);
+            if (error != NULL)
+            {
+                reply(client, "error %s\n", error);
+                continue;
+            }
+            stopTimer(&latency);
+            float latency_time = getElapsedTime(latency);
+            reply(client, "ok job %u pairs %lu batches %u latency %f ms alignment %f ms throughput %f pairs/s %f MB/s%s\n", nb_jobs, stats.nb_pairs,
+                  stats.nb_batches, latency_time * 1e3, stats.total_time * 1e3, stats.nb_pairs / latency_time, stats.input_bytes / (latency_time * 1e6),
+                  loaded ? " loaded" : "");
+        }
+        free(line);
+        fclose(requests);
+    }
+    close(server);
+    unlink(socket_path);
+}
+
+// The library built by make lib runs the jobs of its clients, without the command line
+#ifndef AIM_LIBRARY
+int main(int argc, char *argv[])
+{
+    struct dpu_set_t dpu_set;
+    uint32_t nr_of_dpus;
+
+    // The options of the run default to the values of the build, the kernels read the alignment parameters from the DPU params
+    job_t job;
+    memset(&job, 0, sizeof(job));
+    job.nr_tasklets = NR_TASKLETS;
+    job.read_size = READ_SIZE;
+    job.max_score = MAX_SCORE;
+    job.wram_segment = WRAM_SEGMENT;
+    job.penalties = (penalties_t)DEFAULT_PENALTIES;
+    job.output_format = OUTPUT_TEXT;
+    job.log = stdout;
+    uint32_t nr_dpus = NR_DPUS;
+    const char *socket_path = NULL;
+    if (!parse_job(argc, argv, &job, &nr_dpus, &socket_path))
+        usage(argv[0]);
+    const char *error = validate_job(&job, nr_dpus);
+    if (error != NULL)
+    {
+        fprintf(stderr, "%s\n", error);
+        exit(1);
+    }
+
+    // The DPUs are allocated once, the server keeps them and the loaded binary for all its jobs
+    FILE *dpu_file = fopen("dpu-out", "w");
+    DPU_ASSERT(dpu_alloc(nr_dpus, NULL, &dpu_set));
+    DPU_ASSERT(dpu_get_nr_dpus(dpu_set, &nr_of_dpus));
+    printf("Allocated %d DPU(s)\n", nr_of_dpus);
+    if (socket_path != NULL)
+    {
+        serve(socket_path, dpu_set, nr_of_dpus, &job, dpu_file);
+    }
+    else
+    {
+        job_stats_t stats;
+        DPU_ASSERT(dpu_load(dpu_set, job.dpu_binary, NULL));
+        error = run_job(dpu_set, nr_of_dpus, &job, dpu_file, &stats);
+        if (error != NULL)
+            fprintf(stderr, "%s\n", error);
+    }
+    DPU_ASSERT(dpu_free(dpu_set));
+
+    fclose(dpu_file);
+    return (error != NULL) ? 1 : 0;
+}
+#endif
@@ -0,0 +1,70 @@
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <dpu.h>
+#include "common.h"
+#include "parser.h"
+#include "writer.h"
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "build/edit_dpu"
+#endif
+
+// Kernel of the DPU binary, the library only runs the algorithm it was built for
+#define HOST_ALGORITHM AIM_EDIT
+
+// Takes the results of a batch in place of the output file, with the arguments of write_output_batch
+typedef void (*batch_writer_t)(void *arg, request_t **dpu_requests, result_t **dpu_results, uint8_t **dpu_cigars, const pair_slot_t *batch_order,
+                               uint32_t batch_nb_reads);
+
+// Options of an alignment job, from the command line, a request to the server or the library
+typedef struct job_t
+{
+    uint32_t nr_tasklets;
+    uint32_t read_size;
+    uint32_t max_score;
+    uint32_t wram_segment;
+    penalties_t penalties;
+    output_format_t output_format;
+    const char *in;           // input read pairs file
+    const char *out;          // output file
+    const char *texts_path;   // texts of the pairs when they are in a file of their own
+    const char *index_path;   // index of the pairs, written on the first run
+    uint32_t total_nb_reads;  // total number of reads to align (0 aligns the whole input file)
+    char dpu_binary[sizeof(DPU_BINARY) + 16];
+    input_t *input;              // read pairs already in memory, the job closes them (the input file is opened otherwise)
+    batch_writer_t write_batch;  // takes the results of each batch in place of the output file
+    void *write_arg;
+    FILE *log;                   // progress and statistics of the job
+} job_t;
+
+// What a job aligned, reported to the client of the server
+typedef struct job_stats_t
+{
+    uint64_t nb_pairs;
+    uint32_t nb_batches;
+    uint64_t input_bytes;
+    float total_time;
+} job_stats_t;
+
+// Parses the options and the arguments of a job over the values of job, returns false when they are malformed. The number of DPUs
+// and the socket of the server are only options of the command line, the server doesn't take arguments
+bool parse_job(int argc, char *argv[], job_t *job, uint32_t *nr_dpus, const char **socket_path);
+
+// Bytes of a read pair in the MRAM region of a batch, besides its sequences
+uint32_t job_read_footprint(const job_t *job);
+
+// MRAM reserved for the working memory of the tasklets, each region of a batch also holds the statistics of the tasklets
+uint64_t job_mram_reserved(const job_t *job);
+
+// Checks the options of a job and selects its DPU binary, returns the reason it can't run or NULL
+const char *validate_job(job_t *job, uint32_t nr_dpus);
+
+// Aligns the read pairs of a job with the DPU binary of the job loaded on the DPUs, the batches of the input alternate between the two
+// MRAM regions of the DPUs. Returns the reason the input or the output of the job failed, or NULL
+const char *run_job(struct dpu_set_t dpu_set, uint32_t nr_of_dpus, const job_t *job, FILE *dpu_file, job_stats_t *stats);
+
+#endif
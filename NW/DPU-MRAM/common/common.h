@@ -60,6 +60,14 @@ SOFTWARE. */
 
 #define DPU_CAPACITY (64 << 20)
 
+// MRAM heap shared by the host buffers and the working memory of the tasklets
+#define MRAM_HEAP_SIZE 64000000
+
+// WRAM of a DPU, the stack of each tasklet is reserved in it and the working memory of the tasklets is allocated from the rest
+#define WRAM_SIZE (64 << 10)
+#define WRAM_STACK_SIZE 1024
+
+// Default alignment parameters of the host, the kernels read the parameters of a run from the DPU params at launch
 #ifndef MATCH
 #define MATCH 0
 #endif
@@ -84,15 +92,26 @@ SOFTWARE. */
 #define READ_SIZE 1120
 #endif
 
+#ifndef WRAM_SEGMENT
+#define WRAM_SEGMENT 1024
+#endif
+
+// The linear-space mode aligns long reads whose scores overflow 16 bits
+#ifndef HIRSCHBERG
 #define NW_W16
+#endif
 
+// MAX_SCORE_LIMIT is the highest score the cells hold
 #ifdef NW_W8
 typedef int8_t cell_type_t;
+#define MAX_SCORE_LIMIT (INT8_MAX - 1)
 #else
 #ifdef NW_W16
 typedef int16_t cell_type_t;
+#define MAX_SCORE_LIMIT (INT16_MAX - 1)
 #else
 typedef int cell_type_t;
+#define MAX_SCORE_LIMIT (INT32_MAX - 1)
 #endif
 #endif
 
@@ -102,6 +121,110 @@ typedef int cell_type_t;
 
 #define ROUND_UP_MULTIPLE_8(x) ((((x) + 7) / 8) * 8)
 
+// Highest score a cell of the full DP-table reaches with reads of read_size bases: a mismatch, a gap or a match of negative cost at each
+// base, and one more gap
+#define CELL_SCORE_BOUND(read_size, penalties) \
+  (((int64_t)(read_size) + 1) * MAX(MAX(MAX((penalties).gap_i, (penalties).gap_d), (penalties).mismatch), -(penalties).match))
+
+// With -DPACKED_TRACEBACK, the backtrace keeps TB_BITS bits of directions per cell (one of M, X, D or I) instead of the
+// scores of the DP-table, and only two rows of scores are kept
+#define TB_BITS 2
+#define TB_ROW_SIZE(read_size) ROUND_UP_MULTIPLE_8((((read_size) + 1) * TB_BITS + 7) / 8)
+
+// In the banded mode (-DBANDED), a row of the DP-table only holds the diagonals v - h an alignment within max_score can reach.
+// Reaching diagonal k and ending on the diagonal d of the last cell takes |k| + |k - d| gaps, at most BAND_GAPS
+#define BAND_GAPS(max_score, penalties) ((max_score) / MIN((penalties).gap_i, (penalties).gap_d))
+#define BAND_ROW_SIZE(max_score, penalties) ROUND_UP_MULTIPLE_8((BAND_GAPS(max_score, penalties) + 1) * sizeof(cell_type_t))
+// The band and the early termination only hold when no step of an alignment lowers its score
+#define BAND_PENALTIES_VALID(penalties) ((penalties).match >= 0 && (penalties).mismatch >= 0 && (penalties).gap_i > 0 && (penalties).gap_d > 0)
+
+// With -DEARLY_TERMINATION, the score-only kernels only compute the cells of a row within the max score and stop a read pair once a row
+// has none, the pair is then rejected with a score of max_score + 1
+#if defined(EARLY_TERMINATION) && defined(BACKTRACE)
+#error "EARLY_TERMINATION is a score-only mode, it is not combined with BACKTRACE"
+#endif
+
+// With -DHIRSCHBERG, the CIGAR is computed in linear space: the DP-table is split at its middle row by a forward and a reverse pass
+// over its halves, and the two halves are aligned in turn. A tasklet only keeps two rows of each pass
+#ifdef HIRSCHBERG
+#if !defined(BACKTRACE) || defined(BANDED) || defined(PACKED_TRACEBACK)
+#error "HIRSCHBERG computes the CIGAR of the full DP-table, it needs BACKTRACE and is not combined with BANDED or PACKED_TRACEBACK"
+#endif
+#endif
+
+// MRAM reserved by each tasklet to store the rows of its DP-table, the band of each row in the banded mode, and the last two rows
+// when there is no backtrace or a packed one, followed by the directions, or the two rows of the forward and reverse passes and the
+// CIGAR being built in the linear-space mode
+#ifdef HIRSCHBERG
+#define MRAM_TASKLET_SEGMENT(read_size, max_score, penalties) (4 * ROUND_UP_MULTIPLE_8(((read_size) + 1) * sizeof(cell_type_t)) + CIGAR_CAPACITY(read_size))
+#elif defined(BANDED)
+#define MRAM_TASKLET_SEGMENT(read_size, max_score, penalties) (((read_size) + 1) * BAND_ROW_SIZE(max_score, penalties))
+#elif defined(BACKTRACE) && defined(PACKED_TRACEBACK)
+#define MRAM_TASKLET_SEGMENT(read_size, max_score, penalties) (2 * ROUND_UP_MULTIPLE_8(((read_size) + 1) * sizeof(cell_type_t)) + (read_size) * TB_ROW_SIZE(read_size))
+#elif defined(BACKTRACE)
+#define MRAM_TASKLET_SEGMENT(read_size, max_score, penalties) (((read_size) + 1) * ROUND_UP_MULTIPLE_8(((read_size) + 1) * sizeof(cell_type_t)))
+#else
+#define MRAM_TASKLET_SEGMENT(read_size, max_score, penalties) (2 * ROUND_UP_MULTIPLE_8(((read_size) + 1) * sizeof(cell_type_t)))
+#endif
+
+// Size in bytes of the tiles of the DP rows streamed through the WRAM, at most 2048 (the largest DMA transfer)
+#ifndef TILE_SIZE
+#define TILE_SIZE 512
+#endif
+#define TILE_CELLS ((int)(TILE_SIZE / sizeof(cell_type_t)))
+// The directions of a tile of the packed traceback are written with one DMA transfer
+#define TB_TILE_SIZE (TILE_CELLS * TB_BITS / 8)
+
+#ifdef HIRSCHBERG
+// Window of a packed sequence of the MRAM, it starts on a multiple of 64 bases so that its bases and its N-mask are 8-byte aligned
+#define HB_WINDOW_BASES 256
+typedef struct hb_window_t
+{
+    uint8_t bases[HB_WINDOW_BASES / 4];
+    uint8_t mask[HB_WINDOW_BASES / 8];
+    uint32_t sequence_m; /* Packed sequence in the MRAM */
+    int length;          /* Length of the sequence */
+    int first;           /* First base of the window */
+} hb_window_t;
+
+// Runs of operations buffered in the WRAM before they are appended to the CIGAR in the MRAM
+#define HB_OPS_SIZE 256
+// Sub-problems left to align, the rows of a sub-problem are halved at each split so a stack of 64 holds any read length
+#define HB_STACK_SIZE 64
+
+// Sub-problem text[t0, t1) against pattern[p0, p1)
+typedef struct hb_node_t
+{
+    int t0;
+    int t1;
+    int p0;
+    int p1;
+} hb_node_t;
+#endif
+
+// WRAM allocated by each tasklet: the request, the result and the CIGAR of a pair, its packed sequences, or the windows of the sequences
+// and the stack of sub-problems in the linear-space mode, two rows of the band or two tiles of rows and the directions of a tile, and
+// the operations of the CIGAR
+#define WRAM_PAIR_SIZE (ROUND_UP_MULTIPLE_8(sizeof(request_t)) + ROUND_UP_MULTIPLE_8(sizeof(result_t)) + ROUND_UP_MULTIPLE_8(sizeof(edit_cigar_t)))
+#ifdef BACKTRACE
+#define WRAM_OPERATIONS_SIZE(read_size) ROUND_UP_MULTIPLE_8(2 * (read_size))
+#else
+#define WRAM_OPERATIONS_SIZE(read_size) 0
+#endif
+#ifdef HIRSCHBERG
+#define WRAM_TASKLET_SEGMENT(read_size, max_score, penalties, wram_segment) \
+    (WRAM_PAIR_SIZE + 2 * ROUND_UP_MULTIPLE_8(sizeof(hb_window_t)) + HB_STACK_SIZE * sizeof(hb_node_t) + 2 * TILE_SIZE + HB_OPS_SIZE)
+#elif defined(BANDED)
+#define WRAM_TASKLET_SEGMENT(read_size, max_score, penalties, wram_segment) \
+    (WRAM_PAIR_SIZE + 2 * PACKED_SIZE(read_size) + 2 * BAND_ROW_SIZE(max_score, penalties) + WRAM_OPERATIONS_SIZE(read_size))
+#elif defined(BACKTRACE) && defined(PACKED_TRACEBACK)
+#define WRAM_TASKLET_SEGMENT(read_size, max_score, penalties, wram_segment) \
+    (WRAM_PAIR_SIZE + 2 * PACKED_SIZE(read_size) + 2 * TILE_SIZE + TB_TILE_SIZE + WRAM_OPERATIONS_SIZE(read_size))
+#else
+#define WRAM_TASKLET_SEGMENT(read_size, max_score, penalties, wram_segment) \
+    (WRAM_PAIR_SIZE + 2 * PACKED_SIZE(read_size) + 2 * TILE_SIZE + WRAM_OPERATIONS_SIZE(read_size))
+#endif
+
 typedef struct
 {
     int max_operations;
@@ -109,36 +232,126 @@ typedef struct
     int begin_offset;
     int end_offset;
     int score;
+    int pattern_begin; /* Span of the alignment on the pattern and the text */
+    int pattern_end;
+    int text_begin;
+    int text_end;
 } edit_cigar_t;
 
+// Sequences are 2-bit packed, 4 bases per byte (A=0, C=1, G=2, T=3), and followed by an N-mask with 1 bit per base.
+// Any base other than A, C, G and T is stored as an N
+#define PACKED_BASES_SIZE(len) ROUND_UP_MULTIPLE_8(((len) + 3) / 4)
+#define PACKED_MASK_SIZE(len) ROUND_UP_MULTIPLE_8(((len) + 7) / 8)
+#define PACKED_SIZE(len) (PACKED_BASES_SIZE(len) + PACKED_MASK_SIZE(len))
+#define PACKED_READ_SIZE PACKED_SIZE(READ_SIZE)
+
+// 2-bit code of the base i of a packed sequence
+#define PACKED_CODE(bases, i) ((((const uint8_t *)(bases))[(i) >> 2] >> (((i)&3) << 1)) & 3)
+// Base i of a packed sequence, N bases are returned as 4 so that they only match N bases
+#define PACKED_BASE(bases, mask, i) (PACKED_CODE(bases, i) | (((((const uint8_t *)(mask))[(i) >> 3] >> ((i)&7)) & 1) << 2))
+
+// Estimated cost of aligning a read pair, used by the host to balance the work of the DPUs.
+// The whole DP table is computed, so the edits estimate isn't used (and isn't evaluated by the macro)
+#define PAIR_COST(pattern_len, text_len, edits) ((uint64_t)(pattern_len) * (text_len))
+
 typedef struct request_t
 {
     int pattern_len;
     int text_len;
-    int padding; /* Padding to ensure the alignment of the struct */
+    uint32_t sequence_offset; /* Offset of the packed pattern in the sequences of the DPU, the packed text follows it */
     uint32_t idx;
 } request_t;
 
+// With BACKTRACE, the kernels write the CIGAR of a pair run-length encoded after the CIGARs of the previous pairs of the batch. A byte
+// is a run of 1 to CIGAR_RUN_MAX operations, the length - 1 in its upper 6 bits and the operation in its lower 2 bits, so the CIGAR
+// of a pair is never longer than its operations. Longer runs take several bytes, the host merges them when it writes the CIGAR
+#define CIGAR_RUN_MAX 64
+#define CIGAR_OP_CODE(op) (((op) == 'M') ? 0 : ((op) == 'X') ? 1 : ((op) == 'I') ? 2 : 3)
+#define CIGAR_RUN(op, length) ((uint8_t)((((length)-1) << 2) | CIGAR_OP_CODE(op)))
+#define CIGAR_RUN_OP(run) ("MXID"[(run)&3])
+#define CIGAR_RUN_LENGTH(run) (((run) >> 2) + 1)
+// Bytes reserved for the CIGAR of a pair of reads of at most read_size bases
+#define CIGAR_CAPACITY(read_size) ROUND_UP_MULTIPLE_8(2 * (read_size))
+// The banded and early termination kernels reject a pair above the max score with a score of max_score + 1, the full DP-table scores
+// every pair
+#if defined(BANDED) || defined(EARLY_TERMINATION)
+#define SCORE_REJECTED(score, max_score) ((score) > (int)(max_score))
+#else
+#define SCORE_REJECTED(score, max_score) 0
+#endif
+
 typedef struct result_t
 {
-    int max_operations;
-    int begin_offset;
-    int end_offset;
+    uint32_t cigar_offset; /* Offset of the CIGAR in the CIGARs of the batch */
+    uint32_t cigar_length; /* Number of runs of the CIGAR */
     int score;
-    uint64_t cycles;
+    int pattern_begin; /* Span of the alignment, the begins are -1 when the kernel doesn't compute them */
+    int pattern_end;
+    int text_begin;
+    int text_end;
     uint32_t idx;
+    uint64_t cycles; /* Cycles spent aligning the pair, filled with -DPROFILE */
 } result_t;
 
+// Statistics written by each tasklet at the end of a batch, the DMA and memory fields are only filled with -DPROFILE
+typedef struct tasklet_stats_t
+{
+    uint64_t nb_reads;    /* Number of reads aligned by the tasklet */
+    uint64_t cycles;      /* Cycles from the launch until the tasklet finished */
+    uint64_t dma_read;    /* Bytes read from the MRAM by the tasklet */
+    uint64_t dma_written; /* Bytes written to the MRAM by the tasklet */
+    uint32_t wram_peak;   /* WRAM high-water mark of the tasklet in bytes */
+    uint32_t mram_peak;   /* MRAM high-water mark of the working memory of the tasklet in bytes */
+} tasklet_stats_t;
+
+// Penalties of the alignment, read by the kernels from the DPU params
+typedef struct penalties_t
+{
+    int32_t match;
+    int32_t mismatch;
+    int32_t gap_i;
+    int32_t gap_d;
+} penalties_t;
+
+#define DEFAULT_PENALTIES {MATCH, MISMATCH, GAP_I, GAP_D}
+#define PENALTIES_USAGE "match,mismatch,gap_i,gap_d"
+
+// Span of the alignment, read by the kernels from the DPU params. A global alignment aligns the whole sequences, an ends-free
+// alignment leaves out up to the given number of bases at the begin and the end of the pattern and of the text for free, and a local
+// alignment (Smith-Waterman) aligns the substrings of the lowest score, which needs a match cost below 0
+#define SPAN_GLOBAL 0
+#define SPAN_ENDS_FREE 1
+#define SPAN_LOCAL 2
+
+typedef struct span_t
+{
+    int32_t mode;
+    int32_t pattern_begin_free;
+    int32_t pattern_end_free;
+    int32_t text_begin_free;
+    int32_t text_end_free;
+    int32_t padding;
+} span_t;
+
+#define DEFAULT_SPAN {SPAN_GLOBAL, 0, 0, 0, 0, 0}
+#define SPAN_USAGE "global|local|ends-free,pattern_begin,pattern_end,text_begin,text_end"
+
 typedef struct DPUParams
 {
     uint32_t dpuNumReads;        /* Number of reads assigned to the DPU */
     uint32_t dpuRequests_m;      /* Base address of the requests in the MRAM */
     uint32_t dpuResults_m;       /* Base address of the results in the MRAM */
-    uint32_t dpuPatterns_m;      /* Base address of the patterns sequences in the MRAM */
-    uint32_t dpuTexts_m;         /* Base address of the text sequences in the MRAM */
-    uint32_t dpuOperations_m;    /* Base address of the traceback operations in the MRAM */
+    uint32_t dpuSequences_m;     /* Base address of the packed sequences in the MRAM */
+    uint32_t dpuOperations_m;    /* Base address of the CIGARs in the MRAM */
     uint32_t mramTotalAllocated; /* Size of the MRAM memory allocated by the host */
-    uint32_t padding;            /* Padding to ensure the alignment of the struct */
+    uint32_t dpuActiveBuffer;    /* MRAM region of the batch to align (0 or 1) */
+    uint32_t dpuBufferSize;      /* Size of an MRAM region */
+    uint32_t dpuTaskletStats_m;  /* Base address of the statistics of the tasklets in the MRAM */
+    uint32_t readSize;           /* Length of the longest read */
+    uint32_t maxScore;           /* Highest alignment score computed */
+    uint32_t wramSegment;        /* Size of the WRAM segment of a tasklet */
+    penalties_t penalties;       /* Penalties of the alignment */
+    span_t span;                 /* Span of the alignment */
 } DPUParams;
 
 #endif
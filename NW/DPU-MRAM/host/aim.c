@@ -0,0 +1,382 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "common.h"
+#include "host.h"
+#include "aim.h"
+
+#ifdef PROFILE
+#error "The library doesn't write the profile of its batches, build it without PROFILE"
+#endif
+
+// Batch of pairs submitted to the library, its results are stored by the thread of the library until it is released
+typedef struct aim_batch_t
+{
+    int64_t id;
+    uint32_t nb_pairs;
+    char *bases;             /* Patterns then texts of the pairs, freed once they are aligned */
+    pair_index_t *pairs;     /* Taken by the input of the batch */
+    aim_result_t *results;
+    uint64_t *cigar_offsets; /* Offset of the CIGAR of each result in cigars, the CIGARs move while they grow */
+    uint8_t *cigars;
+    uint64_t cigars_size;
+    uint64_t cigars_capacity;
+    int max_score;
+    bool span;
+    bool done;
+    char error[256];         /* Reason the batch couldn't be aligned, empty when it was */
+    struct aim_batch_t *next;
+} aim_batch_t;
+
+struct aim_t
+{
+    job_t job;
+    struct dpu_set_t dpu_set;
+    uint32_t nr_of_dpus;
+    FILE *null_log; /* Log opened by the library when the caller didn't give one */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t submitted;
+    pthread_cond_t aligned;
+    aim_batch_t *batches; /* Batches not released, in the order they were submitted */
+    aim_batch_t *last_batch;
+    int64_t nb_batches;
+    bool finalizing;
+};
+
+// Stores the results of a batch of the DPUs, like the records of the binary output
+static void store_results(void *arg, request_t **dpu_requests, result_t **dpu_results, uint8_t **dpu_cigars, const pair_slot_t *batch_order,
+                          uint32_t batch_nb_reads)
+{
+    aim_batch_t *batch = (aim_batch_t *)arg;
+    for (uint32_t k = 0; k < batch_nb_reads && batch->error[0] == '\0'; ++k)
+    {
+        const request_t *request = &dpu_requests[batch_order[k].dpu][batch_order[k].slot];
+        const result_t *result = &dpu_results[batch_order[k].dpu][batch_order[k].slot];
+        aim_result_t *aim_result = &batch->results[result->idx];
+        *aim_result = (aim_result_t){result->score, 0, request->pattern_len, 0, request->text_len, 0, false, NULL};
+        if (batch->span)
+        {
+            aim_result->pattern_begin = result->pattern_begin;
+            aim_result->pattern_end = result->pattern_end;
+            aim_result->text_begin = result->text_begin;
+            aim_result->text_end = result->text_end;
+        }
+        aim_result->rejected = SCORE_REJECTED(result->score, batch->max_score);
+        if (dpu_cigars == NULL || aim_result->rejected)
+            continue;
+        if (batch->cigars_size + result->cigar_length > batch->cigars_capacity)
+        {
+            uint64_t capacity = MAX(2 * batch->cigars_capacity, batch->cigars_size + result->cigar_length);
+            uint8_t *cigars = (uint8_t *)realloc(batch->cigars, capacity);
+            if (cigars == NULL)
+            {
+                snprintf(batch->error, sizeof(batch->error), "CIGARs of %lu bytes couldn't be allocated", capacity);
+                return;
+            }
+            batch->cigars = cigars;
+            batch->cigars_capacity = capacity;
+        }
+        memcpy(batch->cigars + batch->cigars_size, &dpu_cigars[batch_order[k].dpu][result->cigar_offset], result->cigar_length);
+        batch->cigar_offsets[result->idx] = batch->cigars_size;
+        batch->cigars_size += result->cigar_length;
+        aim_result->cigar_length = result->cigar_length;
+    }
+}
+
+// Aligns a batch as a job of the pairs in memory, the DPUs keep the binary loaded by aim_init
+static void align_batch(aim_t *aim, aim_batch_t *batch)
+{
+    input_t input;
+    uint64_t patterns_size = 0;
+    for (uint32_t p = 0; p < batch->nb_pairs; ++p)
+        patterns_size += batch->pairs[p].pattern_length;
+    open_memory_input(&input, batch->bases, batch->bases + patterns_size, batch->pairs, batch->nb_pairs, aim->job.read_size);
+    batch->pairs = NULL;
+
+    // The buffers of the DPUs are sized for the batch rather than for the whole MRAM, with at least 8 pairs per DPU
+    job_t job = aim->job;
+    job.total_nb_reads = MAX(batch->nb_pairs, 8 * aim->nr_of_dpus);
+    job.input = &input;
+    job.write_batch = store_results;
+    job.write_arg = batch;
+    job_stats_t stats;
+    const char *error = run_job(aim->dpu_set, aim->nr_of_dpus, &job, job.log, &stats);
+    if (error != NULL)
+        snprintf(batch->error, sizeof(batch->error), "%s", error);
+    free(batch->bases);
+    batch->bases = NULL;
+    for (uint32_t p = 0; p < batch->nb_pairs; ++p)
+        if (batch->results[p].cigar_length != 0)
+            batch->results[p].cigar = batch->cigars + batch->cigar_offsets[p];
+}
+
+// Thread of the library, aligns the batches in the order they were submitted until the library is finalized
+static void *align_batches(void *arg)
+{
+    aim_t *aim = (aim_t *)arg;
+    pthread_mutex_lock(&aim->lock);
+    while (true)
+    {
+        aim_batch_t *batch = aim->batches;
+        while (batch != NULL && batch->done)
+            batch = batch->next;
+        if (batch == NULL)
+        {
+            if (aim->finalizing)
+                break;
+            pthread_cond_wait(&aim->submitted, &aim->lock);
+            continue;
+        }
+        // A batch that isn't done can't be released, the lock is only held to find it
+        pthread_mutex_unlock(&aim->lock);
+        align_batch(aim, batch);
+        pthread_mutex_lock(&aim->lock);
+        batch->done = true;
+        pthread_cond_broadcast(&aim->aligned);
+    }
+    pthread_mutex_unlock(&aim->lock);
+    return NULL;
+}
+
+static aim_batch_t *find_batch(aim_t *aim, int64_t id)
+{
+    aim_batch_t *batch = aim->batches;
+    while (batch != NULL && batch->id != id)
+        batch = batch->next;
+    return batch;
+}
+
+static void free_batch(aim_batch_t *batch)
+{
+    free(batch->bases);
+    free(batch->pairs);
+    free(batch->results);
+    free(batch->cigar_offsets);
+    free(batch->cigars);
+    free(batch);
+}
+
+aim_t *aim_init(const aim_options_t *options)
+{
+    if (options->algorithm != HOST_ALGORITHM)
+    {
+        fprintf(stderr, "The library runs the kernel of the directory it was built in, link the library of the directory of the algorithm\n");
+        return NULL;
+    }
+
+    // The options default to the values of the build, like the options of the host
+    job_t job;
+    memset(&job, 0, sizeof(job));
+    job.nr_tasklets = options->nr_tasklets != 0 ? options->nr_tasklets : NR_TASKLETS;
+    job.read_size = options->read_size != 0 ? options->read_size : READ_SIZE;
+    job.max_score = options->max_score != 0 ? options->max_score : MAX_SCORE;
+    job.wram_segment = WRAM_SEGMENT;
+    job.penalties = (penalties_t)DEFAULT_PENALTIES;
+    job.output_format = OUTPUT_TEXT;
+    int p[4];
+    if (options->penalties != NULL)
+    {
+        if (sscanf(options->penalties, "%d,%d,%d,%d", &p[0], &p[1], &p[2], &p[3]) != 4)
+        {
+            fprintf(stderr, "Invalid penalties '%s', expected %s\n", options->penalties, PENALTIES_USAGE);
+            return NULL;
+        }
+        job.penalties = (penalties_t){p[0], p[1], p[2], p[3]};
+    }
+#ifdef SPAN_USAGE
+    job.span = (span_t)DEFAULT_SPAN;
+    if (options->span != NULL && !parse_span(options->span, &job.span))
+    {
+        fprintf(stderr, "Invalid span '%s', expected %s\n", options->span, SPAN_USAGE);
+        return NULL;
+    }
+#else
+    if (options->span != NULL)
+    {
+        fprintf(stderr, "The kernel only computes global alignments\n");
+        return NULL;
+    }
+#endif
+#ifdef HEURISTIC_USAGE
+    job.heuristic = (wfa_heuristic_t)DEFAULT_HEURISTIC;
+    if (options->heuristic != NULL && !parse_heuristic(options->heuristic, &job.heuristic))
+    {
+        fprintf(stderr, "Invalid heuristic '%s', expected %s\n", options->heuristic, HEURISTIC_USAGE);
+        return NULL;
+    }
+#else
+    if (options->heuristic != NULL)
+    {
+        fprintf(stderr, "The heuristics only apply to WFA\n");
+        return NULL;
+    }
+#endif
+    uint32_t nr_dpus = options->nr_dpus != 0 ? options->nr_dpus : NR_DPUS;
+    const char *error = validate_job(&job, nr_dpus);
+    if (error != NULL)
+    {
+        fprintf(stderr, "%s\n", error);
+        return NULL;
+    }
+
+    // The DPUs are released when the binary can't be loaded, the caller may try again with other options
+    aim_t *aim = (aim_t *)calloc(1, sizeof(aim_t));
+    dpu_error_t status = dpu_alloc(nr_dpus, NULL, &aim->dpu_set);
+    if (status == DPU_OK)
+    {
+        status = dpu_get_nr_dpus(aim->dpu_set, &aim->nr_of_dpus);
+        if (status == DPU_OK)
+            status = dpu_load(aim->dpu_set, job.dpu_binary, NULL);
+        if (status != DPU_OK)
+            dpu_free(aim->dpu_set);
+    }
+    if (status != DPU_OK)
+    {
+        char *reason = dpu_error_to_string(status);
+        fprintf(stderr, "%u DPU(s) couldn't be allocated and loaded with '%s': %s\n", nr_dpus, job.dpu_binary, reason);
+        free(reason);
+        free(aim);
+        return NULL;
+    }
+    job.log = options->log;
+    if (job.log == NULL)
+        job.log = aim->null_log = fopen("/dev/null", "w");
+    aim->job = job;
+    pthread_mutex_init(&aim->lock, NULL);
+    pthread_cond_init(&aim->submitted, NULL);
+    pthread_cond_init(&aim->aligned, NULL);
+    pthread_create(&aim->thread, NULL, align_batches, aim);
+    return aim;
+}
+
+int64_t aim_submit_batch(aim_t *aim, const aim_pair_t *pairs, uint32_t n)
+{
+    // The bases are copied so that the caller reuses its pairs, the patterns and the texts are contiguous like in an input file
+    uint64_t patterns_size = 0, texts_size = 0;
+    for (uint32_t p = 0; p < n; ++p)
+    {
+        if (pairs[p].pattern_length > aim->job.read_size || pairs[p].text_length > aim->job.read_size)
+        {
+            fprintf(stderr, "Pair %u of the batch is longer than the read size %u\n", p, aim->job.read_size);
+            return -1;
+        }
+        patterns_size += pairs[p].pattern_length;
+        texts_size += pairs[p].text_length;
+    }
+    aim_batch_t *batch = (aim_batch_t *)calloc(1, sizeof(aim_batch_t));
+    batch->nb_pairs = n;
+    batch->bases = (char *)malloc(patterns_size + texts_size + 1);
+    batch->pairs = (pair_index_t *)malloc((n + 1) * sizeof(pair_index_t));
+    batch->results = (aim_result_t *)calloc(n + 1, sizeof(aim_result_t));
+    batch->cigar_offsets = (uint64_t *)calloc(n + 1, sizeof(uint64_t));
+    if (batch->bases == NULL || batch->pairs == NULL || batch->results == NULL || batch->cigar_offsets == NULL)
+    {
+        fprintf(stderr, "Batch of %u pairs couldn't be allocated\n", n);
+        free_batch(batch);
+        return -1;
+    }
+    uint64_t pattern_offset = 0, text_offset = 0;
+    for (uint32_t p = 0; p < n; ++p)
+    {
+        batch->pairs[p] = (pair_index_t){pattern_offset, text_offset, pairs[p].pattern_length, pairs[p].text_length};
+        memcpy(batch->bases + pattern_offset, pairs[p].pattern, pairs[p].pattern_length);
+        memcpy(batch->bases + patterns_size + text_offset, pairs[p].text, pairs[p].text_length);
+        pattern_offset += pairs[p].pattern_length;
+        text_offset += pairs[p].text_length;
+    }
+    batch->max_score = aim->job.max_score;
+#ifdef SPAN_USAGE
+    batch->span = aim->job.span.mode != SPAN_GLOBAL;
+#endif
+
+    pthread_mutex_lock(&aim->lock);
+    batch->id = aim->nb_batches++;
+    if (aim->last_batch != NULL)
+        aim->last_batch->next = batch;
+    else
+        aim->batches = batch;
+    aim->last_batch = batch;
+    pthread_cond_signal(&aim->submitted);
+    pthread_mutex_unlock(&aim->lock);
+    return batch->id;
+}
+
+int aim_poll(aim_t *aim, int64_t batch)
+{
+    pthread_mutex_lock(&aim->lock);
+    aim_batch_t *found = find_batch(aim, batch);
+    int done = -1;
+    if (found != NULL && (!found->done || found->error[0] == '\0'))
+        done = found->done;
+    pthread_mutex_unlock(&aim->lock);
+    return done;
+}
+
+const aim_result_t *aim_wait(aim_t *aim, int64_t batch)
+{
+    pthread_mutex_lock(&aim->lock);
+    aim_batch_t *found = find_batch(aim, batch);
+    while (found != NULL && !found->done)
+        pthread_cond_wait(&aim->aligned, &aim->lock);
+    pthread_mutex_unlock(&aim->lock);
+    return (found != NULL && found->error[0] == '\0') ? found->results : NULL;
+}
+
+const char *aim_error(aim_t *aim, int64_t batch)
+{
+    pthread_mutex_lock(&aim->lock);
+    aim_batch_t *found = find_batch(aim, batch);
+    const char *error = "Unknown batch";
+    if (found != NULL)
+        error = (found->done && found->error[0] != '\0') ? found->error : NULL;
+    pthread_mutex_unlock(&aim->lock);
+    return error;
+}
+
+void aim_release(aim_t *aim, int64_t batch)
+{
+    aim_wait(aim, batch);
+    pthread_mutex_lock(&aim->lock);
+    aim_batch_t **link = &aim->batches, *previous = NULL;
+    while (*link != NULL && (*link)->id != batch)
+    {
+        previous = *link;
+        link = &(*link)->next;
+    }
+    aim_batch_t *found = *link;
+    if (found != NULL)
+    {
+        *link = found->next;
+        if (aim->last_batch == found)
+            aim->last_batch = previous;
+    }
+    pthread_mutex_unlock(&aim->lock);
+    if (found != NULL)
+        free_batch(found);
+}
+
+void aim_finalize(aim_t *aim)
+{
+    pthread_mutex_lock(&aim->lock);
+    aim->finalizing = true;
+    pthread_cond_signal(&aim->submitted);
+    pthread_mutex_unlock(&aim->lock);
+    pthread_join(aim->thread, NULL);
+
+    while (aim->batches != NULL)
+    {
+        aim_batch_t *next = aim->batches->next;
+        free_batch(aim->batches);
+        aim->batches = next;
+    }
+    DPU_ASSERT(dpu_free(aim->dpu_set));
+    if (aim->null_log != NULL)
+        fclose(aim->null_log);
+    pthread_mutex_destroy(&aim->lock);
+    pthread_cond_destroy(&aim->submitted);
+    pthread_cond_destroy(&aim->aligned);
+    free(aim);
+}
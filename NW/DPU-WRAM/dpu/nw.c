@@ -52,6 +52,11 @@ SOFTWARE. */
 #include "../common/common.h"
 #include "dpu_allocator_wram.h"
 #include "dpu_allocator_mram.h"
+#include <barrier.h>
+#include <mutex.h>
+#include <perfcounter.h>
+#include "dpu_profile.h"
+#include "dpu_params.h"
 
 void edit_cigar_allocate(
     edit_cigar_t *edit_cigar,
@@ -62,19 +67,55 @@ void edit_cigar_allocate(
     edit_cigar->begin_offset = edit_cigar->max_operations - 1;
     edit_cigar->end_offset = edit_cigar->max_operations;
     edit_cigar->score = 0;
+    edit_cigar->pattern_begin = 0;
+    edit_cigar->pattern_end = pattern_length;
+    edit_cigar->text_begin = 0;
+    edit_cigar->text_end = text_length;
 }
 
-void nw_traceback(int num_cols, int num_rows, edit_cigar_t *cigar, cell_type_t *dp_table)
+// Bases of the pattern and of the text the span of the alignment leaves out for free at their begin and at their end
+typedef struct span_free_t
+{
+    int pattern_begin;
+    int pattern_end;
+    int text_begin;
+    int text_end;
+} span_free_t;
+
+span_free_t span_free(int pattern_length, int text_length)
+{
+    if (SPAN.mode == SPAN_LOCAL)
+        return (span_free_t){pattern_length, pattern_length, text_length, text_length};
+    if (SPAN.mode == SPAN_ENDS_FREE)
+        return (span_free_t){MIN(SPAN.pattern_begin_free, pattern_length), MIN(SPAN.pattern_end_free, pattern_length),
+                             MIN(SPAN.text_begin_free, text_length), MIN(SPAN.text_end_free, text_length)};
+    return (span_free_t){0, 0, 0, 0};
+}
+
+// Score of the cell (h, 0) or (0, v) of the first column or row, the bases left out for free at the begin cost nothing
+#define BEGIN_CELL(bases, free_bases, gap) (((bases) <= (free_bases)) ? 0 : ((bases) - (free_bases)) * (gap))
+
+// Begin of the alignment when the traceback isn't computed, it is unknown when the begin of a sequence is free
+void span_unknown_begin(edit_cigar_t *cigar, span_free_t free)
+{
+    if (free.pattern_begin > 0)
+        cigar->pattern_begin = -1;
+    if (free.text_begin > 0)
+        cigar->text_begin = -1;
+}
+
+// Traceback from the end cell (h, v) of the alignment, it stops at the first row or column once the bases left out for free are reached,
+// or at a cell of score 0 of a local alignment
+void nw_traceback(int num_cols, int h, int v, span_free_t free, edit_cigar_t *cigar, cell_type_t *dp_table)
 {
     char *const operations = cigar->operations;
     int op_sentinel = cigar->end_offset - 1;
-    int h, v;
-    // Compute traceback
-    h = num_cols - 1;
-    v = num_rows - 1;
+    bool local = SPAN.mode == SPAN_LOCAL;
 
     while (h > 0 && v > 0)
     {
+        if (local && dp_table[num_cols * h + v] == 0)
+            break;
         if (dp_table[num_cols * h + v] == dp_table[num_cols * h + v - 1] + GAP_D)
         {
             operations[op_sentinel--] = 'D';
@@ -93,46 +134,50 @@ void nw_traceback(int num_cols, int num_rows, edit_cigar_t *cigar, cell_type_t *
             --v;
         }
     }
-    while (h > 0)
+    while (v == 0 && h > free.text_begin)
     {
         operations[op_sentinel--] = 'I';
         --h;
     }
-    while (v > 0)
+    while (h == 0 && v > free.pattern_begin)
     {
         operations[op_sentinel--] = 'D';
         --v;
     }
     cigar->begin_offset = op_sentinel + 1;
+    cigar->pattern_begin = v;
+    cigar->text_begin = h;
 }
 
 void nw_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, cell_type_t *dp_table)
 {
     int h, v;
-    int num_rows = pattern_length + 1;
-    int num_cols = text_length + 1;
-
-    int cell = 0;
-    dp_table[0] = cell;
+    // A row of the table holds the cells of a base of the text
+    int num_cols = pattern_length + 1;
+    span_free_t free = span_free(pattern_length, text_length);
+    bool local = SPAN.mode == SPAN_LOCAL;
 
+    dp_table[0] = 0;
     for (v = 1; v <= pattern_length; ++v)
     {
         // Initialize first column
-        cell = cell + GAP_D;
-        dp_table[v] = cell;
+        dp_table[v] = BEGIN_CELL(v, free.pattern_begin, GAP_D);
     }
-    cell = 0;
     for (h = 1; h <= text_length; ++h)
     {
         // Initialize first row
-        cell = cell + GAP_I;
-        dp_table[num_cols * h] = cell;
+        dp_table[num_cols * h] = BEGIN_CELL(h, free.text_begin, GAP_I);
     }
 
-    // Compute DP
-    cell_type_t score = 0;
+    // Compute DP, the bases are read from the packed sequences
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    // A local alignment ends at its lowest cell
+    int end_h = text_length, end_v = pattern_length;
+    cell_type_t best = 0;
     for (h = 1; h <= text_length; ++h)
     {
+        int text_base = PACKED_BASE(text, text_mask, h - 1);
         for (v = 1; v <= pattern_length; ++v)
         {
             // Del
@@ -140,22 +185,453 @@ void nw_compute(char *pattern, char *text, int pattern_length, int text_length,
             // Ins
             cell_type_t ins = (cell_type_t)dp_table[num_cols * (h - 1) + v] + GAP_I;
             // Match
-            cell_type_t m_match = (cell_type_t)dp_table[(num_cols * (h - 1) + v - 1)] + ((pattern[v - 1] == text[h - 1]) ? 0 : MISMATCH);
+            cell_type_t m_match = (cell_type_t)dp_table[(num_cols * (h - 1) + v - 1)] + ((PACKED_BASE(pattern, pattern_mask, v - 1) == text_base) ? MATCH : MISMATCH);
 
-            score = dp_table[num_cols * h + v] = (cell_type_t)MIN(m_match, MIN(ins, del));
+            cell_type_t score = (cell_type_t)MIN(m_match, MIN(ins, del));
+            if (local)
+            {
+                // A local alignment can start at any cell
+                score = MIN(score, 0);
+                if (score < best)
+                {
+                    best = score;
+                    end_h = h;
+                    end_v = v;
+                }
+            }
+            dp_table[num_cols * h + v] = score;
         }
     }
-    cigar->score = (int)score;
+    if (SPAN.mode == SPAN_ENDS_FREE)
+    {
+        // The alignment ends in the last row or column once the bases left out for free are reached, the corner wins the ties
+        best = dp_table[num_cols * text_length + pattern_length];
+        for (h = text_length - free.text_end; h < text_length; ++h)
+            if (dp_table[num_cols * h + pattern_length] < best)
+            {
+                best = dp_table[num_cols * h + pattern_length];
+                end_h = h;
+            }
+        for (v = pattern_length - 1; v >= pattern_length - free.pattern_end; --v)
+            if (dp_table[num_cols * text_length + v] < best)
+            {
+                best = dp_table[num_cols * text_length + v];
+                end_h = text_length;
+                end_v = v;
+            }
+    }
+    cigar->score = (int)dp_table[num_cols * end_h + end_v];
+    cigar->pattern_end = end_v;
+    cigar->text_end = end_h;
 #ifdef BACKTRACE
     // Compute traceback
-    nw_traceback(num_cols, num_rows, cigar, dp_table);
+    nw_traceback(num_cols, end_h, end_v, free, cigar, dp_table);
+#else
+    span_unknown_begin(cigar, free);
+#endif
+}
+
+#ifdef PACKED_TRACEBACK
+// Directions of the packed traceback, the choice the traceback of the scores makes at a cell
+#define TB_M 0
+#define TB_X 1
+#define TB_D 2
+#define TB_I 3
+
+// Direction of the cell (h, v), the row h of the directions starts at (h - 1) * TB_ROW_SIZE
+#define TB_CELL(tb, pattern_length, h, v) (((tb)[((h)-1) * TB_ROW_SIZE(pattern_length) + (v)*TB_BITS / 8] >> (((v)*TB_BITS) & 7)) & ((1 << TB_BITS) - 1))
+
+void nw_packed_traceback(int pattern_length, int h, int v, span_free_t free, edit_cigar_t *cigar, uint8_t *tb)
+{
+    char *const operations = cigar->operations;
+    int op_sentinel = cigar->end_offset - 1;
+
+    while (h > 0 && v > 0)
+    {
+        switch (TB_CELL(tb, pattern_length, h, v))
+        {
+        case TB_D:
+            operations[op_sentinel--] = 'D';
+            --v;
+            break;
+        case TB_I:
+            operations[op_sentinel--] = 'I';
+            --h;
+            break;
+        default:
+            operations[op_sentinel--] = (TB_CELL(tb, pattern_length, h, v) == TB_X) ? 'X' : 'M';
+            --h;
+            --v;
+            break;
+        }
+    }
+    while (v == 0 && h > free.text_begin)
+    {
+        operations[op_sentinel--] = 'I';
+        --h;
+    }
+    while (h == 0 && v > free.pattern_begin)
+    {
+        operations[op_sentinel--] = 'D';
+        --v;
+    }
+    cigar->begin_offset = op_sentinel + 1;
+    cigar->pattern_begin = v;
+    cigar->text_begin = h;
+}
+
+// Only two rows of scores are kept, the backtrace follows the TB_BITS bits of direction stored for each cell
+void nw_packed_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, cell_type_t *dp_rows, uint8_t *tb)
+{
+    int row_cells = ROUND_UP_MULTIPLE_8((pattern_length + 1) * sizeof(cell_type_t)) / sizeof(cell_type_t);
+    cell_type_t *row = dp_rows;
+    cell_type_t *upper_row = dp_rows + row_cells;
+    span_free_t free = span_free(pattern_length, text_length);
+    // Lowest cell of the last column before the corner, where an alignment leaving out the end of the text for free can end
+    int end_h = text_length;
+    int best = INT32_MAX;
+
+    // Compute DP, the bases are read from the packed sequences
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    for (int h = 0; h <= text_length; ++h)
+    {
+        int text_base = (h > 0) ? PACKED_BASE(text, text_mask, h - 1) : 0;
+#ifdef BACKTRACE
+        uint8_t *tb_row = tb + (h - 1) * TB_ROW_SIZE(pattern_length);
+#endif
+        for (int v = 0; v <= pattern_length; ++v)
+        {
+            if (h == 0)
+                // Initialize first row
+                row[v] = BEGIN_CELL(v, free.pattern_begin, GAP_D);
+            else if (v == 0)
+                // Initialize first column
+                row[v] = BEGIN_CELL(h, free.text_begin, GAP_I);
+            else
+            {
+                // Del
+                cell_type_t del = (cell_type_t)row[v - 1] + GAP_D;
+                // Ins
+                cell_type_t ins = (cell_type_t)upper_row[v] + GAP_I;
+                // Match
+                cell_type_t m_match = (cell_type_t)upper_row[v - 1] + ((PACKED_BASE(pattern, pattern_mask, v - 1) == text_base) ? MATCH : MISMATCH);
+                row[v] = (cell_type_t)MIN(m_match, MIN(ins, del));
+#ifdef BACKTRACE
+                // Same choices as the traceback of the scores
+                int dir = (row[v] == row[v - 1] + GAP_D) ? TB_D : (row[v] == upper_row[v] + GAP_I) ? TB_I : (row[v] == upper_row[v - 1] + MISMATCH) ? TB_X : TB_M;
+                if (v == 1 || ((v * TB_BITS) & 7) == 0)
+                    tb_row[v * TB_BITS / 8] = 0;
+                tb_row[v * TB_BITS / 8] |= dir << ((v * TB_BITS) & 7);
+#endif
+            }
+        }
+        if (h < text_length && h >= text_length - free.text_end && row[pattern_length] < best)
+        {
+            best = row[pattern_length];
+            end_h = h;
+        }
+        cell_type_t *tmp = row;
+        row = upper_row;
+        upper_row = tmp;
+    }
+    // The last row is in upper_row after the swap, the alignment ends in the last row or column once the bases left out for free are
+    // reached and the corner wins the ties
+    int end_v = pattern_length;
+    if (upper_row[pattern_length] <= best)
+    {
+        best = upper_row[pattern_length];
+        end_h = text_length;
+    }
+    for (int v = pattern_length - 1; v >= pattern_length - free.pattern_end; --v)
+        if (upper_row[v] < best)
+        {
+            best = upper_row[v];
+            end_h = text_length;
+            end_v = v;
+        }
+    cigar->score = best;
+    cigar->pattern_end = end_v;
+    cigar->text_end = end_h;
+#ifdef BACKTRACE
+    nw_packed_traceback(pattern_length, end_h, end_v, free, cigar, tb);
+#else
+    span_unknown_begin(cigar, free);
+#endif
+}
+#endif
+
+#ifdef EARLY_TERMINATION
+// Score-only DP-table that stops at MAX_SCORE, in two rows. As the scores never decrease along an alignment, the cells of a row left of
+// the first cell within MAX_SCORE of the upper row, or right of the last one and of a cell above MAX_SCORE, are above MAX_SCORE too. A
+// row is only computed from its first column lo to the cell ending it, the cells out of [lo, hi] of the upper row saturate at
+// MAX_SCORE + 1, and the pair is rejected with a score of MAX_SCORE + 1 once a row has no cell within MAX_SCORE
+void nw_threshold_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, cell_type_t *dp_rows)
+{
+    int row_cells = ROUND_UP_MULTIPLE_8((pattern_length + 1) * sizeof(cell_type_t)) / sizeof(cell_type_t);
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    const int limit = MAX_SCORE + 1;
+    // First and last columns of the upper row within MAX_SCORE, the first row has no upper row
+    int lo = 0;
+    int hi = -1;
+    for (int h = 0; h <= text_length; ++h)
+    {
+        int text_base = (h > 0) ? PACKED_BASE(text, text_mask, h - 1) : 0;
+        cell_type_t *row = dp_rows + (h & 1) * row_cells;
+        cell_type_t *upper_row = dp_rows + ((h - 1) & 1) * row_cells;
+        int row_lo = -1;
+        int row_hi = -1;
+        int left = limit;
+        int diag = limit;
+        for (int v = lo; v <= pattern_length; ++v)
+        {
+            int up = (v <= hi) ? upper_row[v] : limit;
+            int cell;
+            if (h == 0)
+                cell = v * GAP_D;
+            else if (v == 0)
+                cell = h * GAP_I;
+            else
+                cell = MIN(diag + ((PACKED_BASE(pattern, pattern_mask, v - 1) == text_base) ? MATCH : MISMATCH), MIN(up + GAP_I, left + GAP_D));
+            row[v] = cell = MIN(cell, limit);
+            if (cell <= MAX_SCORE)
+            {
+                if (row_lo < 0)
+                    row_lo = v;
+                row_hi = v;
+            }
+            else if (v > hi)
+                // The next cells of the row only come from this one
+                break;
+            left = cell;
+            diag = up;
+        }
+        if (row_lo < 0)
+        {
+            cigar->score = limit;
+            return;
+        }
+        lo = row_lo;
+        hi = row_hi;
+    }
+    // The last row reaches the last column within MAX_SCORE
+    cigar->score = (hi == pattern_length) ? dp_rows[(text_length & 1) * row_cells + pattern_length] : limit;
+}
+#endif
+
+#ifdef BANDED
+// The traceback needs every row of the band, the score only the last two
+#ifdef BACKTRACE
+#define BAND_ROW(h) (h)
+#else
+#define BAND_ROW(h) ((h)&1)
+#endif
+
+// Lowest diagonal v - h of the band of a read pair, returns the number of diagonals of the band or 0 when the lengths differ by
+// more gaps than an alignment within MAX_SCORE holds
+int nw_band(int pattern_length, int text_length, int *band_lo)
+{
+    int gaps = BAND_GAPS(MAX_SCORE, dpu_params.penalties);
+    int d = pattern_length - text_length;
+    if (ABS(d) > gaps)
+        return 0;
+    int margin = (gaps - ABS(d)) / 2;
+    *band_lo = MIN(0, d) - margin;
+    return ABS(d) + 2 * margin + 1;
+}
+
+// Cell (h, v) of the band, the cells out of the band are never below MAX_SCORE
+static inline int band_cell(cell_type_t *dp_table, int band_width, int band_lo, int h, int v)
+{
+    int k = v - h - band_lo;
+    if (k < 0 || k >= band_width)
+        return MAX_SCORE;
+    return dp_table[BAND_ROW(h) * band_width + k];
+}
+
+void nw_banded_traceback(int band_width, int band_lo, int text_length, int pattern_length, edit_cigar_t *cigar, cell_type_t *dp_table)
+{
+    char *const operations = cigar->operations;
+    int op_sentinel = cigar->end_offset - 1;
+    int h = text_length;
+    int v = pattern_length;
+
+    // Same choices as the traceback of the full DP-table
+    while (h > 0 && v > 0)
+    {
+        int cell = band_cell(dp_table, band_width, band_lo, h, v);
+        if (cell == band_cell(dp_table, band_width, band_lo, h, v - 1) + GAP_D)
+        {
+            operations[op_sentinel--] = 'D';
+            --v;
+        }
+        else if (cell == band_cell(dp_table, band_width, band_lo, h - 1, v) + GAP_I)
+        {
+            operations[op_sentinel--] = 'I';
+            --h;
+        }
+        else
+        {
+            operations[op_sentinel--] = (cell == band_cell(dp_table, band_width, band_lo, h - 1, v - 1) + MISMATCH) ? 'X' : 'M';
+            --h;
+            --v;
+        }
+    }
+    while (h > 0)
+    {
+        operations[op_sentinel--] = 'I';
+        --h;
+    }
+    while (v > 0)
+    {
+        operations[op_sentinel--] = 'D';
+        --v;
+    }
+    cigar->begin_offset = op_sentinel + 1;
+}
+
+// Only computes the diagonals of the band, a row h holds the cells v = h + band_lo ... h + band_lo + band_width - 1. The cells saturate
+// at MAX_SCORE + 1, so the score is exact up to MAX_SCORE and higher scores are reported as MAX_SCORE + 1
+void nw_banded_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, cell_type_t *dp_table)
+{
+    int band_lo;
+    int band_width = nw_band(pattern_length, text_length, &band_lo);
+    if (band_width == 0)
+    {
+        cigar->score = MAX_SCORE + 1;
+        return;
+    }
+
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    for (int h = 0; h <= text_length; ++h)
+    {
+        cell_type_t *row = &dp_table[BAND_ROW(h) * band_width];
+        cell_type_t *upper_row = (h > 0) ? &dp_table[BAND_ROW(h - 1) * band_width] : row;
+        int text_base = (h > 0) ? PACKED_BASE(text, text_mask, h - 1) : 0;
+        for (int k = 0; k < band_width; ++k)
+        {
+            int v = h + band_lo + k;
+            if (v < 0 || v > pattern_length)
+                row[k] = MAX_SCORE;
+            else if (h == 0)
+                row[k] = MIN(v * GAP_D, MAX_SCORE + 1);
+            else if (v == 0)
+                row[k] = MIN(h * GAP_I, MAX_SCORE + 1);
+            else
+            {
+                // Del, the left cell is on the diagonal below
+                int del = ((k > 0) ? row[k - 1] : MAX_SCORE) + GAP_D;
+                // Ins, the upper cell is on the diagonal above
+                int ins = ((k < band_width - 1) ? upper_row[k + 1] : MAX_SCORE) + GAP_I;
+                // Match
+                int m_match = upper_row[k] + ((PACKED_BASE(pattern, pattern_mask, v - 1) == text_base) ? MATCH : MISMATCH);
+                row[k] = (cell_type_t)MIN(MIN(m_match, MIN(ins, del)), MAX_SCORE + 1);
+            }
+        }
+#ifdef EARLY_TERMINATION
+        // The next rows only come from the cells of this row within the DP-table
+        bool within = false;
+        for (int k = MAX(0, -h - band_lo); k <= MIN(band_width - 1, pattern_length - h - band_lo); ++k)
+            within |= row[k] <= MAX_SCORE;
+        if (!within)
+        {
+            cigar->score = MAX_SCORE + 1;
+            return;
+        }
+#endif
+    }
+    int score = dp_table[BAND_ROW(text_length) * band_width + pattern_length - text_length - band_lo];
+    if (score > MAX_SCORE)
+    {
+        cigar->score = MAX_SCORE + 1;
+        return;
+    }
+    cigar->score = score;
+#ifdef BACKTRACE
+    nw_banded_traceback(band_width, band_lo, text_length, pattern_length, cigar, dp_table);
 #endif
 }
+#endif
+
+// Reads a packed sequence from the MRAM, DMA transfers must be less than 2048
+void read_packed_sequence(uint32_t sequence_m, char *sequence, int length)
+{
+    int size = PACKED_SIZE(length);
+    for (int segment = 0; segment < size; segment += 2048)
+        mram_read((__mram_ptr void const *)(sequence_m + segment), &sequence[segment], MIN(2048, size - segment));
+}
+
+// Index of the next read of the batch to align, shared by the tasklets
+uint32_t next_read;
+MUTEX_INIT(next_read_mutex);
+// Offset of the next CIGAR in the CIGARs of the batch, shared by the tasklets
+uint32_t next_cigar;
+MUTEX_INIT(next_cigar_mutex);
+BARRIER_INIT(start_barrier, NR_TASKLETS);
+
+// Parameters of the current launch
+DPUParams dpu_params;
+
+// Statistics of the tasklets of the current launch
+tasklet_stats_t tasklet_stats[NR_TASKLETS];
+
+// Claims the next read of the batch, all the reads are claimed once it returns nb_reads_per_dpu or more
+uint32_t claim_read()
+{
+    mutex_lock(next_read_mutex);
+    uint32_t read_idx = next_read++;
+    mutex_unlock(next_read_mutex);
+    return read_idx;
+}
+
+#ifdef BACKTRACE
+// Claims size bytes of the CIGARs of the batch, returns their offset
+uint32_t claim_cigar(uint32_t size)
+{
+    mutex_lock(next_cigar_mutex);
+    uint32_t cigar_offset = next_cigar;
+    next_cigar += ROUND_UP_MULTIPLE_8(size);
+    mutex_unlock(next_cigar_mutex);
+    return cigar_offset;
+}
+
+// Replaces the operations of the alignment by their runs at the beginning of its operations buffer, returns the number of runs.
+// A run is written after the operations it encodes are read, and before the operations of the next runs
+uint32_t cigar_encode(edit_cigar_t *cigar)
+{
+    uint8_t *runs = (uint8_t *)cigar->operations;
+    uint32_t nb_runs = 0;
+    int i = cigar->begin_offset;
+    while (i < cigar->end_offset)
+    {
+        char op = cigar->operations[i];
+        int length = 1;
+        while (i + length < cigar->end_offset && cigar->operations[i + length] == op && length < CIGAR_RUN_MAX)
+            ++length;
+        runs[nb_runs++] = CIGAR_RUN(op, length);
+        i += length;
+    }
+    return nb_runs;
+}
+
+// Writes the CIGAR of the alignment run-length encoded after the CIGARs of the previous pairs, DMA transfers must be less than 2048
+void store_cigar(edit_cigar_t *cigar, uint32_t cigars_m, result_t *result)
+{
+    uint32_t size = cigar_encode(cigar);
+    result->cigar_offset = claim_cigar(size);
+    result->cigar_length = size;
+    for (uint32_t segment = 0; segment < size; segment += 2048)
+        mram_write(&cigar->operations[segment], (__mram_ptr void *)(cigars_m + result->cigar_offset + segment), MIN(2048, ROUND_UP_MULTIPLE_8(size - segment)));
+}
+#endif
 
 int main()
 {
     mem_reset();
     uint32_t tasklet_id = me();
+    memset(&tasklet_stats[tasklet_id], 0, sizeof(tasklet_stats_t));
 
     // Load parameters
     uint32_t params_m = (uint32_t)DPU_MRAM_HEAP_POINTER;
@@ -166,13 +642,22 @@ int main()
     if (nb_reads_per_dpu <= 0)
         return 0;
 
-    int nb_reads_per_tasklets = ROUND_UP_MULTIPLE_8(((nb_reads_per_dpu + NR_TASKLETS) / NR_TASKLETS));
+    // Tasklet 0 shares the parameters of the launch and resets the read and CIGAR counters of the previous launch and the cycle counter
+    if (tasklet_id == 0)
+    {
+        dpu_params = params_w;
+        next_read = 0;
+        next_cigar = 0;
+        perfcounter_config(COUNT_CYCLES, true);
+    }
+    barrier_wait(&start_barrier);
 
-    uint32_t dpuRequests_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuRequests_m;
-    uint32_t dpuResults_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuResults_m;
-    uint32_t dpuPatterns_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuPatterns_m;
-    uint32_t dpuTexts_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuTexts_m;
-    uint32_t dpuOperations_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuOperations_m;
+    // Base address of the MRAM region holding the batch
+    uint32_t dpuBuffer_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuActiveBuffer * params_w.dpuBufferSize;
+    uint32_t dpuRequests_m = dpuBuffer_m + params_w.dpuRequests_m;
+    uint32_t dpuResults_m = dpuBuffer_m + params_w.dpuResults_m;
+    uint32_t dpuSequences_m = dpuBuffer_m + params_w.dpuSequences_m;
+    uint32_t dpuOperations_m = dpuBuffer_m + params_w.dpuOperations_m;
 
     request_t *request_w = (request_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(request_t)));
     result_t *result_w = (result_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(result_t)));
@@ -180,11 +665,29 @@ int main()
     edit_cigar_t *cigar;
     cigar = (edit_cigar_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(edit_cigar_t)));
 
-    char *pattern = (char *)mem_alloc(ROUND_UP_MULTIPLE_8(READ_SIZE));
-    char *text = (char *)mem_alloc(ROUND_UP_MULTIPLE_8(READ_SIZE));
+    char *pattern = (char *)mem_alloc(PACKED_READ_SIZE);
+    char *text = (char *)mem_alloc(PACKED_READ_SIZE);
 
     // Each taasklet has a DP-table stored in WRAM reused
-    cell_type_t *dp_table = (cell_type_t *)mem_alloc(ROUND_UP_MULTIPLE_8(READ_SIZE * READ_SIZE * sizeof(cell_type_t)));
+#ifdef BANDED
+#ifdef BACKTRACE
+    cell_type_t *dp_table = (cell_type_t *)mem_alloc((READ_SIZE + 1) * BAND_ROW_SIZE(MAX_SCORE, dpu_params.penalties));
+#else
+    cell_type_t *dp_table = (cell_type_t *)mem_alloc(2 * BAND_ROW_SIZE(MAX_SCORE, dpu_params.penalties));
+#endif
+#elif defined(EARLY_TERMINATION)
+    cell_type_t *dp_table = (cell_type_t *)mem_alloc(2 * ROUND_UP_MULTIPLE_8((READ_SIZE + 1) * sizeof(cell_type_t)));
+#elif defined(PACKED_TRACEBACK)
+    // Two rows of scores, and the directions of the cells for the backtrace
+    cell_type_t *dp_table = (cell_type_t *)mem_alloc(2 * ROUND_UP_MULTIPLE_8((READ_SIZE + 1) * sizeof(cell_type_t)));
+#ifdef BACKTRACE
+    uint8_t *tb = (uint8_t *)mem_alloc(READ_SIZE * TB_ROW_SIZE(READ_SIZE));
+#else
+    uint8_t *tb = NULL;
+#endif
+#else
+    cell_type_t *dp_table = (cell_type_t *)mem_alloc(ROUND_UP_MULTIPLE_8((READ_SIZE + 1) * (READ_SIZE + 1) * sizeof(cell_type_t)));
+#endif
 
 #ifdef BACKTRACE
     cigar->operations = (char *)mem_alloc(2 * READ_SIZE);
@@ -192,86 +695,50 @@ int main()
     memset(cigar->operations, 'M', 2 * READ_SIZE);
 #endif
 
-    for (int read_nb = 0; read_nb < nb_reads_per_tasklets; ++read_nb)
+    // The tasklets claim the reads one at a time, so a divergent pair only delays the tasklet aligning it
+    uint64_t tasklet_nb_reads = 0;
+    uint32_t read_idx;
+    while ((read_idx = claim_read()) < nb_reads_per_dpu)
     {
-        if (read_nb + tasklet_id * nb_reads_per_tasklets < nb_reads_per_dpu)
-        {
-
-            mram_read((__mram_ptr void const *)(dpuRequests_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (sizeof(request_t))), request_w, ROUND_UP_MULTIPLE_8(sizeof(request_t)));
-
-            // DMA transfers must be less than 2048
-            if (ROUND_UP_MULTIPLE_8(request_w->pattern_len) <= 2048)
-            {
-                mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE)), pattern, ROUND_UP_MULTIPLE_8(request_w->pattern_len));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(request_w->pattern_len); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(request_w->pattern_len))
-                    {
-                        mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(pattern[segment_size]), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(request_w->pattern_len) - segment_size;
-                        mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(pattern[segment_size]), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
+#ifdef PROFILE
+        perfcounter_t pair_start = perfcounter_get();
+#endif
+        mram_read((__mram_ptr void const *)(dpuRequests_m + read_idx * (sizeof(request_t))), request_w, ROUND_UP_MULTIPLE_8(sizeof(request_t)));
 
-            if (ROUND_UP_MULTIPLE_8(request_w->text_len) <= 2048)
-            {
-                mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE)), text, ROUND_UP_MULTIPLE_8(request_w->text_len));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(request_w->text_len); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(request_w->text_len))
-                    {
-                        mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(text[segment_size]), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(request_w->text_len) - segment_size;
-                        mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(text[segment_size]), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
-            edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len);
+        // The packed text follows the packed pattern
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset, pattern, request_w->pattern_len);
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset + PACKED_SIZE(request_w->pattern_len), text, request_w->text_len);
+        edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len);
 
-            nw_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, dp_table);
+#ifdef BANDED
+        nw_banded_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, dp_table);
+#elif defined(EARLY_TERMINATION)
+        nw_threshold_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, dp_table);
+#elif defined(PACKED_TRACEBACK)
+        nw_packed_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, dp_table, tb);
+#else
+        nw_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, dp_table);
+#endif
 
-            result_w->idx = request_w->idx;
+        result_w->idx = request_w->idx;
 #ifdef BACKTRACE
-            if (ROUND_UP_MULTIPLE_8(cigar->max_operations) <= 2048)
-            {
-                mram_write((cigar->operations), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE)), ROUND_UP_MULTIPLE_8(cigar->max_operations));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(cigar->max_operations); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(cigar->max_operations))
-                    {
-                        mram_write(&(cigar->operations[segment_size]), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE) + segment_size), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(cigar->max_operations) - segment_size;
-                        mram_write(&(cigar->operations[segment_size]), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE) + segment_size), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
+        store_cigar(cigar, dpuOperations_m, result_w);
 #endif
-            result_w->score = cigar->score;
-            result_w->max_operations = cigar->max_operations;
-            result_w->begin_offset = cigar->begin_offset;
-            result_w->end_offset = cigar->end_offset;
+        result_w->score = cigar->score;
+        result_w->pattern_begin = cigar->pattern_begin;
+        result_w->pattern_end = cigar->pattern_end;
+        result_w->text_begin = cigar->text_begin;
+        result_w->text_end = cigar->text_end;
 
-            mram_write(result_w, (__mram_ptr void *)(dpuResults_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (sizeof(result_t))), sizeof(result_t));
-        }
+#ifdef PROFILE
+        result_w->cycles = perfcounter_get() - pair_start;
+#endif
+        mram_write(result_w, (__mram_ptr void *)(dpuResults_m + read_idx * (sizeof(result_t))), sizeof(result_t));
+        ++tasklet_nb_reads;
     }
+    // Number of reads aligned by the tasklet and cycles until it finished
+    tasklet_stats[tasklet_id].nb_reads = tasklet_nb_reads;
+    tasklet_stats[tasklet_id].cycles = perfcounter_get();
+    mram_write(&tasklet_stats[tasklet_id], (__mram_ptr void *)(dpuBuffer_m + params_w.dpuTaskletStats_m + tasklet_id * sizeof(tasklet_stats_t)), sizeof(tasklet_stats_t));
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+#ifndef _PARSER_H_
+#define _PARSER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "common.h"
+
+// Number of host threads used to parse the input, 0 uses all the online cores
+#ifndef NR_HOST_THREADS
+#define NR_HOST_THREADS 0
+#endif
+
+// Place the pairs of a batch on the DPUs so that their estimated costs are balanced, 0 places them in order
+#ifndef COST_PLACEMENT
+#define COST_PLACEMENT 1
+#endif
+
+// Size of the q-grams used to estimate the edits of a read pair
+#define COST_QGRAM_SIZE 8
+
+// Size of the reason an input couldn't be opened
+#define INPUT_ERROR_SIZE 256
+
+// DPU and request slot where a read pair of a batch is placed
+typedef struct pair_slot_t
+{
+    uint32_t dpu;
+    uint32_t slot;
+} pair_slot_t;
+
+// Bases of the sequences of a read pair in the input, the bases of a sequence are contiguous
+typedef struct pair_index_t
+{
+    uint64_t pattern_offset; /* Offset of the pattern in the patterns of the input */
+    uint64_t text_offset;    /* Offset of the text in the texts of the input */
+    uint32_t pattern_length;
+    uint32_t text_length;
+} pair_index_t;
+
+// A file of the input, mapped or decompressed in memory
+typedef struct input_file_t
+{
+    char *data;
+    size_t size;
+    bool mapped;     /* Whether data is a mapping of the file, it is allocated otherwise */
+    bool moved;      /* Whether the bases were moved from their place in the file, by the decompression or by unwrapping FASTA lines */
+    uint64_t file_size;  /* Size and modification time of the file, an index is only used with the file it was built from */
+    int64_t file_mtime;
+} input_file_t;
+
+// Index of an input saved by -x: the header, the index of each pair, and the bases of the patterns and of the texts when the bases
+// of the files were moved, the offsets of the pairs are then in these bases
+#define INDEX_MAGIC "AIMIDX01"
+#define INDEX_SEQUENCES 1
+
+typedef struct index_header_t
+{
+    char magic[8];
+    uint32_t flags;
+    uint32_t nb_files;
+    uint64_t nb_pairs;
+    uint64_t nb_bases;
+    uint64_t input_size;        /* Bytes of the input files, decompressed */
+    uint64_t file_size[2];
+    int64_t file_mtime[2];
+    uint64_t sequences_size[2]; /* Bytes of the bases of the patterns and of the texts stored after the pairs */
+} index_header_t;
+
+// Input read pairs, in one file of pairs (a pattern line '>' followed by a text line '<'), in one FASTA or FASTQ file of interleaved
+// patterns and texts, or in a FASTA or FASTQ file of patterns and one of texts. The files may be gzip or bgzip compressed
+typedef struct input_t
+{
+    const char *patterns;   /* Bases the offsets of the patterns refer to */
+    const char *texts;      /* Bases the offsets of the texts refer to */
+    pair_index_t *pairs;    /* Index of each read pair */
+    uint64_t nb_pairs;      /* Number of read pairs in the input */
+    uint64_t next_pair;     /* Next read pair to be read */
+    uint64_t nb_bases;      /* Number of bases of the sequences of the input */
+    uint64_t size;          /* Bytes of the input files, decompressed */
+    uint32_t nb_threads;    /* Number of parsing threads */
+    uint32_t read_size;     /* Length of the longest read accepted */
+    uint32_t nb_files;
+    input_file_t files[2];
+    uint8_t *index_map;     /* Mapped index of the pairs, when it was loaded from a file */
+    size_t index_size;
+    char error[INPUT_ERROR_SIZE]; /* Reason the input couldn't be opened */
+} input_t;
+
+// Opens the input, texts_path is the file of the texts of the pairs or NULL. The files are mapped, or decompressed in parallel, and the
+// pairs are indexed in parallel. With an index_path, the index is loaded from it if it exists, it is written to it otherwise. Returns
+// false, with the reason in input->error and the input closed, when a file can't be read or written or a read is longer than read_size
+bool open_input(input_t *input, const char *path, const char *texts_path, const char *index_path, uint32_t read_size);
+
+// Opens an input of read pairs already in memory, the offsets of the pairs refer to patterns and texts. The input takes the pairs, they
+// are freed when it is closed, the bases must be kept until then
+void open_memory_input(input_t *input, const char *patterns, const char *texts, pair_index_t *pairs, uint64_t nb_pairs, uint32_t read_size);
+
+// Fills the buffers of each DPU with its packed read pairs in parallel, at most dpu_nb_reads[dpu] pairs and sequences_capacity bytes of
+// sequences are read for each DPU. dpu_nb_reads[dpu], dpu_sequences_size[dpu] and dpu_cost[dpu] are set to what was placed on the DPU,
+// and batch_order[k] to where the k-th pair of the batch was placed
+void get_input_batch(input_t *input, request_t **dpu_requests, char **dpu_sequences, uint32_t *dpu_nb_reads, uint32_t *dpu_sequences_size,
+                     uint64_t *dpu_cost, pair_slot_t *batch_order, uint32_t sequences_capacity, uint32_t nr_of_dpus);
+
+// Number of bytes of the input read so far
+uint64_t input_bytes_read(input_t *input);
+
+void close_input(input_t *input);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef DPU_PARAMS_H_
+#define DPU_PARAMS_H_
+
+#include "common.h"
+
+// Parameters of the current launch, copied from the MRAM by tasklet 0 before the tasklets start aligning
+extern DPUParams dpu_params;
+
+// The alignment parameters are read at launch so that a binary serves every dataset, the -D values only set the defaults of the host
+#undef READ_SIZE
+#define READ_SIZE ((int)dpu_params.readSize)
+#undef MAX_SCORE
+#define MAX_SCORE ((int)dpu_params.maxScore)
+#undef WRAM_SEGMENT
+#define WRAM_SEGMENT (dpu_params.wramSegment)
+
+#undef MATCH
+#define MATCH (dpu_params.penalties.match)
+#undef MISMATCH
+#define MISMATCH (dpu_params.penalties.mismatch)
+#undef GAP_O
+#define GAP_O (dpu_params.penalties.gap_o)
+#undef GAP_E
+#define GAP_E (dpu_params.penalties.gap_e)
+
+// Span of the alignments, selected at run time
+#define SPAN (dpu_params.span)
+
+#endif
@@ -51,6 +51,47 @@ SOFTWARE. */
 #include "../common/common.h"
 #include "dpu_allocator_wram.h"
 #include "dpu_allocator_mram.h"
+#include <barrier.h>
+#include <mutex.h>
+#include <perfcounter.h>
+#include "dpu_profile.h"
+#include "dpu_params.h"
+
+// Cells of an 8-byte aligned MRAM word, the tiles start on a word
+#define WORD_CELLS ((int)(8 / sizeof(dp_cell_t)) > 0 ? (int)(8 / sizeof(dp_cell_t)) : 1)
+
+// Index of the row h in the MRAM, the backtrace keeps every row of the DP-table and the score, or the packed traceback, only the last two
+#if defined(BACKTRACE) && !defined(PACKED_TRACEBACK)
+#define KEEP_ROWS
+#define DP_ROW(h) (h)
+#else
+#define DP_ROW(h) ((h)&1)
+#endif
+
+#ifdef PACKED_TRACEBACK
+// Directions of the packed traceback, the choice the traceback of the scores makes at a cell of the M layer and whether the gaps of
+// the D and I layers open at the cell
+#define TB_M 0
+#define TB_X 1
+#define TB_D 2
+#define TB_I 3
+#define TB_D_OPEN 4
+#define TB_I_OPEN 8
+_Static_assert(TB_TILE_SIZE % 8 == 0, "the tiles must hold a multiple of 64 bits of directions");
+#endif
+
+// Transfers a row, or a tile of a row, between the WRAM and the MRAM, DMA transfers must be less than 2048
+void dp_row_read(uint32_t row_m, dp_cell_t *row, int size)
+{
+    for (int segment = 0; segment < size; segment += 2048)
+        mram_read((__mram_ptr void const *)(row_m + segment), (char *)row + segment, MIN(2048, size - segment));
+}
+
+void dp_row_write(dp_cell_t *row, uint32_t row_m, int size)
+{
+    for (int segment = 0; segment < size; segment += 2048)
+        mram_write((char *)row + segment, (__mram_ptr void *)(row_m + segment), MIN(2048, size - segment));
+}
 
 void edit_cigar_allocate(
     edit_cigar_t *edit_cigar,
@@ -61,35 +102,78 @@ void edit_cigar_allocate(
     edit_cigar->begin_offset = edit_cigar->max_operations - 1;
     edit_cigar->end_offset = edit_cigar->max_operations;
     edit_cigar->score = INT32_MIN;
+    edit_cigar->pattern_begin = 0;
+    edit_cigar->pattern_end = pattern_length;
+    edit_cigar->text_begin = 0;
+    edit_cigar->text_end = text_length;
 }
 
-void swg_traceback(int num_cols, int num_rows, edit_cigar_t *cigar, dpu_alloc_mram_t *dpu_alloc_mram, dp_cell_t *cell_cache, dp_cell_t *upper_cell_cache, dp_cell_t *diag_cell_cache, dp_cell_t *left_cell_cache)
+// Bases of the pattern and of the text the span of the alignment leaves out for free at their begin and at their end
+typedef struct span_free_t
 {
+    int pattern_begin;
+    int pattern_end;
+    int text_begin;
+    int text_end;
+} span_free_t;
 
-    uint32_t matrix_offset = (uint32_t)DPU_MRAM_HEAP_POINTER + dpu_alloc_mram->CUR_PTR_MRAM;
+span_free_t span_free(int pattern_length, int text_length)
+{
+    if (SPAN.mode == SPAN_LOCAL)
+        return (span_free_t){pattern_length, pattern_length, text_length, text_length};
+    if (SPAN.mode == SPAN_ENDS_FREE)
+        return (span_free_t){MIN(SPAN.pattern_begin_free, pattern_length), MIN(SPAN.pattern_end_free, pattern_length),
+                             MIN(SPAN.text_begin_free, text_length), MIN(SPAN.text_end_free, text_length)};
+    return (span_free_t){0, 0, 0, 0};
+}
+
+// Scores of the gap of the cell (h, 0) or (0, v) of the first column or row, the bases left out for free at the begin cost nothing
+#define BEGIN_GAP(bases, free_bases) (((bases) <= (free_bases)) ? MAX_SCORE : GAP_O + ((bases) - (free_bases)) * GAP_E)
+#define BEGIN_M(bases, free_bases) (((bases) <= (free_bases)) ? 0 : GAP_O + ((bases) - (free_bases)) * GAP_E)
+
+// Begin of the alignment when the traceback isn't computed, it is unknown when the begin of a sequence is free
+void span_unknown_begin(edit_cigar_t *cigar, span_free_t free)
+{
+    if (free.pattern_begin > 0)
+        cigar->pattern_begin = -1;
+    if (free.text_begin > 0)
+        cigar->text_begin = -1;
+}
 
+// The rows h and h - 1 are read back from the MRAM one tile at a time, the tiles hold the columns v - 1 and v. The traceback starts from
+// the end cell (h, v) and stops at the first row or column once the bases left out for free are reached, or at a cell of score 0 of a
+// local alignment
+void swg_traceback(int pattern_length, int h, int v, span_free_t free, edit_cigar_t *cigar, uint32_t matrix_offset, int row_size, dp_cell_t *tile,
+                   dp_cell_t *upper_tile)
+{
     char *const operations = cigar->operations;
     int op_sentinel = cigar->end_offset - 1;
-    int h, v;
-    // Compute traceback
-    h = num_cols - 1;
-    v = num_rows - 1;
+    int num_cells = pattern_length + 1;
+    bool local = SPAN.mode == SPAN_LOCAL;
     swg_layer_type swg_layer = swg_M_layer;
+    // First column of the loaded tiles, -1 when they have to be read
+    int c0 = -1;
 
     while (h > 0 && v > 0)
     {
-        // Load needed cells from MAM
-        mram_read((__mram_ptr void const *)(matrix_offset + (num_cols * h + v) * sizeof(dp_cell_t)), cell_cache, ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-        mram_read((__mram_ptr void const *)(matrix_offset + (num_cols * h + v - 1) * sizeof(dp_cell_t)), upper_cell_cache, ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-        mram_read((__mram_ptr void const *)(matrix_offset + (num_cols * (h - 1) + v - 1) * sizeof(dp_cell_t)), diag_cell_cache, ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-        mram_read((__mram_ptr void const *)(matrix_offset + (num_cols * (h - 1) + v) * sizeof(dp_cell_t)), left_cell_cache, ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-
+        if (c0 < 0 || v - 1 < c0)
+        {
+            // The tiles end on the column v
+            c0 = (MAX(0, v + 1 - TILE_CELLS) + WORD_CELLS - 1) / WORD_CELLS * WORD_CELLS;
+            int size = ROUND_UP_MULTIPLE_8(MIN(TILE_CELLS, num_cells - c0) * sizeof(dp_cell_t));
+            dp_row_read(matrix_offset + h * row_size + c0 * sizeof(dp_cell_t), tile, size);
+            dp_row_read(matrix_offset + (h - 1) * row_size + c0 * sizeof(dp_cell_t), upper_tile, size);
+        }
+        dp_cell_t *cell = &tile[v - c0];
+        if (local && swg_layer == swg_M_layer && cell->M == 0)
+            break;
+        int up = 0;
         switch (swg_layer)
         {
         case swg_D_layer:
             // Traceback D-matrix
             operations[op_sentinel--] = 'D';
-            if (cell_cache->D == upper_cell_cache->M + GAP_O + GAP_E)
+            if (cell->D == tile[v - 1 - c0].M + GAP_O + GAP_E)
             {
                 swg_layer = swg_M_layer;
             }
@@ -98,33 +182,33 @@ void swg_traceback(int num_cols, int num_rows, edit_cigar_t *cigar, dpu_alloc_mr
         case swg_I_layer:
             // Traceback I-matrix
             operations[op_sentinel--] = 'I';
-            if (cell_cache->I == left_cell_cache->M + GAP_O + GAP_E)
+            if (cell->I == upper_tile[v - c0].M + GAP_O + GAP_E)
             {
                 swg_layer = swg_M_layer;
             }
-            --h;
+            up = 1;
             break;
         case swg_M_layer:
             // Traceback M-matrix
-            if (cell_cache->M == cell_cache->D)
+            if (cell->M == cell->D)
             {
                 swg_layer = swg_D_layer;
             }
-            else if (cell_cache->M == cell_cache->I)
+            else if (cell->M == cell->I)
             {
                 swg_layer = swg_I_layer;
             }
-            else if (cell_cache->M == diag_cell_cache->M + MATCH)
+            else if (cell->M == upper_tile[v - 1 - c0].M + MATCH)
             {
                 operations[op_sentinel--] = 'M';
-                --h;
                 --v;
+                up = 1;
             }
-            else if (cell_cache->M == diag_cell_cache->M + MISMATCH)
+            else if (cell->M == upper_tile[v - 1 - c0].M + MISMATCH)
             {
                 operations[op_sentinel--] = 'X';
-                --h;
                 --v;
+                up = 1;
             }
             else
             {
@@ -134,93 +218,911 @@ void swg_traceback(int num_cols, int num_rows, edit_cigar_t *cigar, dpu_alloc_mr
             }
             break;
         }
+        if (up)
+        {
+            // Move up a row
+            --h;
+            dp_cell_t *tmp = tile;
+            tile = upper_tile;
+            upper_tile = tmp;
+            if (h > 0 && v - 1 >= c0)
+                dp_row_read(matrix_offset + (h - 1) * row_size + c0 * sizeof(dp_cell_t), upper_tile,
+                            ROUND_UP_MULTIPLE_8(MIN(TILE_CELLS, num_cells - c0) * sizeof(dp_cell_t)));
+            else
+                c0 = -1;
+        }
     }
-    while (h > 0)
+    while (v == 0 && h > free.text_begin)
     {
         operations[op_sentinel--] = 'I';
         --h;
     }
-    while (v > 0)
+    while (h == 0 && v > free.pattern_begin)
     {
         operations[op_sentinel--] = 'D';
         --v;
     }
     cigar->begin_offset = op_sentinel + 1;
+    cigar->pattern_begin = v;
+    cigar->text_begin = h;
 }
 
-void swg_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, dpu_alloc_mram_t *dpu_alloc_mram, dp_cell_t *cell_cache, dp_cell_t *upper_cell_cache, dp_cell_t *diag_cell_cache, dp_cell_t *left_cell_cache)
+#ifdef PACKED_TRACEBACK
+// Follows the directions of the cells, the row h of the directions is at tb_offset + (h - 1) * TB_ROW_SIZE and only the 8-byte word
+// holding the direction of the current cell is read
+void swg_packed_traceback(int pattern_length, int h, int v, span_free_t free, edit_cigar_t *cigar, uint32_t tb_offset, uint8_t *tb_word)
 {
-    int h, v;
-    int num_rows = pattern_length + 1;
-    int num_cols = text_length + 1;
+    char *const operations = cigar->operations;
+    int op_sentinel = cigar->end_offset - 1;
+    swg_layer_type swg_layer = swg_M_layer;
+    uint32_t word_m = 0;
+
+    while (h > 0 && v > 0)
+    {
+        uint32_t byte_m = tb_offset + (h - 1) * TB_ROW_SIZE(pattern_length) + v * TB_BITS / 8;
+        if ((byte_m & ~7) != word_m)
+        {
+            word_m = byte_m & ~7;
+            mram_read((__mram_ptr void const *)word_m, tb_word, 8);
+        }
+        int tb = (tb_word[byte_m & 7] >> ((v * TB_BITS) & 7)) & 15;
+        switch (swg_layer)
+        {
+        case swg_D_layer:
+            operations[op_sentinel--] = 'D';
+            if (tb & TB_D_OPEN)
+                swg_layer = swg_M_layer;
+            --v;
+            break;
+        case swg_I_layer:
+            operations[op_sentinel--] = 'I';
+            if (tb & TB_I_OPEN)
+                swg_layer = swg_M_layer;
+            --h;
+            break;
+        case swg_M_layer:
+            switch (tb & 3)
+            {
+            case TB_D:
+                swg_layer = swg_D_layer;
+                break;
+            case TB_I:
+                swg_layer = swg_I_layer;
+                break;
+            default:
+                operations[op_sentinel--] = ((tb & 3) == TB_X) ? 'X' : 'M';
+                --h;
+                --v;
+                break;
+            }
+            break;
+        }
+    }
+    while (v == 0 && h > free.text_begin)
+    {
+        operations[op_sentinel--] = 'I';
+        --h;
+    }
+    while (h == 0 && v > free.pattern_begin)
+    {
+        operations[op_sentinel--] = 'D';
+        --v;
+    }
+    cigar->begin_offset = op_sentinel + 1;
+    cigar->pattern_begin = v;
+    cigar->text_begin = h;
+}
+#endif
+
+// The rows of the DP-table are computed one tile at a time in the WRAM, from the tile of the upper row. A row is written to the MRAM
+// with one DMA transfer per tile, and a row fitting in a tile is only written for the backtrace
+// With PACKED_TRACEBACK, the directions of each cell are written instead of the rows for the backtrace
+void swg_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, dpu_alloc_mram_t *dpu_alloc_mram, dp_cell_t *tile, dp_cell_t *upper_tile, uint8_t *tb_tile)
+{
+    int num_cells = pattern_length + 1;
+    int row_size = ROUND_UP_MULTIPLE_8(num_cells * sizeof(dp_cell_t));
+    bool single_tile = num_cells <= TILE_CELLS;
+    span_free_t free = span_free(pattern_length, text_length);
+    bool local = SPAN.mode == SPAN_LOCAL;
 
     uint32_t matrix_offset = (uint32_t)DPU_MRAM_HEAP_POINTER + dpu_alloc_mram->CUR_PTR_MRAM;
+#ifdef KEEP_ROWS
+    PROFILE_MRAM_USED((text_length + 1) * row_size);
+#elif defined(BACKTRACE)
+    // The directions follow the two rows of scores
+    uint32_t tb_offset = matrix_offset + 2 * row_size;
+    PROFILE_MRAM_USED(2 * row_size + text_length * TB_ROW_SIZE(pattern_length));
+#else
+    PROFILE_MRAM_USED(single_tile ? 0 : 2 * row_size);
+#endif
 
-    // Initialize DP
-    cell_cache->D = MAX_SCORE;
-    cell_cache->I = MAX_SCORE;
-    cell_cache->M = 0;
+    // Compute DP, the bases are read from the packed sequences
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    dp_cell_t cell = {0, MAX_SCORE, MAX_SCORE};
+    // Lowest cells of the last column and of the last row before the corner, where an alignment leaving out the end of the text or of
+    // the pattern for free can end, and lowest cell of a local alignment
+    int column_best = INT32_MAX, column_h = text_length;
+    int row_best = INT32_MAX, row_v = pattern_length;
+    int local_best = 0, local_h = text_length, local_v = pattern_length;
+    for (int h = 0; h <= text_length; ++h)
+    {
+        int text_base = (h > 0) ? PACKED_BASE(text, text_mask, h - 1) : 0;
+        uint32_t row_m = matrix_offset + DP_ROW(h) * row_size;
+        uint32_t upper_row_m = matrix_offset + DP_ROW(h - 1) * row_size;
+        // Left cell and upper left M of the next cell, they come from the previous tile at its beginning
+        dp_cell_t left = cell;
+        cell_size_t diag_M = 0;
+        for (int c0 = 0; c0 < num_cells; c0 += TILE_CELLS)
+        {
+            int n = MIN(TILE_CELLS, num_cells - c0);
+            int size = ROUND_UP_MULTIPLE_8(n * sizeof(dp_cell_t));
+            if (h > 0 && !single_tile)
+                dp_row_read(upper_row_m + c0 * sizeof(dp_cell_t), upper_tile, size);
+            for (int i = 0; i < n; ++i)
+            {
+                int v = c0 + i;
+#if defined(BACKTRACE) && defined(PACKED_TRACEBACK)
+                int tb = TB_M;
+#endif
+                if (h == 0)
+                {
+                    // Init first row
+                    cell.D = BEGIN_GAP(v, free.pattern_begin);
+                    cell.I = MAX_SCORE;
+                    cell.M = BEGIN_M(v, free.pattern_begin);
+                }
+                else if (v == 0)
+                {
+                    // Init first column
+                    cell.D = MAX_SCORE;
+                    cell.I = BEGIN_GAP(h, free.text_begin);
+                    cell.M = BEGIN_M(h, free.text_begin);
+                }
+                else
+                {
+                    // Update DP.D
+                    cell_size_t del_new = left.M + GAP_O + GAP_E;
+                    cell_size_t del_ext = left.D + GAP_E;
+                    cell_size_t del = MIN(del_new, del_ext);
+                    cell.D = del;
+                    // Update DP.I
+                    cell_size_t ins_new = upper_tile[i].M + GAP_O + GAP_E;
+                    cell_size_t ins_ext = upper_tile[i].I + GAP_E;
+                    cell_size_t ins = MIN(ins_new, ins_ext);
+                    cell.I = ins;
+                    // Update DP.M
+                    cell_size_t m_match = diag_M + ((PACKED_BASE(pattern, pattern_mask, v - 1) == text_base) ? MATCH : MISMATCH);
+                    cell.M = MIN(m_match, MIN(ins, del));
+                    if (local)
+                    {
+                        // A local alignment can start at any cell
+                        cell.M = MIN(cell.M, 0);
+                        if (cell.M < local_best)
+                        {
+                            local_best = cell.M;
+                            local_h = h;
+                            local_v = v;
+                        }
+                    }
+#if defined(BACKTRACE) && defined(PACKED_TRACEBACK)
+                    // Same choices as the traceback of the scores
+                    tb = (cell.M == cell.D) ? TB_D : (cell.M == cell.I) ? TB_I : (cell.M == diag_M + MATCH) ? TB_M : TB_X;
+                    if (cell.D == left.M + GAP_O + GAP_E)
+                        tb |= TB_D_OPEN;
+                    if (cell.I == upper_tile[i].M + GAP_O + GAP_E)
+                        tb |= TB_I_OPEN;
+#endif
+                }
+#if defined(BACKTRACE) && defined(PACKED_TRACEBACK)
+                if (((i * TB_BITS) & 7) == 0)
+                    tb_tile[i * TB_BITS / 8] = 0;
+                tb_tile[i * TB_BITS / 8] |= tb << ((i * TB_BITS) & 7);
+#endif
+                if (h == text_length && v < pattern_length && v >= pattern_length - free.pattern_end && cell.M <= row_best)
+                {
+                    row_best = cell.M;
+                    row_v = v;
+                }
+                if (h > 0)
+                    diag_M = upper_tile[i].M;
+                left = cell;
+                tile[i] = cell;
+            }
+#ifdef KEEP_ROWS
+            dp_row_write(tile, row_m + c0 * sizeof(dp_cell_t), size);
+#else
+            if (!single_tile)
+                dp_row_write(tile, row_m + c0 * sizeof(dp_cell_t), size);
+#endif
+#if defined(BACKTRACE) && defined(PACKED_TRACEBACK)
+            if (h > 0)
+                mram_write(tb_tile, (__mram_ptr void *)(tb_offset + (h - 1) * TB_ROW_SIZE(pattern_length) + c0 * TB_BITS / 8),
+                           ROUND_UP_MULTIPLE_8((n * TB_BITS + 7) / 8));
+#endif
+        }
+        if (h < text_length && h >= text_length - free.text_end && cell.M < column_best)
+        {
+            column_best = cell.M;
+            column_h = h;
+        }
+        // A single tile row is the upper row of the next one
+        dp_cell_t *tmp = tile;
+        tile = upper_tile;
+        upper_tile = tmp;
+    }
+    // The last cell computed is the bottom right cell, an ends-free alignment ends in the last row or column once the bases left out for
+    // free are reached and the corner wins the ties
+    int end_h = text_length, end_v = pattern_length;
+    int best = cell.M;
+    if (local)
+    {
+        best = local_best;
+        end_h = local_h;
+        end_v = local_v;
+    }
+    if (column_best < best)
+    {
+        best = column_best;
+        end_h = column_h;
+    }
+    if (row_best < best)
+    {
+        best = row_best;
+        end_h = text_length;
+        end_v = row_v;
+    }
+    cigar->score = best;
+    cigar->pattern_end = end_v;
+    cigar->text_end = end_h;
+#ifdef KEEP_ROWS
+    // Compute traceback
+    swg_traceback(pattern_length, end_h, end_v, free, cigar, matrix_offset, row_size, tile, upper_tile);
+#elif defined(BACKTRACE)
+    swg_packed_traceback(pattern_length, end_h, end_v, free, cigar, tb_offset, tb_tile);
+#else
+    span_unknown_begin(cigar, free);
+#endif
+}
+
+#ifdef EARLY_TERMINATION
+// Score-only DP-table that stops at MAX_SCORE. As the scores never decrease along an alignment, the cells of a row left of the first
+// cell within MAX_SCORE of the upper row, or right of the last one and of a cell above MAX_SCORE, are above MAX_SCORE too. A row is only
+// computed from the tile of its first column lo to the cell ending it, the layers of the cells out of [lo, hi] of the upper row saturate
+// at MAX_SCORE + 1, and the pair is rejected with a score of MAX_SCORE + 1 once a row has no cell within MAX_SCORE
+void swg_threshold_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, dpu_alloc_mram_t *dpu_alloc_mram, dp_cell_t *tile, dp_cell_t *upper_tile)
+{
+    int num_cells = pattern_length + 1;
+    int row_size = ROUND_UP_MULTIPLE_8(num_cells * sizeof(dp_cell_t));
+    bool single_tile = num_cells <= TILE_CELLS;
+    uint32_t matrix_offset = (uint32_t)DPU_MRAM_HEAP_POINTER + dpu_alloc_mram->CUR_PTR_MRAM;
+    PROFILE_MRAM_USED(single_tile ? 0 : 2 * row_size);
+
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    const int limit = MAX_SCORE + 1;
+    const dp_cell_t out = {limit, limit, limit, 0};
+    // First and last columns of the upper row within MAX_SCORE, the first row has no upper row
+    int lo = 0;
+    int hi = -1;
+    // Last cell of the row, when the row reaches it
+    int score = limit;
+    for (int h = 0; h <= text_length; ++h)
+    {
+        int text_base = (h > 0) ? PACKED_BASE(text, text_mask, h - 1) : 0;
+        uint32_t row_m = matrix_offset + (h & 1) * row_size;
+        uint32_t upper_row_m = matrix_offset + ((h - 1) & 1) * row_size;
+        int row_lo = -1;
+        int row_hi = -1;
+        bool row_end = false;
+        score = limit;
+        dp_cell_t left = out;
+        int diag_M = limit;
+        for (int c0 = lo / TILE_CELLS * TILE_CELLS; c0 < num_cells && !row_end; c0 += TILE_CELLS)
+        {
+            int n = MIN(TILE_CELLS, num_cells - c0);
+            int size = ROUND_UP_MULTIPLE_8(n * sizeof(dp_cell_t));
+            if (h > 0 && !single_tile)
+                dp_row_read(upper_row_m + c0 * sizeof(dp_cell_t), upper_tile, size);
+            for (int i = 0; i < n; ++i)
+            {
+                int v = c0 + i;
+                dp_cell_t cell = out;
+                if (v >= lo && !row_end)
+                {
+                    dp_cell_t up = (v <= hi) ? upper_tile[i] : out;
+                    if (h == 0)
+                    {
+                        cell.D = (v == 0) ? limit : MIN(GAP_O + v * GAP_E, limit);
+                        cell.M = (v == 0) ? 0 : cell.D;
+                    }
+                    else
+                    {
+                        cell.I = MIN(MIN(up.M + GAP_O + GAP_E, up.I + GAP_E), limit);
+                        if (v > 0)
+                            cell.D = MIN(MIN(left.M + GAP_O + GAP_E, left.D + GAP_E), limit);
+                        int m_match = (v > 0) ? diag_M + ((PACKED_BASE(pattern, pattern_mask, v - 1) == text_base) ? MATCH : MISMATCH) : limit;
+                        cell.M = MIN(MIN(m_match, MIN(cell.I, cell.D)), limit);
+                    }
+                    if (v == pattern_length)
+                        score = cell.M;
+                    if (cell.M <= MAX_SCORE)
+                    {
+                        if (row_lo < 0)
+                            row_lo = v;
+                        row_hi = v;
+                    }
+                    else if (v > hi)
+                        // The next cells of the row only come from this one
+                        row_end = true;
+                    diag_M = up.M;
+                }
+                left = cell;
+                tile[i] = cell;
+            }
+            if (!single_tile)
+                dp_row_write(tile, row_m + c0 * sizeof(dp_cell_t), size);
+        }
+        if (row_lo < 0)
+        {
+            cigar->score = limit;
+            return;
+        }
+        lo = row_lo;
+        hi = row_hi;
+        dp_cell_t *tmp = tile;
+        tile = upper_tile;
+        upper_tile = tmp;
+    }
+    cigar->score = score;
+}
+#endif
+
+#ifdef HIRSCHBERG
+// Score of the layers no alignment reaches
+#define HB_INF (INT32_MAX / 4)
 
-    mram_write(cell_cache, (__mram_ptr void *)(matrix_offset), ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
+void hb_window_init(hb_window_t *window, uint32_t sequence_m, int length)
+{
+    window->sequence_m = sequence_m;
+    window->length = length;
+    window->first = -HB_WINDOW_BASES;
+}
+
+// Base i of a sequence, the window is moved forward or backward to the 64 bases holding it when i is out of it
+static inline int hb_base(hb_window_t *window, int i)
+{
+    if (i < window->first || i >= window->first + HB_WINDOW_BASES)
+    {
+        window->first = (i > window->first) ? (i & ~63) : MAX(0, (i & ~63) + 64 - HB_WINDOW_BASES);
+        int bases_size = MIN(HB_WINDOW_BASES / 4, PACKED_BASES_SIZE(window->length) - window->first / 4);
+        int mask_size = MIN(HB_WINDOW_BASES / 8, PACKED_MASK_SIZE(window->length) - window->first / 8);
+        mram_read((__mram_ptr void const *)(window->sequence_m + window->first / 4), window->bases, bases_size);
+        mram_read((__mram_ptr void const *)(window->sequence_m + PACKED_BASES_SIZE(window->length) + window->first / 8), window->mask, mask_size);
+    }
+    return PACKED_BASE(window->bases, window->mask, i - window->first);
+}
 
-    for (v = 1; v <= pattern_length; ++v)
+// The operations are appended in order as runs (see CIGAR_RUN), cigar->end_offset counts the runs. The last run stays in the WRAM to
+// be extended, so a full buffer is written to the MRAM when the next run starts
+void hb_push_ops(edit_cigar_t *cigar, uint32_t operations_m, char op, int count)
+{
+    uint8_t *runs = (uint8_t *)cigar->operations;
+    if (count > 0 && cigar->end_offset > 0)
     {
-        // Init first column
-        mram_read((__mram_ptr void const *)(matrix_offset + v * sizeof(dp_cell_t)), cell_cache, ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-        cell_cache->D = GAP_O + v * GAP_E;
-        cell_cache->I = MAX_SCORE;
-        cell_cache->M = cell_cache->D;
-        mram_write(cell_cache, (__mram_ptr void *)(matrix_offset + v * sizeof(dp_cell_t)), ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
+        uint8_t *last = &runs[(cigar->end_offset - 1) % HB_OPS_SIZE];
+        if (CIGAR_RUN_OP(*last) == op)
+        {
+            int length = MIN(count, CIGAR_RUN_MAX - CIGAR_RUN_LENGTH(*last));
+            *last = CIGAR_RUN(op, CIGAR_RUN_LENGTH(*last) + length);
+            count -= length;
+        }
     }
-    for (h = 1; h <= text_length; ++h)
+    while (count > 0)
     {
-        // Init first row
-        mram_read((__mram_ptr void const *)(matrix_offset + num_cols * h * sizeof(dp_cell_t)), cell_cache, ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-        cell_cache->D = MAX_SCORE;
-        cell_cache->I = GAP_O + h * GAP_E;
-        cell_cache->M = cell_cache->I;
-        mram_write(cell_cache, (__mram_ptr void *)(matrix_offset + num_cols * h * sizeof(dp_cell_t)), ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
+        if (cigar->end_offset > 0 && cigar->end_offset % HB_OPS_SIZE == 0)
+            mram_write(runs, (__mram_ptr void *)(operations_m + cigar->end_offset - HB_OPS_SIZE), HB_OPS_SIZE);
+        int length = MIN(count, CIGAR_RUN_MAX);
+        runs[cigar->end_offset++ % HB_OPS_SIZE] = CIGAR_RUN(op, length);
+        count -= length;
     }
+}
+
+void hb_flush_ops(edit_cigar_t *cigar, uint32_t operations_m)
+{
+    int rest = cigar->end_offset % HB_OPS_SIZE;
+    if (rest == 0 && cigar->end_offset > 0)
+        rest = HB_OPS_SIZE;
+    if (rest > 0)
+        mram_write(cigar->operations, (__mram_ptr void *)(operations_m + cigar->end_offset - rest), ROUND_UP_MULTIPLE_8(rest));
+}
+
+// Cost of a gap of length bases, nothing without bases
+static inline int hb_gap(int length)
+{
+    return (length > 0) ? GAP_O + length * GAP_E : 0;
+}
 
-    // Compute DP
-    int score = 0;
-    for (h = 1; h <= text_length; ++h)
+// Last row of the layers of text[t0, t0 + rows) against pattern[p0, p0 + cols) from the top left corner, or from the bottom right
+// corner with reverse, the cell v of the row is then the column cols - v. With gap_open, an insertion gap is open at the corner the
+// pass starts from. The rows are computed as in swg_compute in two rows at rows_m, and the last one is written to
+// rows_m + (rows & 1) * row_size even when it fits in a tile
+void swg_hb_pass(hb_window_t *pattern, hb_window_t *text, int p0, int cols, int t0, int rows, bool reverse, bool gap_open, uint32_t rows_m, dp_cell_t *tile, dp_cell_t *upper_tile)
+{
+    int num_cells = cols + 1;
+    int row_size = ROUND_UP_MULTIPLE_8(num_cells * sizeof(dp_cell_t));
+    bool single_tile = num_cells <= TILE_CELLS;
+
+    for (int h = 0; h <= rows; ++h)
     {
-        for (v = 1; v <= pattern_length; ++v)
+        int text_base = (h > 0) ? hb_base(text, reverse ? t0 + rows - h : t0 + h - 1) : 0;
+        uint32_t row_m = rows_m + (h & 1) * row_size;
+        uint32_t upper_row_m = rows_m + ((h - 1) & 1) * row_size;
+        dp_cell_t left = {0, 0, 0, 0};
+        cell_size_t diag_M = 0;
+        for (int c0 = 0; c0 < num_cells; c0 += TILE_CELLS)
         {
-            mram_read((__mram_ptr void const *)(matrix_offset + (num_cols * h + v - 1) * sizeof(dp_cell_t)), upper_cell_cache, ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-            mram_read((__mram_ptr void const *)(matrix_offset + (num_cols * (h - 1) + v - 1) * sizeof(dp_cell_t)), diag_cell_cache, ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-            mram_read((__mram_ptr void const *)(matrix_offset + (num_cols * (h - 1) + v) * sizeof(dp_cell_t)), left_cell_cache, ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-
-            // Update DP.D
-            cell_size_t del_new = upper_cell_cache->M + GAP_O + GAP_E;
-            cell_size_t del_ext = upper_cell_cache->D + GAP_E;
-            cell_size_t del = MIN(del_new, del_ext);
-            cell_cache->D = del;
-            // Update DP.I
-            cell_size_t ins_new = left_cell_cache->M + GAP_O + GAP_E;
-            cell_size_t ins_ext = left_cell_cache->I + GAP_E;
-            cell_size_t ins = MIN(ins_new, ins_ext);
-            cell_cache->I = ins;
-            // Update DP.M
-            cell_size_t m_match = diag_cell_cache->M + ((pattern[v - 1] == text[h - 1]) ? MATCH : MISMATCH);
-            cell_cache->M = MIN(m_match, MIN(ins, del));
-            score = cell_cache->M;
-            mram_write(cell_cache, (__mram_ptr void *)(matrix_offset + (num_cols * h + v) * sizeof(dp_cell_t)), ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
+            int n = MIN(TILE_CELLS, num_cells - c0);
+            int size = ROUND_UP_MULTIPLE_8(n * sizeof(dp_cell_t));
+            if (h > 0 && !single_tile)
+                dp_row_read(upper_row_m + c0 * sizeof(dp_cell_t), upper_tile, size);
+            for (int i = 0; i < n; ++i)
+            {
+                int v = c0 + i;
+                dp_cell_t cell = {0, 0, 0, 0};
+                if (h == 0)
+                {
+                    cell.D = (v == 0) ? HB_INF : GAP_O + v * GAP_E;
+                    cell.I = (v == 0 && gap_open) ? 0 : HB_INF;
+                    cell.M = (v == 0) ? 0 : cell.D;
+                }
+                else
+                {
+                    cell.I = MIN(upper_tile[i].M + GAP_O + GAP_E, upper_tile[i].I + GAP_E);
+                    if (v == 0)
+                    {
+                        cell.D = HB_INF;
+                        cell.M = cell.I;
+                    }
+                    else
+                    {
+                        cell.D = MIN(left.M + GAP_O + GAP_E, left.D + GAP_E);
+                        int pattern_base = hb_base(pattern, reverse ? p0 + cols - v : p0 + v - 1);
+                        cell_size_t m_match = diag_M + ((pattern_base == text_base) ? MATCH : MISMATCH);
+                        cell.M = MIN(m_match, MIN(cell.I, cell.D));
+                    }
+                }
+                if (h > 0)
+                    diag_M = upper_tile[i].M;
+                left = cell;
+                tile[i] = cell;
+            }
+            if (!single_tile || h == rows)
+                dp_row_write(tile, row_m + c0 * sizeof(dp_cell_t), size);
         }
+        dp_cell_t *tmp = tile;
+        tile = upper_tile;
+        upper_tile = tmp;
     }
+}
+
+// Myers and Miller's linear-space alignment. A sub-problem of two rows or more is split at its middle row mid, in the column where the
+// forward layers of the upper half and the reverse layers of the lower half sum to the lowest score. When the insertion gaps of both
+// halves meet there, the gap crosses the row and the halves end and start with it, it pays GAP_O once. The halves are pushed on the
+// stack so that the operations of the upper half come first. Sub-problems of one row or without columns are aligned directly. The rows
+// of the passes are kept in the MRAM and the sequences read through their windows, so the WRAM of a tasklet doesn't depend on the read
+// length
+void swg_hirschberg(uint32_t pattern_m, uint32_t text_m, int pattern_length, int text_length, edit_cigar_t *cigar, uint32_t operations_m, dpu_alloc_mram_t *dpu_alloc_mram,
+                    dp_cell_t *tile, dp_cell_t *upper_tile, hb_window_t *pattern, hb_window_t *text, hb_node_t *stack)
+{
+    int row_size = ROUND_UP_MULTIPLE_8((pattern_length + 1) * sizeof(dp_cell_t));
+    uint32_t forward_m = (uint32_t)DPU_MRAM_HEAP_POINTER + dpu_alloc_mram->CUR_PTR_MRAM;
+    uint32_t reverse_m = forward_m + 2 * row_size;
+    PROFILE_MRAM_USED(4 * row_size);
+
+    hb_window_init(pattern, pattern_m, pattern_length);
+    hb_window_init(text, text_m, text_length);
+    cigar->begin_offset = 0;
+    cigar->end_offset = 0;
+    stack[0] = (hb_node_t){0, text_length, 0, pattern_length, false, false};
+    int nb_nodes = 1;
+    bool root = true;
+    while (nb_nodes > 0)
+    {
+        hb_node_t node = stack[--nb_nodes];
+        int rows = node.t1 - node.t0;
+        int cols = node.p1 - node.p0;
+        int score;
+        if (rows == 0 || cols == 0)
+        {
+            hb_push_ops(cigar, operations_m, 'D', cols);
+            hb_push_ops(cigar, operations_m, 'I', rows);
+            score = hb_gap(cols) + hb_gap(rows) - ((rows > 0 && (node.start_open || node.end_open)) ? GAP_O : 0);
+        }
+        else if (rows == 1)
+        {
+            // The text base is aligned with the pattern base costing the least, or inserted before or after the deletions
+            int text_base = hb_base(text, node.t0);
+            int insert_first = hb_gap(1) - (node.start_open ? GAP_O : 0) + hb_gap(cols);
+            int insert_last = hb_gap(cols) + hb_gap(1) - (node.end_open ? GAP_O : 0);
+            int match_v = -1;
+            score = MIN(insert_first, insert_last);
+            for (int v = 0; v < cols; ++v)
+            {
+                int cost = hb_gap(v) + ((hb_base(pattern, node.p0 + v) == text_base) ? MATCH : MISMATCH) + hb_gap(cols - 1 - v);
+                if (cost < score)
+                {
+                    score = cost;
+                    match_v = v;
+                }
+            }
+            if (match_v >= 0)
+            {
+                hb_push_ops(cigar, operations_m, 'D', match_v);
+                hb_push_ops(cigar, operations_m, (hb_base(pattern, node.p0 + match_v) == text_base) ? 'M' : 'X', 1);
+                hb_push_ops(cigar, operations_m, 'D', cols - 1 - match_v);
+            }
+            else if (insert_first <= insert_last)
+            {
+                hb_push_ops(cigar, operations_m, 'I', 1);
+                hb_push_ops(cigar, operations_m, 'D', cols);
+            }
+            else
+            {
+                hb_push_ops(cigar, operations_m, 'D', cols);
+                hb_push_ops(cigar, operations_m, 'I', 1);
+            }
+        }
+        else
+        {
+            int mid = rows / 2;
+            swg_hb_pass(pattern, text, node.p0, cols, node.t0, mid, false, node.start_open, forward_m, tile, upper_tile);
+            swg_hb_pass(pattern, text, node.p0, cols, node.t0 + mid, rows - mid, true, node.end_open, reverse_m, tile, upper_tile);
+            int sub_row_size = ROUND_UP_MULTIPLE_8((cols + 1) * sizeof(dp_cell_t));
+            uint32_t forward_row_m = forward_m + (mid & 1) * sub_row_size;
+            uint32_t reverse_row_m = reverse_m + ((rows - mid) & 1) * sub_row_size;
 
+            // The reverse row is read a tile at a time, and the forward row from the first word holding its columns, so a tile is
+            // one word shorter than TILE_CELLS
+            int split = 0;
+            bool gap = false;
+            int chunk = TILE_CELLS - WORD_CELLS;
+            score = INT32_MAX;
+            for (int r0 = 0; r0 <= cols; r0 += chunk)
+            {
+                int n = MIN(chunk, cols + 1 - r0);
+                int f0 = (cols + 1 - r0 - n) / WORD_CELLS * WORD_CELLS;
+                dp_row_read(reverse_row_m + r0 * sizeof(dp_cell_t), tile, ROUND_UP_MULTIPLE_8(n * sizeof(dp_cell_t)));
+                dp_row_read(forward_row_m + f0 * sizeof(dp_cell_t), upper_tile, ROUND_UP_MULTIPLE_8((cols - r0 - f0 + 1) * sizeof(dp_cell_t)));
+                for (int i = 0; i < n; ++i)
+                {
+                    int v = cols - r0 - i;
+                    int cost = upper_tile[v - f0].M + tile[i].M;
+                    if (cost < score)
+                    {
+                        score = cost;
+                        split = v;
+                        gap = false;
+                    }
+                    cost = upper_tile[v - f0].I + tile[i].I - GAP_O;
+                    if (cost < score)
+                    {
+                        score = cost;
+                        split = v;
+                        gap = true;
+                    }
+                }
+            }
+            if (gap)
+            {
+                // The insertions of the rows mid and mid + 1 are aligned between the halves
+                stack[nb_nodes++] = (hb_node_t){node.t0 + mid + 1, node.t1, node.p0 + split, node.p1, true, node.end_open};
+                stack[nb_nodes++] = (hb_node_t){node.t0 + mid - 1, node.t0 + mid + 1, node.p0 + split, node.p0 + split, false, false};
+                stack[nb_nodes++] = (hb_node_t){node.t0, node.t0 + mid - 1, node.p0, node.p0 + split, node.start_open, true};
+            }
+            else
+            {
+                stack[nb_nodes++] = (hb_node_t){node.t0 + mid, node.t1, node.p0 + split, node.p1, false, node.end_open};
+                stack[nb_nodes++] = (hb_node_t){node.t0, node.t0 + mid, node.p0, node.p0 + split, node.start_open, false};
+            }
+        }
+        // The first sub-problem is the whole DP-table
+        if (root)
+        {
+            cigar->score = score;
+            root = false;
+        }
+    }
+    hb_flush_ops(cigar, operations_m);
+}
+#endif
+
+#ifdef BANDED
+// Lowest diagonal v - h of the band of a read pair, returns the number of diagonals of the band or 0 when the lengths differ by
+// more gaps than an alignment within MAX_SCORE holds
+int swg_band(int pattern_length, int text_length, int *band_lo)
+{
+    int gaps = BAND_GAPS(MAX_SCORE, dpu_params.penalties);
+    int d = pattern_length - text_length;
+    if (ABS(d) > gaps)
+        return 0;
+    int margin = (gaps - ABS(d)) / 2;
+    *band_lo = MIN(0, d) - margin;
+    return ABS(d) + 2 * margin + 1;
+}
+
+// Cell (h, v) of the band from the row h, the layers of the cells out of the band are MAX_SCORE like the borders of the DP-table
+static inline dp_cell_t band_cell(dp_cell_t *row, int band_width, int band_lo, int h, int v)
+{
+    int k = v - h - band_lo;
+    if (k < 0 || k >= band_width)
+    {
+        dp_cell_t out = {MAX_SCORE, MAX_SCORE, MAX_SCORE};
+        return out;
+    }
+    return row[k];
+}
+
+// The rows of the band are read back from the MRAM, row holds the row h and upper_row the row h - 1
+void swg_banded_traceback(int band_width, int band_lo, int text_length, int pattern_length, edit_cigar_t *cigar, uint32_t matrix_offset, dp_cell_t *row, dp_cell_t *upper_row)
+{
+    char *const operations = cigar->operations;
+    int op_sentinel = cigar->end_offset - 1;
+    int row_size = ROUND_UP_MULTIPLE_8(band_width * sizeof(dp_cell_t));
+    int h = text_length;
+    int v = pattern_length;
+    swg_layer_type swg_layer = swg_M_layer;
+    dp_row_read(matrix_offset + h * row_size, row, row_size);
+    if (h > 0)
+        dp_row_read(matrix_offset + (h - 1) * row_size, upper_row, row_size);
+
+    // Same choices as the traceback of the full DP-table
+    while (h > 0 && v > 0)
+    {
+        dp_cell_t cell = band_cell(row, band_width, band_lo, h, v);
+        int up = 0;
+        switch (swg_layer)
+        {
+        case swg_D_layer:
+            operations[op_sentinel--] = 'D';
+            if (cell.D == band_cell(row, band_width, band_lo, h, v - 1).M + GAP_O + GAP_E)
+                swg_layer = swg_M_layer;
+            --v;
+            break;
+        case swg_I_layer:
+            operations[op_sentinel--] = 'I';
+            if (cell.I == band_cell(upper_row, band_width, band_lo, h - 1, v).M + GAP_O + GAP_E)
+                swg_layer = swg_M_layer;
+            up = 1;
+            break;
+        case swg_M_layer:
+            if (cell.M == cell.D)
+                swg_layer = swg_D_layer;
+            else if (cell.M == cell.I)
+                swg_layer = swg_I_layer;
+            else
+            {
+                int diag = band_cell(upper_row, band_width, band_lo, h - 1, v - 1).M;
+                if (cell.M == diag + MATCH)
+                    operations[op_sentinel--] = 'M';
+                else if (cell.M == diag + MISMATCH)
+                    operations[op_sentinel--] = 'X';
+                else
+                {
+                    printf("SWG backtrace. No backtrace operation found");
+                    exit(1);
+                }
+                --v;
+                up = 1;
+            }
+            break;
+        }
+        if (up)
+        {
+            // Move up a row
+            --h;
+            dp_cell_t *tmp = row;
+            row = upper_row;
+            upper_row = tmp;
+            if (h > 0)
+                dp_row_read(matrix_offset + (h - 1) * row_size, upper_row, row_size);
+        }
+    }
+    while (h > 0)
+    {
+        operations[op_sentinel--] = 'I';
+        --h;
+    }
+    while (v > 0)
+    {
+        operations[op_sentinel--] = 'D';
+        --v;
+    }
+    cigar->begin_offset = op_sentinel + 1;
+}
+
+// Only computes the diagonals of the band, a row h holds the cells v = h + band_lo ... h + band_lo + band_width - 1. The rows are
+// computed in two WRAM buffers and only written to the MRAM for the traceback. The cells saturate at MAX_SCORE + 1, so the score is exact up
+// to MAX_SCORE and higher scores are reported as MAX_SCORE + 1
+void swg_banded_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, dpu_alloc_mram_t *dpu_alloc_mram, dp_cell_t *row_a, dp_cell_t *row_b)
+{
+    int band_lo;
+    int band_width = swg_band(pattern_length, text_length, &band_lo);
+    if (band_width == 0)
+    {
+        cigar->score = MAX_SCORE + 1;
+        return;
+    }
+#ifdef BACKTRACE
+    uint32_t matrix_offset = (uint32_t)DPU_MRAM_HEAP_POINTER + dpu_alloc_mram->CUR_PTR_MRAM;
+    int row_size = ROUND_UP_MULTIPLE_8(band_width * sizeof(dp_cell_t));
+    PROFILE_MRAM_USED((text_length + 1) * row_size);
+#endif
+
+    const dp_cell_t out = {MAX_SCORE, MAX_SCORE, MAX_SCORE};
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    dp_cell_t *row = row_a;
+    dp_cell_t *upper_row = row_b;
+    for (int h = 0; h <= text_length; ++h)
+    {
+        int text_base = (h > 0) ? PACKED_BASE(text, text_mask, h - 1) : 0;
+        for (int k = 0; k < band_width; ++k)
+        {
+            int v = h + band_lo + k;
+            if (v < 0 || v > pattern_length)
+                row[k] = out;
+            else if (h == 0)
+            {
+                // First row
+                row[k].D = (v == 0) ? MAX_SCORE : MIN(GAP_O + v * GAP_E, MAX_SCORE + 1);
+                row[k].I = MAX_SCORE;
+                row[k].M = (v == 0) ? 0 : row[k].D;
+            }
+            else if (v == 0)
+            {
+                // First column
+                row[k].D = MAX_SCORE;
+                row[k].I = MIN(GAP_O + h * GAP_E, MAX_SCORE + 1);
+                row[k].M = row[k].I;
+            }
+            else
+            {
+                // The left cell is on the diagonal below and the upper cell on the diagonal above
+                const dp_cell_t *left = (k > 0) ? &row[k - 1] : &out;
+                const dp_cell_t *upper = (k < band_width - 1) ? &upper_row[k + 1] : &out;
+                int del = MIN(MIN(left->M + GAP_O + GAP_E, left->D + GAP_E), MAX_SCORE + 1);
+                int ins = MIN(MIN(upper->M + GAP_O + GAP_E, upper->I + GAP_E), MAX_SCORE + 1);
+                int m_match = upper_row[k].M + ((PACKED_BASE(pattern, pattern_mask, v - 1) == text_base) ? MATCH : MISMATCH);
+                row[k].D = del;
+                row[k].I = ins;
+                row[k].M = MIN(MIN(m_match, MIN(ins, del)), MAX_SCORE + 1);
+            }
+        }
+#ifdef EARLY_TERMINATION
+        // The next rows only come from the cells of this row within the DP-table
+        bool within = false;
+        for (int k = MAX(0, -h - band_lo); k <= MIN(band_width - 1, pattern_length - h - band_lo); ++k)
+            within |= row[k].M <= MAX_SCORE;
+        if (!within)
+        {
+            cigar->score = MAX_SCORE + 1;
+            return;
+        }
+#endif
+#ifdef BACKTRACE
+        dp_row_write(row, matrix_offset + h * row_size, row_size);
+#endif
+        dp_cell_t *tmp = row;
+        row = upper_row;
+        upper_row = tmp;
+    }
+    // The last row is in upper_row after the swap
+    int score = upper_row[pattern_length - text_length - band_lo].M;
+    if (score > MAX_SCORE)
+    {
+        cigar->score = MAX_SCORE + 1;
+        return;
+    }
     cigar->score = score;
 #ifdef BACKTRACE
-    // Compute traceback
-    swg_traceback(num_cols, num_rows, cigar, dpu_alloc_mram, cell_cache, upper_cell_cache, diag_cell_cache, left_cell_cache);
+    swg_banded_traceback(band_width, band_lo, text_length, pattern_length, cigar, matrix_offset, row_a, row_b);
 #endif
 }
+#endif
+
+// Reads a packed sequence from the MRAM, DMA transfers must be less than 2048
+void read_packed_sequence(uint32_t sequence_m, char *sequence, int length)
+{
+    int size = PACKED_SIZE(length);
+    for (int segment = 0; segment < size; segment += 2048)
+        mram_read((__mram_ptr void const *)(sequence_m + segment), &sequence[segment], MIN(2048, size - segment));
+}
+
+// Index of the next read of the batch to align, shared by the tasklets
+uint32_t next_read;
+MUTEX_INIT(next_read_mutex);
+// Offset of the next CIGAR in the CIGARs of the batch, shared by the tasklets
+uint32_t next_cigar;
+MUTEX_INIT(next_cigar_mutex);
+BARRIER_INIT(start_barrier, NR_TASKLETS);
+
+// Parameters of the current launch
+DPUParams dpu_params;
+
+// Statistics of the tasklets of the current launch
+tasklet_stats_t tasklet_stats[NR_TASKLETS];
+
+// Claims the next read of the batch, all the reads are claimed once it returns nb_reads_per_dpu or more
+uint32_t claim_read()
+{
+    mutex_lock(next_read_mutex);
+    uint32_t read_idx = next_read++;
+    mutex_unlock(next_read_mutex);
+    return read_idx;
+}
+
+#ifdef BACKTRACE
+// Claims size bytes of the CIGARs of the batch, returns their offset
+uint32_t claim_cigar(uint32_t size)
+{
+    mutex_lock(next_cigar_mutex);
+    uint32_t cigar_offset = next_cigar;
+    next_cigar += ROUND_UP_MULTIPLE_8(size);
+    mutex_unlock(next_cigar_mutex);
+    return cigar_offset;
+}
+
+// Replaces the operations of the alignment by their runs at the beginning of its operations buffer, returns the number of runs.
+// A run is written after the operations it encodes are read, and before the operations of the next runs
+uint32_t cigar_encode(edit_cigar_t *cigar)
+{
+    uint8_t *runs = (uint8_t *)cigar->operations;
+    uint32_t nb_runs = 0;
+    int i = cigar->begin_offset;
+    while (i < cigar->end_offset)
+    {
+        char op = cigar->operations[i];
+        int length = 1;
+        while (i + length < cigar->end_offset && cigar->operations[i + length] == op && length < CIGAR_RUN_MAX)
+            ++length;
+        runs[nb_runs++] = CIGAR_RUN(op, length);
+        i += length;
+    }
+    return nb_runs;
+}
+
+// Writes the CIGAR of the alignment run-length encoded after the CIGARs of the previous pairs, DMA transfers must be less than 2048
+void store_cigar(edit_cigar_t *cigar, uint32_t cigars_m, result_t *result)
+{
+    uint32_t size = cigar_encode(cigar);
+    result->cigar_offset = claim_cigar(size);
+    result->cigar_length = size;
+    for (uint32_t segment = 0; segment < size; segment += 2048)
+        mram_write(&cigar->operations[segment], (__mram_ptr void *)(cigars_m + result->cigar_offset + segment), MIN(2048, ROUND_UP_MULTIPLE_8(size - segment)));
+}
+
+#ifdef HIRSCHBERG
+// Copies the CIGAR built by the linear-space mode at cigar_m after the CIGARs of the previous pairs, through the operations buffer
+void hb_store_cigar(edit_cigar_t *cigar, uint32_t cigar_m, uint32_t cigars_m, result_t *result)
+{
+    result->cigar_offset = claim_cigar(cigar->end_offset);
+    result->cigar_length = cigar->end_offset;
+    for (int segment = 0; segment < cigar->end_offset; segment += HB_OPS_SIZE)
+    {
+        int size = ROUND_UP_MULTIPLE_8(MIN(HB_OPS_SIZE, cigar->end_offset - segment));
+        mram_read((__mram_ptr void const *)(cigar_m + segment), cigar->operations, size);
+        mram_write(cigar->operations, (__mram_ptr void *)(cigars_m + result->cigar_offset + segment), size);
+    }
+}
+#endif
+#endif
 
 int main()
 {
     mem_reset();
     uint32_t tasklet_id = me();
+    memset(&tasklet_stats[tasklet_id], 0, sizeof(tasklet_stats_t));
 
     dpu_alloc_mram_t dpu_alloc_mram;
 
@@ -233,26 +1135,40 @@ int main()
     if (nb_reads_per_dpu <= 0)
         return 0;
 
-    int nb_reads_per_tasklets = ROUND_UP_MULTIPLE_8(((nb_reads_per_dpu + NR_TASKLETS) / NR_TASKLETS));
+    // Tasklet 0 shares the parameters of the launch and resets the read and CIGAR counters of the previous launch and the cycle counter
+    if (tasklet_id == 0)
+    {
+        dpu_params = params_w;
+        next_read = 0;
+        next_cigar = 0;
+        perfcounter_config(COUNT_CYCLES, true);
+    }
+    barrier_wait(&start_barrier);
 
-    uint32_t dpuRequests_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuRequests_m;
-    uint32_t dpuResults_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuResults_m;
-    uint32_t dpuPatterns_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuPatterns_m;
-    uint32_t dpuTexts_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuTexts_m;
+    // Base address of the MRAM region holding the batch
+    uint32_t dpuBuffer_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuActiveBuffer * params_w.dpuBufferSize;
+    uint32_t dpuRequests_m = dpuBuffer_m + params_w.dpuRequests_m;
+    uint32_t dpuResults_m = dpuBuffer_m + params_w.dpuResults_m;
+    uint32_t dpuSequences_m = dpuBuffer_m + params_w.dpuSequences_m;
 #ifdef BACKTRACE
-    uint32_t dpuOperations_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuOperations_m;
+    uint32_t dpuOperations_m = dpuBuffer_m + params_w.dpuOperations_m;
 #endif
     // Check if the size of the DP-table fits in the MRAM for all tasklets
-    if (ROUND_UP_MULTIPLE_8(READ_SIZE * READ_SIZE * NR_TASKLETS * sizeof(dp_cell_t)) + params_w.mramTotalAllocated >= 64000000)
+    if (MRAM_TASKLET_SEGMENT(READ_SIZE, MAX_SCORE, dpu_params.penalties) * NR_TASKLETS + params_w.mramTotalAllocated > MRAM_HEAP_SIZE)
     {
         printf("Insufficient MRAM memory\n");
         exit(-1);
     }
 
     // Get the base address of the DP-table in the MRAM
-    dpu_alloc_mram.HEAD_PTR_MRAM = ROUND_UP_MULTIPLE_8(READ_SIZE * READ_SIZE * tasklet_id * sizeof(dp_cell_t)) + params_w.mramTotalAllocated;
+    dpu_alloc_mram.HEAD_PTR_MRAM = MRAM_TASKLET_SEGMENT(READ_SIZE, MAX_SCORE, dpu_params.penalties) * tasklet_id + params_w.mramTotalAllocated;
     dpu_alloc_mram.CUR_PTR_MRAM = dpu_alloc_mram.HEAD_PTR_MRAM;
     dpu_alloc_mram.mem_used_mram = 0;
+#ifdef HIRSCHBERG
+    // The CIGAR of a pair is built at the end of the MRAM segment of the tasklet
+    uint32_t cigar_m = (uint32_t)DPU_MRAM_HEAP_POINTER + dpu_alloc_mram.HEAD_PTR_MRAM + MRAM_TASKLET_SEGMENT(READ_SIZE, MAX_SCORE, dpu_params.penalties) -
+                       CIGAR_CAPACITY(READ_SIZE);
+#endif
 
     request_t *request_w = (request_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(request_t)));
     result_t *result_w = (result_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(result_t)));
@@ -260,108 +1176,97 @@ int main()
     edit_cigar_t *cigar;
     cigar = (edit_cigar_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(edit_cigar_t)));
 
-    char *pattern = (char *)mem_alloc(ROUND_UP_MULTIPLE_8(READ_SIZE));
-    char *text = (char *)mem_alloc(ROUND_UP_MULTIPLE_8(READ_SIZE));
+#ifdef HIRSCHBERG
+    // The sequences are read from the MRAM through windows, and the operations appended to the MRAM through a buffer
+    hb_window_t *pattern_window = (hb_window_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(hb_window_t)));
+    hb_window_t *text_window = (hb_window_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(hb_window_t)));
+    hb_node_t *stack = (hb_node_t *)mem_alloc(HB_STACK_SIZE * sizeof(hb_node_t));
+#else
+    char *pattern = (char *)mem_alloc(PACKED_READ_SIZE);
+    char *text = (char *)mem_alloc(PACKED_READ_SIZE);
+#endif
 
-    // We only need 4 cache cells in the WRAM
-    dp_cell_t *cell_cache = (dp_cell_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-    dp_cell_t *diag_cell_cache = (dp_cell_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-    dp_cell_t *upper_cell_cache = (dp_cell_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-    dp_cell_t *left_cell_cache = (dp_cell_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(dp_cell_t)));
-#ifdef BACKTRACE
+#ifdef BANDED
+    // Two rows of the band are computed in the WRAM
+    dp_cell_t *row_a = (dp_cell_t *)mem_alloc(BAND_ROW_SIZE(MAX_SCORE, dpu_params.penalties));
+    dp_cell_t *row_b = (dp_cell_t *)mem_alloc(BAND_ROW_SIZE(MAX_SCORE, dpu_params.penalties));
+#else
+    // A tile of the current row and one of the upper row are kept in the WRAM
+    dp_cell_t *tile = (dp_cell_t *)mem_alloc(TILE_SIZE);
+    dp_cell_t *upper_tile = (dp_cell_t *)mem_alloc(TILE_SIZE);
+#if defined(BACKTRACE) && defined(PACKED_TRACEBACK)
+    uint8_t *tb_tile = (uint8_t *)mem_alloc(TB_TILE_SIZE);
+#elif !defined(HIRSCHBERG) && !defined(EARLY_TERMINATION)
+    uint8_t *tb_tile = NULL;
+#endif
+#endif
+#ifdef HIRSCHBERG
+    cigar->operations = (char *)mem_alloc(HB_OPS_SIZE);
+#elif defined(BACKTRACE)
     cigar->operations = (char *)mem_alloc(2 * READ_SIZE);
 #endif
 
-    for (int read_nb = 0; read_nb < nb_reads_per_tasklets; ++read_nb)
+    // The tasklets claim the reads one at a time, so a divergent pair only delays the tasklet aligning it
+    uint64_t tasklet_nb_reads = 0;
+    uint32_t read_idx;
+    while ((read_idx = claim_read()) < nb_reads_per_dpu)
     {
+#ifdef PROFILE
+        perfcounter_t pair_start = perfcounter_get();
+#endif
+        mram_read((__mram_ptr void const *)(dpuRequests_m + read_idx * (sizeof(request_t))), request_w, ROUND_UP_MULTIPLE_8(sizeof(request_t)));
 
-        if (read_nb + tasklet_id * nb_reads_per_tasklets < nb_reads_per_dpu)
-        {
-
-            mram_read((__mram_ptr void const *)(dpuRequests_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (sizeof(request_t))), request_w, ROUND_UP_MULTIPLE_8(sizeof(request_t)));
-
-            // DMA transfers can't be greater than 2048
-            if (ROUND_UP_MULTIPLE_8(request_w->pattern_len) <= 2048)
-            {
-                mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE)), pattern, ROUND_UP_MULTIPLE_8(request_w->pattern_len));
-            }
-            else
-            {
-
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(request_w->pattern_len); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(request_w->pattern_len))
-                    {
-                        mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(pattern[segment_size]), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(request_w->pattern_len) - segment_size;
-                        mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(pattern[segment_size]), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
-
-            if (ROUND_UP_MULTIPLE_8(request_w->text_len) <= 2048)
-            {
-                mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE)), text, ROUND_UP_MULTIPLE_8(request_w->text_len));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(request_w->text_len); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(request_w->text_len))
-                    {
-                        mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(text[segment_size]), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(request_w->text_len) - segment_size;
-                        mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(text[segment_size]), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
-            edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len);
+#ifdef HIRSCHBERG
+        // The packed text follows the packed pattern, the CIGAR is built at the end of the MRAM segment of the tasklet
+        edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len);
+        result_w->idx = request_w->idx;
+        swg_hirschberg(dpuSequences_m + request_w->sequence_offset, dpuSequences_m + request_w->sequence_offset + PACKED_SIZE(request_w->pattern_len),
+                       request_w->pattern_len, request_w->text_len, cigar, cigar_m, &dpu_alloc_mram, tile, upper_tile,
+                       pattern_window, text_window, stack);
+#else
+        // The packed text follows the packed pattern
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset, pattern, request_w->pattern_len);
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset + PACKED_SIZE(request_w->pattern_len), text, request_w->text_len);
+        edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len);
 
 #ifdef BACKTRACE
-            // Initialize the operations memory
-            memset(cigar->operations, 'M', 2 * READ_SIZE);
+        // Initialize the operations memory
+        memset(cigar->operations, 'M', 2 * READ_SIZE);
 #endif
 
-            result_w->idx = request_w->idx;
+        result_w->idx = request_w->idx;
 
-            swg_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, &dpu_alloc_mram, cell_cache, upper_cell_cache, diag_cell_cache, left_cell_cache);
+#ifdef BANDED
+        swg_banded_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, &dpu_alloc_mram, row_a, row_b);
+#elif defined(EARLY_TERMINATION)
+        swg_threshold_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, &dpu_alloc_mram, tile, upper_tile);
+#else
+        swg_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, &dpu_alloc_mram, tile, upper_tile, tb_tile);
+#endif
+#endif
 
-#ifdef BACKTRACE
-            if (ROUND_UP_MULTIPLE_8(cigar->max_operations) <= 2048)
-            {
-                mram_write((cigar->operations), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE)), ROUND_UP_MULTIPLE_8(cigar->max_operations));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(cigar->max_operations); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(cigar->max_operations))
-                    {
-                        mram_write(&(cigar->operations[segment_size]), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE) + segment_size), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(cigar->max_operations) - segment_size;
-                        mram_write(&(cigar->operations[segment_size]), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE) + segment_size), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
+#ifdef HIRSCHBERG
+        hb_store_cigar(cigar, cigar_m, dpuOperations_m, result_w);
+#elif defined(BACKTRACE)
+        store_cigar(cigar, dpuOperations_m, result_w);
 #endif
 
-            result_w->score = cigar->score;
-            result_w->max_operations = cigar->max_operations;
-            result_w->begin_offset = cigar->begin_offset;
-            result_w->end_offset = cigar->end_offset;
+        result_w->score = cigar->score;
+        result_w->pattern_begin = cigar->pattern_begin;
+        result_w->pattern_end = cigar->pattern_end;
+        result_w->text_begin = cigar->text_begin;
+        result_w->text_end = cigar->text_end;
 
-            mram_write(result_w, (__mram_ptr void *)(dpuResults_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (sizeof(result_t))), sizeof(result_t));
-        }
+#ifdef PROFILE
+        result_w->cycles = perfcounter_get() - pair_start;
+#endif
+        mram_write(result_w, (__mram_ptr void *)(dpuResults_m + read_idx * (sizeof(result_t))), sizeof(result_t));
+        ++tasklet_nb_reads;
     }
 
+    // Number of reads aligned by the tasklet and cycles until it finished
+    tasklet_stats[tasklet_id].nb_reads = tasklet_nb_reads;
+    tasklet_stats[tasklet_id].cycles = perfcounter_get();
+    mram_write(&tasklet_stats[tasklet_id], (__mram_ptr void *)(dpuBuffer_m + params_w.dpuTaskletStats_m + tasklet_id * sizeof(tasklet_stats_t)), sizeof(tasklet_stats_t));
     return 0;
 }
\ No newline at end of file
@@ -24,12 +24,32 @@ ap.add_argument("-a", "--gap_extending", type=int,
                 default=1, help="Cost of Extending gap")
 ap.add_argument("-b", "--backtrace", action='store_true',
                 help="Enable backtracing")
+ap.add_argument("-B", "--banded", action='store_true',
+                help="Only compute the diagonals reachable within the max score")
+ap.add_argument("-E", "--early_termination", action='store_true',
+                help="Stop a read pair once no cell of a row is within the max score (without -b)")
+ap.add_argument("-P", "--packed_traceback", action='store_true',
+                help="Keep 4 bits of traceback per cell instead of the scores")
+ap.add_argument("-H", "--hirschberg", action='store_true',
+                help="Compute the CIGAR in linear space (with -b)")
+ap.add_argument("-S", "--span", type=str, default="global",
+                help="Span of the alignments: global, local, or ends-free,pattern_begin,pattern_end,text_begin,text_end for the bases of the ends of the sequences left out for free")
+ap.add_argument("-F", "--format", type=str, default="text",
+                help="Format of the output file: text, paf, sam (with -b) or binary")
+ap.add_argument("-T", "--texts", type=str,
+                help="FASTA or FASTQ file of the texts, the input file then holds the patterns (optional)")
+ap.add_argument("-X", "--index", type=str,
+                help="Index file of the pairs, written on the first run and loaded by the next ones (optional)")
 ap.add_argument("-t", "--nr_of_tasklets", type=int,
                 help="NR_TASKLETS (optional)")
 ap.add_argument("-d", "--nr_of_dpus", type=int,
                 help="NR_DPUs to allocate (default=1)")
 args = vars(ap.parse_args())
 
+if args["format"] not in ["text", "paf", "sam", "binary"] or (args["format"] in ["paf", "sam"] and not args["backtrace"]):
+    print("Wrong format " + args["format"] + ", it must be text, binary, or paf or sam with -b\n")
+    exit(-1)
+
 
 match_cost = args["match_cost"]
 mismatch_cost = args["mismatch_cost"]
@@ -41,11 +61,38 @@ if match_cost > 0 or mismatch_cost <= 0 or gap_opening <= 0 or gap_extending <=
     print("Wrong affine gap penalties must be  m <= 0 and g, a, x > 0\n")
     exit(-1)
 
+if args["banded"] and match_cost < 0:
+    print("The banded mode needs m = 0\n")
+    exit(-1)
+
+if args["early_termination"] and (args["backtrace"] or match_cost < 0):
+    print("The early termination is score-only, it needs m = 0 and is not combined with -b\n")
+    exit(-1)
+
+if args["hirschberg"] and (not args["backtrace"] or args["banded"] or args["packed_traceback"]):
+    print("The linear-space mode needs -b and is not combined with -B or -P\n")
+    exit(-1)
+
 read_length = args["read_length"]
 if read_length <= 0:
     print("Undefined input read length")
     exit(-1)
 
+span = args["span"]
+span_params = span.split(",")
+if not (span_params[0] in ["global", "local"] and len(span_params) == 1) and not (span_params[0] == "ends-free" and len(span_params) == 5):
+    print("Wrong span " + span + ", it must be global, local or ends-free,pattern_begin,pattern_end,text_begin,text_end")
+    exit(-1)
+if span_params[0] == "local" and match_cost >= 0:
+    print("The local alignment needs m < 0\n")
+    exit(-1)
+if span_params[0] != "global" and (args["banded"] or args["early_termination"] or args["hirschberg"]):
+    print("The banded, early termination and Hirschberg modes only compute global alignments\n")
+    exit(-1)
+if span_params[0] == "local" and args["packed_traceback"]:
+    print("The packed traceback doesn't record where a local alignment starts, it is not combined with a local span\n")
+    exit(-1)
+
 number_reads = args["number_reads"]
 if number_reads <= 0:
     print("Undefined number of input reads")
@@ -55,19 +102,32 @@ nr_of_wrong_bases = read_length * args["error"]
 max_score = math.ceil(max(nr_of_wrong_bases*mismatch_cost,
                       nr_of_wrong_bases*(gap_opening + gap_extending)))
 
-if read_length < 32767:
+# The linear-space mode has 32-bit scores
+if read_length < 32767 and not args["hirschberg"]:
     sizeof_offset = 2
 else:
     sizeof_offset = 4
 
 read_length = math.ceil((((read_length + nr_of_wrong_bases) + 7)/8))*8
+# patterns and texts are 2-bit packed and followed by a 1-bit N-mask
+packed_length = math.ceil(read_length/32)*8 + math.ceil(read_length/64)*8 + 8
+
+# In the banded mode a row of the DP-table only holds the diagonals reachable within max_score
+band_row = math.ceil(((max(max_score - gap_opening, 0) // gap_extending + 1)*sizeof_offset*4 + 7)/8)*8
 
-# WRAM used memory upper limit
-memory_upper_limit = 100 + 2*read_length
+# The packed traceback keeps two rows of scores and 4 bits of directions per cell
+tb_row = math.ceil(((read_length + 1)*4/8 + 7)/8)*8
+
+# WRAM used memory upper limit, two 512-byte tiles of the DP rows (two rows of the band in the banded mode)
+memory_upper_limit = 100 + 2*packed_length + (2*band_row if args["banded"] else 2*512)
 memory_upper_limit = int(math.ceil((((memory_upper_limit) + 7)/8))*8)
 
 
-if args["backtrace"]:
+# The linear-space mode reads the sequences through two 112-byte windows and keeps a stack of 64 sub-problems and a 256-byte
+# buffer of operations instead
+if args["hirschberg"]:
+    memory_upper_limit = 100 + 2*512 + 2*112 + 64*20 + 256
+elif args["backtrace"]:
     memory_upper_limit = memory_upper_limit + 2 * read_length
 
 memory_upper_limit = int(memory_upper_limit)
@@ -78,9 +138,16 @@ for NR_TASKLETS in range(1, 21):
         NR_TASKLETS = NR_TASKLETS-1
         break
 
-# MRAM used memory upper limit
-memory_upper_limit_mram = (number_reads/args["nr_of_dpus"])*2*read_length + (
-    number_reads/args["nr_of_dpus"])*80 + read_length*read_length*NR_TASKLETS*8
+# MRAM used memory upper limit, a tasklet stores (read_length + 1) rows of the DP-table (of the band in the banded mode) with the
+# backtrace and two rows without
+dp_row = math.ceil(((read_length + 1)*sizeof_offset*4 + 7)/8)*8
+dp_table_mram = (read_length + 1 if args["backtrace"] else 2)*(band_row if args["banded"] else dp_row)
+if args["packed_traceback"] and args["backtrace"] and not args["banded"]:
+    dp_table_mram = 2*dp_row + read_length*tb_row
+if args["hirschberg"]:
+    dp_table_mram = 4*dp_row
+memory_upper_limit_mram = (number_reads/args["nr_of_dpus"])*2*packed_length + (
+    number_reads/args["nr_of_dpus"])*80 + dp_table_mram*NR_TASKLETS
 
 if args["backtrace"]:
     memory_upper_limit_mram = memory_upper_limit_mram + \
@@ -89,8 +156,8 @@ if args["backtrace"]:
 # Check if it exceeds the MRAM capacity
 if memory_upper_limit_mram >= 64000000:
     for NR_TASKLETS in range(1, NR_TASKLETS):
-        memory_upper_limit_mram = (number_reads/args["nr_of_dpus"])*2*read_length + (
-            number_reads/args["nr_of_dpus"])*76 + read_length*read_length*NR_TASKLETS*8
+        memory_upper_limit_mram = (number_reads/args["nr_of_dpus"])*2*packed_length + (
+            number_reads/args["nr_of_dpus"])*76 + dp_table_mram*NR_TASKLETS
 
         if args["backtrace"]:
             memory_upper_limit_mram = memory_upper_limit_mram + \
@@ -121,8 +188,8 @@ if args["nr_of_tasklets"] is not None:
     # Check MRAM capcity
     if memory_upper_limit_mram >= 64000000:
         for NR_TASKLETS in range(1, NR_TASKLETS):
-            memory_upper_limit_mram = (number_reads/args["nr_of_dpus"])*2*read_length + (
-                number_reads/args["nr_of_dpus"])*76 + read_length*read_length*NR_TASKLETS*8
+            memory_upper_limit_mram = (number_reads/args["nr_of_dpus"])*2*packed_length + (
+                number_reads/args["nr_of_dpus"])*76 + dp_table_mram*NR_TASKLETS
 
             if args["backtrace"]:
                 memory_upper_limit_mram = memory_upper_limit_mram + \
@@ -141,6 +208,14 @@ print("Number of allocated bytes per tasklets: ", str(memory_upper_limit))
 options = ""
 if args["backtrace"]:
     options = options + " -DBACKTRACE"
+if args["banded"]:
+    options = options + " -DBANDED"
+if args["early_termination"]:
+    options = options + " -DEARLY_TERMINATION"
+if args["packed_traceback"]:
+    options = options + " -DPACKED_TRACEBACK"
+if args["hirschberg"]:
+    options = options + " -DHIRSCHBERG"
 NR_DPUs = 1
 if args["nr_of_dpus"]:
     NR_DPUs = args["nr_of_dpus"]
@@ -148,15 +223,13 @@ if args["nr_of_dpus"]:
 
 # os.system("echo "+args["input"])
 # os.system("echo "+str(NR_TASKLETS))
-os.system("make clean")
-cmd = "make NR_DPUS="+str(NR_DPUs)+" NR_TASKLETS="+str(NR_TASKLETS)+" FLAGS=\"-DMAX_SCORE="+str(int(max_score))+" -DREAD_SIZE="+str(int(read_length))+" -DWRAM_SEGMENT=" + \
-    str(memory_upper_limit)+" -DMATCH="+str(match_cost)+" -DMISMATCH="+str(mismatch_cost) + \
-    " -DGAP_O="+str(gap_opening)+" -DGAP_E="+str(gap_extending) + options+"\""
+# The DPU binaries only depend on the number of tasklets and the build flags, they are built once and the alignment parameters are passed at run time
+cmd = "make prebuilt PREBUILT_TASKLETS="+str(NR_TASKLETS)+" FLAGS=\""+options.strip()+"\""
 
 os.system("echo "+str(cmd))
 os.system(cmd)
 
 
-cmd = "./build/host " + args["input"] + " " + \
-    args["output"] + " " + str(number_reads)
+cmd = "./build/host -t "+str(NR_TASKLETS)+" -d "+str(NR_DPUs)+" -l "+str(int(read_length))+" -s "+str(int(max_score))+" -w "+str(memory_upper_limit) + \
+    " -p "+str(match_cost)+","+str(mismatch_cost)+","+str(gap_opening)+","+str(gap_extending)+" -a "+span+" -f "+args["format"]+(" -T "+args["texts"] if args["texts"] else "")+(" -x "+args["index"] if args["index"] else "")+" " + args["input"] + " " + args["output"] + " " + str(number_reads)
 os.system(cmd)
@@ -40,6 +40,14 @@
 
 #define DPU_CAPACITY (64 << 20)
 
+// MRAM heap shared by the host buffers and the working memory of the tasklets
+#define MRAM_HEAP_SIZE 64000000
+
+// WRAM of a DPU, the stack of each tasklet is reserved in it and the working memory of the tasklets is allocated from the rest
+#define WRAM_SIZE (64 << 10)
+#define WRAM_STACK_SIZE 1024
+
+// Default alignment parameters of the host, the kernels read the parameters of a run from the DPU params at launch
 #ifndef MATCH
 #define MATCH 0
 #endif
@@ -74,16 +82,22 @@
 #define SWG_W16
 #endif
 
+// The width of the cells is chosen with the MAX_SCORE of the build, MAX_SCORE_LIMIT is the highest score they hold. The 8-bit cells
+// can't hold the scores of whole reads, the full DP-table then stops its cells at MAX_SCORE + 1 as the banded mode
 #ifdef SWG_W8
 typedef int8_t cell_size_t;
 #define SWG_OFFSET_NULL (INT8_MIN / 2)
+#define MAX_SCORE_LIMIT (INT8_MAX - 1)
+#define SWG_CLAMPED
 #else
 #ifdef SWG_W16
 typedef int16_t cell_size_t;
 #define SWG_OFFSET_NULL (INT16_MIN / 2)
+#define MAX_SCORE_LIMIT (INT16_MAX - 1)
 #else
 typedef int cell_size_t;
 #define SWG_OFFSET_NULL (INT32_MIN / 2)
+#define MAX_SCORE_LIMIT (INT32_MAX - 1)
 #endif
 #endif
 
@@ -93,6 +107,13 @@ typedef int cell_size_t;
 
 #define ROUND_UP_MULTIPLE_8(x) ((((x) + 7) / 8) * 8)
 
+#ifndef SWG_CLAMPED
+// Highest score a cell of the full DP-table reaches with reads of read_size bases: a mismatch, a gap extension or a match of negative
+// cost at each base, and the openings of two gaps
+#define CELL_SCORE_BOUND(read_size, penalties) \
+  (2 * ((int64_t)(penalties).gap_o + (penalties).gap_e) + (int64_t)(read_size)*MAX(MAX((penalties).gap_e, (penalties).mismatch), -(penalties).match))
+#endif
+
 typedef enum
 {
   swg_M_layer,
@@ -107,6 +128,10 @@ typedef struct
   int begin_offset;
   int end_offset;
   int score;
+  int pattern_begin; /* Span of the alignment on the pattern and the text */
+  int pattern_end;
+  int text_begin;
+  int text_end;
 } edit_cigar_t;
 
 typedef struct
@@ -117,34 +142,164 @@ typedef struct
   // cell_size_t padding; /* Padding to ensure the alignment of the struct */
 } dp_cell_t;
 
+// With -DPACKED_TRACEBACK, the backtrace keeps TB_BITS bits of directions per cell (the M direction and whether the D and I gaps open) instead of the
+// scores of the DP-table, and only two rows of scores are kept
+#define TB_BITS 4
+#define TB_ROW_SIZE(read_size) ROUND_UP_MULTIPLE_8((((read_size) + 1) * TB_BITS + 7) / 8)
+
+// In the banded mode (-DBANDED), a row of the DP-table only holds the diagonals v - h an alignment within max_score can reach.
+// Reaching diagonal k and ending on the diagonal d of the last cell takes |k| + |k - d| gap extensions and one gap opening, at most BAND_GAPS
+#define BAND_GAPS(max_score, penalties) ((max_score) > (penalties).gap_o ? ((max_score) - (penalties).gap_o) / (penalties).gap_e : 0)
+#define BAND_ROW_SIZE(max_score, penalties) ROUND_UP_MULTIPLE_8((BAND_GAPS(max_score, penalties) + 1) * sizeof(dp_cell_t))
+// The band and the early termination only hold when no step of an alignment lowers its score
+#define BAND_PENALTIES_VALID(penalties) ((penalties).match >= 0 && (penalties).mismatch >= 0 && (penalties).gap_o >= 0 && (penalties).gap_e > 0)
+
+// With -DEARLY_TERMINATION, the score-only kernels only compute the cells of a row within the max score and stop a read pair once a row
+// has none, the pair is then rejected with a score of max_score + 1
+#if defined(EARLY_TERMINATION) && defined(BACKTRACE)
+#error "EARLY_TERMINATION is a score-only mode, it is not combined with BACKTRACE"
+#endif
+
+// The DP-tables are stored in the WRAM
+#define MRAM_TASKLET_SEGMENT(read_size, max_score, penalties) 0
+
+// WRAM allocated by each tasklet: the request, the result and the CIGAR of a pair, its packed sequences, its DP-table, the rows of the
+// band, or two rows and the directions of the packed traceback, and the operations of the CIGAR
+#define WRAM_PAIR_SIZE (ROUND_UP_MULTIPLE_8(sizeof(request_t)) + ROUND_UP_MULTIPLE_8(sizeof(result_t)) + ROUND_UP_MULTIPLE_8(sizeof(edit_cigar_t)))
+#ifdef BACKTRACE
+#define WRAM_OPERATIONS_SIZE(read_size) ROUND_UP_MULTIPLE_8(2 * (read_size))
+#else
+#define WRAM_OPERATIONS_SIZE(read_size) 0
+#endif
+#if defined(BANDED) && defined(BACKTRACE)
+#define WRAM_DP_TABLE_SIZE(read_size, max_score, penalties) (((uint64_t)(read_size) + 1) * BAND_ROW_SIZE(max_score, penalties))
+#elif defined(BANDED)
+#define WRAM_DP_TABLE_SIZE(read_size, max_score, penalties) (2 * BAND_ROW_SIZE(max_score, penalties))
+#elif defined(PACKED_TRACEBACK) && defined(BACKTRACE)
+#define WRAM_DP_TABLE_SIZE(read_size, max_score, penalties) \
+    (2 * ROUND_UP_MULTIPLE_8(((uint64_t)(read_size) + 1) * sizeof(dp_cell_t)) + (uint64_t)(read_size) * TB_ROW_SIZE(read_size))
+#elif defined(EARLY_TERMINATION) || defined(PACKED_TRACEBACK)
+#define WRAM_DP_TABLE_SIZE(read_size, max_score, penalties) (2 * ROUND_UP_MULTIPLE_8(((uint64_t)(read_size) + 1) * sizeof(dp_cell_t)))
+#else
+#define WRAM_DP_TABLE_SIZE(read_size, max_score, penalties) ROUND_UP_MULTIPLE_8(((uint64_t)(read_size) + 1) * ((uint64_t)(read_size) + 1) * sizeof(dp_cell_t))
+#endif
+#define WRAM_TASKLET_SEGMENT(read_size, max_score, penalties, wram_segment) \
+    (WRAM_PAIR_SIZE + 2 * PACKED_SIZE(read_size) + WRAM_DP_TABLE_SIZE(read_size, max_score, penalties) + WRAM_OPERATIONS_SIZE(read_size))
+
+// Sequences are 2-bit packed, 4 bases per byte (A=0, C=1, G=2, T=3), and followed by an N-mask with 1 bit per base.
+// Any base other than A, C, G and T is stored as an N
+#define PACKED_BASES_SIZE(len) ROUND_UP_MULTIPLE_8(((len) + 3) / 4)
+#define PACKED_MASK_SIZE(len) ROUND_UP_MULTIPLE_8(((len) + 7) / 8)
+#define PACKED_SIZE(len) (PACKED_BASES_SIZE(len) + PACKED_MASK_SIZE(len))
+#define PACKED_READ_SIZE PACKED_SIZE(READ_SIZE)
+
+// 2-bit code of the base i of a packed sequence
+#define PACKED_CODE(bases, i) ((((const uint8_t *)(bases))[(i) >> 2] >> (((i)&3) << 1)) & 3)
+// Base i of a packed sequence, N bases are returned as 4 so that they only match N bases
+#define PACKED_BASE(bases, mask, i) (PACKED_CODE(bases, i) | (((((const uint8_t *)(mask))[(i) >> 3] >> ((i)&7)) & 1) << 2))
+
+// Estimated cost of aligning a read pair, used by the host to balance the work of the DPUs.
+// The whole DP table is computed, so the edits estimate isn't used (and isn't evaluated by the macro)
+#define PAIR_COST(pattern_len, text_len, edits) ((uint64_t)(pattern_len) * (text_len))
+
 typedef struct request_t
 {
   int pattern_len;
   int text_len;
-  int padding; /* Padding to ensure the alignment of the struct */
+  uint32_t sequence_offset; /* Offset of the packed pattern in the sequences of the DPU, the packed text follows it */
   uint32_t idx;
 } request_t;
 
+// With BACKTRACE, the kernels write the CIGAR of a pair run-length encoded after the CIGARs of the previous pairs of the batch. A byte
+// is a run of 1 to CIGAR_RUN_MAX operations, the length - 1 in its upper 6 bits and the operation in its lower 2 bits, so the CIGAR
+// of a pair is never longer than its operations. Longer runs take several bytes, the host merges them when it writes the CIGAR
+#define CIGAR_RUN_MAX 64
+#define CIGAR_OP_CODE(op) (((op) == 'M') ? 0 : ((op) == 'X') ? 1 : ((op) == 'I') ? 2 : 3)
+#define CIGAR_RUN(op, length) ((uint8_t)((((length)-1) << 2) | CIGAR_OP_CODE(op)))
+#define CIGAR_RUN_OP(run) ("MXID"[(run)&3])
+#define CIGAR_RUN_LENGTH(run) (((run) >> 2) + 1)
+// Bytes reserved for the CIGAR of a pair of reads of at most read_size bases
+#define CIGAR_CAPACITY(read_size) ROUND_UP_MULTIPLE_8(2 * (read_size))
+// The banded and early termination kernels, and the full DP-table of 8-bit cells, reject a pair above the max score with a score of
+// max_score + 1, the full DP-table of wider cells scores every pair
+#if defined(BANDED) || defined(EARLY_TERMINATION) || defined(SWG_CLAMPED)
+#define SCORE_REJECTED(score, max_score) ((score) > (int)(max_score))
+#else
+#define SCORE_REJECTED(score, max_score) 0
+#endif
+
 typedef struct result_t
 {
-  int max_operations;
-  int begin_offset;
-  int end_offset;
+  uint32_t cigar_offset; /* Offset of the CIGAR in the CIGARs of the batch */
+  uint32_t cigar_length; /* Number of runs of the CIGAR */
   int score;
-  int padding; /* Padding to ensure the alignment of the struct */
+  int pattern_begin; /* Span of the alignment, the begins are -1 when the kernel doesn't compute them */
+  int pattern_end;
+  int text_begin;
+  int text_end;
   uint32_t idx;
+  uint64_t cycles; /* Cycles spent aligning the pair, filled with -DPROFILE */
 } result_t;
 
+// Statistics written by each tasklet at the end of a batch, the DMA and memory fields are only filled with -DPROFILE
+typedef struct tasklet_stats_t
+{
+  uint64_t nb_reads;    /* Number of reads aligned by the tasklet */
+  uint64_t cycles;      /* Cycles from the launch until the tasklet finished */
+  uint64_t dma_read;    /* Bytes read from the MRAM by the tasklet */
+  uint64_t dma_written; /* Bytes written to the MRAM by the tasklet */
+  uint32_t wram_peak;   /* WRAM high-water mark of the tasklet in bytes */
+  uint32_t mram_peak;   /* MRAM high-water mark of the working memory of the tasklet in bytes */
+} tasklet_stats_t;
+
+// Penalties of the alignment, read by the kernels from the DPU params
+typedef struct penalties_t
+{
+  int32_t match;
+  int32_t mismatch;
+  int32_t gap_o;
+  int32_t gap_e;
+} penalties_t;
+
+#define DEFAULT_PENALTIES {MATCH, MISMATCH, GAP_O, GAP_E}
+#define PENALTIES_USAGE "match,mismatch,gap_o,gap_e"
+
+// Span of the alignment, read by the kernels from the DPU params. A global alignment aligns the whole sequences, an ends-free
+// alignment leaves out up to the given number of bases at the begin and the end of the pattern and of the text for free, and a local
+// alignment (Smith-Waterman) aligns the substrings of the lowest score, which needs a match cost below 0
+#define SPAN_GLOBAL 0
+#define SPAN_ENDS_FREE 1
+#define SPAN_LOCAL 2
+
+typedef struct span_t
+{
+  int32_t mode;
+  int32_t pattern_begin_free;
+  int32_t pattern_end_free;
+  int32_t text_begin_free;
+  int32_t text_end_free;
+  int32_t padding;
+} span_t;
+
+#define DEFAULT_SPAN {SPAN_GLOBAL, 0, 0, 0, 0, 0}
+#define SPAN_USAGE "global|local|ends-free,pattern_begin,pattern_end,text_begin,text_end"
+
 typedef struct DPUParams
 {
   uint32_t dpuNumReads;        /* Number of reads assigned to the DPU */
   uint32_t dpuRequests_m;      /* Base address of the requests in the MRAM */
   uint32_t dpuResults_m;       /* Base address of the results in the MRAM */
-  uint32_t dpuPatterns_m;      /* Base address of the patterns sequences in the MRAM */
-  uint32_t dpuTexts_m;         /* Base address of the text sequences in the MRAM */
-  uint32_t dpuOperations_m;    /* Base address of the traceback operations in the MRAM */
+  uint32_t dpuSequences_m;     /* Base address of the packed sequences in the MRAM */
+  uint32_t dpuOperations_m;    /* Base address of the CIGARs in the MRAM */
   uint32_t mramTotalAllocated; /* Size of the MRAM memory allocated by the host */
-  uint32_t padding;            /* Padding to ensure the alignment of the struct */
+  uint32_t dpuActiveBuffer;    /* MRAM region of the batch to align (0 or 1) */
+  uint32_t dpuBufferSize;      /* Size of an MRAM region */
+  uint32_t dpuTaskletStats_m;  /* Base address of the statistics of the tasklets in the MRAM */
+  uint32_t readSize;           /* Length of the longest read */
+  uint32_t maxScore;           /* Highest alignment score computed */
+  uint32_t wramSegment;        /* Size of the WRAM segment of a tasklet */
+  penalties_t penalties;       /* Penalties of the alignment */
+  span_t span;                 /* Span of the alignment */
 } DPUParams;
 
 #endif
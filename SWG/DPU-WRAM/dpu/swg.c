@@ -30,6 +30,11 @@
 #include "../common/common.h"
 #include "dpu_allocator_wram.h"
 #include "dpu_allocator_mram.h"
+#include <barrier.h>
+#include <mutex.h>
+#include <perfcounter.h>
+#include "dpu_profile.h"
+#include "dpu_params.h"
 
 void edit_cigar_allocate(
     edit_cigar_t *edit_cigar,
@@ -40,20 +45,64 @@ void edit_cigar_allocate(
     edit_cigar->begin_offset = edit_cigar->max_operations - 1;
     edit_cigar->end_offset = edit_cigar->max_operations;
     edit_cigar->score = INT32_MIN;
+    edit_cigar->pattern_begin = 0;
+    edit_cigar->pattern_end = pattern_length;
+    edit_cigar->text_begin = 0;
+    edit_cigar->text_end = text_length;
 }
 
-void swg_traceback(int num_cols, int num_rows, edit_cigar_t *cigar, dp_cell_t *dp_table)
+// Bases of the pattern and of the text the span of the alignment leaves out for free at their begin and at their end
+typedef struct span_free_t
+{
+    int pattern_begin;
+    int pattern_end;
+    int text_begin;
+    int text_end;
+} span_free_t;
+
+span_free_t span_free(int pattern_length, int text_length)
+{
+    if (SPAN.mode == SPAN_LOCAL)
+        return (span_free_t){pattern_length, pattern_length, text_length, text_length};
+    if (SPAN.mode == SPAN_ENDS_FREE)
+        return (span_free_t){MIN(SPAN.pattern_begin_free, pattern_length), MIN(SPAN.pattern_end_free, pattern_length),
+                             MIN(SPAN.text_begin_free, text_length), MIN(SPAN.text_end_free, text_length)};
+    return (span_free_t){0, 0, 0, 0};
+}
+
+// Scores of the gap of the cell (h, 0) or (0, v) of the first column or row, the bases left out for free at the begin cost nothing
+#define BEGIN_GAP(bases, free_bases) (((bases) <= (free_bases)) ? MAX_SCORE : GAP_O + ((bases) - (free_bases)) * GAP_E)
+#define BEGIN_M(bases, free_bases) (((bases) <= (free_bases)) ? 0 : GAP_O + ((bases) - (free_bases)) * GAP_E)
+
+// The 8-bit cells of the full DP-table stop at MAX_SCORE + 1, the scores are computed in int before being stored
+#ifdef SWG_CLAMPED
+#define CELL_CLAMP(score) MIN(score, MAX_SCORE + 1)
+#else
+#define CELL_CLAMP(score) (score)
+#endif
+
+// Begin of the alignment when the traceback isn't computed, it is unknown when the begin of a sequence is free
+void span_unknown_begin(edit_cigar_t *cigar, span_free_t free)
+{
+    if (free.pattern_begin > 0)
+        cigar->pattern_begin = -1;
+    if (free.text_begin > 0)
+        cigar->text_begin = -1;
+}
+
+// Traceback from the end cell (h, v) of the alignment, it stops at the first row or column once the bases left out for free are reached,
+// or at a cell of score 0 of a local alignment
+void swg_traceback(int num_cols, int h, int v, span_free_t free, edit_cigar_t *cigar, dp_cell_t *dp_table)
 {
     char *const operations = cigar->operations;
     int op_sentinel = cigar->end_offset - 1;
-    int h, v;
-    // Compute traceback
-    h = num_cols - 1;
-    v = num_rows - 1;
+    bool local = SPAN.mode == SPAN_LOCAL;
     swg_layer_type swg_layer = swg_M_layer;
 
     while (h > 0 && v > 0)
     {
+        if (local && swg_layer == swg_M_layer && dp_table[num_cols * h + v].M == 0)
+            break;
         switch (swg_layer)
         {
         case swg_D_layer:
@@ -105,75 +154,598 @@ void swg_traceback(int num_cols, int num_rows, edit_cigar_t *cigar, dp_cell_t *d
             break;
         }
     }
-    while (h > 0)
+    while (v == 0 && h > free.text_begin)
     {
         operations[op_sentinel--] = 'I';
         --h;
     }
-    while (v > 0)
+    while (h == 0 && v > free.pattern_begin)
     {
         operations[op_sentinel--] = 'D';
         --v;
     }
     cigar->begin_offset = op_sentinel + 1;
+    cigar->pattern_begin = v;
+    cigar->text_begin = h;
 }
 
 void swg_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, dp_cell_t *dp_table)
 {
     int h, v;
-    int num_rows = pattern_length + 1;
-    int num_cols = text_length + 1;
+    // A row of the table holds the cells of a base of the text
+    int num_cols = pattern_length + 1;
+    span_free_t free = span_free(pattern_length, text_length);
+    bool local = SPAN.mode == SPAN_LOCAL;
 
     // Init DP
-    dp_table[0].D = MAX_SCORE;
-    dp_table[0].I = MAX_SCORE;
-    dp_table[0].M = 0;
-
-    for (v = 1; v <= pattern_length; ++v)
+    for (v = 0; v <= pattern_length; ++v)
     { // Init first column
-        dp_table[v].D = GAP_O + v * GAP_E;
+        dp_table[v].D = CELL_CLAMP(BEGIN_GAP(v, free.pattern_begin));
         dp_table[v].I = MAX_SCORE;
-        dp_table[v].M = dp_table[v].D;
+        dp_table[v].M = CELL_CLAMP(BEGIN_M(v, free.pattern_begin));
     }
     for (h = 1; h <= text_length; ++h)
     { // Init first row
         dp_table[num_cols * h].D = MAX_SCORE;
-        dp_table[num_cols * h].I = GAP_O + h * GAP_E;
-        dp_table[num_cols * h].M = dp_table[num_cols * h].I;
+        dp_table[num_cols * h].I = CELL_CLAMP(BEGIN_GAP(h, free.text_begin));
+        dp_table[num_cols * h].M = CELL_CLAMP(BEGIN_M(h, free.text_begin));
     }
-    // Compute DP
-    int score = 0;
+    // Compute DP, the bases are read from the packed sequences
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    // A local alignment ends at its lowest cell
+    int end_h = text_length, end_v = pattern_length;
+    int best = 0;
     for (h = 1; h <= text_length; ++h)
     {
+        int text_base = PACKED_BASE(text, text_mask, h - 1);
         for (v = 1; v <= pattern_length; ++v)
         {
             // Update DP.D
-            cell_size_t del_new = dp_table[num_cols * h + v - 1].M + GAP_O + GAP_E;
-            cell_size_t del_ext = dp_table[num_cols * h + v - 1].D + GAP_E;
-            cell_size_t del = MIN(del_new, del_ext);
+            int del_new = dp_table[num_cols * h + v - 1].M + GAP_O + GAP_E;
+            int del_ext = dp_table[num_cols * h + v - 1].D + GAP_E;
+            int del = CELL_CLAMP(MIN(del_new, del_ext));
             dp_table[num_cols * h + v].D = del;
             // Update DP.I
-            cell_size_t ins_new = dp_table[num_cols * (h - 1) + v].M + GAP_O + GAP_E;
-            cell_size_t ins_ext = dp_table[num_cols * (h - 1) + v].I + GAP_E;
-            cell_size_t ins = MIN(ins_new, ins_ext);
+            int ins_new = dp_table[num_cols * (h - 1) + v].M + GAP_O + GAP_E;
+            int ins_ext = dp_table[num_cols * (h - 1) + v].I + GAP_E;
+            int ins = CELL_CLAMP(MIN(ins_new, ins_ext));
             dp_table[num_cols * h + v].I = ins;
             // Update DP.M
-            cell_size_t m_match = dp_table[num_cols * (h - 1) + v - 1].M + ((pattern[v - 1] == text[h - 1]) ? MATCH : MISMATCH);
-            score = dp_table[num_cols * h + v].M = MIN(m_match, MIN(ins, del));
+            int m_match = dp_table[num_cols * (h - 1) + v - 1].M + ((PACKED_BASE(pattern, pattern_mask, v - 1) == text_base) ? MATCH : MISMATCH);
+            int score = CELL_CLAMP(MIN(m_match, MIN(ins, del)));
+            if (local)
+            {
+                // A local alignment can start at any cell
+                score = MIN(score, 0);
+                if (score < best)
+                {
+                    best = score;
+                    end_h = h;
+                    end_v = v;
+                }
+            }
+            dp_table[num_cols * h + v].M = score;
         }
     }
+    if (SPAN.mode == SPAN_ENDS_FREE)
+    {
+        // The alignment ends in the last row or column once the bases left out for free are reached, the corner wins the ties
+        best = dp_table[num_cols * text_length + pattern_length].M;
+        for (h = text_length - free.text_end; h < text_length; ++h)
+            if (dp_table[num_cols * h + pattern_length].M < best)
+            {
+                best = dp_table[num_cols * h + pattern_length].M;
+                end_h = h;
+            }
+        for (v = pattern_length - 1; v >= pattern_length - free.pattern_end; --v)
+            if (dp_table[num_cols * text_length + v].M < best)
+            {
+                best = dp_table[num_cols * text_length + v].M;
+                end_h = text_length;
+                end_v = v;
+            }
+    }
 
-    cigar->score = score;
+    cigar->score = dp_table[num_cols * end_h + end_v].M;
+    cigar->pattern_end = end_v;
+    cigar->text_end = end_h;
 #ifdef BACKTRACE
     // Compute traceback
-    swg_traceback(num_cols, num_rows, cigar, dp_table);
+    swg_traceback(num_cols, end_h, end_v, free, cigar, dp_table);
+#else
+    span_unknown_begin(cigar, free);
+#endif
+}
+
+#ifdef PACKED_TRACEBACK
+// Directions of the packed traceback, the choice the traceback of the scores makes at a cell of the M layer and whether the gaps of
+// the D and I layers open at the cell
+#define TB_M 0
+#define TB_X 1
+#define TB_D 2
+#define TB_I 3
+#define TB_D_OPEN 4
+#define TB_I_OPEN 8
+
+// Directions of the cell (h, v), the row h of the directions starts at (h - 1) * TB_ROW_SIZE
+#define TB_CELL(tb, pattern_length, h, v) (((tb)[((h)-1) * TB_ROW_SIZE(pattern_length) + (v)*TB_BITS / 8] >> (((v)*TB_BITS) & 7)) & ((1 << TB_BITS) - 1))
+
+void swg_packed_traceback(int pattern_length, int h, int v, span_free_t free, edit_cigar_t *cigar, uint8_t *tb)
+{
+    char *const operations = cigar->operations;
+    int op_sentinel = cigar->end_offset - 1;
+    swg_layer_type swg_layer = swg_M_layer;
+
+    while (h > 0 && v > 0)
+    {
+        int dir = TB_CELL(tb, pattern_length, h, v);
+        switch (swg_layer)
+        {
+        case swg_D_layer:
+            operations[op_sentinel--] = 'D';
+            if (dir & TB_D_OPEN)
+                swg_layer = swg_M_layer;
+            --v;
+            break;
+        case swg_I_layer:
+            operations[op_sentinel--] = 'I';
+            if (dir & TB_I_OPEN)
+                swg_layer = swg_M_layer;
+            --h;
+            break;
+        case swg_M_layer:
+            switch (dir & 3)
+            {
+            case TB_D:
+                swg_layer = swg_D_layer;
+                break;
+            case TB_I:
+                swg_layer = swg_I_layer;
+                break;
+            default:
+                operations[op_sentinel--] = ((dir & 3) == TB_X) ? 'X' : 'M';
+                --h;
+                --v;
+                break;
+            }
+            break;
+        }
+    }
+    while (v == 0 && h > free.text_begin)
+    {
+        operations[op_sentinel--] = 'I';
+        --h;
+    }
+    while (h == 0 && v > free.pattern_begin)
+    {
+        operations[op_sentinel--] = 'D';
+        --v;
+    }
+    cigar->begin_offset = op_sentinel + 1;
+    cigar->pattern_begin = v;
+    cigar->text_begin = h;
+}
+
+// Only two rows of scores are kept, the backtrace follows the TB_BITS bits of directions stored for each cell
+void swg_packed_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, dp_cell_t *dp_rows, uint8_t *tb)
+{
+    int row_cells = ROUND_UP_MULTIPLE_8((pattern_length + 1) * sizeof(dp_cell_t)) / sizeof(dp_cell_t);
+    dp_cell_t *row = dp_rows;
+    dp_cell_t *upper_row = dp_rows + row_cells;
+    span_free_t free = span_free(pattern_length, text_length);
+    // Lowest cell of the last column before the corner, where an alignment leaving out the end of the text for free can end
+    int end_h = text_length;
+    int best = INT32_MAX;
+
+    // Compute DP, the bases are read from the packed sequences
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    for (int h = 0; h <= text_length; ++h)
+    {
+        int text_base = (h > 0) ? PACKED_BASE(text, text_mask, h - 1) : 0;
+#ifdef BACKTRACE
+        uint8_t *tb_row = tb + (h - 1) * TB_ROW_SIZE(pattern_length);
+#endif
+        for (int v = 0; v <= pattern_length; ++v)
+        {
+            if (h == 0)
+            {
+                // Init first row
+                row[v].D = CELL_CLAMP(BEGIN_GAP(v, free.pattern_begin));
+                row[v].I = MAX_SCORE;
+                row[v].M = CELL_CLAMP(BEGIN_M(v, free.pattern_begin));
+            }
+            else if (v == 0)
+            {
+                // Init first column
+                row[v].D = MAX_SCORE;
+                row[v].I = CELL_CLAMP(BEGIN_GAP(h, free.text_begin));
+                row[v].M = CELL_CLAMP(BEGIN_M(h, free.text_begin));
+            }
+            else
+            {
+                // Update DP.D
+                int del_new = row[v - 1].M + GAP_O + GAP_E;
+                int del_ext = row[v - 1].D + GAP_E;
+                int del = CELL_CLAMP(MIN(del_new, del_ext));
+                row[v].D = del;
+                // Update DP.I
+                int ins_new = upper_row[v].M + GAP_O + GAP_E;
+                int ins_ext = upper_row[v].I + GAP_E;
+                int ins = CELL_CLAMP(MIN(ins_new, ins_ext));
+                row[v].I = ins;
+                // Update DP.M
+                int m_match = upper_row[v - 1].M + ((PACKED_BASE(pattern, pattern_mask, v - 1) == text_base) ? MATCH : MISMATCH);
+                row[v].M = CELL_CLAMP(MIN(m_match, MIN(ins, del)));
+#ifdef BACKTRACE
+                // Same choices as the traceback of the scores
+                int dir = (row[v].M == row[v].D) ? TB_D : (row[v].M == row[v].I) ? TB_I : (row[v].M == upper_row[v - 1].M + MATCH) ? TB_M : TB_X;
+                if (row[v].D == row[v - 1].M + GAP_O + GAP_E)
+                    dir |= TB_D_OPEN;
+                if (row[v].I == upper_row[v].M + GAP_O + GAP_E)
+                    dir |= TB_I_OPEN;
+                if (v == 1 || ((v * TB_BITS) & 7) == 0)
+                    tb_row[v * TB_BITS / 8] = 0;
+                tb_row[v * TB_BITS / 8] |= dir << ((v * TB_BITS) & 7);
+#endif
+            }
+        }
+        if (h < text_length && h >= text_length - free.text_end && row[pattern_length].M < best)
+        {
+            best = row[pattern_length].M;
+            end_h = h;
+        }
+        dp_cell_t *tmp = row;
+        row = upper_row;
+        upper_row = tmp;
+    }
+    // The last row is in upper_row after the swap, the alignment ends in the last row or column once the bases left out for free are
+    // reached and the corner wins the ties
+    int end_v = pattern_length;
+    if (upper_row[pattern_length].M <= best)
+    {
+        best = upper_row[pattern_length].M;
+        end_h = text_length;
+    }
+    for (int v = pattern_length - 1; v >= pattern_length - free.pattern_end; --v)
+        if (upper_row[v].M < best)
+        {
+            best = upper_row[v].M;
+            end_h = text_length;
+            end_v = v;
+        }
+    cigar->score = best;
+    cigar->pattern_end = end_v;
+    cigar->text_end = end_h;
+#ifdef BACKTRACE
+    swg_packed_traceback(pattern_length, end_h, end_v, free, cigar, tb);
+#else
+    span_unknown_begin(cigar, free);
+#endif
+}
+#endif
+
+#ifdef EARLY_TERMINATION
+// Score-only DP-table that stops at MAX_SCORE, in two rows. As the scores never decrease along an alignment, the cells of a row left of
+// the first cell within MAX_SCORE of the upper row, or right of the last one and of a cell above MAX_SCORE, are above MAX_SCORE too. A
+// row is only computed from its first column lo to the cell ending it, the layers of the cells out of [lo, hi] of the upper row saturate
+// at MAX_SCORE + 1, and the pair is rejected with a score of MAX_SCORE + 1 once a row has no cell within MAX_SCORE
+void swg_threshold_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, dp_cell_t *dp_rows)
+{
+    int row_cells = ROUND_UP_MULTIPLE_8((pattern_length + 1) * sizeof(dp_cell_t)) / sizeof(dp_cell_t);
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    const int limit = MAX_SCORE + 1;
+    // First and last columns of the upper row within MAX_SCORE, the first row has no upper row
+    int lo = 0;
+    int hi = -1;
+    for (int h = 0; h <= text_length; ++h)
+    {
+        int text_base = (h > 0) ? PACKED_BASE(text, text_mask, h - 1) : 0;
+        dp_cell_t *row = dp_rows + (h & 1) * row_cells;
+        dp_cell_t *upper_row = dp_rows + ((h - 1) & 1) * row_cells;
+        int row_lo = -1;
+        int row_hi = -1;
+        int left_M = limit;
+        int left_D = limit;
+        int diag_M = limit;
+        for (int v = lo; v <= pattern_length; ++v)
+        {
+            int up_M = (v <= hi) ? upper_row[v].M : limit;
+            int up_I = (v <= hi) ? upper_row[v].I : limit;
+            int M, I = limit, D = limit;
+            if (h == 0)
+            {
+                D = (v == 0) ? limit : MIN(GAP_O + v * GAP_E, limit);
+                M = (v == 0) ? 0 : D;
+            }
+            else
+            {
+                I = MIN(MIN(up_M + GAP_O + GAP_E, up_I + GAP_E), limit);
+                if (v > 0)
+                    D = MIN(MIN(left_M + GAP_O + GAP_E, left_D + GAP_E), limit);
+                int m_match = (v > 0) ? diag_M + ((PACKED_BASE(pattern, pattern_mask, v - 1) == text_base) ? MATCH : MISMATCH) : limit;
+                M = MIN(MIN(m_match, MIN(I, D)), limit);
+            }
+            row[v].M = M;
+            row[v].I = I;
+            row[v].D = D;
+            if (M <= MAX_SCORE)
+            {
+                if (row_lo < 0)
+                    row_lo = v;
+                row_hi = v;
+            }
+            else if (v > hi)
+                // The next cells of the row only come from this one
+                break;
+            left_M = M;
+            left_D = D;
+            diag_M = up_M;
+        }
+        if (row_lo < 0)
+        {
+            cigar->score = limit;
+            return;
+        }
+        lo = row_lo;
+        hi = row_hi;
+    }
+    // The last row reaches the last column within MAX_SCORE
+    cigar->score = (hi == pattern_length) ? dp_rows[(text_length & 1) * row_cells + pattern_length].M : limit;
+}
+#endif
+
+#ifdef BANDED
+// The traceback needs every row of the band, the score only the last two
+#ifdef BACKTRACE
+#define BAND_ROW(h) (h)
+#else
+#define BAND_ROW(h) ((h)&1)
+#endif
+
+// Lowest diagonal v - h of the band of a read pair, returns the number of diagonals of the band or 0 when the lengths differ by
+// more gaps than an alignment within MAX_SCORE holds
+int swg_band(int pattern_length, int text_length, int *band_lo)
+{
+    int gaps = BAND_GAPS(MAX_SCORE, dpu_params.penalties);
+    int d = pattern_length - text_length;
+    if (ABS(d) > gaps)
+        return 0;
+    int margin = (gaps - ABS(d)) / 2;
+    *band_lo = MIN(0, d) - margin;
+    return ABS(d) + 2 * margin + 1;
+}
+
+// Cell (h, v) of the band, the layers of the cells out of the band are MAX_SCORE like the borders of the DP-table
+static inline dp_cell_t band_cell(dp_cell_t *dp_table, int band_width, int band_lo, int h, int v)
+{
+    int k = v - h - band_lo;
+    if (k < 0 || k >= band_width)
+    {
+        dp_cell_t out = {MAX_SCORE, MAX_SCORE, MAX_SCORE};
+        return out;
+    }
+    return dp_table[BAND_ROW(h) * band_width + k];
+}
+
+void swg_banded_traceback(int band_width, int band_lo, int text_length, int pattern_length, edit_cigar_t *cigar, dp_cell_t *dp_table)
+{
+    char *const operations = cigar->operations;
+    int op_sentinel = cigar->end_offset - 1;
+    int h = text_length;
+    int v = pattern_length;
+    swg_layer_type swg_layer = swg_M_layer;
+
+    // Same choices as the traceback of the full DP-table
+    while (h > 0 && v > 0)
+    {
+        dp_cell_t cell = band_cell(dp_table, band_width, band_lo, h, v);
+        switch (swg_layer)
+        {
+        case swg_D_layer:
+            operations[op_sentinel--] = 'D';
+            if (cell.D == band_cell(dp_table, band_width, band_lo, h, v - 1).M + GAP_O + GAP_E)
+                swg_layer = swg_M_layer;
+            --v;
+            break;
+        case swg_I_layer:
+            operations[op_sentinel--] = 'I';
+            if (cell.I == band_cell(dp_table, band_width, band_lo, h - 1, v).M + GAP_O + GAP_E)
+                swg_layer = swg_M_layer;
+            --h;
+            break;
+        case swg_M_layer:
+            if (cell.M == cell.D)
+                swg_layer = swg_D_layer;
+            else if (cell.M == cell.I)
+                swg_layer = swg_I_layer;
+            else
+            {
+                int diag = band_cell(dp_table, band_width, band_lo, h - 1, v - 1).M;
+                if (cell.M == diag + MATCH)
+                    operations[op_sentinel--] = 'M';
+                else if (cell.M == diag + MISMATCH)
+                    operations[op_sentinel--] = 'X';
+                else
+                {
+                    printf("SWG backtrace. No backtrace operation found");
+                    exit(1);
+                }
+                --h;
+                --v;
+            }
+            break;
+        }
+    }
+    while (h > 0)
+    {
+        operations[op_sentinel--] = 'I';
+        --h;
+    }
+    while (v > 0)
+    {
+        operations[op_sentinel--] = 'D';
+        --v;
+    }
+    cigar->begin_offset = op_sentinel + 1;
+}
+
+// Only computes the diagonals of the band, a row h holds the cells v = h + band_lo ... h + band_lo + band_width - 1. The cells saturate
+// at MAX_SCORE + 1, so the score is exact up to MAX_SCORE and higher scores are reported as MAX_SCORE + 1
+void swg_banded_compute(char *pattern, char *text, int pattern_length, int text_length, edit_cigar_t *cigar, dp_cell_t *dp_table)
+{
+    int band_lo;
+    int band_width = swg_band(pattern_length, text_length, &band_lo);
+    if (band_width == 0)
+    {
+        cigar->score = MAX_SCORE + 1;
+        return;
+    }
+
+    const dp_cell_t out = {MAX_SCORE, MAX_SCORE, MAX_SCORE};
+    const char *pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    const char *text_mask = text + PACKED_BASES_SIZE(text_length);
+    for (int h = 0; h <= text_length; ++h)
+    {
+        dp_cell_t *row = &dp_table[BAND_ROW(h) * band_width];
+        dp_cell_t *upper_row = (h > 0) ? &dp_table[BAND_ROW(h - 1) * band_width] : row;
+        int text_base = (h > 0) ? PACKED_BASE(text, text_mask, h - 1) : 0;
+        for (int k = 0; k < band_width; ++k)
+        {
+            int v = h + band_lo + k;
+            if (v < 0 || v > pattern_length)
+                row[k] = out;
+            else if (h == 0)
+            {
+                // First row
+                row[k].D = (v == 0) ? MAX_SCORE : MIN(GAP_O + v * GAP_E, MAX_SCORE + 1);
+                row[k].I = MAX_SCORE;
+                row[k].M = (v == 0) ? 0 : row[k].D;
+            }
+            else if (v == 0)
+            {
+                // First column
+                row[k].D = MAX_SCORE;
+                row[k].I = MIN(GAP_O + h * GAP_E, MAX_SCORE + 1);
+                row[k].M = row[k].I;
+            }
+            else
+            {
+                // The left cell is on the diagonal below and the upper cell on the diagonal above
+                const dp_cell_t *left = (k > 0) ? &row[k - 1] : &out;
+                const dp_cell_t *upper = (k < band_width - 1) ? &upper_row[k + 1] : &out;
+                int del = MIN(MIN(left->M + GAP_O + GAP_E, left->D + GAP_E), MAX_SCORE + 1);
+                int ins = MIN(MIN(upper->M + GAP_O + GAP_E, upper->I + GAP_E), MAX_SCORE + 1);
+                int m_match = upper_row[k].M + ((PACKED_BASE(pattern, pattern_mask, v - 1) == text_base) ? MATCH : MISMATCH);
+                row[k].D = del;
+                row[k].I = ins;
+                row[k].M = MIN(MIN(m_match, MIN(ins, del)), MAX_SCORE + 1);
+            }
+        }
+#ifdef EARLY_TERMINATION
+        // The next rows only come from the cells of this row within the DP-table
+        bool within = false;
+        for (int k = MAX(0, -h - band_lo); k <= MIN(band_width - 1, pattern_length - h - band_lo); ++k)
+            within |= row[k].M <= MAX_SCORE;
+        if (!within)
+        {
+            cigar->score = MAX_SCORE + 1;
+            return;
+        }
+#endif
+    }
+    int score = dp_table[BAND_ROW(text_length) * band_width + pattern_length - text_length - band_lo].M;
+    if (score > MAX_SCORE)
+    {
+        cigar->score = MAX_SCORE + 1;
+        return;
+    }
+    cigar->score = score;
+#ifdef BACKTRACE
+    swg_banded_traceback(band_width, band_lo, text_length, pattern_length, cigar, dp_table);
+#endif
+}
 #endif
+
+// Reads a packed sequence from the MRAM, DMA transfers must be less than 2048
+void read_packed_sequence(uint32_t sequence_m, char *sequence, int length)
+{
+    int size = PACKED_SIZE(length);
+    for (int segment = 0; segment < size; segment += 2048)
+        mram_read((__mram_ptr void const *)(sequence_m + segment), &sequence[segment], MIN(2048, size - segment));
+}
+
+// Index of the next read of the batch to align, shared by the tasklets
+uint32_t next_read;
+MUTEX_INIT(next_read_mutex);
+// Offset of the next CIGAR in the CIGARs of the batch, shared by the tasklets
+uint32_t next_cigar;
+MUTEX_INIT(next_cigar_mutex);
+BARRIER_INIT(start_barrier, NR_TASKLETS);
+
+// Parameters of the current launch
+DPUParams dpu_params;
+
+// Statistics of the tasklets of the current launch
+tasklet_stats_t tasklet_stats[NR_TASKLETS];
+
+// Claims the next read of the batch, all the reads are claimed once it returns nb_reads_per_dpu or more
+uint32_t claim_read()
+{
+    mutex_lock(next_read_mutex);
+    uint32_t read_idx = next_read++;
+    mutex_unlock(next_read_mutex);
+    return read_idx;
+}
+
+#ifdef BACKTRACE
+// Claims size bytes of the CIGARs of the batch, returns their offset
+uint32_t claim_cigar(uint32_t size)
+{
+    mutex_lock(next_cigar_mutex);
+    uint32_t cigar_offset = next_cigar;
+    next_cigar += ROUND_UP_MULTIPLE_8(size);
+    mutex_unlock(next_cigar_mutex);
+    return cigar_offset;
+}
+
+// Replaces the operations of the alignment by their runs at the beginning of its operations buffer, returns the number of runs.
+// A run is written after the operations it encodes are read, and before the operations of the next runs
+uint32_t cigar_encode(edit_cigar_t *cigar)
+{
+    uint8_t *runs = (uint8_t *)cigar->operations;
+    uint32_t nb_runs = 0;
+    int i = cigar->begin_offset;
+    while (i < cigar->end_offset)
+    {
+        char op = cigar->operations[i];
+        int length = 1;
+        while (i + length < cigar->end_offset && cigar->operations[i + length] == op && length < CIGAR_RUN_MAX)
+            ++length;
+        runs[nb_runs++] = CIGAR_RUN(op, length);
+        i += length;
+    }
+    return nb_runs;
 }
 
+// Writes the CIGAR of the alignment run-length encoded after the CIGARs of the previous pairs, DMA transfers must be less than 2048
+void store_cigar(edit_cigar_t *cigar, uint32_t cigars_m, result_t *result)
+{
+    uint32_t size = cigar_encode(cigar);
+    result->cigar_offset = claim_cigar(size);
+    result->cigar_length = size;
+    for (uint32_t segment = 0; segment < size; segment += 2048)
+        mram_write(&cigar->operations[segment], (__mram_ptr void *)(cigars_m + result->cigar_offset + segment), MIN(2048, ROUND_UP_MULTIPLE_8(size - segment)));
+}
+#endif
+
 int main()
 {
     mem_reset();
     uint32_t tasklet_id = me();
+    memset(&tasklet_stats[tasklet_id], 0, sizeof(tasklet_stats_t));
 
     // Load parameters
     uint32_t params_m = (uint32_t)DPU_MRAM_HEAP_POINTER;
@@ -184,16 +756,43 @@ int main()
     if (nb_reads_per_dpu <= 0)
         return 0;
 
-    int nb_reads_per_tasklets = ROUND_UP_MULTIPLE_8(((nb_reads_per_dpu + NR_TASKLETS) / NR_TASKLETS));
+    // Tasklet 0 shares the parameters of the launch and resets the read and CIGAR counters of the previous launch and the cycle counter
+    if (tasklet_id == 0)
+    {
+        dpu_params = params_w;
+        next_read = 0;
+        next_cigar = 0;
+        perfcounter_config(COUNT_CYCLES, true);
+    }
+    barrier_wait(&start_barrier);
 
-    uint32_t dpuRequests_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuRequests_m;
-    uint32_t dpuResults_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuResults_m;
-    uint32_t dpuPatterns_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuPatterns_m;
-    uint32_t dpuTexts_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuTexts_m;
-    uint32_t dpuOperations_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuOperations_m;
+    // Base address of the MRAM region holding the batch
+    uint32_t dpuBuffer_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuActiveBuffer * params_w.dpuBufferSize;
+    uint32_t dpuRequests_m = dpuBuffer_m + params_w.dpuRequests_m;
+    uint32_t dpuResults_m = dpuBuffer_m + params_w.dpuResults_m;
+    uint32_t dpuSequences_m = dpuBuffer_m + params_w.dpuSequences_m;
+    uint32_t dpuOperations_m = dpuBuffer_m + params_w.dpuOperations_m;
 
     // Allocate DP table in WRAM for each tasklet and reuse it after every iteration
-    dp_cell_t *dp_table = (dp_cell_t *)mem_alloc(ROUND_UP_MULTIPLE_8(READ_SIZE) * READ_SIZE * sizeof(dp_cell_t));
+#ifdef BANDED
+#ifdef BACKTRACE
+    dp_cell_t *dp_table = (dp_cell_t *)mem_alloc((READ_SIZE + 1) * BAND_ROW_SIZE(MAX_SCORE, dpu_params.penalties));
+#else
+    dp_cell_t *dp_table = (dp_cell_t *)mem_alloc(2 * BAND_ROW_SIZE(MAX_SCORE, dpu_params.penalties));
+#endif
+#elif defined(EARLY_TERMINATION)
+    dp_cell_t *dp_table = (dp_cell_t *)mem_alloc(2 * ROUND_UP_MULTIPLE_8((READ_SIZE + 1) * sizeof(dp_cell_t)));
+#elif defined(PACKED_TRACEBACK)
+    // Two rows of scores, and the directions of the cells for the backtrace
+    dp_cell_t *dp_table = (dp_cell_t *)mem_alloc(2 * ROUND_UP_MULTIPLE_8((READ_SIZE + 1) * sizeof(dp_cell_t)));
+#ifdef BACKTRACE
+    uint8_t *tb = (uint8_t *)mem_alloc(READ_SIZE * TB_ROW_SIZE(READ_SIZE));
+#else
+    uint8_t *tb = NULL;
+#endif
+#else
+    dp_cell_t *dp_table = (dp_cell_t *)mem_alloc(ROUND_UP_MULTIPLE_8((READ_SIZE + 1) * (READ_SIZE + 1) * sizeof(dp_cell_t)));
+#endif
 
     request_t *request_w = (request_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(request_t)));
     result_t *result_w = (result_t *)mem_alloc(ROUND_UP_MULTIPLE_8(sizeof(result_t)));
@@ -204,97 +803,61 @@ int main()
 #ifdef BACKTRACE
     cigar->operations = (char *)mem_alloc(ROUND_UP_MULTIPLE_8(2 * READ_SIZE));
 #endif
-    char *pattern = (char *)mem_alloc(ROUND_UP_MULTIPLE_8(READ_SIZE));
-    char *text = (char *)mem_alloc(ROUND_UP_MULTIPLE_8(READ_SIZE));
+    char *pattern = (char *)mem_alloc(PACKED_READ_SIZE);
+    char *text = (char *)mem_alloc(PACKED_READ_SIZE);
 
-    for (int read_nb = 0; read_nb < nb_reads_per_tasklets; ++read_nb)
+    // The tasklets claim the reads one at a time, so a divergent pair only delays the tasklet aligning it
+    uint64_t tasklet_nb_reads = 0;
+    uint32_t read_idx;
+    while ((read_idx = claim_read()) < nb_reads_per_dpu)
     {
+#ifdef PROFILE
+        perfcounter_t pair_start = perfcounter_get();
+#endif
+        mram_read((__mram_ptr void const *)(dpuRequests_m + read_idx * (sizeof(request_t))), request_w, ROUND_UP_MULTIPLE_8(sizeof(request_t)));
 
-        if (read_nb + tasklet_id * nb_reads_per_tasklets < nb_reads_per_dpu)
-        {
-
-            mram_read((__mram_ptr void const *)(dpuRequests_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (sizeof(request_t))), request_w, ROUND_UP_MULTIPLE_8(sizeof(request_t)));
-
-            if (ROUND_UP_MULTIPLE_8(request_w->pattern_len) <= 2048)
-            {
-                mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE)), pattern, ROUND_UP_MULTIPLE_8(request_w->pattern_len));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(request_w->pattern_len); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(request_w->pattern_len))
-                    {
-                        mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(pattern[segment_size]), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(request_w->pattern_len) - segment_size;
-                        mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(pattern[segment_size]), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
-
-            if (ROUND_UP_MULTIPLE_8(request_w->text_len) <= 2048)
-            {
-                mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE)), text, ROUND_UP_MULTIPLE_8(request_w->text_len));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(request_w->text_len); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(request_w->text_len))
-                    {
-                        mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(text[segment_size]), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(request_w->text_len) - segment_size;
-                        mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(text[segment_size]), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
-            edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len);
+        // The packed text follows the packed pattern
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset, pattern, request_w->pattern_len);
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset + PACKED_SIZE(request_w->pattern_len), text, request_w->text_len);
+        edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len);
 
 #ifdef BACKTRACE
-            // Initialize the operations memory
-            memset(cigar->operations, 'M', 2 * READ_SIZE);
+        // Initialize the operations memory
+        memset(cigar->operations, 'M', 2 * READ_SIZE);
 #endif
 
-            result_w->idx = request_w->idx;
+        result_w->idx = request_w->idx;
 
-            swg_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, dp_table);
+#ifdef BANDED
+        swg_banded_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, dp_table);
+#elif defined(EARLY_TERMINATION)
+        swg_threshold_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, dp_table);
+#elif defined(PACKED_TRACEBACK)
+        swg_packed_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, dp_table, tb);
+#else
+        swg_compute(pattern, text, request_w->pattern_len, request_w->text_len, cigar, dp_table);
+#endif
 
 #ifdef BACKTRACE
-            if (ROUND_UP_MULTIPLE_8(cigar->max_operations) <= 2048)
-            {
-                mram_write((cigar->operations), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE)), ROUND_UP_MULTIPLE_8(cigar->max_operations));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(cigar->max_operations); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(cigar->max_operations))
-                    {
-                        mram_write(&(cigar->operations[segment_size]), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE) + segment_size), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(cigar->max_operations) - segment_size;
-                        mram_write(&(cigar->operations[segment_size]), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE) + segment_size), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
+        store_cigar(cigar, dpuOperations_m, result_w);
 #endif
 
-            result_w->score = cigar->score;
-            result_w->max_operations = cigar->max_operations;
-            result_w->begin_offset = cigar->begin_offset;
-            result_w->end_offset = cigar->end_offset;
+        result_w->score = cigar->score;
+        result_w->pattern_begin = cigar->pattern_begin;
+        result_w->pattern_end = cigar->pattern_end;
+        result_w->text_begin = cigar->text_begin;
+        result_w->text_end = cigar->text_end;
 
-            mram_write(result_w, (__mram_ptr void *)(dpuResults_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (sizeof(result_t))), sizeof(result_t));
-        }
+#ifdef PROFILE
+        result_w->cycles = perfcounter_get() - pair_start;
+#endif
+        mram_write(result_w, (__mram_ptr void *)(dpuResults_m + read_idx * (sizeof(result_t))), sizeof(result_t));
+        ++tasklet_nb_reads;
     }
 
+    // Number of reads aligned by the tasklet and cycles until it finished
+    tasklet_stats[tasklet_id].nb_reads = tasklet_nb_reads;
+    tasklet_stats[tasklet_id].cycles = perfcounter_get();
+    mram_write(&tasklet_stats[tasklet_id], (__mram_ptr void *)(dpuBuffer_m + params_w.dpuTaskletStats_m + tasklet_id * sizeof(tasklet_stats_t)), sizeof(tasklet_stats_t));
     return 0;
 }
\ No newline at end of file
@@ -24,12 +24,30 @@ ap.add_argument("-a", "--gap_extending", type=int,
                 default=1, help="Cost of extending gap")
 ap.add_argument("-b", "--backtrace", action='store_true',
                 help="Enable backtracing")
+ap.add_argument("-B", "--banded", action='store_true',
+                help="Only compute the diagonals reachable within the max score")
+ap.add_argument("-E", "--early_termination", action='store_true',
+                help="Stop a read pair once no cell of a row is within the max score (without -b)")
+ap.add_argument("-P", "--packed_traceback", action='store_true',
+                help="Keep 4 bits of traceback per cell instead of the scores")
+ap.add_argument("-S", "--span", type=str, default="global",
+                help="Span of the alignments: global, local, or ends-free,pattern_begin,pattern_end,text_begin,text_end for the bases of the ends of the sequences left out for free")
+ap.add_argument("-F", "--format", type=str, default="text",
+                help="Format of the output file: text, paf, sam (with -b) or binary")
+ap.add_argument("-T", "--texts", type=str,
+                help="FASTA or FASTQ file of the texts, the input file then holds the patterns (optional)")
+ap.add_argument("-X", "--index", type=str,
+                help="Index file of the pairs, written on the first run and loaded by the next ones (optional)")
 ap.add_argument("-t", "--nr_of_tasklets", type=int,
                 help="NR_TASKLETS (optional)")
 ap.add_argument("-d", "--nr_of_dpus", type=int,
                 help="NR_DPUs to allocate (default=1)")
 args = vars(ap.parse_args())
 
+if args["format"] not in ["text", "paf", "sam", "binary"] or (args["format"] in ["paf", "sam"] and not args["backtrace"]):
+    print("Wrong format " + args["format"] + ", it must be text, binary, or paf or sam with -b\n")
+    exit(-1)
+
 
 match_cost = args["match_cost"]
 mismatch_cost = args["mismatch_cost"]
@@ -41,11 +59,34 @@ if match_cost > 0 or mismatch_cost <= 0 or gap_opening <= 0 or gap_extending <=
     print("Wrong affine gap penalties must be  m <= 0 and g, a, x > 0\n")
     exit(-1)
 
+if args["banded"] and match_cost < 0:
+    print("The banded mode needs m = 0\n")
+    exit(-1)
+
+if args["early_termination"] and (args["backtrace"] or match_cost < 0):
+    print("The early termination is score-only, it needs m = 0 and is not combined with -b\n")
+    exit(-1)
+
 read_length = args["read_length"]
 if read_length <= 0:
     print("Undefined input read length")
     exit(-1)
 
+span = args["span"]
+span_params = span.split(",")
+if not (span_params[0] in ["global", "local"] and len(span_params) == 1) and not (span_params[0] == "ends-free" and len(span_params) == 5):
+    print("Wrong span " + span + ", it must be global, local or ends-free,pattern_begin,pattern_end,text_begin,text_end")
+    exit(-1)
+if span_params[0] == "local" and match_cost >= 0:
+    print("The local alignment needs m < 0\n")
+    exit(-1)
+if span_params[0] != "global" and (args["banded"] or args["early_termination"]):
+    print("The banded and early termination modes only compute global alignments\n")
+    exit(-1)
+if span_params[0] == "local" and args["packed_traceback"]:
+    print("The packed traceback doesn't record where a local alignment starts, it is not combined with a local span\n")
+    exit(-1)
+
 number_reads = args["number_reads"]
 if number_reads <= 0:
     print("Undefined number of input reads")
@@ -63,14 +104,32 @@ else:
     sizeof_offset = 4
 
 read_length = math.ceil((((read_length + nr_of_wrong_bases) + 7)/8))*8
+# patterns and texts are 2-bit packed and followed by a 1-bit N-mask
+packed_length = math.ceil(read_length/32)*8 + math.ceil(read_length/64)*8 + 8
+
+# In the banded mode a row of the DP-table only holds the diagonals reachable within max_score
+band_row = math.ceil(((max(max_score - gap_opening, 0) // gap_extending + 1)*sizeof_offset*3 + 7)/8)*8
+
+# The packed traceback keeps two rows of scores and 4 bits of directions per cell
+tb_row = math.ceil(((read_length + 1)*4/8 + 7)/8)*8
 
 # WRAM used memory upper limit is DP-table
-memory_upper_limit = 100 + 2*read_length + \
+memory_upper_limit = 100 + 2*packed_length + \
     read_length*read_length*sizeof_offset*3
+if args["banded"]:
+    # (read_length + 1) rows are kept for the backtrace, two rows otherwise
+    band_rows = read_length + 1 if args["backtrace"] else 2
+    memory_upper_limit = 100 + 2*packed_length + band_rows*band_row
+elif args["early_termination"]:
+    memory_upper_limit = 100 + 2*packed_length + 2*math.ceil(((read_length + 1)*sizeof_offset*3 + 7)/8)*8
+elif args["packed_traceback"]:
+    memory_upper_limit = 100 + 2*packed_length + 2*math.ceil(((read_length + 1)*sizeof_offset*3 + 7)/8)*8
+    if args["backtrace"]:
+        memory_upper_limit = memory_upper_limit + read_length*tb_row
 memory_upper_limit = int(math.ceil((((memory_upper_limit) + 7)/8))*8)
 
 memory_upper_limit_mram = (
-    number_reads/args["nr_of_dpus"])*2*read_length + (number_reads/args["nr_of_dpus"])*24
+    number_reads/args["nr_of_dpus"])*2*packed_length + (number_reads/args["nr_of_dpus"])*24
 
 if args["backtrace"]:
     memory_upper_limit = memory_upper_limit + 2 * read_length
@@ -115,6 +174,12 @@ print("Number of allocated bytes per tasklets: ", str(memory_upper_limit))
 options = ""
 if args["backtrace"]:
     options = options + " -DBACKTRACE"
+if args["banded"]:
+    options = options + " -DBANDED"
+if args["early_termination"]:
+    options = options + " -DEARLY_TERMINATION"
+if args["packed_traceback"]:
+    options = options + " -DPACKED_TRACEBACK"
 NR_DPUs = 1
 if args["nr_of_dpus"]:
     NR_DPUs = args["nr_of_dpus"]
@@ -122,15 +187,19 @@ if args["nr_of_dpus"]:
 
 # os.system("echo "+args["input"])
 # os.system("echo "+str(NR_TASKLETS))
-os.system("make clean")
-cmd = "make NR_DPUS="+str(NR_DPUs)+" NR_TASKLETS="+str(NR_TASKLETS)+" FLAGS=\"-DMAX_SCORE="+str(int(max_score))+" -DREAD_SIZE="+str(int(read_length))+" -DWRAM_SEGMENT=" + \
-    str(memory_upper_limit)+" -DMATCH="+str(match_cost)+" -DMISMATCH="+str(mismatch_cost) + \
-    " -DGAP_O="+str(gap_opening)+" -DGAP_E="+str(gap_extending) + options+"\""
+# The width of the DP cells is the only parameter fixed at build time, the binaries are shared by the scores of the same width
+if max_score <= 126:
+    options = " -DMAX_SCORE=126" + options
+else:
+    options = " -DMAX_SCORE=32766" + options
+
+# The DPU binaries only depend on the number of tasklets and the build flags, they are built once and the alignment parameters are passed at run time
+cmd = "make prebuilt PREBUILT_TASKLETS="+str(NR_TASKLETS)+" FLAGS=\""+options.strip()+"\""
 
 os.system("echo "+str(cmd))
 os.system(cmd)
 
 
-cmd = "./build/host " + args["input"] + " " + \
-    args["output"] + " " + str(number_reads)
+cmd = "./build/host -t "+str(NR_TASKLETS)+" -d "+str(NR_DPUs)+" -l "+str(int(read_length))+" -s "+str(int(max_score))+" -w "+str(memory_upper_limit) + \
+    " -p "+str(match_cost)+","+str(mismatch_cost)+","+str(gap_opening)+","+str(gap_extending)+" -a "+span+" -f "+args["format"]+(" -T "+args["texts"] if args["texts"] else "")+(" -x "+args["index"] if args["index"] else "")+" " + args["input"] + " " + args["output"] + " " + str(number_reads)
 os.system(cmd)
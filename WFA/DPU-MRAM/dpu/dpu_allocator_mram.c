@@ -1,4 +1,5 @@
 #include "dpu_allocator_mram.h"
+#include "dpu_profile.h"
 
 void add_wfa_cmpnt_to_mram(uint32_t *mramIdx, uint32_t size, dpu_alloc_mram_t *dpu_alloc_mram)
 {
@@ -15,333 +16,60 @@ void add_wfa_cmpnt_to_mram(uint32_t *mramIdx, uint32_t size, dpu_alloc_mram_t *d
     }
     size = ROUND_UP_MULTIPLE_8(size);
     dpu_alloc_mram->mem_used_mram += size;
+    PROFILE_MRAM_USED(dpu_alloc_mram->mem_used_mram);
     *(mramIdx) = dpu_alloc_mram->CUR_PTR_MRAM;
     dpu_alloc_mram->CUR_PTR_MRAM += size;
 }
 
-wfa_component *load_wfa_cmpnt_from_mram(dpu_alloc_wram_t *allocator, uint32_t mramIdx)
+// Writes a WRAM buffer to the MRAM, DMA transfers must be less than 2048
+static void write_to_mram(void *buffer, uint32_t addr_m, int size)
 {
-    if (mramIdx == 0)
-    {
-        return NULL;
-    }
-    wfa_component *wfa = (wfa_component *)allocate_new(allocator, sizeof(wfa_component));
-    uint32_t wfa_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + mramIdx;
-    mram_read((__mram_ptr void const *)(wfa_m), wfa, ROUND_UP_MULTIPLE_8(sizeof(wfa_component)));
-    int wv_len = wfa->hi_base - wfa->lo_base + 1;
-    wfa_m += ROUND_UP_MULTIPLE_8(sizeof(wfa_component));
-    awf_offset_t *moffset = (awf_offset_t *)allocate_new(allocator, wv_len * sizeof(awf_offset_t));
-    if (ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)) <= 2048)
-    {
-        mram_read((__mram_ptr void const *)(wfa_m), moffset, ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)));
-    }
-    else
-    {
-        int wavefront_segment = 2048 / sizeof(awf_offset_t);
-        for (int num_wavefronts = 0; num_wavefronts <= wv_len; num_wavefronts += wavefront_segment)
-        {
-            if (num_wavefronts + wavefront_segment <= wv_len)
-            {
-                mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &moffset[num_wavefronts], (wavefront_segment * sizeof(awf_offset_t)));
-            }
-            else
-            {
-                int wv_remaining = wv_len - num_wavefronts;
-                if (wv_remaining > 0)
-                {
-                    mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &moffset[num_wavefronts], ROUND_UP_MULTIPLE_8(wv_remaining * sizeof(awf_offset_t)));
-                }
-            }
-        }
-    }
-
-    wfa->mwavefront = (awf_offset_t *)(moffset - wfa->lo_base);
-    wfa_m += ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t));
-    if (wfa->i_null)
-    {
-        wfa->iwavefront = NULL;
-    }
-    else
-    {
-        awf_offset_t *ioffset = (awf_offset_t *)allocate_new(allocator, wv_len * sizeof(awf_offset_t));
-        if (ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)) <= 2048)
-        {
-            mram_read((__mram_ptr void const *)(wfa_m), ioffset, ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)));
-        }
-        else
-        {
-            int wavefront_segment = 2048 / sizeof(awf_offset_t);
-            for (int num_wavefronts = 0; num_wavefronts <= wv_len; num_wavefronts += wavefront_segment)
-            {
-                if (num_wavefronts + wavefront_segment <= wv_len)
-                {
-                    mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &ioffset[num_wavefronts], (wavefront_segment * sizeof(awf_offset_t)));
-                }
-                else
-                {
-                    int wv_remaining = wv_len - num_wavefronts;
-                    if (wv_remaining > 0)
-                    {
-                        mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &ioffset[num_wavefronts], ROUND_UP_MULTIPLE_8(wv_remaining * sizeof(awf_offset_t)));
-                    }
-                }
-            }
-        }
-        wfa->iwavefront = (awf_offset_t *)(ioffset - wfa->lo_base);
-        wfa_m += ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t));
-    }
-    if (wfa->d_null)
-    {
-        wfa->dwavefront = NULL;
-    }
-    else
-    {
-        awf_offset_t *doffset = (awf_offset_t *)allocate_new(allocator, wv_len * sizeof(awf_offset_t));
-        if (ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)) <= 2048)
-        {
-            mram_read((__mram_ptr void const *)(wfa_m), doffset, ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)));
-        }
-        else
-        {
-            int wavefront_segment = 2048 / sizeof(awf_offset_t);
-            for (int num_wavefronts = 0; num_wavefronts <= wv_len; num_wavefronts += wavefront_segment)
-            {
-                if (num_wavefronts + wavefront_segment <= wv_len)
-                {
-                    mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &doffset[num_wavefronts], (wavefront_segment * sizeof(awf_offset_t)));
-                }
-                else
-                {
-                    int wv_remaining = wv_len - num_wavefronts;
-                    if (wv_remaining > 0)
-                    {
-                        mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &doffset[num_wavefronts], ROUND_UP_MULTIPLE_8(wv_remaining * sizeof(awf_offset_t)));
-                    }
-                }
-            }
-        }
-        wfa->dwavefront = (awf_offset_t *)(doffset - wfa->lo_base);
-    }
-    return wfa;
+    for (int segment = 0; segment < size; segment += 2048)
+        mram_write((char *)buffer + segment, (__mram_ptr void *)(addr_m + segment), MIN(2048, size - segment));
 }
 
-void store_wfa_cmpnt_to_mram(wfa_component *wfa, uint32_t mramIdx)
+void store_wfa_backtrace_to_mram(wfa_component *wfa, uint8_t *bt, uint32_t mramIdx)
 {
     if (wfa == NULL || mramIdx == 0)
     {
         return;
     }
     uint32_t wfa_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + mramIdx;
-    mram_write(wfa, (__mram_ptr void *)(wfa_m), ROUND_UP_MULTIPLE_8(sizeof(wfa_component)));
-    wfa_m += ROUND_UP_MULTIPLE_8(sizeof(wfa_component));
-
     int wv_len = wfa->hi_base - wfa->lo_base + 1;
-    awf_offset_t *moffset = (awf_offset_t *)(wfa->mwavefront + wfa->lo_base);
-
-    if (ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)) <= 2048)
-    {
-        mram_write(moffset, (__mram_ptr void *)(wfa_m), ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)));
-    }
-    else
-    {
-        int wavefront_segment = 2048 / sizeof(awf_offset_t);
-        for (int num_wavefronts = 0; num_wavefronts <= wv_len; num_wavefronts += wavefront_segment)
-        {
-            if (num_wavefronts + wavefront_segment <= wv_len)
-            {
-                mram_write(&moffset[num_wavefronts], (__mram_ptr void *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), (wavefront_segment * sizeof(awf_offset_t)));
-            }
-            else
-            {
-                int wv_remaining = wv_len - num_wavefronts;
-                if (wv_remaining > 0)
-                {
-                    mram_write(&moffset[num_wavefronts], (__mram_ptr void *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), ROUND_UP_MULTIPLE_8(wv_remaining * sizeof(awf_offset_t)));
-                }
-            }
-        }
-    }
+    // The WRAM side of a transfer is 8-byte aligned too
+    union
+    {
+        uint64_t word;
+        int header[2];
+    } buffer;
+    buffer.header[0] = wfa->lo_base;
+    buffer.header[1] = wfa->hi_base;
+    mram_write(&buffer, (__mram_ptr void *)(wfa_m), WFA_BT_HEADER_SIZE);
+    wfa_m += WFA_BT_HEADER_SIZE;
+    write_to_mram(wfa->mwavefront + wfa->lo_base, wfa_m, ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)));
     wfa_m += ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t));
-    if (!wfa->i_null)
-    {
-        awf_offset_t *ioffset = (awf_offset_t *)(wfa->iwavefront + wfa->lo_base);
-        if (ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)) <= 2048)
-        {
-            mram_write(ioffset, (__mram_ptr void *)(wfa_m), ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)));
-        }
-        else
-        {
-            int wavefront_segment = 2048 / sizeof(awf_offset_t);
-            for (int num_wavefronts = 0; num_wavefronts <= wv_len; num_wavefronts += wavefront_segment)
-            {
-                if (num_wavefronts + wavefront_segment <= wv_len)
-                {
-                    mram_write(&ioffset[num_wavefronts], (__mram_ptr void *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), (wavefront_segment * sizeof(awf_offset_t)));
-                }
-                else
-                {
-                    int wv_remaining = wv_len - num_wavefronts;
-                    if (wv_remaining > 0)
-                    {
-                        mram_write(&ioffset[num_wavefronts], (__mram_ptr void *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), ROUND_UP_MULTIPLE_8(wv_remaining * sizeof(awf_offset_t)));
-                    }
-                }
-            }
-        }
-        wfa_m += ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t));
-    }
-
-    if (!wfa->d_null)
-    {
-        awf_offset_t *doffset = (awf_offset_t *)(wfa->dwavefront + wfa->lo_base);
-        if (ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)) <= 2048)
-        {
-            mram_write(doffset, (__mram_ptr void *)(wfa_m), ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)));
-        }
-        else
-        {
-            int wavefront_segment = 2048 / sizeof(awf_offset_t);
-            for (int num_wavefronts = 0; num_wavefronts <= wv_len; num_wavefronts += wavefront_segment)
-            {
-                if (num_wavefronts + wavefront_segment <= wv_len)
-                {
-                    mram_write(&doffset[num_wavefronts], (__mram_ptr void *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), (wavefront_segment * sizeof(awf_offset_t)));
-                }
-                else
-                {
-                    int wv_remaining = wv_len - num_wavefronts;
-                    if (wv_remaining > 0)
-                    {
-                        mram_write(&doffset[num_wavefronts], (__mram_ptr void *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), ROUND_UP_MULTIPLE_8(wv_remaining * sizeof(awf_offset_t)));
-                    }
-                }
-            }
-        }
-    }
+    write_to_mram(bt, wfa_m, ROUND_UP_MULTIPLE_8((wv_len + 1) / 2));
 }
 
-wfa_component *load_mwavefront_cmpnt_from_mram(dpu_alloc_wram_t *allocator, uint32_t mramIdx)
+void load_wfa_backtrace_from_mram(uint32_t mramIdx, int k, awf_offset_t *offset, int *bits)
 {
-    if (mramIdx == 0)
-    {
-        return NULL;
-    }
-    wfa_component *wfa = (wfa_component *)allocate_new(allocator, sizeof(wfa_component));
     uint32_t wfa_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + mramIdx;
-    mram_read((__mram_ptr void const *)(wfa_m), wfa, ROUND_UP_MULTIPLE_8(sizeof(wfa_component)));
-    int wv_len = wfa->hi_base - wfa->lo_base + 1;
-    wfa_m += ROUND_UP_MULTIPLE_8(sizeof(wfa_component));
-    awf_offset_t *moffset = (awf_offset_t *)allocate_new(allocator, wv_len * sizeof(awf_offset_t));
-    if (ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)) <= 2048)
-    {
-        mram_read((__mram_ptr void const *)(wfa_m), moffset, ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)));
-    }
-    else
-    {
-        int wavefront_segment = 2048 / sizeof(awf_offset_t);
-        for (int num_wavefronts = 0; num_wavefronts <= wv_len; num_wavefronts += wavefront_segment)
-        {
-            if (num_wavefronts + wavefront_segment <= wv_len)
-            {
-                mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &moffset[num_wavefronts], (wavefront_segment * sizeof(awf_offset_t)));
-            }
-            else
-            {
-                int wv_remaining = wv_len - num_wavefronts;
-                if (wv_remaining > 0)
-                {
-                    mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &moffset[num_wavefronts], ROUND_UP_MULTIPLE_8(wv_remaining * sizeof(awf_offset_t)));
-                }
-            }
-        }
-    }
-    wfa->mwavefront = (awf_offset_t *)(moffset - wfa->lo_base);
-    wfa_m += ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t));
-
-    wfa->iwavefront = NULL;
-
-    wfa->dwavefront = NULL;
-
-    return wfa;
+    // 8-byte aligned words holding the header, the offset and the bits of the diagonal
+    union
+    {
+        uint64_t word;
+        int header[2];
+        awf_offset_t offsets[8 / sizeof(awf_offset_t)];
+        uint8_t bits[8];
+    } buffer;
+    mram_read((__mram_ptr void const *)(wfa_m), &buffer, 8);
+    int lo = buffer.header[0];
+    int hi = buffer.header[1];
+    int idx = k - lo;
+    wfa_m += WFA_BT_HEADER_SIZE;
+    mram_read((__mram_ptr void const *)(wfa_m + ((idx * sizeof(awf_offset_t)) & ~7)), &buffer, 8);
+    *offset = buffer.offsets[idx % (8 / sizeof(awf_offset_t))];
+    wfa_m += ROUND_UP_MULTIPLE_8((hi - lo + 1) * sizeof(awf_offset_t));
+    mram_read((__mram_ptr void const *)(wfa_m + ((idx >> 1) & ~7)), &buffer, 8);
+    *bits = (buffer.bits[(idx >> 1) & 7] >> ((idx & 1) << 2)) & 15;
 }
-
-wfa_component *load_idwavefront_cmpnt_from_mram(dpu_alloc_wram_t *allocator, uint32_t mramIdx)
-{
-    if (mramIdx == 0)
-    {
-        return NULL;
-    }
-    wfa_component *wfa = (wfa_component *)allocate_new(allocator, sizeof(wfa_component));
-    uint32_t wfa_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + mramIdx;
-    mram_read((__mram_ptr void const *)(wfa_m), wfa, ROUND_UP_MULTIPLE_8(sizeof(wfa_component)));
-    int wv_len = wfa->hi_base - wfa->lo_base + 1;
-    wfa_m += ROUND_UP_MULTIPLE_8(sizeof(wfa_component));
-    wfa->mwavefront = NULL;
-    wfa_m += ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t));
-    if (wfa->i_null)
-    {
-        wfa->iwavefront = NULL;
-    }
-    else
-    {
-        awf_offset_t *ioffset = (awf_offset_t *)allocate_new(allocator, wv_len * sizeof(awf_offset_t));
-        if (ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)) <= 2048)
-        {
-            mram_read((__mram_ptr void const *)(wfa_m), ioffset, ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)));
-        }
-        else
-        {
-            int wavefront_segment = 2048 / sizeof(awf_offset_t);
-            for (int num_wavefronts = 0; num_wavefronts <= wv_len; num_wavefronts += wavefront_segment)
-            {
-                if (num_wavefronts + wavefront_segment <= wv_len)
-                {
-                    mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &ioffset[num_wavefronts], (wavefront_segment * sizeof(awf_offset_t)));
-                }
-                else
-                {
-                    int wv_remaining = wv_len - num_wavefronts;
-                    if (wv_remaining > 0)
-                    {
-                        mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &ioffset[num_wavefronts], ROUND_UP_MULTIPLE_8(wv_remaining * sizeof(awf_offset_t)));
-                    }
-                }
-            }
-        }
-        wfa->iwavefront = (awf_offset_t *)(ioffset - wfa->lo_base);
-        wfa_m += ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t));
-    }
-    if (wfa->d_null)
-    {
-        wfa->dwavefront = NULL;
-    }
-    else
-    {
-        awf_offset_t *doffset = (awf_offset_t *)allocate_new(allocator, wv_len * sizeof(awf_offset_t));
-        if (ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)) <= 2048)
-        {
-            mram_read((__mram_ptr void const *)(wfa_m), doffset, ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t)));
-        }
-        else
-        {
-            int wavefront_segment = 2048 / sizeof(awf_offset_t);
-            for (int num_wavefronts = 0; num_wavefronts <= wv_len; num_wavefronts += wavefront_segment)
-            {
-                if (num_wavefronts + wavefront_segment <= wv_len)
-                {
-                    mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &doffset[num_wavefronts], (wavefront_segment * sizeof(awf_offset_t)));
-                }
-                else
-                {
-                    int wv_remaining = wv_len - num_wavefronts;
-                    if (wv_remaining > 0)
-                    {
-                        mram_read((__mram_ptr void const *)(wfa_m + num_wavefronts * sizeof(awf_offset_t)), &doffset[num_wavefronts], ROUND_UP_MULTIPLE_8(wv_remaining * sizeof(awf_offset_t)));
-                    }
-                }
-            }
-        }
-        wfa->dwavefront = (awf_offset_t *)(doffset - wfa->lo_base);
-    }
-    return wfa;
-}
\ No newline at end of file
@@ -14,9 +14,9 @@ typedef struct dpu_alloc_mram_t
 
 void add_wfa_cmpnt_to_mram(uint32_t *mramIdx, uint32_t size, dpu_alloc_mram_t *dpu_alloc_mram);
 
-wfa_component *load_wfa_cmpnt_from_mram(dpu_alloc_wram_t *allocator, uint32_t mramIdx);
-wfa_component *load_mwavefront_cmpnt_from_mram(dpu_alloc_wram_t *allocator, uint32_t mramIdx);
-wfa_component *load_idwavefront_cmpnt_from_mram(dpu_alloc_wram_t *allocator, uint32_t mramIdx);
+// Writes the backtrace record of a score, its M offsets before the extension and the bits bt of its diagonals
+void store_wfa_backtrace_to_mram(wfa_component *wfa, uint8_t *bt, uint32_t mramIdx);
 
-void store_wfa_cmpnt_to_mram(wfa_component *wfa, uint32_t mramIdx);
+// Reads the M offset before the extension and the backtrace bits of the diagonal k from the backtrace record of a score
+void load_wfa_backtrace_from_mram(uint32_t mramIdx, int k, awf_offset_t *offset, int *bits);
 #endif
\ No newline at end of file
@@ -51,9 +51,15 @@ SOFTWARE. */
 
 #include "../common/common.h"
 #include "wfa_backtracing.h"
+#include "wfa_bialign.h"
 
 #include "dpu_allocator_wram.h"
 #include "dpu_allocator_mram.h"
+#include <barrier.h>
+#include <mutex.h>
+#include <perfcounter.h>
+#include "dpu_profile.h"
+#include "dpu_params.h"
 
 void edit_cigar_allocate(
     edit_cigar_t *edit_cigar,
@@ -65,12 +71,16 @@ void edit_cigar_allocate(
     edit_cigar->begin_offset = edit_cigar->max_operations - 1;
     edit_cigar->end_offset = edit_cigar->max_operations;
     edit_cigar->score = INT32_MIN;
+    edit_cigar->pattern_begin = 0;
+    edit_cigar->pattern_end = pattern_length;
+    edit_cigar->text_begin = 0;
+    edit_cigar->text_end = text_length;
 }
 
-void affine_wfa_reduce_wvs(wfa_component *wfa, awf_offset_t pattern_length, awf_offset_t text_length, int score)
+// WFA-adaptive, drops the diagonals of the ends of the wavefront whose distance to the end is more than max_distance_threshold above
+// the closest one
+void affine_wfa_reduce_wvs(wfa_component *wfa, int pattern_length, int text_length, int min_wavefront_length, int max_distance_threshold)
 {
-    int min_wavefront_length = 10;
-    int max_distance_threshold = 50;
     int alignment_k = AFFINE_WAVEFRONT_DIAGONAL(text_length, pattern_length);
 
     if (wfa == NULL || wfa->m_null)
@@ -112,7 +122,7 @@ void affine_wfa_reduce_wvs(wfa_component *wfa, awf_offset_t pattern_length, awf_
         wfa->klo = wfa->klo + 1;
     }
 
-    // //reduce from top
+    // reduce from top
     int bottom_limit = MAX(alignment_k + 1, wfa->klo);
     for (int k = khi; k > bottom_limit; --k)
     {
@@ -139,25 +149,217 @@ void affine_wfa_reduce_wvs(wfa_component *wfa, awf_offset_t pattern_length, awf_
         return;
     }
 }
-// insert new score
-wfa_component *allocate_new_score(dpu_alloc_wram_t *allocator, int score, int lo, int hi, int kernel, uint32_t *mramIdx, dpu_alloc_mram_t *dpu_alloc_mram)
+
+// State of the heuristic of an alignment
+typedef struct wfa_heuristic_state_t
 {
-    int wv_len = hi - lo + 1;
-    uint32_t cmpnt_size = 0;
+    int next_score;   /* Next score the heuristic is applied to */
+    int last_score;   /* Last score of a wavefront kept by the heuristic */
+    int max_sw_score; /* Best X-drop and Z-drop score of the alignment */
+    int max_sw_k;     /* Diagonal of the best score */
+} wfa_heuristic_state_t;
+
+// Distance of the diagonal k of a wavefront to the end of the alignment
+static inline int affine_wfa_distance(int k, awf_offset_t offset, int pattern_length, int text_length)
+{
+    return MAX(pattern_length - AFFINE_WAVEFRONT_V(k, offset), text_length - AFFINE_WAVEFRONT_H(k, offset));
+}
 
-    wfa_component *wfa_cmpnt = (wfa_component *)allocate_new(allocator, sizeof(wfa_component));
-    awf_offset_t *offset_ptr = (awf_offset_t *)allocate_new(allocator, (wv_len * sizeof(awf_offset_t)));
+// X-drop and Z-drop score of the diagonal k of the wavefront of score, an aligned base scores 1 as the wavefronts score a match 0
+static inline int affine_wfa_sw_score(int k, awf_offset_t offset, int score)
+{
+    return (AFFINE_WAVEFRONT_V(k, offset) + AFFINE_WAVEFRONT_H(k, offset)) / 2 - score;
+}
 
-    wfa_cmpnt->mwavefront = (awf_offset_t *)(offset_ptr - lo);
-    cmpnt_size += ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t));
-    if (kernel == 3 || kernel == 1)
+// Keeps the diagonals within [band_min_k, band_max_k] of the diagonal closest to the end
+void affine_wfa_band_wvs(wfa_component *wfa, int pattern_length, int text_length, int band_min_k, int band_max_k)
+{
+    int min_distance = affine_wfa_distance(wfa->klo, wfa->mwavefront[wfa->klo], pattern_length, text_length);
+    int min_k = wfa->klo;
+    for (int k = wfa->klo + 1; k <= wfa->khi; ++k)
     {
+        int distance = affine_wfa_distance(k, wfa->mwavefront[k], pattern_length, text_length);
+        if (distance < min_distance)
+        {
+            min_distance = distance;
+            min_k = k;
+        }
+    }
+    wfa->klo = MAX(wfa->klo, min_k + band_min_k);
+    wfa->khi = MIN(wfa->khi, min_k + band_max_k);
+}
 
-        awf_offset_t *offset_ptr = (awf_offset_t *)allocate_new(allocator, (wv_len * sizeof(awf_offset_t)));
+// Drops the diagonals of the ends of the wavefront of score whose score fell more than drop below the best one
+void affine_wfa_xdrop_wvs(wfa_component *wfa, int score, int drop, wfa_heuristic_state_t *state)
+{
+    int klo = wfa->klo;
+    int khi = wfa->khi;
+    for (int k = wfa->klo; k <= wfa->khi; ++k)
+    {
+        int sw_score = affine_wfa_sw_score(k, wfa->mwavefront[k], score);
+        if (sw_score > state->max_sw_score)
+        {
+            state->max_sw_score = sw_score;
+            state->max_sw_k = k;
+        }
+    }
+    while (wfa->klo <= wfa->khi && state->max_sw_score - affine_wfa_sw_score(wfa->klo, wfa->mwavefront[wfa->klo], score) > drop)
+        ++wfa->klo;
+    while (wfa->khi >= wfa->klo && state->max_sw_score - affine_wfa_sw_score(wfa->khi, wfa->mwavefront[wfa->khi], score) > drop)
+        --wfa->khi;
+    if (wfa->klo > wfa->khi)
+    {
+        wfa->m_null = true;
+        wfa->i_null = true;
+        wfa->d_null = true;
+        wfa->klo = klo;
+        wfa->khi = khi;
+    }
+}
+
+// Returns true when the best score of the wavefront of score fell more than drop below the best one, allowing GAP_E per diagonal
+// between them
+bool affine_wfa_zdrop(wfa_component *wfa, int score, int drop, wfa_heuristic_state_t *state)
+{
+    int cmax_sw_score = affine_wfa_sw_score(wfa->klo, wfa->mwavefront[wfa->klo], score);
+    int cmax_k = wfa->klo;
+    for (int k = wfa->klo + 1; k <= wfa->khi; ++k)
+    {
+        int sw_score = affine_wfa_sw_score(k, wfa->mwavefront[k], score);
+        if (sw_score > cmax_sw_score)
+        {
+            cmax_sw_score = sw_score;
+            cmax_k = k;
+        }
+    }
+    if (cmax_sw_score > state->max_sw_score)
+    {
+        state->max_sw_score = cmax_sw_score;
+        state->max_sw_k = cmax_k;
+        return false;
+    }
+    return state->max_sw_score - cmax_sw_score > drop + GAP_E * ABS(cmax_k - state->max_sw_k);
+}
 
-        wfa_cmpnt->dwavefront = offset_ptr - lo;
+// Applies the heuristic of the launch to the wavefront of score every HEURISTIC.steps scores, returns true when the alignment is
+// abandoned
+bool affine_wfa_heuristic(wfa_component *wfa, int pattern_length, int text_length, int score, wfa_heuristic_state_t *state)
+{
+    if (HEURISTIC.strategy == WFA_HEURISTIC_NONE)
+        return false;
+    // The next scores only depend on the wavefronts of the last MAX(MISMATCH, GAP_O + GAP_E) scores, the alignment is abandoned once
+    // the heuristic dropped all of them. Z-drop only checks a wavefront every steps scores, it drops the ones in between
+    int window = MAX(MISMATCH, GAP_O + GAP_E);
+    if (HEURISTIC.strategy == WFA_HEURISTIC_ZDROP)
+        window += HEURISTIC.steps - 1;
+    if (wfa == NULL || wfa->m_null)
+        return score - state->last_score > window;
+    if (score >= state->next_score)
+    {
+        state->next_score = score + HEURISTIC.steps;
+        switch (HEURISTIC.strategy)
+        {
+        case WFA_HEURISTIC_ADAPTIVE:
+            affine_wfa_reduce_wvs(wfa, pattern_length, text_length, HEURISTIC.min_wavefront_length, HEURISTIC.max_distance_threshold);
+            break;
+        case WFA_HEURISTIC_BANDED_ADAPTIVE:
+            affine_wfa_band_wvs(wfa, pattern_length, text_length, HEURISTIC.band_min_k, HEURISTIC.band_max_k);
+            break;
+        case WFA_HEURISTIC_XDROP:
+            affine_wfa_xdrop_wvs(wfa, score, HEURISTIC.drop, state);
+            break;
+        default:
+            if (affine_wfa_zdrop(wfa, score, HEURISTIC.drop, state))
+                return score - state->last_score > window;
+        }
+    }
+    else if (HEURISTIC.strategy == WFA_HEURISTIC_ZDROP)
+        return false;
+    if (!wfa->m_null)
+        state->last_score = score;
+    return false;
+}
+// Wavefronts of the last scores kept in the WRAM, the next score only reads the M offsets of the last max(MISMATCH, GAP_O + GAP_E)
+// scores and the I and D offsets of the last GAP_E scores, each ring has one more slot for the score being computed
+typedef struct wfa_ring_t
+{
+    int m_slots;
+    int id_slots;
+    int width;               /* Diagonals of a slot */
+    wfa_component *cmpnts;   /* m_slots components */
+    awf_offset_t *moffsets;  /* m_slots slots of M offsets */
+    awf_offset_t *idoffsets; /* id_slots slots of I offsets followed by D offsets */
+#ifdef BACKTRACE
+    uint8_t *bt; /* Backtrace bits of the score being computed */
+#endif
+} wfa_ring_t;
+
+void wfa_ring_init(wfa_ring_t *ring, dpu_alloc_wram_t *allocator, int begin_diagonals)
+{
+    ring->m_slots = MAX(MISMATCH, GAP_O + GAP_E) + 1;
+    ring->id_slots = GAP_E + 1;
+    ring->cmpnts = (wfa_component *)allocate_new(allocator, ring->m_slots * sizeof(wfa_component));
+
+    // The slots hold the widest wavefront of the max score grown from the begin_diagonals of score 0, 16 diagonals at a time, or what
+    // is left of the WRAM segment when it doesn't fit (the wavefronts of WFA-Adaptive stay narrower)
+    int block_size = 16 * (ring->m_slots + 2 * ring->id_slots) * sizeof(awf_offset_t);
+#ifdef BACKTRACE
+    block_size += 8;
+#endif
+    int blocks = (2 * MAX_SCORE + 2 + begin_diagonals + 15) / 16;
+    int free_blocks = ((int)allocator->segment_size - (int)allocator->mem_used_wram - 8) / block_size;
+    if (free_blocks <= 0)
+    {
+        printf("Out of WRAM memory\n");
+        exit(1);
+    }
+    ring->width = 16 * MIN(blocks, free_blocks);
+
+    ring->moffsets = (awf_offset_t *)allocate_new(allocator, ring->m_slots * ring->width * sizeof(awf_offset_t));
+    ring->idoffsets = (awf_offset_t *)allocate_new(allocator, 2 * ring->id_slots * ring->width * sizeof(awf_offset_t));
+#ifdef BACKTRACE
+    ring->bt = (uint8_t *)allocate_new(allocator, ring->width / 2);
+#endif
+}
+
+// Wavefront of a score still in the ring, or NULL for the scores below 0
+wfa_component *wfa_ring_get(wfa_ring_t *ring, int score)
+{
+    if (score < 0)
+        return NULL;
+    return &ring->cmpnts[score % ring->m_slots];
+}
+
+// Marks the wavefront of a score as null
+void wfa_ring_null_score(wfa_ring_t *ring, int score)
+{
+    wfa_component *wfa_cmpnt = wfa_ring_get(ring, score);
+    wfa_cmpnt->mwavefront = NULL;
+    wfa_cmpnt->iwavefront = NULL;
+    wfa_cmpnt->dwavefront = NULL;
+    wfa_cmpnt->m_null = true;
+    wfa_cmpnt->i_null = true;
+    wfa_cmpnt->d_null = true;
+}
+
+// insert new score, it takes the slots of the score that is no longer read
+wfa_component *allocate_new_score(wfa_ring_t *ring, int score, int lo, int hi, int kernel)
+{
+    int wv_len = hi - lo + 1;
+    if (wv_len > ring->width)
+    {
+        printf("Out of WRAM memory %d %d\n", wv_len, ring->width);
+        exit(1);
+    }
+
+    wfa_component *wfa_cmpnt = wfa_ring_get(ring, score);
+    awf_offset_t *id_slot = ring->idoffsets + 2 * (score % ring->id_slots) * ring->width;
+
+    wfa_cmpnt->mwavefront = ring->moffsets + (score % ring->m_slots) * ring->width - lo;
+    if (kernel == 3 || kernel == 1)
+    {
+        wfa_cmpnt->dwavefront = id_slot + ring->width - lo;
         wfa_cmpnt->d_null = false;
-        cmpnt_size += ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t));
     }
     else
     {
@@ -166,12 +368,8 @@ wfa_component *allocate_new_score(dpu_alloc_wram_t *allocator, int score, int lo
     }
     if (kernel == 3 || kernel == 2)
     {
-
-        awf_offset_t *offset_ptr = (awf_offset_t *)allocate_new(allocator, (wv_len * sizeof(awf_offset_t)));
-
-        wfa_cmpnt->iwavefront = offset_ptr - lo;
+        wfa_cmpnt->iwavefront = id_slot - lo;
         wfa_cmpnt->i_null = false;
-        cmpnt_size += ROUND_UP_MULTIPLE_8(wv_len * sizeof(awf_offset_t));
     }
     else
     {
@@ -184,17 +382,54 @@ wfa_component *allocate_new_score(dpu_alloc_wram_t *allocator, int score, int lo
     wfa_cmpnt->khi = hi;
     wfa_cmpnt->lo_base = lo;
     wfa_cmpnt->hi_base = hi;
-    cmpnt_size += ROUND_UP_MULTIPLE_8(sizeof(wfa_component));
-    add_wfa_cmpnt_to_mram(mramIdx, cmpnt_size, dpu_alloc_mram);
     return wfa_cmpnt;
 }
 
-// wavefront extend matching
-void affine_wfa_extend(wfa_component *wfa, char *pattern, char *text, awf_offset_t pattern_len, awf_offset_t text_len, int score)
+// 16 bases of a packed sequence starting from base i
+static inline uint32_t packed_bases16(const uint32_t *bases, int i)
+{
+    int shift = (i & 15) << 1;
+    uint32_t word = bases[i >> 4] >> shift;
+    if (shift != 0)
+        word |= bases[(i >> 4) + 1] << (32 - shift);
+    return word;
+}
+
+// 32 bits of the N-mask of a packed sequence starting from base i
+static inline uint32_t packed_mask32(const uint32_t *mask, int i)
+{
+    int shift = i & 31;
+    uint32_t word = mask[i >> 5] >> shift;
+    if (shift != 0)
+        word |= mask[(i >> 5) + 1] << (32 - shift);
+    return word;
+}
+
+// Whether a packed sequence has N bases, the extend only compares the N-masks when one of the sequences has some
+bool packed_has_n(const char *sequence, int length)
+{
+    const uint32_t *mask = (const uint32_t *)(sequence + PACKED_BASES_SIZE(length));
+    uint32_t n = 0;
+    for (int i = 0; i < PACKED_MASK_SIZE(length) / 4; ++i)
+        n |= mask[i];
+    return n != 0;
+}
+
+// wavefront extend matching, the packed sequences are compared 16 bases at a time. The first comparison of a diagonal stops at a
+// 16-base boundary of the pattern, so that the next words of the pattern are aligned loads and only the text words are shifted
+void affine_wfa_extend(wfa_component *wfa, const wfa_sequences_t *seqs)
 {
     if (wfa == NULL || wfa->m_null)
         return;
 
+    const uint32_t *pattern_bases = (const uint32_t *)seqs->pattern;
+    const uint32_t *text_bases = (const uint32_t *)seqs->text;
+    const uint32_t *pattern_mask = (const uint32_t *)seqs->pattern_mask;
+    const uint32_t *text_mask = (const uint32_t *)seqs->text_mask;
+    int pattern_len = seqs->pattern_length;
+    int text_len = seqs->text_length;
+    bool has_n = seqs->has_n;
+
     int klo = wfa->klo;
     for (int k = klo; k <= wfa->khi; ++k)
     {
@@ -204,42 +439,84 @@ void affine_wfa_extend(wfa_component *wfa, char *pattern, char *text, awf_offset
 
         int v = moffset - k;
         int h = moffset;
+        if (v < 0 || h < 0)
+            continue;
 
+        // Bases left on the diagonal
+        int end = MIN(pattern_len - v, text_len - h);
         int count = 0;
-        while ((v < pattern_len && h < text_len && v >= 0 && h >= 0) && pattern[v++] == text[h++])
+        while (count < end)
         {
-            ++count;
+            int p = seqs->pattern_begin + v + count;
+            int t = seqs->text_begin + h + count;
+            // Bases to the next 16-base boundary of the pattern, the bits above them are not compared
+            int step = 16 - (p & 15);
+            // Matching bases XOR to 0, the lowest set bit gives the first mismatch
+            uint32_t diff = (pattern_bases[p >> 4] >> ((p & 15) << 1)) ^ packed_bases16(text_bases, t);
+            int matches = MIN((diff == 0) ? 16 : (__builtin_ctz(diff) >> 1), step);
+            if (has_n)
+                matches = MIN(matches, __builtin_ctz((packed_mask32(pattern_mask, p) ^ packed_mask32(text_mask, t)) | 0x10000));
+            count += matches;
+            if (matches < step)
+                break;
         }
-        wfa->mwavefront[k] += count;
+        wfa->mwavefront[k] += MIN(count, end);
     }
 }
-// end reached
-bool affine_wfa_end_reached(wfa_component *wfa, awf_offset_t pattern_len, awf_offset_t text_len, int score)
+// end reached, in the end component of the alignment, on the diagonal of the last cell or on the diagonals of the free ends of the span.
+// alignment_k is set to the diagonal the alignment ends on
+bool affine_wfa_end_reached(wfa_component *wfa, const wfa_sequences_t *seqs, backtrace_wavefront_type component_end, int *alignment_k)
 {
 
-    if (wfa == NULL || wfa->m_null)
+    if (wfa == NULL)
         return false;
 
-    int alignment_k =
-        AFFINE_WAVEFRONT_DIAGONAL(text_len, pattern_len);
-    int alignment_offset =
-        AFFINE_WAVEFRONT_OFFSET(text_len, pattern_len);
+    int end_k =
+        AFFINE_WAVEFRONT_DIAGONAL(seqs->text_length, seqs->pattern_length);
+    int end_offset =
+        AFFINE_WAVEFRONT_OFFSET(seqs->text_length, seqs->pattern_length);
 
-    if (wfa->klo <= alignment_k && wfa->khi >= alignment_k)
+    awf_offset_t *wavefront = (component_end == backtrace_wavefront_M) ? (wfa->m_null ? NULL : wfa->mwavefront) : (component_end == backtrace_wavefront_I) ? (wfa->i_null ? NULL : wfa->iwavefront) : (wfa->d_null ? NULL : wfa->dwavefront);
+    if (wavefront == NULL)
+        return false;
+
+    if (wfa->klo <= end_k && wfa->khi >= end_k && wavefront[end_k] >= end_offset)
     {
-        int offset = wfa->mwavefront[alignment_k];
+        *alignment_k = end_k;
+        return true;
+    }
 
-        if (offset >= alignment_offset)
+    // The diagonals above end the alignment on the last column before the free end of the pattern, the ones below on the last row before
+    // the free end of the text
+    for (int k = MAX(wfa->klo, end_k + 1); k <= MIN(wfa->khi, end_k + seqs->pattern_end_free); ++k)
+    {
+        if (wavefront[k] >= seqs->text_length)
+        {
+            *alignment_k = k;
             return true;
+        }
+    }
+    for (int k = MIN(wfa->khi, end_k - 1); k >= MAX(wfa->klo, end_k - seqs->text_end_free); --k)
+    {
+        if (AFFINE_WAVEFRONT_V(k, wavefront[k]) >= seqs->pattern_length)
+        {
+            *alignment_k = k;
+            return true;
+        }
     }
 
     return false;
 }
-void affine_wfa_compute_offsets(wfa_component *wfa, wfa_set wfa_set, int lo, int hi, int score, int kernel)
+void affine_wfa_compute_offsets(wfa_component *wfa, wfa_set wfa_set, int lo, int hi, int score, int kernel, uint8_t *bt)
 {
+#ifdef BACKTRACE
+    memset(bt, 0, ROUND_UP_MULTIPLE_8((hi - lo + 2) / 2));
+#endif
     // Compute score wavefronts (core)
     for (int k = lo; k <= hi; ++k)
     {
+        // Backtrace bits, a gap is extended rather than opened on a tie
+        int bits = 0;
         awf_offset_t ins = -10;
         if (!wfa_set.m_o_null || !wfa_set.i_e_null)
         {
@@ -251,6 +528,7 @@ void affine_wfa_compute_offsets(wfa_component *wfa, wfa_set wfa_set, int lo, int
             else
                 ins = MAX(ins_g, ins_i) + 1;
             wfa->iwavefront[k] = ins;
+            bits |= (ins_i >= ins_g) ? WFA_BT_I_EXT : 0;
         }
         awf_offset_t del = -10;
         if (!wfa_set.m_o_null || !wfa_set.d_e_null)
@@ -261,6 +539,7 @@ void affine_wfa_compute_offsets(wfa_component *wfa, wfa_set wfa_set, int lo, int
 
             del = MAX(del_g, del_d);
             wfa->dwavefront[k] = del;
+            bits |= (del_d >= del_g) ? WFA_BT_D_EXT : 0;
         }
         // Update M
         awf_offset_t sub = -10;
@@ -269,10 +548,15 @@ void affine_wfa_compute_offsets(wfa_component *wfa, wfa_set wfa_set, int lo, int
 
         awf_offset_t new = MAX(sub, ins);
         wfa->mwavefront[k] = MAX(del, new);
+#ifdef BACKTRACE
+        // The backtrace takes a deletion before an insertion before a mismatch
+        bits |= (wfa->mwavefront[k] == del) ? WFA_BT_M_D : (wfa->mwavefront[k] == ins) ? WFA_BT_M_I : WFA_BT_M_X;
+        bt[(k - lo) >> 1] |= bits << (((k - lo) & 1) << 2);
+#endif
     }
 }
 
-wfa_component *affine_wfa_compute_next(int score, uint32_t *mramIdx, dpu_alloc_wram_t *alloc_obj, dpu_alloc_mram_t *dpu_alloc_mram)
+wfa_component *affine_wfa_compute_next(int score, uint32_t *mramIdx, wfa_ring_t *ring, dpu_alloc_mram_t *dpu_alloc_mram)
 {
     wfa_set wfa_set;
 
@@ -281,9 +565,9 @@ wfa_component *affine_wfa_compute_next(int score, uint32_t *mramIdx, dpu_alloc_w
     int o_score = score - GAP_O - GAP_E;
     int e_score = score - GAP_E;
 
-    wfa_component *wfa_mismatch = (mismatch_score < 0 || mramIdx[mismatch_score] == 0) ? NULL : load_mwavefront_cmpnt_from_mram(alloc_obj, mramIdx[mismatch_score]);
-    wfa_component *wfa_o_score = (o_score < 0 || mramIdx[o_score] == 0) ? NULL : load_mwavefront_cmpnt_from_mram(alloc_obj, mramIdx[o_score]);
-    wfa_component *wfa_e_score = (e_score < 0 || mramIdx[e_score] == 0) ? NULL : load_idwavefront_cmpnt_from_mram(alloc_obj, mramIdx[e_score]);
+    wfa_component *wfa_mismatch = wfa_ring_get(ring, mismatch_score);
+    wfa_component *wfa_o_score = wfa_ring_get(ring, o_score);
+    wfa_component *wfa_e_score = wfa_ring_get(ring, e_score);
 
     // is null?
     wfa_set.m_sub_null = ((mismatch_score < 0) || (wfa_mismatch == NULL) || (wfa_mismatch->m_null));
@@ -298,7 +582,10 @@ wfa_component *affine_wfa_compute_next(int score, uint32_t *mramIdx, dpu_alloc_w
     if (wfa_set.m_sub_null && (wfa_set.i_out_null && wfa_set.d_out_null))
     {
         //  if the wavefront is null store 0 in the mram idx
+#ifdef BACKTRACE
         mramIdx[score] = 0;
+#endif
+        wfa_ring_null_score(ring, score);
         return NULL;
     }
 
@@ -347,69 +634,228 @@ wfa_component *affine_wfa_compute_next(int score, uint32_t *mramIdx, dpu_alloc_w
     // Compute WF
     int kernel = ((!wfa_set.i_out_null) << 1) | (!wfa_set.d_out_null);
 
-    wfa_component *wfa = allocate_new_score(alloc_obj, score, lo, hi, kernel, &mramIdx[score], dpu_alloc_mram);
+    wfa_component *wfa = allocate_new_score(ring, score, lo, hi, kernel);
 
-    affine_wfa_compute_offsets(wfa, wfa_set, lo, hi, score, kernel);
+#ifdef BACKTRACE
+    affine_wfa_compute_offsets(wfa, wfa_set, lo, hi, score, kernel, ring->bt);
+    // The backtrace only needs the M offsets before the extension and the bits of their sources
+    add_wfa_cmpnt_to_mram(&mramIdx[score], WFA_BT_RECORD_SIZE(hi - lo + 1), dpu_alloc_mram);
+    store_wfa_backtrace_to_mram(wfa, ring->bt, mramIdx[score]);
+#else
+    affine_wfa_compute_offsets(wfa, wfa_set, lo, hi, score, kernel, NULL);
+#endif
     return wfa;
 }
 
-void affine_wfa_compute(dpu_alloc_wram_t *dpu_alloc_wram, edit_cigar_t *cigar, char *pattern, char *text, int pattern_length, int text_length, dpu_alloc_mram_t *dpu_alloc_mram)
+wfa_sequences_t wfa_sequences(char *pattern, int pattern_length, char *text, int text_length)
 {
+    wfa_sequences_t seqs;
+    seqs.pattern = pattern;
+    seqs.pattern_mask = pattern + PACKED_BASES_SIZE(pattern_length);
+    seqs.text = text;
+    seqs.text_mask = text + PACKED_BASES_SIZE(text_length);
+    seqs.pattern_begin = 0;
+    seqs.text_begin = 0;
+    seqs.pattern_length = pattern_length;
+    seqs.text_length = text_length;
+    // Bases of the ends left out for free by the span of the launch
+    bool ends_free = SPAN.mode == SPAN_ENDS_FREE;
+    seqs.pattern_begin_free = ends_free ? MIN(SPAN.pattern_begin_free, pattern_length) : 0;
+    seqs.pattern_end_free = ends_free ? MIN(SPAN.pattern_end_free, pattern_length) : 0;
+    seqs.text_begin_free = ends_free ? MIN(SPAN.text_begin_free, text_length) : 0;
+    seqs.text_end_free = ends_free ? MIN(SPAN.text_end_free, text_length) : 0;
+    seqs.has_n = packed_has_n(pattern, pattern_length) || packed_has_n(text, text_length);
+    return seqs;
+}
 
-    wfa_component *wfa_score;
+int affine_wfa_align(dpu_alloc_wram_t *dpu_alloc_wram, edit_cigar_t *cigar, const wfa_sequences_t *seqs, backtrace_wavefront_type component_begin,
+                     backtrace_wavefront_type component_end, int max_score, dpu_alloc_mram_t *dpu_alloc_mram)
+{
 
-    // MRAM base address for every WFA components
-    uint32_t *wfa_mramIdx = (uint32_t *)allocate_new(dpu_alloc_wram, (MAX_SCORE + 1) * sizeof(uint32_t));
+    wfa_component *wfa_score;
+    // The WRAM and the MRAM of the alignment are released when it returns
+    char *wram_ptr = dpu_alloc_wram->CUR_PTR_WRAM;
+    uint32_t mem_used_wram = dpu_alloc_wram->mem_used_wram;
+    uint32_t mram_ptr = dpu_alloc_mram->CUR_PTR_MRAM;
+    uint32_t mem_used_mram = dpu_alloc_mram->mem_used_mram;
 
-    wfa_score = allocate_new_score(dpu_alloc_wram, 0, 0, 0, 0, &(wfa_mramIdx[0]), dpu_alloc_mram);
+#ifdef BACKTRACE
+    // MRAM base address of the backtrace record of every score
+    uint32_t *wfa_mramIdx = (uint32_t *)allocate_new(dpu_alloc_wram, (max_score + 1) * sizeof(uint32_t));
+#else
+    uint32_t *wfa_mramIdx = NULL;
+#endif
 
-    wfa_score->mwavefront[0] = 0;
+    // The wavefronts are computed in the WRAM, without BACKTRACE the alignment doesn't access the MRAM
+    wfa_ring_t ring;
+    wfa_ring_init(&ring, dpu_alloc_wram, seqs->pattern_begin_free + seqs->text_begin_free + 1);
 
-    dpu_alloc_wram->WFA_PTR_WRAM = dpu_alloc_wram->CUR_PTR_WRAM;
-    uint32_t mem_used_wram_old = dpu_alloc_wram->mem_used_wram;
+    // An alignment that begins in a gap starts with the gap already open, one that begins in M starts on the diagonals of the free begins
+    // of the span, the ones above 0 on the first row and the ones below on the first column
+    wfa_score = allocate_new_score(&ring, 0, -seqs->pattern_begin_free, seqs->text_begin_free,
+                                   (component_begin == backtrace_wavefront_I) ? 2 : (component_begin == backtrace_wavefront_D) ? 1 : 0);
+    if (component_begin == backtrace_wavefront_M)
+    {
+        for (int k = -seqs->pattern_begin_free; k <= seqs->text_begin_free; ++k)
+            wfa_score->mwavefront[k] = MAX(k, 0);
+    }
+    else
+    {
+        wfa_score->m_null = true;
+        wfa_score->mwavefront[0] = AFFINE_WAVEFRONT_OFFSET_NULL;
+        if (component_begin == backtrace_wavefront_I)
+            wfa_score->iwavefront[0] = 0;
+        else
+            wfa_score->dwavefront[0] = 0;
+    }
+#ifdef BACKTRACE
+    // The backtrace stops at score 0, it has no record
+    wfa_mramIdx[0] = 0;
+#endif
 
+    wfa_heuristic_state_t heuristic = {0, 0, 0, 0};
     int score = 0;
     while (true)
     {
 
-        affine_wfa_extend(wfa_score, pattern, text, pattern_length, text_length, score);
+        affine_wfa_extend(wfa_score, seqs);
 
-#ifdef REDUCE
-        affine_wfa_reduce_wvs(wfa_score, pattern_length, text_length, score);
+        int alignment_k;
+        if (affine_wfa_end_reached(wfa_score, seqs, component_end, &alignment_k))
+        {
+            // The last cell of the alignment, on the last row or column
+            int pattern_end = MIN(seqs->pattern_length, seqs->text_length - alignment_k);
+            cigar->pattern_end = seqs->pattern_begin + pattern_end;
+            cigar->text_end = seqs->text_begin + pattern_end + alignment_k;
+#ifdef BACKTRACE
+            awf_offset_t *wavefront = (component_end == backtrace_wavefront_M) ? wfa_score->mwavefront : (component_end == backtrace_wavefront_I) ? wfa_score->iwavefront : wfa_score->dwavefront;
+            affine_wavefronts_backtrace(wfa_mramIdx, cigar, seqs, score, alignment_k, wavefront[alignment_k], component_end);
+#else
+            // The begin of the alignment is unknown without the backtrace when the begin of a sequence is free
+            if (seqs->pattern_begin_free > 0)
+                cigar->pattern_begin = -1;
+            if (seqs->text_begin_free > 0)
+                cigar->text_begin = -1;
 #endif
+            break;
+        }
 
-        if (affine_wfa_end_reached(wfa_score, pattern_length, text_length, score))
+        // An alignment abandoned by the heuristic is reported above the max score
+        if (affine_wfa_heuristic(wfa_score, seqs->pattern_length, seqs->text_length, score, &heuristic))
         {
+            score = max_score + 1;
+            break;
+        }
+
+        ++score;
+        if (score > max_score)
+            break;
+        wfa_score = affine_wfa_compute_next(score, wfa_mramIdx, &ring, dpu_alloc_mram);
+    }
+
+    dpu_alloc_wram->CUR_PTR_WRAM = wram_ptr;
+    dpu_alloc_wram->mem_used_wram = mem_used_wram;
+    dpu_alloc_mram->CUR_PTR_MRAM = mram_ptr;
+    dpu_alloc_mram->mem_used_mram = mem_used_mram;
+    return score;
+}
+
+void affine_wfa_compute(dpu_alloc_wram_t *dpu_alloc_wram, edit_cigar_t *cigar, char *pattern, char *text, int pattern_length, int text_length, dpu_alloc_mram_t *dpu_alloc_mram)
+{
+    wfa_sequences_t seqs = wfa_sequences(pattern, pattern_length, text, text_length);
+#if defined(BACKTRACE) && defined(BIWFA)
+    cigar->score = wfa_bialign(dpu_alloc_wram, cigar, &seqs, dpu_alloc_mram);
+    // The subproblems set the span of their own alignments, a BiWFA alignment is global
+    cigar->pattern_begin = 0;
+    cigar->pattern_end = pattern_length;
+    cigar->text_begin = 0;
+    cigar->text_end = text_length;
+#else
+    cigar->score = affine_wfa_align(dpu_alloc_wram, cigar, &seqs, backtrace_wavefront_M, backtrace_wavefront_M, MAX_SCORE, dpu_alloc_mram);
+#endif
 #ifdef BACKTRACE
-            store_wfa_cmpnt_to_mram(wfa_score, wfa_mramIdx[score]);
-            dpu_alloc_wram->CUR_PTR_WRAM = dpu_alloc_wram->WFA_PTR_WRAM;
-            dpu_alloc_wram->mem_used_wram = mem_used_wram_old;
-            affine_wavefronts_backtrace(wfa_mramIdx, cigar, pattern, pattern_length, text, text_length, score, dpu_alloc_wram);
+    if (cigar->score <= MAX_SCORE)
+        ++(cigar->begin_offset); // Set CIGAR length
 #endif
-            cigar->score = score;
-            return;
-        }
+}
 
-        store_wfa_cmpnt_to_mram(wfa_score, wfa_mramIdx[score]);
+// Reads a packed sequence from the MRAM, DMA transfers must be less than 2048
+void read_packed_sequence(uint32_t sequence_m, char *sequence, int length)
+{
+    int size = PACKED_SIZE(length);
+    for (int segment = 0; segment < size; segment += 2048)
+        mram_read((__mram_ptr void const *)(sequence_m + segment), &sequence[segment], MIN(2048, size - segment));
+}
 
-        // reset wram after every iteration
-        dpu_alloc_wram->CUR_PTR_WRAM = dpu_alloc_wram->WFA_PTR_WRAM;
-        dpu_alloc_wram->mem_used_wram = mem_used_wram_old;
+// Index of the next read of the batch to align, shared by the tasklets
+uint32_t next_read;
+MUTEX_INIT(next_read_mutex);
+// Offset of the next CIGAR in the CIGARs of the batch, shared by the tasklets
+uint32_t next_cigar;
+MUTEX_INIT(next_cigar_mutex);
+BARRIER_INIT(start_barrier, NR_TASKLETS);
 
-        ++score;
-        if (score > MAX_SCORE)
-        {
-            cigar->score = score;
-            return;
-        }
-        wfa_score = affine_wfa_compute_next(score, wfa_mramIdx, dpu_alloc_wram, dpu_alloc_mram);
+// Parameters of the current launch
+DPUParams dpu_params;
+
+// Statistics of the tasklets of the current launch
+tasklet_stats_t tasklet_stats[NR_TASKLETS];
+
+// Claims the next read of the batch, all the reads are claimed once it returns nb_reads_per_dpu or more
+uint32_t claim_read()
+{
+    mutex_lock(next_read_mutex);
+    uint32_t read_idx = next_read++;
+    mutex_unlock(next_read_mutex);
+    return read_idx;
+}
+
+#ifdef BACKTRACE
+// Claims size bytes of the CIGARs of the batch, returns their offset
+uint32_t claim_cigar(uint32_t size)
+{
+    mutex_lock(next_cigar_mutex);
+    uint32_t cigar_offset = next_cigar;
+    next_cigar += ROUND_UP_MULTIPLE_8(size);
+    mutex_unlock(next_cigar_mutex);
+    return cigar_offset;
+}
+
+// Replaces the operations of the alignment by their runs at the beginning of its operations buffer, returns the number of runs.
+// A run is written after the operations it encodes are read, and before the operations of the next runs
+uint32_t cigar_encode(edit_cigar_t *cigar)
+{
+    uint8_t *runs = (uint8_t *)cigar->operations;
+    uint32_t nb_runs = 0;
+    int i = cigar->begin_offset;
+    while (i < cigar->end_offset)
+    {
+        char op = cigar->operations[i];
+        int length = 1;
+        while (i + length < cigar->end_offset && cigar->operations[i + length] == op && length < CIGAR_RUN_MAX)
+            ++length;
+        runs[nb_runs++] = CIGAR_RUN(op, length);
+        i += length;
     }
+    return nb_runs;
 }
 
+// Writes the CIGAR of the alignment run-length encoded after the CIGARs of the previous pairs, DMA transfers must be less than 2048
+void store_cigar(edit_cigar_t *cigar, uint32_t cigars_m, result_t *result)
+{
+    uint32_t size = cigar_encode(cigar);
+    result->cigar_offset = claim_cigar(size);
+    result->cigar_length = size;
+    for (uint32_t segment = 0; segment < size; segment += 2048)
+        mram_write(&cigar->operations[segment], (__mram_ptr void *)(cigars_m + result->cigar_offset + segment), MIN(2048, ROUND_UP_MULTIPLE_8(size - segment)));
+}
+#endif
+
 int main()
 {
     mem_reset();
     uint32_t tasklet_id = me();
+    memset(&tasklet_stats[tasklet_id], 0, sizeof(tasklet_stats_t));
 
     dpu_alloc_wram_t dpu_alloc_wram;
     dpu_alloc_mram_t dpu_alloc_mram;
@@ -423,120 +869,88 @@ int main()
     if (nb_reads_per_dpu <= 0)
         return 0;
 
-    int nb_reads_per_tasklets = (((nb_reads_per_dpu + NR_TASKLETS) / NR_TASKLETS));
+    // Tasklet 0 shares the parameters of the launch and resets the read and CIGAR counters of the previous launch and the cycle counter
+    if (tasklet_id == 0)
+    {
+        dpu_params = params_w;
+        next_read = 0;
+        next_cigar = 0;
+        perfcounter_config(COUNT_CYCLES, true);
+    }
+    barrier_wait(&start_barrier);
+
     dpu_alloc_wram = init_dpu_alloc_wram(WRAM_SEGMENT);
 
     // Divide MRAM segments equally between tasklets
-    dpu_alloc_mram.segment_size = ROUND_UP_MULTIPLE_8((64000000 - params_w.mramTotalAllocated) / NR_TASKLETS);
+    dpu_alloc_mram.segment_size = ROUND_UP_MULTIPLE_8((MRAM_HEAP_SIZE - params_w.mramTotalAllocated) / NR_TASKLETS);
     dpu_alloc_mram.HEAD_PTR_MRAM = ROUND_UP_MULTIPLE_8(dpu_alloc_mram.segment_size * tasklet_id + params_w.mramTotalAllocated);
     dpu_alloc_mram.CUR_PTR_MRAM = dpu_alloc_mram.HEAD_PTR_MRAM;
     dpu_alloc_mram.mem_used_mram = 0;
 
-    uint32_t dpuRequests_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuRequests_m;
-    uint32_t dpuResults_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuResults_m;
-    uint32_t dpuPatterns_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuPatterns_m;
-    uint32_t dpuTexts_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuTexts_m;
+    // Base address of the MRAM region holding the batch
+    uint32_t dpuBuffer_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuActiveBuffer * params_w.dpuBufferSize;
+    uint32_t dpuRequests_m = dpuBuffer_m + params_w.dpuRequests_m;
+    uint32_t dpuResults_m = dpuBuffer_m + params_w.dpuResults_m;
+    uint32_t dpuSequences_m = dpuBuffer_m + params_w.dpuSequences_m;
 #ifdef BACKTRACE
-    uint32_t dpuOperations_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuOperations_m;
+    uint32_t dpuOperations_m = dpuBuffer_m + params_w.dpuOperations_m;
 #endif
-    for (int read_nb = 0; read_nb < nb_reads_per_tasklets; ++read_nb)
+    // The tasklets claim the reads one at a time, so a divergent pair only delays the tasklet aligning it
+    uint64_t tasklet_nb_reads = 0;
+    uint32_t read_idx;
+    while ((read_idx = claim_read()) < nb_reads_per_dpu)
     {
+#ifdef PROFILE
+        perfcounter_t pair_start = perfcounter_get();
+#endif
         request_t *request_w = (request_t *)allocate_new(&dpu_alloc_wram, (sizeof(request_t)));
         result_t *result_w = (result_t *)allocate_new(&dpu_alloc_wram, (sizeof(result_t)));
 
         edit_cigar_t *cigar;
         cigar = (edit_cigar_t *)allocate_new(&dpu_alloc_wram, sizeof(edit_cigar_t));
 
-        if (read_nb + tasklet_id * nb_reads_per_tasklets < nb_reads_per_dpu)
-        {
-            mram_read((__mram_ptr void const *)(dpuRequests_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (sizeof(request_t))), request_w, ROUND_UP_MULTIPLE_8(sizeof(request_t)));
-            char *pattern = (char *)allocate_new(&dpu_alloc_wram, ROUND_UP_MULTIPLE_8(request_w->pattern_len));
-            char *text = (char *)allocate_new(&dpu_alloc_wram, ROUND_UP_MULTIPLE_8(request_w->text_len));
-
-            //  DMA transfers can't be of size grater than 2048
-            if (ROUND_UP_MULTIPLE_8(request_w->pattern_len) <= 2048)
-            {
-                mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE)), pattern, ROUND_UP_MULTIPLE_8(request_w->pattern_len));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(request_w->pattern_len); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(request_w->pattern_len))
-                    {
-                        mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(pattern[segment_size]), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(request_w->pattern_len) - segment_size;
-                        mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(pattern[segment_size]), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
-
-            if (ROUND_UP_MULTIPLE_8(request_w->text_len) <= 2048)
-            {
-                mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE)), text, ROUND_UP_MULTIPLE_8(request_w->text_len));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(request_w->text_len); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(request_w->text_len))
-                    {
-                        mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(text[segment_size]), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(request_w->text_len) - segment_size;
-                        mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(text[segment_size]), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
-            edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len, &dpu_alloc_wram);
+        mram_read((__mram_ptr void const *)(dpuRequests_m + read_idx * (sizeof(request_t))), request_w, ROUND_UP_MULTIPLE_8(sizeof(request_t)));
+        // Packed sequences, 8 more bytes for the word accesses past their end
+        char *pattern = (char *)allocate_new(&dpu_alloc_wram, PACKED_SIZE(request_w->pattern_len) + 8);
+        char *text = (char *)allocate_new(&dpu_alloc_wram, PACKED_SIZE(request_w->text_len) + 8);
+
+        // The packed text follows the packed pattern
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset, pattern, request_w->pattern_len);
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset + PACKED_SIZE(request_w->pattern_len), text, request_w->text_len);
+        edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len, &dpu_alloc_wram);
 
 #ifdef BACKTRACE
-            cigar->operations = (char *)allocate_new(&dpu_alloc_wram, 2 * READ_SIZE);
-            // Initialize the operations memory
-            memset(cigar->operations, 'M', 2 * READ_SIZE);
+        cigar->operations = (char *)allocate_new(&dpu_alloc_wram, 2 * READ_SIZE);
+        // Initialize the operations memory
+        memset(cigar->operations, 'M', 2 * READ_SIZE);
 #endif
 
-            affine_wfa_compute(&dpu_alloc_wram, cigar, pattern, text, request_w->pattern_len, request_w->text_len, &dpu_alloc_mram);
+        affine_wfa_compute(&dpu_alloc_wram, cigar, pattern, text, request_w->pattern_len, request_w->text_len, &dpu_alloc_mram);
 
-            result_w->idx = request_w->idx;
+        result_w->idx = request_w->idx;
 #ifdef BACKTRACE
-            if (ROUND_UP_MULTIPLE_8(cigar->max_operations) <= 2048)
-            {
-                mram_write((cigar->operations), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE)), ROUND_UP_MULTIPLE_8(cigar->max_operations));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(cigar->max_operations); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(cigar->max_operations))
-                    {
-                        mram_write(&(cigar->operations[segment_size]), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE) + segment_size), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(cigar->max_operations) - segment_size;
-                        mram_write(&(cigar->operations[segment_size]), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE) + segment_size), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
+        store_cigar(cigar, dpuOperations_m, result_w);
 #endif
-            result_w->score = cigar->score;
-            result_w->max_operations = cigar->max_operations;
-            result_w->begin_offset = cigar->begin_offset;
-            result_w->end_offset = cigar->end_offset;
-
-            mram_write(result_w, (__mram_ptr void *)(dpuResults_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (sizeof(result_t))), sizeof(result_t));
-        }
+        result_w->score = cigar->score;
+        result_w->pattern_begin = cigar->pattern_begin;
+        result_w->pattern_end = cigar->pattern_end;
+        result_w->text_begin = cigar->text_begin;
+        result_w->text_end = cigar->text_end;
+
+#ifdef PROFILE
+        result_w->cycles = perfcounter_get() - pair_start;
+#endif
+        mram_write(result_w, (__mram_ptr void *)(dpuResults_m + read_idx * (sizeof(result_t))), sizeof(result_t));
+        ++tasklet_nb_reads;
 
         // reset WRAM and MRAM segments after every read pair alignment
         reset_dpu_alloc_wram(&dpu_alloc_wram);
         dpu_alloc_mram.CUR_PTR_MRAM = dpu_alloc_mram.HEAD_PTR_MRAM;
         dpu_alloc_mram.mem_used_mram = 0;
     }
+    // Number of reads aligned by the tasklet and cycles until it finished
+    tasklet_stats[tasklet_id].nb_reads = tasklet_nb_reads;
+    tasklet_stats[tasklet_id].cycles = perfcounter_get();
+    mram_write(&tasklet_stats[tasklet_id], (__mram_ptr void *)(dpuBuffer_m + params_w.dpuTaskletStats_m + tasklet_id * sizeof(tasklet_stats_t)), sizeof(tasklet_stats_t));
     return 0;
 }
\ No newline at end of file
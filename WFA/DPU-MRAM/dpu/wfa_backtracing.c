@@ -29,6 +29,7 @@
  */
 
 #include "wfa_backtracing.h"
+#include "dpu_params.h"
 
 /*
  * Backtrace Detect Limits
@@ -67,110 +68,11 @@ void affine_wavefronts_offset_add_trailing_gap(
   }
   edit_cigar->begin_offset = op_sentinel;
 }
-/*
- * Backtrace Paths Offsets
- */
-awf_offset_t backtrace_wavefront_trace_deletion_open_offset(
-    wfa_component *wfa,
-    int score,
-    int k,
-    awf_offset_t offset)
-{
-  if (score < 0)
-    return AFFINE_WAVEFRONT_OFFSET_NULL;
-  if (wfa != NULL &&
-      wfa->klo <= k + 1 &&
-      k + 1 <= wfa->khi)
-  {
-    return wfa->mwavefront[k + 1];
-  }
-  else
-  {
-    return AFFINE_WAVEFRONT_OFFSET_NULL;
-  }
-}
-awf_offset_t backtrace_wavefront_trace_deletion_extend_offset(
-    wfa_component *wfa,
-    int score,
-    int k,
-    awf_offset_t offset)
-{
-
-  if (wfa != NULL && !wfa->d_null &&
-      wfa->klo <= k + 1 &&
-      k + 1 <= wfa->khi)
-  {
-    return wfa->dwavefront[k + 1];
-  }
-  else
-  {
-    return AFFINE_WAVEFRONT_OFFSET_NULL;
-  }
-}
-awf_offset_t backtrace_wavefront_trace_insertion_open_offset(
-    wfa_component *wfa,
-    int score,
-    int k,
-    awf_offset_t offset)
-{
-  if (score < 0)
-    return AFFINE_WAVEFRONT_OFFSET_NULL;
-  if (wfa != NULL &&
-      wfa->klo <= k - 1 &&
-      k - 1 <= wfa->khi)
-  {
-    return wfa->mwavefront[k - 1] + 1;
-  }
-  else
-  {
-    return AFFINE_WAVEFRONT_OFFSET_NULL;
-  }
-}
-awf_offset_t backtrace_wavefront_trace_insertion_extend_offset(
-    wfa_component *wfa,
-    int score,
-    int k,
-    awf_offset_t offset)
-{
-  if (score < 0)
-    return AFFINE_WAVEFRONT_OFFSET_NULL;
-  if (wfa != NULL && wfa->iwavefront != NULL &&
-      wfa->klo <= k - 1 &&
-      k - 1 <= wfa->khi)
-  {
-    return wfa->iwavefront[k - 1] + 1;
-  }
-  else
-  {
-    return AFFINE_WAVEFRONT_OFFSET_NULL;
-  }
-}
-awf_offset_t backtrace_wavefront_trace_mismatch_offset(
-    wfa_component *wfa,
-    int score,
-    int k,
-    awf_offset_t offset)
-{
-  if (score < 0)
-    return AFFINE_WAVEFRONT_OFFSET_NULL;
-  if (wfa != NULL &&
-      wfa->klo <= k &&
-      k <= wfa->khi)
-  {
-    return wfa->mwavefront[k] + 1;
-  }
-  else
-  {
-    return AFFINE_WAVEFRONT_OFFSET_NULL;
-  }
-}
-
 /*
  * Backtrace Operations
  */
 void affine_wavefronts_backtrace_matches__check(
-    char *pattern,
-    char *text,
+    const wfa_sequences_t *seqs,
     int k,
     awf_offset_t offset,
     bool valid_location,
@@ -189,7 +91,7 @@ void affine_wavefronts_backtrace_matches__check(
       printf("Backtrace error: Match outside DP-Table\n");
       exit(1);
     }
-    else if (pattern[v - 1] != text[h - 1])
+    else if (PACKED_CODE(seqs->pattern, seqs->pattern_begin + v - 1) != PACKED_CODE(seqs->text, seqs->text_begin + h - 1))
     { // Check match
       printf("Backtrace error: Not a match traceback\n");
       exit(1);
@@ -219,27 +121,24 @@ void affine_wavefronts_backtrace_matches(
 void affine_wavefronts_backtrace(
     uint32_t *mramIdx,
     edit_cigar_t *cigar,
-    char *pattern,
-    int pattern_length,
-    char *text,
-    int text_length,
+    const wfa_sequences_t *seqs,
     int alignment_score,
-    dpu_alloc_wram_t *wram_alloc)
+    int alignment_k,
+    awf_offset_t alignment_offset,
+    backtrace_wavefront_type component_end)
 {
 
   // Parameters
-  int alignment_k = AFFINE_WAVEFRONT_DIAGONAL(text_length, pattern_length);
+  int pattern_length = seqs->pattern_length;
+  int text_length = seqs->text_length;
 
   // Compute starting location
   int score = alignment_score;
   int k = alignment_k;
-  wfa_component *wfa_alignment = load_mwavefront_cmpnt_from_mram(wram_alloc, mramIdx[alignment_score]);
-  awf_offset_t offset = wfa_alignment->mwavefront[k];
-  char *start_ptr = wram_alloc->CUR_PTR_WRAM;
-  uint32_t size_wram = wram_alloc->mem_used_wram;
+  awf_offset_t offset = alignment_offset;
   bool valid_location = affine_wavefronts_valid_location(k, offset, pattern_length, text_length);
   // Trace the alignment back
-  backtrace_wavefront_type backtrace_type = backtrace_wavefront_M;
+  backtrace_wavefront_type backtrace_type = component_end;
   int v = AFFINE_WAVEFRONT_V(k, offset);
   int h = AFFINE_WAVEFRONT_H(k, offset);
 
@@ -254,122 +153,90 @@ void affine_wavefronts_backtrace(
         affine_wavefronts_offset_add_trailing_gap(cigar, k, alignment_k);
       }
     }
-    // Compute scores
-    int gap_open_score = score - GAP_O - GAP_E;
-    int gap_extend_score = score - GAP_E;
-    int mismatch_score = score - MISMATCH;
-
-    // load needed components from MRAM
-    wfa_component *wfa_gap_open = (gap_open_score < 0) ? NULL : load_mwavefront_cmpnt_from_mram(wram_alloc, mramIdx[gap_open_score]);
-    wfa_component *wfa_gap_extend = (gap_extend_score < 0) ? NULL : load_idwavefront_cmpnt_from_mram(wram_alloc, mramIdx[gap_extend_score]);
-    wfa_component *wfa_mismatch = (mismatch_score < 0) ? NULL : load_mwavefront_cmpnt_from_mram(wram_alloc, mramIdx[mismatch_score]);
-    // Compute source offsets
-    awf_offset_t del_ext = (backtrace_type == backtrace_wavefront_I) ? AFFINE_WAVEFRONT_OFFSET_NULL : backtrace_wavefront_trace_deletion_extend_offset(wfa_gap_extend, gap_extend_score, k, offset);
-    awf_offset_t del_open = (backtrace_type == backtrace_wavefront_I) ? AFFINE_WAVEFRONT_OFFSET_NULL : backtrace_wavefront_trace_deletion_open_offset(wfa_gap_open, gap_open_score, k, offset);
-    awf_offset_t ins_ext = (backtrace_type == backtrace_wavefront_D) ? AFFINE_WAVEFRONT_OFFSET_NULL : backtrace_wavefront_trace_insertion_extend_offset(wfa_gap_extend, gap_extend_score, k, offset);
-    awf_offset_t ins_open = (backtrace_type == backtrace_wavefront_D) ? AFFINE_WAVEFRONT_OFFSET_NULL : backtrace_wavefront_trace_insertion_open_offset(wfa_gap_open, gap_open_score, k, offset);
-    awf_offset_t misms = (backtrace_type != backtrace_wavefront_M) ? AFFINE_WAVEFRONT_OFFSET_NULL : backtrace_wavefront_trace_mismatch_offset(wfa_mismatch, mismatch_score, k, offset);
-    // Compute maximum offset
-    awf_offset_t max_del = MAX(del_ext, del_open);
-    awf_offset_t max_ins = MAX(ins_ext, ins_open);
-    awf_offset_t max_all = MAX(misms, MAX(max_ins, max_del));
+    if (mramIdx[score] == 0)
+    {
+      printf("Backtrace error: No link found during backtrace\n");
+      exit(1);
+    }
+    // M offset before the extension and sources of the offsets of the diagonal
+    awf_offset_t moffset;
+    int bits;
+    load_wfa_backtrace_from_mram(mramIdx[score], k, &moffset, &bits);
 
     // Traceback Matches
+    backtrace_wavefront_type source = backtrace_type;
     if (backtrace_type == backtrace_wavefront_M)
     {
-      int num_matches = offset - max_all;
-      affine_wavefronts_backtrace_matches__check(pattern, text, k, offset, valid_location, num_matches, cigar);
-      offset = max_all;
+      int num_matches = offset - moffset;
+      affine_wavefronts_backtrace_matches__check(seqs, k, offset, valid_location, num_matches, cigar);
+      offset = moffset;
       // Update coordinates
       v = AFFINE_WAVEFRONT_V(k, offset);
       h = AFFINE_WAVEFRONT_H(k, offset);
       if (v <= 0 || h <= 0)
         break;
+      source = ((bits & WFA_BT_M_MASK) == WFA_BT_M_D) ? backtrace_wavefront_D : ((bits & WFA_BT_M_MASK) == WFA_BT_M_I) ? backtrace_wavefront_I : backtrace_wavefront_M;
     }
     // Traceback Operation
-    if (max_all == del_ext)
+    if (source == backtrace_wavefront_D)
     {
       // Add Deletion
       if (valid_location)
         cigar->operations[(cigar->begin_offset)--] = 'D';
       // Update state
-      score = gap_extend_score;
+      bool extend = bits & WFA_BT_D_EXT;
+      score -= extend ? GAP_E : GAP_O + GAP_E;
       ++k;
-      backtrace_type = backtrace_wavefront_D;
+      backtrace_type = extend ? backtrace_wavefront_D : backtrace_wavefront_M;
     }
-    else if (max_all == del_open)
-    {
-      // Add Deletion
-      if (valid_location)
-        cigar->operations[(cigar->begin_offset)--] = 'D';
-      // Update state
-      score = gap_open_score;
-      ++k;
-      backtrace_type = backtrace_wavefront_M;
-    }
-    else if (max_all == ins_ext)
-    {
-      // Add Insertion
-      if (valid_location)
-        cigar->operations[(cigar->begin_offset)--] = 'I';
-      // Update state
-      score = gap_extend_score;
-      --k;
-      --offset;
-      backtrace_type = backtrace_wavefront_I;
-    }
-    else if (max_all == ins_open)
+    else if (source == backtrace_wavefront_I)
     {
       // Add Insertion
       if (valid_location)
         cigar->operations[(cigar->begin_offset)--] = 'I';
       // Update state
-      score = gap_open_score;
+      bool extend = bits & WFA_BT_I_EXT;
+      score -= extend ? GAP_E : GAP_O + GAP_E;
       --k;
       --offset;
-      backtrace_type = backtrace_wavefront_M;
+      backtrace_type = extend ? backtrace_wavefront_I : backtrace_wavefront_M;
     }
-    else if (max_all == misms)
+    else
     {
       // Add Mismatch
       if (valid_location)
         cigar->operations[(cigar->begin_offset)--] = 'X';
       // Update state
-      score = mismatch_score;
+      score -= MISMATCH;
       --offset;
     }
-    else
-    {
-      printf("Backtrace error: No link found during backtrace\n");
-      exit(1);
-    }
     // Update coordinates
     v = AFFINE_WAVEFRONT_V(k, offset);
     h = AFFINE_WAVEFRONT_H(k, offset);
-
-    // reset wram memory
-    wram_alloc->CUR_PTR_WRAM = start_ptr;
-    wram_alloc->mem_used_wram = size_wram;
   }
   // Account for last operations
   if (score == 0)
   {
-    // Account for last stroke of matches
-    affine_wavefronts_backtrace_matches__check(pattern, text, k, offset, valid_location, offset, cigar);
+    // Account for last stroke of matches, the diagonals of score 0 start on the first row or column
+    affine_wavefronts_backtrace_matches__check(seqs, k, offset, valid_location, offset - MAX(k, 0), cigar);
+    offset = MAX(k, 0);
+    v = AFFINE_WAVEFRONT_V(k, offset);
+    h = AFFINE_WAVEFRONT_H(k, offset);
   }
   else
   {
-    // Account for last stroke of insertion/deletion
-    while (v > 0)
+    // Account for last stroke of insertion/deletion, the bases of the free begins are left out
+    while (v > ((h > 0) ? 0 : seqs->pattern_begin_free))
     {
       cigar->operations[(cigar->begin_offset)--] = 'D';
       --v;
     };
-    while (h > 0)
+    while (h > ((v > 0) ? 0 : seqs->text_begin_free))
     {
       cigar->operations[(cigar->begin_offset)--] = 'I';
       --h;
     };
   }
-  ++(cigar->begin_offset); // Set CIGAR length
+  cigar->pattern_begin = seqs->pattern_begin + v;
+  cigar->text_begin = seqs->text_begin + h;
 }
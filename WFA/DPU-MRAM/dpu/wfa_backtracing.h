@@ -58,14 +58,15 @@ typedef enum
 /*
  * Backtrace
  */
+// Writes the operations of the alignment of seqs before cigar->begin_offset, from the end of the alignment on diagonal alignment_k in the
+// component component_end, and sets the begin of its span
 void affine_wavefronts_backtrace(
     uint32_t *mramIdx,
     edit_cigar_t *const cigar,
-    char *const pattern,
-    const int pattern_length,
-    char *const text,
-    const int text_length,
+    const wfa_sequences_t *seqs,
     const int alignment_score,
-    dpu_alloc_wram_t *wram_alloc);
+    const int alignment_k,
+    const awf_offset_t alignment_offset,
+    const backtrace_wavefront_type component_end);
 
 #endif /* AFFINE_WAVEFRONT_BACKTRACE_H_ */
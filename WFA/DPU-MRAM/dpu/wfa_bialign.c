@@ -0,0 +1,487 @@
+/* MIT License
+
+Copyright (c) 2021 SAFARI Research Group at ETH Zürich
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE. */
+
+#include "wfa_bialign.h"
+#include "dpu_params.h"
+
+#if defined(BACKTRACE) && defined(BIWFA)
+
+// Wavefront of a score of a BiWFA search, its offsets are in the MRAM
+typedef struct wfa_bialign_slot_t
+{
+    int klo;
+    int khi;
+    bool null[3]; /* Whether its M, I and D offsets are null, indexed by backtrace_wavefront_type */
+} wfa_bialign_slot_t;
+
+// Side of a BiWFA search, the forward side aligns the sequences of a subproblem and the reverse side their reverse
+typedef struct wfa_bialign_side_t
+{
+    wfa_sequences_t seqs;
+    backtrace_wavefront_type component_end; /* Component the side ends in */
+    int score;                              /* Last score computed */
+    int max_ak;                             /* Furthest antidiagonal h + v reached */
+    int end_score;                          /* Score at which the side reached the end of its sequences, INT32_MAX until then */
+    int end_bias;                           /* Added to the score at which the side reaches its end */
+    uint32_t ring_m;                        /* MRAM address of the offsets of its last wavefronts */
+    wfa_bialign_slot_t *slots;
+} wfa_bialign_side_t;
+
+// Breakpoint of a subproblem, an optimal alignment goes through (v, h) in the component
+typedef struct wfa_breakpoint_t
+{
+    int score;
+    int imbalance; /* Difference of the scores of the forward and the reverse offsets */
+    backtrace_wavefront_type component;
+    int v;
+    int h;
+} wfa_breakpoint_t;
+
+// Subproblem of a BiWFA alignment, the bases [pattern_begin, pattern_end) of the pattern against [text_begin, text_end) of the text
+typedef struct wfa_bialign_task_t
+{
+    int pattern_begin;
+    int pattern_end;
+    int text_begin;
+    int text_end;
+    backtrace_wavefront_type component_begin;
+    backtrace_wavefront_type component_end;
+} wfa_bialign_task_t;
+
+// State of a BiWFA alignment
+typedef struct wfa_bialign_t
+{
+    wfa_sequences_t seqs;         /* Sequences of the alignment */
+    wfa_sequences_t reverse_seqs; /* Reversed sequences of the alignment */
+    wfa_bialign_side_t forward;
+    wfa_bialign_side_t reverse;
+    int end_gap_open; /* GAP_O when the subproblem ends in a gap, its reverse side starts with the gap open */
+    int nr_slots;     /* Wavefronts kept by each side */
+    int center;   /* Index of the diagonal 0 in the offsets of a wavefront */
+    int width;    /* Diagonals of the offsets of a wavefront */
+    awf_offset_t *buffers[7]; /* Tiles of BIWFA_TILE + 16 diagonals: 4 for the sources and 3 for the new offsets */
+    uint8_t *bt;              /* Backtrace bits of a tile, only needed by affine_wfa_compute_offsets */
+} wfa_bialign_t;
+
+// Copies a packed sequence reversed, 8 more bytes for the word accesses past its end
+static char *packed_reverse(dpu_alloc_wram_t *dpu_alloc_wram, const char *sequence, int length)
+{
+    const uint8_t *mask = (const uint8_t *)sequence + PACKED_BASES_SIZE(length);
+    uint8_t *reverse = (uint8_t *)allocate_new(dpu_alloc_wram, PACKED_SIZE(length) + 8);
+    uint8_t *reverse_mask = reverse + PACKED_BASES_SIZE(length);
+    memset(reverse, 0, PACKED_SIZE(length) + 8);
+    for (int i = 0; i < length; ++i)
+    {
+        int j = length - 1 - i;
+        reverse[i >> 2] |= PACKED_CODE(sequence, j) << ((i & 3) << 1);
+        reverse_mask[i >> 3] |= ((mask[j >> 3] >> (j & 7)) & 1) << (i & 7);
+    }
+    return (char *)reverse;
+}
+
+// MRAM address of the M, I or D offsets of the wavefront of a score of a side
+static uint32_t slot_offsets_m(wfa_bialign_t *bi, wfa_bialign_side_t *side, int score, backtrace_wavefront_type component)
+{
+    return side->ring_m + ((score % bi->nr_slots) * 3 + component) * bi->width * sizeof(awf_offset_t);
+}
+
+// Wavefront of a score of a side, NULL for the scores below 0
+static wfa_bialign_slot_t *side_slot(wfa_bialign_t *bi, wfa_bialign_side_t *side, int score)
+{
+    if (score < 0)
+        return NULL;
+    return &side->slots[score % bi->nr_slots];
+}
+
+// Reads the offsets of the diagonals [k_from, k_to] of a wavefront from the MRAM, 8 diagonals at a time so that the transfers are
+// aligned. The returned pointer is indexed by diagonal
+static awf_offset_t *load_offsets(wfa_bialign_t *bi, uint32_t offsets_m, int k_from, int k_to, awf_offset_t *buffer)
+{
+    int from = MAX(k_from + bi->center, 0) & ~7;
+    int to = ROUND_UP_MULTIPLE_8(MIN(k_to + bi->center + 1, bi->width));
+    if (to > from)
+        mram_read((__mram_ptr void const *)(offsets_m + from * sizeof(awf_offset_t)), buffer, (to - from) * sizeof(awf_offset_t));
+    return buffer - from + bi->center;
+}
+
+// Writes the offsets of the tile of a wavefront starting at the diagonal kb to the MRAM
+static void store_offsets(wfa_bialign_t *bi, uint32_t offsets_m, int kb, awf_offset_t *offsets)
+{
+    int from = kb + bi->center;
+    int count = MIN(BIWFA_TILE, bi->width - from);
+    mram_write(offsets + kb, (__mram_ptr void *)(offsets_m + from * sizeof(awf_offset_t)), count * sizeof(awf_offset_t));
+}
+
+// Tile of the diagonals [lo, hi] of a new wavefront, its offsets are in the WRAM buffers from the diagonal kb
+static wfa_component tile_component(wfa_bialign_t *bi, int kb, int lo, int hi, int kernel)
+{
+    wfa_component tile;
+    tile.klo = lo;
+    tile.khi = hi;
+    tile.lo_base = lo;
+    tile.hi_base = hi;
+    tile.mwavefront = bi->buffers[4] - kb;
+    tile.iwavefront = bi->buffers[5] - kb;
+    tile.dwavefront = bi->buffers[6] - kb;
+    tile.m_null = false;
+    tile.i_null = !(kernel & 2);
+    tile.d_null = !(kernel & 1);
+    return tile;
+}
+
+// Extends a tile of the last wavefront of a side and writes it to the MRAM
+static void store_tile(wfa_bialign_t *bi, wfa_bialign_side_t *side, wfa_component *tile, int kb)
+{
+    affine_wfa_extend(tile, &side->seqs);
+    for (int k = tile->klo; k <= tile->khi; ++k)
+        if (tile->mwavefront[k] >= 0)
+            side->max_ak = MAX(side->max_ak, 2 * tile->mwavefront[k] - k);
+    int alignment_k;
+    if (affine_wfa_end_reached(tile, &side->seqs, side->component_end, &alignment_k))
+        side->end_score = MIN(side->end_score, side->score + side->end_bias);
+
+    store_offsets(bi, slot_offsets_m(bi, side, side->score, backtrace_wavefront_M), kb, tile->mwavefront);
+    if (!tile->i_null)
+        store_offsets(bi, slot_offsets_m(bi, side, side->score, backtrace_wavefront_I), kb, tile->iwavefront);
+    if (!tile->d_null)
+        store_offsets(bi, slot_offsets_m(bi, side, side->score, backtrace_wavefront_D), kb, tile->dwavefront);
+}
+
+// Starts a side at score 0, an alignment that begins in a gap starts with the gap already open
+static void init_side(wfa_bialign_t *bi, wfa_bialign_side_t *side, const wfa_sequences_t *seqs, backtrace_wavefront_type component_begin,
+                      backtrace_wavefront_type component_end, int end_bias)
+{
+    side->seqs = *seqs;
+    side->component_end = component_end;
+    side->end_bias = end_bias;
+    side->score = 0;
+    side->max_ak = 0;
+    side->end_score = INT32_MAX;
+
+    int kernel = (component_begin == backtrace_wavefront_I) ? 2 : (component_begin == backtrace_wavefront_D) ? 1 : 0;
+    wfa_component tile = tile_component(bi, 0, 0, 0, kernel);
+    tile.m_null = component_begin != backtrace_wavefront_M;
+    tile.mwavefront[0] = tile.m_null ? AFFINE_WAVEFRONT_OFFSET_NULL : 0;
+    tile.iwavefront[0] = 0;
+    tile.dwavefront[0] = 0;
+    store_tile(bi, side, &tile, 0);
+
+    wfa_bialign_slot_t *slot = side_slot(bi, side, 0);
+    slot->klo = 0;
+    slot->khi = 0;
+    slot->null[backtrace_wavefront_M] = tile.m_null;
+    slot->null[backtrace_wavefront_I] = tile.i_null;
+    slot->null[backtrace_wavefront_D] = tile.d_null;
+}
+
+// Computes the wavefront of the next score of a side, BIWFA_TILE diagonals at a time: the tiles of its sources are read from the MRAM,
+// the offsets are computed and extended in the WRAM and written back to the MRAM
+static void compute_next(wfa_bialign_t *bi, wfa_bialign_side_t *side)
+{
+    int score = ++side->score;
+    int mismatch_score = score - MISMATCH;
+    int o_score = score - GAP_O - GAP_E;
+    int e_score = score - GAP_E;
+    wfa_bialign_slot_t *slot = side_slot(bi, side, score);
+    wfa_bialign_slot_t *wfa_mismatch = side_slot(bi, side, mismatch_score);
+    wfa_bialign_slot_t *wfa_o_score = side_slot(bi, side, o_score);
+    wfa_bialign_slot_t *wfa_e_score = side_slot(bi, side, e_score);
+
+    wfa_set wfa_set;
+    wfa_set.m_sub_null = wfa_mismatch == NULL || wfa_mismatch->null[backtrace_wavefront_M];
+    wfa_set.m_o_null = wfa_o_score == NULL || wfa_o_score->null[backtrace_wavefront_M];
+    wfa_set.i_e_null = wfa_e_score == NULL || wfa_e_score->null[backtrace_wavefront_I];
+    wfa_set.d_e_null = wfa_e_score == NULL || wfa_e_score->null[backtrace_wavefront_D];
+    wfa_set.i_out_null = wfa_set.m_o_null && wfa_set.i_e_null;
+    wfa_set.d_out_null = wfa_set.m_o_null && wfa_set.d_e_null;
+
+    if (wfa_set.m_sub_null && wfa_set.i_out_null && wfa_set.d_out_null)
+    {
+        slot->null[backtrace_wavefront_M] = true;
+        slot->null[backtrace_wavefront_I] = true;
+        slot->null[backtrace_wavefront_D] = true;
+        return;
+    }
+
+    wfa_set.m_sub_lo = wfa_set.m_sub_null ? 1 : wfa_mismatch->klo;
+    wfa_set.m_sub_hi = wfa_set.m_sub_null ? -1 : wfa_mismatch->khi;
+    wfa_set.m_o_lo = wfa_set.m_o_null ? 1 : wfa_o_score->klo;
+    wfa_set.m_o_hi = wfa_set.m_o_null ? -1 : wfa_o_score->khi;
+    wfa_set.e_lo = (wfa_set.i_e_null && wfa_set.d_e_null) ? 1 : wfa_e_score->klo;
+    wfa_set.e_hi = (wfa_set.i_e_null && wfa_set.d_e_null) ? -1 : wfa_e_score->khi;
+    int lo = MIN(MIN(wfa_set.m_sub_lo, wfa_set.m_o_lo), wfa_set.e_lo) - 1;
+    int hi = MAX(MAX(wfa_set.m_sub_hi, wfa_set.m_o_hi), wfa_set.e_hi) + 1;
+    int kernel = ((!wfa_set.i_out_null) << 1) | (!wfa_set.d_out_null);
+
+    // The tiles start at a multiple of 8 diagonals, the sources are read with the diagonals around the tile they depend on
+    for (int kb = lo & ~7; kb <= hi; kb += BIWFA_TILE)
+    {
+        int ke = kb + BIWFA_TILE - 1;
+        if (!wfa_set.m_sub_null)
+            wfa_set.wfa_sub_mwavefront = load_offsets(bi, slot_offsets_m(bi, side, mismatch_score, backtrace_wavefront_M), kb, ke, bi->buffers[0]);
+        if (!wfa_set.m_o_null)
+            wfa_set.wfa_o_mwavefront = load_offsets(bi, slot_offsets_m(bi, side, o_score, backtrace_wavefront_M), kb - 1, ke + 1, bi->buffers[1]);
+        if (!wfa_set.i_e_null)
+            wfa_set.wfa_e_iwavefront = load_offsets(bi, slot_offsets_m(bi, side, e_score, backtrace_wavefront_I), kb - 1, ke, bi->buffers[2]);
+        if (!wfa_set.d_e_null)
+            wfa_set.wfa_e_dwavefront = load_offsets(bi, slot_offsets_m(bi, side, e_score, backtrace_wavefront_D), kb + 1, ke + 1, bi->buffers[3]);
+
+        wfa_component tile = tile_component(bi, kb, MAX(lo, kb), MIN(hi, ke), kernel);
+        affine_wfa_compute_offsets(&tile, wfa_set, tile.klo, tile.khi, score, kernel, bi->bt);
+        store_tile(bi, side, &tile, kb);
+    }
+
+    slot->klo = lo;
+    slot->khi = hi;
+    slot->null[backtrace_wavefront_M] = false;
+    slot->null[backtrace_wavefront_I] = !(kernel & 2);
+    slot->null[backtrace_wavefront_D] = !(kernel & 1);
+}
+
+// Keeps the breakpoint of a forward offset on the diagonal k_forward and a reverse offset on the diagonal k_reverse that overlap,
+// when its score is lower, or when its scores are closer so that the halves of the subproblem are balanced. The breakpoint is the
+// forward offset, or the reverse one when the forward offset is at an end of the subproblem and would not split it
+static void add_breakpoint(wfa_bialign_t *bi, wfa_breakpoint_t *bp, backtrace_wavefront_type component, int score, int imbalance,
+                           int k_forward, int offset_forward, int k_reverse, int offset_reverse)
+{
+    int pattern_length = bi->forward.seqs.pattern_length;
+    int text_length = bi->forward.seqs.text_length;
+    int v = AFFINE_WAVEFRONT_V(k_forward, offset_forward);
+    int h = AFFINE_WAVEFRONT_H(k_forward, offset_forward);
+    int reverse_v = AFFINE_WAVEFRONT_V(k_reverse, offset_reverse);
+    int reverse_h = AFFINE_WAVEFRONT_H(k_reverse, offset_reverse);
+    if (score > bp->score || (score == bp->score && imbalance >= bp->imbalance))
+        return;
+    if (v < 0 || h < 0 || v > pattern_length || h > text_length)
+        return;
+    if (reverse_v < 0 || reverse_h < 0 || reverse_v > pattern_length || reverse_h > text_length)
+        return;
+    if ((v == 0 && h == 0) || (v == pattern_length && h == text_length))
+    {
+        v = pattern_length - reverse_v;
+        h = text_length - reverse_h;
+        if ((v == 0 && h == 0) || (v == pattern_length && h == text_length))
+            return;
+    }
+    bp->score = score;
+    bp->imbalance = imbalance;
+    bp->component = component;
+    bp->v = v;
+    bp->h = h;
+}
+
+// Compares the last wavefront of a side to the wavefronts of the other side on the mirrored diagonals. An offset of each side in the
+// same component overlap when they add up to the length of the text, the score of a breakpoint in a gap counts its opening once
+static void find_breakpoint(wfa_bialign_t *bi, wfa_bialign_side_t *side, wfa_bialign_side_t *other, wfa_breakpoint_t *bp)
+{
+    int text_length = side->seqs.text_length;
+    int alignment_k = AFFINE_WAVEFRONT_DIAGONAL(text_length, side->seqs.pattern_length);
+    // The searches can only overlap once their furthest antidiagonals add up to the lengths of the sequences
+    if (side->max_ak + other->max_ak < side->seqs.pattern_length + text_length)
+        return;
+
+    wfa_bialign_slot_t *slot = side_slot(bi, side, side->score);
+    for (int other_score = MAX(0, other->score - bi->nr_slots + 1); other_score <= other->score; ++other_score)
+    {
+        wfa_bialign_slot_t *other_slot = side_slot(bi, other, other_score);
+        int lo = MAX(slot->klo, alignment_k - other_slot->khi);
+        int hi = MIN(slot->khi, alignment_k - other_slot->klo);
+        for (int component = backtrace_wavefront_M; component <= backtrace_wavefront_D; ++component)
+        {
+            int score = side->score + other_score - ((component == backtrace_wavefront_M) ? 0 : GAP_O) + bi->end_gap_open;
+            int imbalance = ABS(side->score - other_score);
+            if (slot->null[component] || other_slot->null[component] || score > bp->score || (score == bp->score && imbalance >= bp->imbalance))
+                continue;
+            for (int kb = lo & ~7; kb <= hi; kb += BIWFA_TILE)
+            {
+                int k_from = MAX(lo, kb);
+                int k_to = MIN(hi, kb + BIWFA_TILE - 1);
+                awf_offset_t *offsets = load_offsets(bi, slot_offsets_m(bi, side, side->score, component), k_from, k_to, bi->buffers[0]);
+                awf_offset_t *other_offsets = load_offsets(bi, slot_offsets_m(bi, other, other_score, component), alignment_k - k_to,
+                                                           alignment_k - k_from, bi->buffers[1]);
+                for (int k = k_from; k <= k_to; ++k)
+                {
+                    int offset = offsets[k];
+                    int other_offset = other_offsets[alignment_k - k];
+                    if (offset < 0 || other_offset < 0 || offset + other_offset < text_length)
+                        continue;
+                    if (side == &bi->forward)
+                        add_breakpoint(bi, bp, component, score, imbalance, k, offset, alignment_k - k, other_offset);
+                    else
+                        add_breakpoint(bi, bp, component, score, imbalance, alignment_k - k, other_offset, k, offset);
+                }
+            }
+        }
+    }
+}
+
+// Forward sequences of a subproblem
+static wfa_sequences_t task_sequences(wfa_bialign_t *bi, wfa_bialign_task_t *task)
+{
+    wfa_sequences_t seqs = bi->seqs;
+    seqs.pattern_begin = task->pattern_begin;
+    seqs.text_begin = task->text_begin;
+    seqs.pattern_length = task->pattern_end - task->pattern_begin;
+    seqs.text_length = task->text_end - task->text_begin;
+    return seqs;
+}
+
+// Runs the forward and the reverse searches of a subproblem, the side with the lowest score computes the next one. Returns the score of
+// the subproblem when one of the sides reached its end with a score up to BIWFA_BASE_SCORE or when it has no breakpoint, -1 when bp
+// is the breakpoint of an optimal alignment, or MAX_SCORE + 1 when the score of the subproblem is above MAX_SCORE
+static int search_breakpoint(wfa_bialign_t *bi, wfa_bialign_task_t *task, wfa_breakpoint_t *bp)
+{
+    wfa_sequences_t seqs = task_sequences(bi, task);
+    wfa_sequences_t reverse_seqs = bi->reverse_seqs;
+    reverse_seqs.pattern_begin = bi->seqs.pattern_length - task->pattern_end;
+    reverse_seqs.text_begin = bi->seqs.text_length - task->text_end;
+    reverse_seqs.pattern_length = seqs.pattern_length;
+    reverse_seqs.text_length = seqs.text_length;
+
+    // The score of a subproblem counts the opening of the gap it ends in but not of the gap it begins in, like its forward side. Its
+    // reverse side starts with the gap of the end open and opens the gap of the beginning
+    bi->end_gap_open = (task->component_end == backtrace_wavefront_M) ? 0 : GAP_O;
+    init_side(bi, &bi->forward, &seqs, task->component_begin, task->component_end, 0);
+    init_side(bi, &bi->reverse, &reverse_seqs, task->component_end, task->component_begin,
+              bi->end_gap_open - ((task->component_begin == backtrace_wavefront_M) ? 0 : GAP_O));
+    bp->score = INT32_MAX;
+    bp->imbalance = INT32_MAX;
+    find_breakpoint(bi, &bi->forward, &bi->reverse, bp);
+
+    // A breakpoint of a lower score than the one found has both of its scores within the margin
+    int margin = BIWFA_MARGIN(dpu_params.penalties);
+    while (true)
+    {
+        int end_score = MIN(bi->forward.end_score, bi->reverse.end_score);
+        if (end_score <= BIWFA_BASE_SCORE)
+            return end_score;
+        int scores = bi->forward.score + bi->reverse.score;
+        int limit = MIN(bp->score, end_score);
+        if ((limit != INT32_MAX && scores >= limit + margin) || scores > MAX_SCORE + margin)
+            break;
+
+        wfa_bialign_side_t *side = (bi->forward.score <= bi->reverse.score) ? &bi->forward : &bi->reverse;
+        wfa_bialign_side_t *other = (side == &bi->forward) ? &bi->reverse : &bi->forward;
+        compute_next(bi, side);
+        find_breakpoint(bi, side, other, bp);
+    }
+    // A subproblem of one operation has no breakpoint of its score to split it
+    int end_score = MIN(bi->forward.end_score, bi->reverse.end_score);
+    if (bp->score <= MAX_SCORE && bp->score <= end_score)
+        return -1;
+    return MIN(end_score, MAX_SCORE + 1);
+}
+
+int wfa_bialign(dpu_alloc_wram_t *dpu_alloc_wram, edit_cigar_t *cigar, const wfa_sequences_t *seqs, dpu_alloc_mram_t *dpu_alloc_mram)
+{
+    if (MAX_SCORE <= BIWFA_BASE_SCORE)
+        return affine_wfa_align(dpu_alloc_wram, cigar, seqs, backtrace_wavefront_M, backtrace_wavefront_M, MAX_SCORE, dpu_alloc_mram);
+
+    // The WRAM and the MRAM of the alignment are released when it returns
+    char *wram_ptr = dpu_alloc_wram->CUR_PTR_WRAM;
+    uint32_t mem_used_wram = dpu_alloc_wram->mem_used_wram;
+    uint32_t mram_ptr = dpu_alloc_mram->CUR_PTR_MRAM;
+    uint32_t mem_used_mram = dpu_alloc_mram->mem_used_mram;
+
+    wfa_bialign_t bi;
+    bi.seqs = *seqs;
+    bi.reverse_seqs = *seqs;
+    bi.reverse_seqs.pattern = packed_reverse(dpu_alloc_wram, seqs->pattern, seqs->pattern_length);
+    bi.reverse_seqs.pattern_mask = bi.reverse_seqs.pattern + PACKED_BASES_SIZE(seqs->pattern_length);
+    bi.reverse_seqs.text = packed_reverse(dpu_alloc_wram, seqs->text, seqs->text_length);
+    bi.reverse_seqs.text_mask = bi.reverse_seqs.text + PACKED_BASES_SIZE(seqs->text_length);
+
+    bi.nr_slots = BIWFA_SLOTS(dpu_params.penalties);
+    bi.center = BIWFA_CENTER(MAX_SCORE, dpu_params.penalties);
+    bi.width = 2 * bi.center;
+    for (int i = 0; i < 7; ++i)
+        bi.buffers[i] = (awf_offset_t *)allocate_new(dpu_alloc_wram, (BIWFA_TILE + 16) * sizeof(awf_offset_t));
+    bi.bt = (uint8_t *)allocate_new(dpu_alloc_wram, BIWFA_TILE / 2 + 8);
+
+    uint32_t ring_size = bi.nr_slots * 3 * bi.width * sizeof(awf_offset_t);
+    wfa_bialign_side_t *sides[2] = {&bi.forward, &bi.reverse};
+    for (int i = 0; i < 2; ++i)
+    {
+        sides[i]->slots = (wfa_bialign_slot_t *)allocate_new(dpu_alloc_wram, bi.nr_slots * sizeof(wfa_bialign_slot_t));
+        add_wfa_cmpnt_to_mram(&sides[i]->ring_m, ring_size, dpu_alloc_mram);
+        sides[i]->ring_m += (uint32_t)DPU_MRAM_HEAP_POINTER;
+    }
+
+    // The subproblems are aligned from the end of the alignment, the CIGAR is written backwards
+    wfa_bialign_task_t *tasks = (wfa_bialign_task_t *)allocate_new(dpu_alloc_wram, BIWFA_STACK_SIZE * sizeof(wfa_bialign_task_t));
+    int nr_tasks = 1;
+    tasks[0].pattern_begin = 0;
+    tasks[0].pattern_end = seqs->pattern_length;
+    tasks[0].text_begin = 0;
+    tasks[0].text_end = seqs->text_length;
+    tasks[0].component_begin = backtrace_wavefront_M;
+    tasks[0].component_end = backtrace_wavefront_M;
+
+    int score = 0;
+    while (nr_tasks > 0)
+    {
+        wfa_bialign_task_t task = tasks[--nr_tasks];
+        wfa_breakpoint_t bp;
+        int task_score = search_breakpoint(&bi, &task, &bp);
+        if (task_score > MAX_SCORE)
+        {
+            score = MAX_SCORE + 1;
+            break;
+        }
+        if (task_score >= 0)
+        {
+            wfa_sequences_t task_seqs = task_sequences(&bi, &task);
+            int aligned_score = affine_wfa_align(dpu_alloc_wram, cigar, &task_seqs, task.component_begin, task.component_end, task_score, dpu_alloc_mram);
+            if (aligned_score > task_score)
+            {
+                printf("BiWFA error: subproblem not aligned within its score\n");
+                exit(1);
+            }
+            score += aligned_score;
+            continue;
+        }
+
+        if (nr_tasks + 2 > BIWFA_STACK_SIZE)
+        {
+            printf("BiWFA stack overflow\n");
+            exit(1);
+        }
+        wfa_bialign_task_t *left = &tasks[nr_tasks++];
+        *left = task;
+        left->pattern_end = task.pattern_begin + bp.v;
+        left->text_end = task.text_begin + bp.h;
+        left->component_end = bp.component;
+        wfa_bialign_task_t *right = &tasks[nr_tasks++];
+        *right = task;
+        right->pattern_begin = task.pattern_begin + bp.v;
+        right->text_begin = task.text_begin + bp.h;
+        right->component_begin = bp.component;
+    }
+
+    dpu_alloc_wram->CUR_PTR_WRAM = wram_ptr;
+    dpu_alloc_wram->mem_used_wram = mem_used_wram;
+    dpu_alloc_mram->CUR_PTR_MRAM = mram_ptr;
+    dpu_alloc_mram->mem_used_mram = mem_used_mram;
+    return score;
+}
+
+#endif
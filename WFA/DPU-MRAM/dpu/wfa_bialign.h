@@ -0,0 +1,31 @@
+#ifndef WFA_BIALIGN_H_
+#define WFA_BIALIGN_H_
+
+#include "../common/common.h"
+#include "wfa_backtracing.h"
+#include "dpu_allocator_mram.h"
+#include "dpu_allocator_wram.h"
+
+// Diagonals of the wavefronts of a BiWFA search computed at a time in the WRAM, a multiple of 8. The tiles of the sources are read
+// with 16 more diagonals in one transfer, so that (BIWFA_TILE + 16) offsets are at most 2048 bytes
+#ifndef BIWFA_TILE
+#define BIWFA_TILE 128
+#endif
+
+// Subproblems of a BiWFA alignment waiting to be aligned
+#ifndef BIWFA_STACK_SIZE
+#define BIWFA_STACK_SIZE 32
+#endif
+
+// Wavefront functions of wfa.c shared with BiWFA
+void affine_wfa_extend(wfa_component *wfa, const wfa_sequences_t *seqs);
+bool affine_wfa_end_reached(wfa_component *wfa, const wfa_sequences_t *seqs, backtrace_wavefront_type component_end, int *alignment_k);
+void affine_wfa_compute_offsets(wfa_component *wfa, wfa_set wfa_set, int lo, int hi, int score, int kernel, uint8_t *bt);
+int affine_wfa_align(dpu_alloc_wram_t *dpu_alloc_wram, edit_cigar_t *cigar, const wfa_sequences_t *seqs, backtrace_wavefront_type component_begin,
+                     backtrace_wavefront_type component_end, int max_score, dpu_alloc_mram_t *dpu_alloc_mram);
+
+// Writes the operations of the optimal alignment of seqs before cigar->begin_offset with the bidirectional WFA, returns its score or
+// MAX_SCORE + 1 when it is above MAX_SCORE
+int wfa_bialign(dpu_alloc_wram_t *dpu_alloc_wram, edit_cigar_t *cigar, const wfa_sequences_t *seqs, dpu_alloc_mram_t *dpu_alloc_mram);
+
+#endif
@@ -25,7 +25,19 @@ ap.add_argument("-a", "--gap_extending", type=int,
 ap.add_argument("-b", "--backtrace", action='store_true',
                 help="Enable backtracing")
 ap.add_argument("-r", "--reduced", action='store_true',
-                help="Enable WFA-Adaptive")
+                help="Enable WFA-Adaptive, same as -H adaptive,10,50")
+ap.add_argument("-H", "--heuristic", type=str,
+                help="WFA heuristic: none, adaptive,min_len,max_dist, xdrop,x, zdrop,z or banded,min_k,max_k, each followed by an optional ,steps")
+ap.add_argument("-B", "--biwfa", action='store_true',
+                help="Compute the backtrace with the bidirectional WFA in O(s) memory")
+ap.add_argument("-S", "--span", type=str, default="global",
+                help="Span of the alignments: global, or ends-free,pattern_begin,pattern_end,text_begin,text_end for the bases of the ends of the sequences left out for free")
+ap.add_argument("-F", "--format", type=str, default="text",
+                help="Format of the output file: text, paf, sam (with -b) or binary")
+ap.add_argument("-T", "--texts", type=str,
+                help="FASTA or FASTQ file of the texts, the input file then holds the patterns (optional)")
+ap.add_argument("-X", "--index", type=str,
+                help="Index file of the pairs, written on the first run and loaded by the next ones (optional)")
 ap.add_argument("-t", "--nr_of_tasklets", type=int,
                 help="NR_TASKLETS (optional)")
 ap.add_argument("-d", "--nr_of_dpus", type=int,
@@ -34,6 +46,10 @@ ap.add_argument("-d", "--nr_of_dpus", type=int,
 parse = ap.parse_args()
 args = vars(parse)
 
+if args["format"] not in ["text", "paf", "sam", "binary"] or (args["format"] in ["paf", "sam"] and not args["backtrace"]):
+    print("Wrong format " + args["format"] + ", it must be text, binary, or paf or sam with -b\n")
+    exit(-1)
+
 
 match_cost = args["match_cost"]
 mismatch_cost = args["mismatch_cost"]
@@ -41,8 +57,19 @@ gap_opening = args["gap_opening"]
 gap_extending = args["gap_extending"]
 
 
-if match_cost > 0 or mismatch_cost <= 0 or gap_opening <= 0 or gap_extending <= 0:
-    print("Wrong affine gap penalties must be  m <= 0 and g, a, x > 0\n")
+if match_cost != 0 or mismatch_cost <= 0 or gap_opening <= 0 or gap_extending <= 0:
+    print("Wrong affine gap penalties must be  m = 0 and g, a, x > 0\n")
+    exit(-1)
+
+heuristic = args["heuristic"]
+if args["reduced"]:
+    if heuristic is not None:
+        print("-r is a shorthand of -H adaptive,10,50, they are not combined")
+        exit(-1)
+    heuristic = "adaptive,10,50"
+heuristic_params = heuristic.split(",") if heuristic is not None else ["none"]
+if heuristic_params[0] not in ["none", "adaptive", "xdrop", "zdrop", "banded"]:
+    print("Unknown WFA heuristic " + heuristic_params[0])
     exit(-1)
 
 read_length = args["read_length"]
@@ -50,6 +77,26 @@ if read_length <= 0:
     print("Undefined input read length")
     exit(-1)
 
+if args["biwfa"] and (not args["backtrace"] or heuristic_params[0] != "none"):
+    print("The bidirectional WFA needs the backtrace and is not combined with a heuristic")
+    exit(-1)
+
+span = args["span"]
+span_params = span.split(",")
+if not (span_params[0] in ["global", "local"] and len(span_params) == 1) and not (span_params[0] == "ends-free" and len(span_params) == 5):
+    print("Wrong span " + span + ", it must be global, local or ends-free,pattern_begin,pattern_end,text_begin,text_end")
+    exit(-1)
+if span_params[0] == "local":
+    print("The WFA computes global and ends-free alignments, not local ones")
+    exit(-1)
+# the wavefront of score 0 of an ends-free alignment starts on the diagonals of the free begins, the next ones are wider by as many diagonals
+begin_diagonals = 0
+if span_params[0] == "ends-free":
+    begin_diagonals = int(span_params[1]) + int(span_params[3])
+if args["biwfa"] and span_params[0] != "global":
+    print("The bidirectional WFA only computes global alignments")
+    exit(-1)
+
 number_reads = args["number_reads"]
 if number_reads <= 0:
     print("Undefined number of input reads")
@@ -65,16 +112,29 @@ else:
     sizeof_offset = 4
 
 read_length = math.ceil((((read_length + nr_of_wrong_bases) + 7)/8))*8
+# patterns and texts are 2-bit packed and followed by a 1-bit N-mask
+packed_length = math.ceil(read_length/32)*8 + math.ceil(read_length/64)*8 + 8
 
-# memory upper limit is estimated according to the max wavefront length which depend on the max_score and including the size of the WRAM allocated memory
-memory_upper_limit = math.ceil((((2*max_score+1) + 7)/8)) * \
-    8*12*sizeof_offset + 9*32 + 2*read_length + max_score*4 + 712
-
+# with BiWFA, the wavefronts of the alignments are in the MRAM and only the subproblems of a score up to 128 are aligned with the WRAM ring
+wavefront_score = max_score
+if args["biwfa"]:
+    wavefront_score = min(max_score, 128)
 
-if args["reduced"]:
-    # used a heuristic to estimate the max wavefront length when applying WFA-Adaptive
+# memory upper limit is estimated according to the max wavefront length which depend on the max_score and including the size of the WRAM allocated memory
+# the wavefronts of the last max(x, o+e) scores (M) and of the last e scores (I and D) are kept in the WRAM, plus the ones being computed
+ring_slots = max(mismatch_cost, gap_opening + gap_extending) + 1 + 2*(gap_extending + 1)
+memory_upper_limit = math.ceil((((2*wavefront_score+3+begin_diagonals) + 15)/16)) * \
+    16*ring_slots*sizeof_offset + ring_slots*32 + 2*packed_length + 712
+
+
+if heuristic_params[0] in ["adaptive", "banded"]:
+    # used a heuristic to estimate the max wavefront length when applying WFA-Adaptive, banded-adaptive keeps its band and the diagonals
+    # reached from it since it was applied, the WRAM ring takes the WRAM segment it is given
+    wavefront_length = 2*60+1+begin_diagonals
+    if heuristic_params[0] == "banded":
+        wavefront_length = int(heuristic_params[2]) - int(heuristic_params[1]) + 1 + 2*max(mismatch_cost, gap_opening + gap_extending)
     memory_upper_limit_red = math.ceil(
-        (((2*60+1) + 7)/8))*8*12*sizeof_offset + 9*32 + 2*read_length + max_score*4 + 712
+        ((wavefront_length + 15)/16))*16*ring_slots*sizeof_offset + ring_slots*32 + 2*packed_length + 712
     if memory_upper_limit_red < memory_upper_limit:
         memory_upper_limit = memory_upper_limit_red
 
@@ -82,8 +142,15 @@ if args["reduced"]:
 memory_upper_limit = int(math.ceil((((memory_upper_limit) + 7)/8))*8)
 
 if args["backtrace"]:
+    # CIGAR, MRAM index of the backtrace record of each score and backtrace bits of a wavefront
     memory_upper_limit = memory_upper_limit + 2 * \
-        read_length + (max_score*2 + 1)*3*sizeof_offset
+        read_length + wavefront_score*4 + wavefront_score + 16
+
+if args["biwfa"] and max_score > 128:
+    # reversed sequences, tiles of the wavefronts of the searches, their wavefront headers and the stack of the subproblems
+    biwfa_slots = max(mismatch_cost, gap_opening + gap_extending) + gap_opening + 1
+    memory_upper_limit = memory_upper_limit + 2*packed_length + \
+        7*(128+16)*sizeof_offset + 72 + 2*biwfa_slots*12 + 32*24
 
 memory_upper_limit = int(memory_upper_limit)
 
@@ -118,10 +185,10 @@ print("Number of allocated tasklets: ", str(NR_TASKLETS))
 print("Number of allocated bytes per tasklets: ", str(memory_upper_limit))
 
 options = ""
-if args["reduced"]:
-    options = options + " -DREDUCE"
 if args["backtrace"]:
     options = options + " -DBACKTRACE"
+if args["biwfa"]:
+    options = options + " -DBIWFA"
 NR_DPUs = 1
 if args["nr_of_dpus"]:
     NR_DPUs = args["nr_of_dpus"]
@@ -130,15 +197,13 @@ if args["nr_of_dpus"]:
 # os.system("echo "+args["input"])
 # os.system("echo wfa"+str(args["reduced"]))
 # os.system("echo "+str(NR_TASKLETS))
-os.system("make clean")
-cmd = "make NR_DPUS="+str(NR_DPUs)+" NR_TASKLETS="+str(NR_TASKLETS)+" FLAGS=\"-DMAX_SCORE="+str(int(max_score))+" -DREAD_SIZE="+str(int(read_length))+" -DWRAM_SEGMENT=" + \
-    str(memory_upper_limit)+" -DMATCH="+str(match_cost)+" -DMISMATCH="+str(mismatch_cost) + \
-    " -DGAP_O="+str(gap_opening)+" -DGAP_E="+str(gap_extending) + options+"\""
+# The DPU binaries only depend on the number of tasklets and the build flags, they are built once and the alignment parameters are passed at run time
+cmd = "make prebuilt PREBUILT_TASKLETS="+str(NR_TASKLETS)+" FLAGS=\""+options.strip()+"\""
 
 os.system("echo "+str(cmd))
 os.system(cmd)
 
 
-cmd = "./build/host " + args["input"] + " " + \
-    args["output"] + " " + str(number_reads)
+cmd = "./build/host -t "+str(NR_TASKLETS)+" -d "+str(NR_DPUs)+" -l "+str(int(read_length))+" -s "+str(int(max_score))+" -w "+str(memory_upper_limit) + \
+    " -p "+str(match_cost)+","+str(mismatch_cost)+","+str(gap_opening)+","+str(gap_extending)+" -H "+",".join(heuristic_params)+" -a "+span+" -f "+args["format"]+(" -T "+args["texts"] if args["texts"] else "")+(" -x "+args["index"] if args["index"] else "")+" " + args["input"] + " " + args["output"] + " " + str(number_reads)
 os.system(cmd)
@@ -60,6 +60,14 @@ SOFTWARE. */
 
 #define DPU_CAPACITY (64 << 20) 
 
+// MRAM heap shared by the host buffers and the working memory of the tasklets
+#define MRAM_HEAP_SIZE 64000000
+
+// WRAM of a DPU, the stack of each tasklet is reserved in it and the working memory of the tasklets is allocated from the rest
+#define WRAM_SIZE (64 << 10)
+#define WRAM_STACK_SIZE 1024
+
+// Default alignment parameters of the host, the kernels read the parameters of a run from the DPU params at launch
 #ifndef MATCH
 #define MATCH 0
 #endif
@@ -137,6 +145,22 @@ typedef struct wfa_component
     int hi_base;
 } wfa_component;
 
+// The wavefronts are stored in the WRAM
+#define MRAM_TASKLET_SEGMENT(read_size, max_score, penalties) 0
+
+// WRAM allocated by each tasklet, the WRAM segment that holds the buffers of a pair and its wavefronts
+#define WRAM_TASKLET_SEGMENT(read_size, max_score, penalties, wram_segment) ROUND_UP_MULTIPLE_8(wram_segment)
+// Part of the WRAM segment a pair takes before its wavefronts: the request, the result and the CIGAR, the packed sequences with a word
+// past their end, the operations of the CIGAR and the wavefront of each score, a pointer of the DPU is 32-bit
+#define WRAM_PAIR_BUFFERS_SIZE(read_size) \
+    (ROUND_UP_MULTIPLE_8(sizeof(request_t)) + ROUND_UP_MULTIPLE_8(sizeof(result_t)) + ROUND_UP_MULTIPLE_8(sizeof(edit_cigar_t)) + \
+     2 * ROUND_UP_MULTIPLE_8(PACKED_SIZE(read_size) + 8))
+#ifdef BACKTRACE
+#define WRAM_SEGMENT_MIN(read_size, max_score) (WRAM_PAIR_BUFFERS_SIZE(read_size) + ROUND_UP_MULTIPLE_8(2 * (read_size)) + ROUND_UP_MULTIPLE_8(((uint64_t)(max_score) + 1) * sizeof(uint32_t)))
+#else
+#define WRAM_SEGMENT_MIN(read_size, max_score) (WRAM_PAIR_BUFFERS_SIZE(read_size) + ROUND_UP_MULTIPLE_8(((uint64_t)(max_score) + 1) * sizeof(uint32_t)))
+#endif
+
 typedef struct wfa_set
 {
     bool m_sub_null;
@@ -167,34 +191,156 @@ typedef struct
     int begin_offset;
     int end_offset;
     int score;
+    int pattern_begin; /* Span of the alignment on the pattern and the text */
+    int pattern_end;
+    int text_begin;
+    int text_end;
 } edit_cigar_t;
 
+// Sequences are 2-bit packed, 4 bases per byte (A=0, C=1, G=2, T=3), and followed by an N-mask with 1 bit per base.
+// Any base other than A, C, G and T is stored as an N
+#define PACKED_BASES_SIZE(len) ROUND_UP_MULTIPLE_8(((len) + 3) / 4)
+#define PACKED_MASK_SIZE(len) ROUND_UP_MULTIPLE_8(((len) + 7) / 8)
+#define PACKED_SIZE(len) (PACKED_BASES_SIZE(len) + PACKED_MASK_SIZE(len))
+#define PACKED_READ_SIZE PACKED_SIZE(READ_SIZE)
+
+// 2-bit code of the base i of a packed sequence
+#define PACKED_CODE(bases, i) ((((const uint8_t *)(bases))[(i) >> 2] >> (((i)&3) << 1)) & 3)
+// Base i of a packed sequence, N bases are returned as 4 so that they only match N bases
+#define PACKED_BASE(bases, mask, i) (PACKED_CODE(bases, i) | (((((const uint8_t *)(mask))[(i) >> 3] >> ((i)&7)) & 1) << 2))
+
+// Estimated cost of aligning a read pair, used by the host to balance the work of the DPUs.
+// The number of wavefronts grows with the score and the extensions with the lengths
+#define PAIR_COST(pattern_len, text_len, edits) ((uint64_t)(pattern_len) + (text_len) + 16 * (uint64_t)(edits) * (edits))
+
 typedef struct request_t
 {
     awf_offset_t pattern_len;
     awf_offset_t text_len;
     uint32_t idx;
+    uint32_t sequence_offset; /* Offset of the packed pattern in the sequences of the DPU, the packed text follows it */
+    uint32_t padding;         /* Padding to ensure the alignment of the struct */
 } request_t;
 
+// With BACKTRACE, the kernels write the CIGAR of a pair run-length encoded after the CIGARs of the previous pairs of the batch. A byte
+// is a run of 1 to CIGAR_RUN_MAX operations, the length - 1 in its upper 6 bits and the operation in its lower 2 bits, so the CIGAR
+// of a pair is never longer than its operations. Longer runs take several bytes, the host merges them when it writes the CIGAR
+#define CIGAR_RUN_MAX 64
+#define CIGAR_OP_CODE(op) (((op) == 'M') ? 0 : ((op) == 'X') ? 1 : ((op) == 'I') ? 2 : 3)
+#define CIGAR_RUN(op, length) ((uint8_t)((((length)-1) << 2) | CIGAR_OP_CODE(op)))
+#define CIGAR_RUN_OP(run) ("MXID"[(run)&3])
+#define CIGAR_RUN_LENGTH(run) (((run) >> 2) + 1)
+// Bytes reserved for the CIGAR of a pair of reads of at most read_size bases
+#define CIGAR_CAPACITY(read_size) ROUND_UP_MULTIPLE_8(2 * (read_size))
+// A pair above the max score, or dropped by a heuristic, is rejected with a score of max_score + 1
+#define SCORE_REJECTED(score, max_score) ((score) > (int)(max_score))
+
 typedef struct result_t
 {
-    int max_operations;
-    int begin_offset;
-    int end_offset;
+    uint32_t cigar_offset; /* Offset of the CIGAR in the CIGARs of the batch */
+    uint32_t cigar_length; /* Number of runs of the CIGAR */
     int score;
-    uint64_t cycles;
-    uint32_t idx;    
+    int pattern_begin; /* Span of the alignment, the begins are -1 when the kernel doesn't compute them */
+    int pattern_end;
+    int text_begin;
+    int text_end;
+    uint32_t idx;
+    uint64_t cycles; /* Cycles spent aligning the pair, filled with -DPROFILE */
 } result_t;
 
+// Statistics written by each tasklet at the end of a batch, the DMA and memory fields are only filled with -DPROFILE
+typedef struct tasklet_stats_t
+{
+    uint64_t nb_reads;    /* Number of reads aligned by the tasklet */
+    uint64_t cycles;      /* Cycles from the launch until the tasklet finished */
+    uint64_t dma_read;    /* Bytes read from the MRAM by the tasklet */
+    uint64_t dma_written; /* Bytes written to the MRAM by the tasklet */
+    uint32_t wram_peak;   /* WRAM high-water mark of the tasklet in bytes */
+    uint32_t mram_peak;   /* MRAM high-water mark of the working memory of the tasklet in bytes */
+} tasklet_stats_t;
+
+// Penalties of the alignment, read by the kernels from the DPU params
+typedef struct penalties_t
+{
+    int32_t match;
+    int32_t mismatch;
+    int32_t gap_o;
+    int32_t gap_e;
+} penalties_t;
+
+#define DEFAULT_PENALTIES {MATCH, MISMATCH, GAP_O, GAP_E}
+#define PENALTIES_USAGE "match,mismatch,gap_o,gap_e"
+
+// Span of the alignment, read by the kernels from the DPU params. A global alignment aligns the whole sequences, an ends-free
+// alignment leaves out up to the given number of bases at the begin and the end of the pattern and of the text for free, and a local
+// alignment (Smith-Waterman) aligns the substrings of the lowest score, which needs a match cost below 0
+#define SPAN_GLOBAL 0
+#define SPAN_ENDS_FREE 1
+#define SPAN_LOCAL 2
+
+typedef struct span_t
+{
+    int32_t mode;
+    int32_t pattern_begin_free;
+    int32_t pattern_end_free;
+    int32_t text_begin_free;
+    int32_t text_end_free;
+    int32_t padding;
+} span_t;
+
+#define DEFAULT_SPAN {SPAN_GLOBAL, 0, 0, 0, 0, 0}
+#define SPAN_USAGE "global|local|ends-free,pattern_begin,pattern_end,text_begin,text_end"
+
+// Heuristic of the WFA, selected at run time with -H and applied every steps scores. WFA-adaptive drops the diagonals whose distance
+// to the end is more than max_distance_threshold above the closest one once the wavefront has min_wavefront_length diagonals, X-drop
+// drops the diagonals whose score fell more than drop below the best one, banded-adaptive keeps the diagonals within
+// [band_min_k, band_max_k] of the one closest to the end, and Z-drop abandons the alignment once the best scores of its wavefronts fell
+// more than drop below the best one. The scores of X-drop and Z-drop count -match per aligned base, or 1 when match is 0
+typedef enum wfa_heuristic_strategy_t
+{
+    WFA_HEURISTIC_NONE,
+    WFA_HEURISTIC_ADAPTIVE,
+    WFA_HEURISTIC_XDROP,
+    WFA_HEURISTIC_ZDROP,
+    WFA_HEURISTIC_BANDED_ADAPTIVE
+} wfa_heuristic_strategy_t;
+
+typedef struct wfa_heuristic_t
+{
+    int32_t strategy;               /* wfa_heuristic_strategy_t */
+    int32_t steps;                  /* Scores between two applications of the heuristic */
+    int32_t min_wavefront_length;   /* WFA-adaptive */
+    int32_t max_distance_threshold; /* WFA-adaptive */
+    int32_t drop;                   /* X-drop and Z-drop */
+    int32_t band_min_k;             /* Banded-adaptive */
+    int32_t band_max_k;             /* Banded-adaptive */
+} wfa_heuristic_t;
+
+// -DREDUCE makes WFA-adaptive with the parameters of upstream WFA the default of the host
+#ifdef REDUCE
+#define DEFAULT_HEURISTIC {WFA_HEURISTIC_ADAPTIVE, 1, 10, 50, 0, 0, 0}
+#else
+#define DEFAULT_HEURISTIC {WFA_HEURISTIC_NONE, 1, 0, 0, 0, 0, 0}
+#endif
+#define HEURISTIC_USAGE "none|adaptive,min_len,max_dist|xdrop,x|zdrop,z|banded,min_k,max_k[,steps]"
+
 typedef struct DPUParams
 {
     uint32_t dpuNumReads;        /* Number of reads assigned to the DPU */
     uint32_t dpuRequests_m;      /* Base address of the requests in the MRAM */
     uint32_t dpuResults_m;       /* Base address of the results in the MRAM */
-    uint32_t dpuPatterns_m;      /* Base address of the patterns sequences in the MRAM */
-    uint32_t dpuTexts_m;         /* Base address of the text sequences in the MRAM */
-    uint32_t dpuOperations_m;    /* Base address of the traceback operations in the MRAM */
+    uint32_t dpuSequences_m;     /* Base address of the packed sequences in the MRAM */
+    uint32_t dpuOperations_m;    /* Base address of the CIGARs in the MRAM */
     uint32_t mramTotalAllocated; /* Size of the MRAM memory allocated by the host */
+    uint32_t dpuActiveBuffer;    /* MRAM region of the batch to align (0 or 1) */
+    uint32_t dpuBufferSize;      /* Size of an MRAM region */
+    uint32_t dpuTaskletStats_m;  /* Base address of the statistics of the tasklets in the MRAM */
+    uint32_t readSize;           /* Length of the longest read */
+    uint32_t maxScore;           /* Highest alignment score computed */
+    uint32_t wramSegment;        /* Size of the WRAM segment of a tasklet */
+    penalties_t penalties;       /* Penalties of the alignment */
+    span_t span;                 /* Span of the alignment */
+    wfa_heuristic_t heuristic;   /* Heuristic of the alignment */
     uint32_t padding;            /* Padding to ensure the alignment of the struct */
 } DPUParams;
 
@@ -1,4 +1,5 @@
 #include "dpu_allocator_wram.h"
+#include "dpu_profile.h"
 #include <assert.h>
 #include "common.h"
 
@@ -23,6 +24,7 @@ char *allocate_new(dpu_alloc_wram_t *dpu_alloc_obj, unsigned int size)
     }
     size = ROUND_UP_MULTIPLE_8(size);
     dpu_alloc_obj->mem_used_wram += size;
+    PROFILE_WRAM_USED(dpu_alloc_obj->mem_used_wram);
     char *allocated = (char *)dpu_alloc_obj->CUR_PTR_WRAM;
     dpu_alloc_obj->CUR_PTR_WRAM += size;
 
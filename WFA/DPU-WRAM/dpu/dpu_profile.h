@@ -0,0 +1,24 @@
+#ifndef DPU_PROFILE_H_
+#define DPU_PROFILE_H_
+
+#include <defs.h>
+#include <mram.h>
+#include "common.h"
+
+// Statistics of the tasklets of the current launch, written to the MRAM at the end of the batch
+extern tasklet_stats_t tasklet_stats[NR_TASKLETS];
+
+#ifdef PROFILE
+// Count the bytes moved by the DMA transfers of each tasklet, a macro is not expanded inside itself so the SDK functions are still called
+#define mram_read(from, to, size) (tasklet_stats[me()].dma_read += (size), mram_read(from, to, size))
+#define mram_write(from, to, size) (tasklet_stats[me()].dma_written += (size), mram_write(from, to, size))
+
+// Raise the WRAM and MRAM high-water marks of the tasklet to the memory it is using
+#define PROFILE_WRAM_USED(bytes) (tasklet_stats[me()].wram_peak = MAX(tasklet_stats[me()].wram_peak, (uint32_t)(bytes)))
+#define PROFILE_MRAM_USED(bytes) (tasklet_stats[me()].mram_peak = MAX(tasklet_stats[me()].mram_peak, (uint32_t)(bytes)))
+#else
+#define PROFILE_WRAM_USED(bytes)
+#define PROFILE_MRAM_USED(bytes)
+#endif
+
+#endif
@@ -53,6 +53,10 @@ SOFTWARE. */
 
 #include "dpu_allocator_wram.h"
 #include <barrier.h>
+#include <mutex.h>
+#include <perfcounter.h>
+#include "dpu_profile.h"
+#include "dpu_params.h"
 
 void edit_cigar_allocate(
     edit_cigar_t *edit_cigar,
@@ -64,12 +68,34 @@ void edit_cigar_allocate(
     edit_cigar->begin_offset = edit_cigar->max_operations - 1;
     edit_cigar->end_offset = edit_cigar->max_operations;
     edit_cigar->score = INT32_MIN;
+    edit_cigar->pattern_begin = 0;
+    edit_cigar->pattern_end = pattern_length;
+    edit_cigar->text_begin = 0;
+    edit_cigar->text_end = text_length;
 }
 
-void affine_wfa_reduce_wvs(wfa_component *wfa, awf_offset_t pattern_length, awf_offset_t text_length, int score)
+// Bases of the ends of the sequences left out for free by the span of the launch
+span_free_t span_free(int pattern_length, int text_length)
+{
+    if (SPAN.mode == SPAN_ENDS_FREE)
+        return (span_free_t){MIN(SPAN.pattern_begin_free, pattern_length), MIN(SPAN.pattern_end_free, pattern_length),
+                             MIN(SPAN.text_begin_free, text_length), MIN(SPAN.text_end_free, text_length)};
+    return (span_free_t){0, 0, 0, 0};
+}
+
+// Begin of the alignment when the backtrace isn't computed, it is unknown when the begin of a sequence is free
+void span_unknown_begin(edit_cigar_t *cigar, span_free_t free)
+{
+    if (free.pattern_begin > 0)
+        cigar->pattern_begin = -1;
+    if (free.text_begin > 0)
+        cigar->text_begin = -1;
+}
+
+// WFA-adaptive, drops the diagonals of the ends of the wavefront whose distance to the end is more than max_distance_threshold above
+// the closest one
+void affine_wfa_reduce_wvs(wfa_component *wfa, int pattern_length, int text_length, int min_wavefront_length, int max_distance_threshold)
 {
-    int min_wavefront_length = 10;
-    int max_distance_threshold = 50;
     int alignment_k = AFFINE_WAVEFRONT_DIAGONAL(text_length, pattern_length);
 
     if (wfa == NULL || wfa->m_null)
@@ -139,6 +165,136 @@ void affine_wfa_reduce_wvs(wfa_component *wfa, awf_offset_t pattern_length, awf_
     }
 }
 
+// State of the heuristic of an alignment
+typedef struct wfa_heuristic_state_t
+{
+    int next_score;   /* Next score the heuristic is applied to */
+    int last_score;   /* Last score of a wavefront kept by the heuristic */
+    int max_sw_score; /* Best X-drop and Z-drop score of the alignment */
+    int max_sw_k;     /* Diagonal of the best score */
+} wfa_heuristic_state_t;
+
+// Distance of the diagonal k of a wavefront to the end of the alignment
+static inline int affine_wfa_distance(int k, awf_offset_t offset, int pattern_length, int text_length)
+{
+    return MAX(pattern_length - AFFINE_WAVEFRONT_V(k, offset), text_length - AFFINE_WAVEFRONT_H(k, offset));
+}
+
+// X-drop and Z-drop score of the diagonal k of the wavefront of score, an aligned base scores 1 as the wavefronts score a match 0
+static inline int affine_wfa_sw_score(int k, awf_offset_t offset, int score)
+{
+    return (AFFINE_WAVEFRONT_V(k, offset) + AFFINE_WAVEFRONT_H(k, offset)) / 2 - score;
+}
+
+// Keeps the diagonals within [band_min_k, band_max_k] of the diagonal closest to the end
+void affine_wfa_band_wvs(wfa_component *wfa, int pattern_length, int text_length, int band_min_k, int band_max_k)
+{
+    int min_distance = affine_wfa_distance(wfa->klo, wfa->mwavefront[wfa->klo], pattern_length, text_length);
+    int min_k = wfa->klo;
+    for (int k = wfa->klo + 1; k <= wfa->khi; ++k)
+    {
+        int distance = affine_wfa_distance(k, wfa->mwavefront[k], pattern_length, text_length);
+        if (distance < min_distance)
+        {
+            min_distance = distance;
+            min_k = k;
+        }
+    }
+    wfa->klo = MAX(wfa->klo, min_k + band_min_k);
+    wfa->khi = MIN(wfa->khi, min_k + band_max_k);
+}
+
+// Drops the diagonals of the ends of the wavefront of score whose score fell more than drop below the best one
+void affine_wfa_xdrop_wvs(wfa_component *wfa, int score, int drop, wfa_heuristic_state_t *state)
+{
+    int klo = wfa->klo;
+    int khi = wfa->khi;
+    for (int k = wfa->klo; k <= wfa->khi; ++k)
+    {
+        int sw_score = affine_wfa_sw_score(k, wfa->mwavefront[k], score);
+        if (sw_score > state->max_sw_score)
+        {
+            state->max_sw_score = sw_score;
+            state->max_sw_k = k;
+        }
+    }
+    while (wfa->klo <= wfa->khi && state->max_sw_score - affine_wfa_sw_score(wfa->klo, wfa->mwavefront[wfa->klo], score) > drop)
+        ++wfa->klo;
+    while (wfa->khi >= wfa->klo && state->max_sw_score - affine_wfa_sw_score(wfa->khi, wfa->mwavefront[wfa->khi], score) > drop)
+        --wfa->khi;
+    if (wfa->klo > wfa->khi)
+    {
+        wfa->m_null = true;
+        wfa->i_null = true;
+        wfa->d_null = true;
+        wfa->klo = klo;
+        wfa->khi = khi;
+    }
+}
+
+// Returns true when the best score of the wavefront of score fell more than drop below the best one, allowing GAP_E per diagonal
+// between them
+bool affine_wfa_zdrop(wfa_component *wfa, int score, int drop, wfa_heuristic_state_t *state)
+{
+    int cmax_sw_score = affine_wfa_sw_score(wfa->klo, wfa->mwavefront[wfa->klo], score);
+    int cmax_k = wfa->klo;
+    for (int k = wfa->klo + 1; k <= wfa->khi; ++k)
+    {
+        int sw_score = affine_wfa_sw_score(k, wfa->mwavefront[k], score);
+        if (sw_score > cmax_sw_score)
+        {
+            cmax_sw_score = sw_score;
+            cmax_k = k;
+        }
+    }
+    if (cmax_sw_score > state->max_sw_score)
+    {
+        state->max_sw_score = cmax_sw_score;
+        state->max_sw_k = cmax_k;
+        return false;
+    }
+    return state->max_sw_score - cmax_sw_score > drop + GAP_E * ABS(cmax_k - state->max_sw_k);
+}
+
+// Applies the heuristic of the launch to the wavefront of score every HEURISTIC.steps scores, returns true when the alignment is
+// abandoned
+bool affine_wfa_heuristic(wfa_component *wfa, int pattern_length, int text_length, int score, wfa_heuristic_state_t *state)
+{
+    if (HEURISTIC.strategy == WFA_HEURISTIC_NONE)
+        return false;
+    // The next scores only depend on the wavefronts of the last MAX(MISMATCH, GAP_O + GAP_E) scores, the alignment is abandoned once
+    // the heuristic dropped all of them. Z-drop only checks a wavefront every steps scores, it drops the ones in between
+    int window = MAX(MISMATCH, GAP_O + GAP_E);
+    if (HEURISTIC.strategy == WFA_HEURISTIC_ZDROP)
+        window += HEURISTIC.steps - 1;
+    if (wfa == NULL || wfa->m_null)
+        return score - state->last_score > window;
+    if (score >= state->next_score)
+    {
+        state->next_score = score + HEURISTIC.steps;
+        switch (HEURISTIC.strategy)
+        {
+        case WFA_HEURISTIC_ADAPTIVE:
+            affine_wfa_reduce_wvs(wfa, pattern_length, text_length, HEURISTIC.min_wavefront_length, HEURISTIC.max_distance_threshold);
+            break;
+        case WFA_HEURISTIC_BANDED_ADAPTIVE:
+            affine_wfa_band_wvs(wfa, pattern_length, text_length, HEURISTIC.band_min_k, HEURISTIC.band_max_k);
+            break;
+        case WFA_HEURISTIC_XDROP:
+            affine_wfa_xdrop_wvs(wfa, score, HEURISTIC.drop, state);
+            break;
+        default:
+            if (affine_wfa_zdrop(wfa, score, HEURISTIC.drop, state))
+                return score - state->last_score > window;
+        }
+    }
+    else if (HEURISTIC.strategy == WFA_HEURISTIC_ZDROP)
+        return false;
+    if (!wfa->m_null)
+        state->last_score = score;
+    return false;
+}
+
 // insert new score
 wfa_component *allocate_new_score(dpu_alloc_wram_t *allocator, int score, int lo, int hi, int kernel)
 {
@@ -182,12 +338,48 @@ wfa_component *allocate_new_score(dpu_alloc_wram_t *allocator, int score, int lo
     return wfa_cmpnt;
 }
 
-// wavefront extend matching
-void affine_wfa_extend(wfa_component *wfa, char *pattern, char *text, awf_offset_t pattern_len, awf_offset_t text_len, int score)
+// 16 bases of a packed sequence starting from base i
+static inline uint32_t packed_bases16(const uint32_t *bases, int i)
+{
+    int shift = (i & 15) << 1;
+    uint32_t word = bases[i >> 4] >> shift;
+    if (shift != 0)
+        word |= bases[(i >> 4) + 1] << (32 - shift);
+    return word;
+}
+
+// 32 bits of the N-mask of a packed sequence starting from base i
+static inline uint32_t packed_mask32(const uint32_t *mask, int i)
+{
+    int shift = i & 31;
+    uint32_t word = mask[i >> 5] >> shift;
+    if (shift != 0)
+        word |= mask[(i >> 5) + 1] << (32 - shift);
+    return word;
+}
+
+// Whether a packed sequence has N bases, the extend only compares the N-masks when one of the sequences has some
+bool packed_has_n(const char *sequence, int length)
+{
+    const uint32_t *mask = (const uint32_t *)(sequence + PACKED_BASES_SIZE(length));
+    uint32_t n = 0;
+    for (int i = 0; i < PACKED_MASK_SIZE(length) / 4; ++i)
+        n |= mask[i];
+    return n != 0;
+}
+
+// wavefront extend matching, the packed sequences are compared 16 bases at a time. The first comparison of a diagonal stops at a
+// 16-base boundary of the pattern, so that the next words of the pattern are aligned loads and only the text words are shifted
+void affine_wfa_extend(wfa_component *wfa, char *pattern, char *text, awf_offset_t pattern_len, awf_offset_t text_len, bool has_n)
 {
     if (wfa == NULL || wfa->m_null)
         return;
 
+    const uint32_t *pattern_bases = (const uint32_t *)pattern;
+    const uint32_t *text_bases = (const uint32_t *)text;
+    const uint32_t *pattern_mask = (const uint32_t *)(pattern + PACKED_BASES_SIZE(pattern_len));
+    const uint32_t *text_mask = (const uint32_t *)(text + PACKED_BASES_SIZE(text_len));
+
     int klo = wfa->klo;
     for (int k = klo; k <= wfa->khi; ++k)
     {
@@ -197,33 +389,71 @@ void affine_wfa_extend(wfa_component *wfa, char *pattern, char *text, awf_offset
 
         int v = moffset - k;
         int h = moffset;
+        if (v < 0 || h < 0)
+            continue;
 
+        // Bases left on the diagonal
+        int end = MIN(pattern_len - v, text_len - h);
         int count = 0;
-        while ((v < pattern_len && h < text_len && v >= 0 && h >= 0) && pattern[v++] == text[h++])
+        while (count < end)
         {
-            ++count;
+            int p = v + count;
+            int t = h + count;
+            // Bases to the next 16-base boundary of the pattern, the bits above them are not compared
+            int step = 16 - (p & 15);
+            // Matching bases XOR to 0, the lowest set bit gives the first mismatch
+            uint32_t diff = (pattern_bases[p >> 4] >> ((p & 15) << 1)) ^ packed_bases16(text_bases, t);
+            int matches = MIN((diff == 0) ? 16 : (__builtin_ctz(diff) >> 1), step);
+            if (has_n)
+                matches = MIN(matches, __builtin_ctz((packed_mask32(pattern_mask, p) ^ packed_mask32(text_mask, t)) | 0x10000));
+            count += matches;
+            if (matches < step)
+                break;
         }
-        wfa->mwavefront[k] += count;
+        wfa->mwavefront[k] += MIN(count, end);
     }
 }
-// end reached
-bool affine_wfa_end_reached(wfa_component *wfa, awf_offset_t pattern_len, awf_offset_t text_len, int score)
+// end reached, on the diagonal of the last cell or on the diagonals of the free ends of the span. alignment_k is set to the diagonal the
+// alignment ends on
+bool affine_wfa_end_reached(wfa_component *wfa, awf_offset_t pattern_len, awf_offset_t text_len, span_free_t free, int *alignment_k)
 {
 
     if (wfa == NULL || wfa->m_null)
         return false;
 
-    int alignment_k =
+    int end_k =
         AFFINE_WAVEFRONT_DIAGONAL(text_len, pattern_len);
-    int alignment_offset =
+    int end_offset =
         AFFINE_WAVEFRONT_OFFSET(text_len, pattern_len);
 
-    if (wfa->klo <= alignment_k && wfa->khi >= alignment_k)
+    if (wfa->klo <= end_k && wfa->khi >= end_k)
     {
-        int offset = wfa->mwavefront[alignment_k];
+        int offset = wfa->mwavefront[end_k];
 
-        if (offset >= alignment_offset)
+        if (offset >= end_offset)
+        {
+            *alignment_k = end_k;
             return true;
+        }
+    }
+
+    // The diagonals above end the alignment on the last column before the free end of the pattern, the ones below on the last row before
+    // the free end of the text
+    for (int k = MAX(wfa->klo, end_k + 1); k <= MIN(wfa->khi, end_k + free.pattern_end); ++k)
+    {
+        if (wfa->mwavefront[k] >= text_len)
+        {
+            *alignment_k = k;
+            return true;
+        }
+    }
+    for (int k = MIN(wfa->khi, end_k - 1); k >= MAX(wfa->klo, end_k - free.text_end); --k)
+    {
+        if (AFFINE_WAVEFRONT_V(k, wfa->mwavefront[k]) >= pattern_len)
+        {
+            *alignment_k = k;
+            return true;
+        }
     }
 
     return false;
@@ -342,35 +572,54 @@ void affine_wfa_compute_next(wfa_component **wavefronts, dpu_alloc_wram_t *alloc
 void affine_wfa_compute(dpu_alloc_wram_t *dpu_alloc_wram, edit_cigar_t *cigar, char pattern[], char text[], int pattern_length, int text_length)
 {
 
-    wfa_component *wavefronts[MAX_SCORE + 1] = {NULL};
+    // The highest score is only known at launch, the wavefronts are allocated in the WRAM segment
+    wfa_component **wavefronts = (wfa_component **)allocate_new(dpu_alloc_wram, (MAX_SCORE + 1) * sizeof(wfa_component *));
+    memset(wavefronts, 0, (MAX_SCORE + 1) * sizeof(wfa_component *));
 
-    wavefronts[0] = allocate_new_score(dpu_alloc_wram, 0, 0, 0, 0);
-    wavefronts[0]->mwavefront[0] = 0;
+    // The alignment starts on the diagonals of the free begins of the span, the ones above 0 on the first row and the ones below on the first
+    // column
+    span_free_t free = span_free(pattern_length, text_length);
+    wavefronts[0] = allocate_new_score(dpu_alloc_wram, 0, -free.pattern_begin, free.text_begin, 0);
+    for (int k = -free.pattern_begin; k <= free.text_begin; ++k)
+        wavefronts[0]->mwavefront[k] = MAX(k, 0);
 
+    bool has_n = packed_has_n(pattern, pattern_length) || packed_has_n(text, text_length);
+    wfa_heuristic_state_t heuristic = {0, 0, 0, 0};
     int score = 0;
     while (true)
     {
 
-        affine_wfa_extend(wavefronts[score], pattern, text, pattern_length, text_length, score);
+        affine_wfa_extend(wavefronts[score], pattern, text, pattern_length, text_length, has_n);
 
-#ifdef REDUCE
-        affine_wfa_reduce_wvs(wavefronts[score], pattern_length, text_length, score);
-#endif
-        if (affine_wfa_end_reached(wavefronts[score], pattern_length, text_length, score))
+        int alignment_k;
+        if (affine_wfa_end_reached(wavefronts[score], pattern_length, text_length, free, &alignment_k))
         {
+            // The last cell of the alignment, on the last row or column
+            cigar->pattern_end = MIN(pattern_length, text_length - alignment_k);
+            cigar->text_end = cigar->pattern_end + alignment_k;
 #ifdef BACKTRACE
-            affine_wavefronts_backtrace(wavefronts, cigar, pattern, pattern_length, text, text_length, score);
+            affine_wavefronts_backtrace(wavefronts, cigar, pattern, pattern_length, text, text_length, score, alignment_k, free);
+#else
+            span_unknown_begin(cigar, free);
 #endif
             cigar->score = score;
             return;
         }
 
+        // An alignment abandoned by the heuristic is reported above the max score
+        if (affine_wfa_heuristic(wavefronts[score], pattern_length, text_length, score, &heuristic))
+        {
+            cigar->score = MAX_SCORE + 1;
+            return;
+        }
+
         ++score;
         if (score > MAX_SCORE)
         {
             cigar->score = score;
 #ifdef BACKTRACE
-            affine_wavefronts_backtrace(wavefronts, cigar, pattern, pattern_length, text, text_length, score);
+            affine_wavefronts_backtrace(wavefronts, cigar, pattern, pattern_length, text, text_length, score,
+                                        AFFINE_WAVEFRONT_DIAGONAL(text_length, pattern_length), free);
 #endif
             return;
         }
@@ -378,10 +627,83 @@ void affine_wfa_compute(dpu_alloc_wram_t *dpu_alloc_wram, edit_cigar_t *cigar, c
     }
 }
 
+// Reads a packed sequence from the MRAM, DMA transfers must be less than 2048
+void read_packed_sequence(uint32_t sequence_m, char *sequence, int length)
+{
+    int size = PACKED_SIZE(length);
+    for (int segment = 0; segment < size; segment += 2048)
+        mram_read((__mram_ptr void const *)(sequence_m + segment), &sequence[segment], MIN(2048, size - segment));
+}
+
+// Index of the next read of the batch to align, shared by the tasklets
+uint32_t next_read;
+MUTEX_INIT(next_read_mutex);
+// Offset of the next CIGAR in the CIGARs of the batch, shared by the tasklets
+uint32_t next_cigar;
+MUTEX_INIT(next_cigar_mutex);
+BARRIER_INIT(start_barrier, NR_TASKLETS);
+
+// Parameters of the current launch
+DPUParams dpu_params;
+
+// Statistics of the tasklets of the current launch
+tasklet_stats_t tasklet_stats[NR_TASKLETS];
+
+// Claims the next read of the batch, all the reads are claimed once it returns nb_reads_per_dpu or more
+uint32_t claim_read()
+{
+    mutex_lock(next_read_mutex);
+    uint32_t read_idx = next_read++;
+    mutex_unlock(next_read_mutex);
+    return read_idx;
+}
+
+#ifdef BACKTRACE
+// Claims size bytes of the CIGARs of the batch, returns their offset
+uint32_t claim_cigar(uint32_t size)
+{
+    mutex_lock(next_cigar_mutex);
+    uint32_t cigar_offset = next_cigar;
+    next_cigar += ROUND_UP_MULTIPLE_8(size);
+    mutex_unlock(next_cigar_mutex);
+    return cigar_offset;
+}
+
+// Replaces the operations of the alignment by their runs at the beginning of its operations buffer, returns the number of runs.
+// A run is written after the operations it encodes are read, and before the operations of the next runs
+uint32_t cigar_encode(edit_cigar_t *cigar)
+{
+    uint8_t *runs = (uint8_t *)cigar->operations;
+    uint32_t nb_runs = 0;
+    int i = cigar->begin_offset;
+    while (i < cigar->end_offset)
+    {
+        char op = cigar->operations[i];
+        int length = 1;
+        while (i + length < cigar->end_offset && cigar->operations[i + length] == op && length < CIGAR_RUN_MAX)
+            ++length;
+        runs[nb_runs++] = CIGAR_RUN(op, length);
+        i += length;
+    }
+    return nb_runs;
+}
+
+// Writes the CIGAR of the alignment run-length encoded after the CIGARs of the previous pairs, DMA transfers must be less than 2048
+void store_cigar(edit_cigar_t *cigar, uint32_t cigars_m, result_t *result)
+{
+    uint32_t size = cigar_encode(cigar);
+    result->cigar_offset = claim_cigar(size);
+    result->cigar_length = size;
+    for (uint32_t segment = 0; segment < size; segment += 2048)
+        mram_write(&cigar->operations[segment], (__mram_ptr void *)(cigars_m + result->cigar_offset + segment), MIN(2048, ROUND_UP_MULTIPLE_8(size - segment)));
+}
+#endif
+
 int main()
 {
     mem_reset();
     uint32_t tasklet_id = me();
+    memset(&tasklet_stats[tasklet_id], 0, sizeof(tasklet_stats_t));
     dpu_alloc_wram_t dpu_alloc_wram;
 
     // Load parameters
@@ -393,111 +715,79 @@ int main()
     if (nb_reads_per_dpu <= 0)
         return 0;
 
-    int nb_reads_per_tasklets = (((nb_reads_per_dpu + NR_TASKLETS) / NR_TASKLETS));
+    // Tasklet 0 shares the parameters of the launch and resets the read and CIGAR counters of the previous launch and the cycle counter
+    if (tasklet_id == 0)
+    {
+        dpu_params = params_w;
+        next_read = 0;
+        next_cigar = 0;
+        perfcounter_config(COUNT_CYCLES, true);
+    }
+    barrier_wait(&start_barrier);
+
     // Each tasklet allocates WRAM segment
     dpu_alloc_wram = init_dpu_alloc_wram(WRAM_SEGMENT);
 
-    uint32_t dpuRequests_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuRequests_m;
-    uint32_t dpuResults_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuResults_m;
-    uint32_t dpuPatterns_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuPatterns_m;
-    uint32_t dpuTexts_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuTexts_m;
-    uint32_t dpuOperations_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuOperations_m;
-
-    for (int read_nb = 0; read_nb < nb_reads_per_tasklets; ++read_nb)
+    // Base address of the MRAM region holding the batch
+    uint32_t dpuBuffer_m = ((uint32_t)DPU_MRAM_HEAP_POINTER) + params_w.dpuActiveBuffer * params_w.dpuBufferSize;
+    uint32_t dpuRequests_m = dpuBuffer_m + params_w.dpuRequests_m;
+    uint32_t dpuResults_m = dpuBuffer_m + params_w.dpuResults_m;
+    uint32_t dpuSequences_m = dpuBuffer_m + params_w.dpuSequences_m;
+    uint32_t dpuOperations_m = dpuBuffer_m + params_w.dpuOperations_m;
+
+    // The tasklets claim the reads one at a time, so a divergent pair only delays the tasklet aligning it
+    uint64_t tasklet_nb_reads = 0;
+    uint32_t read_idx;
+    while ((read_idx = claim_read()) < nb_reads_per_dpu)
     {
+#ifdef PROFILE
+        perfcounter_t pair_start = perfcounter_get();
+#endif
         request_t *request_w = (request_t *)allocate_new(&dpu_alloc_wram, (sizeof(request_t)));
         result_t *result_w = (result_t *)allocate_new(&dpu_alloc_wram, (sizeof(result_t)));
 
         edit_cigar_t *cigar;
         cigar = (edit_cigar_t *)allocate_new(&dpu_alloc_wram, sizeof(edit_cigar_t));
 
-        if (read_nb + tasklet_id * nb_reads_per_tasklets < nb_reads_per_dpu)
-        {
-            mram_read((__mram_ptr void const *)(dpuRequests_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (sizeof(request_t))), request_w, ROUND_UP_MULTIPLE_8(sizeof(request_t)));
-            char *pattern = (char *)allocate_new(&dpu_alloc_wram, ROUND_UP_MULTIPLE_8(request_w->pattern_len));
-            char *text = (char *)allocate_new(&dpu_alloc_wram, ROUND_UP_MULTIPLE_8(request_w->text_len));
-
-            // DMA transfers must be less than 2048
-            if (ROUND_UP_MULTIPLE_8(request_w->pattern_len) <= 2048)
-            {
-                mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE)), pattern, ROUND_UP_MULTIPLE_8(request_w->pattern_len));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(request_w->pattern_len); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(request_w->pattern_len))
-                    {
-                        mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(pattern[segment_size]), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(request_w->pattern_len) - segment_size;
-                        mram_read((__mram_ptr void const *)(dpuPatterns_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(pattern[segment_size]), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
-
-            if (ROUND_UP_MULTIPLE_8(request_w->text_len) <= 2048)
-            {
-                mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE)), text, ROUND_UP_MULTIPLE_8(request_w->text_len));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(request_w->text_len); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(request_w->text_len))
-                    {
-                        mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(text[segment_size]), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(request_w->text_len) - segment_size;
-                        mram_read((__mram_ptr void const *)(dpuTexts_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (READ_SIZE) + segment_size), &(text[segment_size]), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
-            edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len, &dpu_alloc_wram);
+        mram_read((__mram_ptr void const *)(dpuRequests_m + read_idx * (sizeof(request_t))), request_w, ROUND_UP_MULTIPLE_8(sizeof(request_t)));
+        // Packed sequences, 8 more bytes for the word accesses past their end
+        char *pattern = (char *)allocate_new(&dpu_alloc_wram, PACKED_SIZE(request_w->pattern_len) + 8);
+        char *text = (char *)allocate_new(&dpu_alloc_wram, PACKED_SIZE(request_w->text_len) + 8);
+
+        // The packed text follows the packed pattern
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset, pattern, request_w->pattern_len);
+        read_packed_sequence(dpuSequences_m + request_w->sequence_offset + PACKED_SIZE(request_w->pattern_len), text, request_w->text_len);
+        edit_cigar_allocate(cigar, request_w->pattern_len, request_w->text_len, &dpu_alloc_wram);
 
 #ifdef BACKTRACE
-            cigar->operations = (char *)allocate_new(&dpu_alloc_wram, 2 * READ_SIZE);
-            // initialize traceback operations segment
-            memset(cigar->operations, 'M', 2 * READ_SIZE);
+        cigar->operations = (char *)allocate_new(&dpu_alloc_wram, 2 * READ_SIZE);
+        // initialize traceback operations segment
+        memset(cigar->operations, 'M', 2 * READ_SIZE);
 #endif
-            affine_wfa_compute(&dpu_alloc_wram, cigar, pattern, text, request_w->pattern_len, request_w->text_len);
+        affine_wfa_compute(&dpu_alloc_wram, cigar, pattern, text, request_w->pattern_len, request_w->text_len);
 
-            result_w->idx = request_w->idx;
+        result_w->idx = request_w->idx;
 
 #ifdef BACKTRACE
-            if (ROUND_UP_MULTIPLE_8(cigar->max_operations) <= 2048)
-            {
-                mram_write((cigar->operations), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE)), ROUND_UP_MULTIPLE_8(cigar->max_operations));
-            }
-            else
-            {
-                for (int segment_size = 0; segment_size <= ROUND_UP_MULTIPLE_8(cigar->max_operations); segment_size += 2048)
-                {
-                    if (segment_size + 2048 <= ROUND_UP_MULTIPLE_8(cigar->max_operations))
-                    {
-                        mram_write(&(cigar->operations[segment_size]), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE) + segment_size), 2048);
-                    }
-                    else
-                    {
-                        int size = ROUND_UP_MULTIPLE_8(cigar->max_operations) - segment_size;
-                        mram_write(&(cigar->operations[segment_size]), (__mram_ptr void *)(dpuOperations_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (2 * READ_SIZE) + segment_size), ROUND_UP_MULTIPLE_8(size));
-                    }
-                }
-            }
+        store_cigar(cigar, dpuOperations_m, result_w);
 #endif
-            result_w->score = cigar->score;
-            result_w->max_operations = cigar->max_operations;
-            result_w->begin_offset = cigar->begin_offset;
-            result_w->end_offset = cigar->end_offset;
-
-            mram_write(result_w, (__mram_ptr void *)(dpuResults_m + (read_nb + tasklet_id * nb_reads_per_tasklets) * (sizeof(result_t))), sizeof(result_t));
-        }
+        result_w->score = cigar->score;
+        result_w->pattern_begin = cigar->pattern_begin;
+        result_w->pattern_end = cigar->pattern_end;
+        result_w->text_begin = cigar->text_begin;
+        result_w->text_end = cigar->text_end;
+
+#ifdef PROFILE
+        result_w->cycles = perfcounter_get() - pair_start;
+#endif
+        mram_write(result_w, (__mram_ptr void *)(dpuResults_m + read_idx * (sizeof(result_t))), sizeof(result_t));
+        ++tasklet_nb_reads;
         // reset WRAM segment for each tasklet after every alignment
         reset_dpu_alloc_wram(&dpu_alloc_wram);
     }
+    // Number of reads aligned by the tasklet and cycles until it finished
+    tasklet_stats[tasklet_id].nb_reads = tasklet_nb_reads;
+    tasklet_stats[tasklet_id].cycles = perfcounter_get();
+    mram_write(&tasklet_stats[tasklet_id], (__mram_ptr void *)(dpuBuffer_m + params_w.dpuTaskletStats_m + tasklet_id * sizeof(tasklet_stats_t)), sizeof(tasklet_stats_t));
     return 0;
 }
\ No newline at end of file
@@ -29,6 +29,7 @@
  */
 
 #include "wfa_backtracing.h"
+#include "dpu_params.h"
 #include "../common/common.h"
 /*
  * Backtrace Detect Limits
@@ -214,12 +215,11 @@ void affine_wavefronts_backtrace(
     int pattern_length,
     char *text,
     int text_length,
-    int alignment_score)
+    int alignment_score,
+    int alignment_k,
+    span_free_t free)
 {
 
-  // Parameters
-  int alignment_k = AFFINE_WAVEFRONT_DIAGONAL(text_length, pattern_length);
-
   // Compute starting location
   int score = alignment_score;
   int k = alignment_k;
@@ -330,22 +330,27 @@ void affine_wavefronts_backtrace(
   // Account for last operations
   if (score == 0)
   {
-    // Account for last stroke of matches
-    affine_wavefronts_backtrace_matches__check(pattern, text, k, offset, valid_location, offset, cigar);
+    // Account for last stroke of matches, the diagonals of score 0 start on the first row or column
+    affine_wavefronts_backtrace_matches__check(pattern, text, k, offset, valid_location, offset - MAX(k, 0), cigar);
+    offset = MAX(k, 0);
+    v = AFFINE_WAVEFRONT_V(k, offset);
+    h = AFFINE_WAVEFRONT_H(k, offset);
   }
   else
   {
-    // Account for last stroke of insertion/deletion
-    while (v > 0)
+    // Account for last stroke of insertion/deletion, the bases of the free begins are left out
+    while (v > ((h > 0) ? 0 : free.pattern_begin))
     {
       cigar->operations[(cigar->begin_offset)--] = 'D';
       --v;
     };
-    while (h > 0)
+    while (h > ((v > 0) ? 0 : free.text_begin))
     {
       cigar->operations[(cigar->begin_offset)--] = 'I';
       --h;
     };
   }
+  cigar->pattern_begin = v;
+  cigar->text_begin = h;
   ++(cigar->begin_offset); // Set CIGAR length
 }
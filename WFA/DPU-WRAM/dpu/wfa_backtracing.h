@@ -54,6 +54,17 @@ typedef enum
   backtrace_wavefront_D = 2
 } backtrace_wavefront_type;
 
+/*
+ * Bases of the ends of the sequences left out for free by the span, 0 for a global alignment
+ */
+typedef struct span_free_t
+{
+  int pattern_begin;
+  int pattern_end;
+  int text_begin;
+  int text_end;
+} span_free_t;
+
 /*
  * Backtrace
  */
@@ -64,6 +75,8 @@ void affine_wavefronts_backtrace(
     const int pattern_length,
     char *const text,
     const int text_length,
-    const int alignment_score);
+    const int alignment_score,
+    const int alignment_k,
+    const span_free_t free);
 
 #endif
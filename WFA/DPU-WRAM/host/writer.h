@@ -0,0 +1,95 @@
+#ifndef _WRITER_H_
+#define _WRITER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "common.h"
+#include "parser.h"
+
+// Initial size of the buffer of a formatting thread, it grows with the lines of a batch
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+// Formats of the output file, the pattern of a pair is the query and its text the reference, both named after the index of the pair
+typedef enum output_format_t
+{
+    OUTPUT_TEXT,   /* "idx, score, " lines, followed by the span and the CIGAR of the alignment when they are known */
+    OUTPUT_PAF,    /* A PAF line per pair within the max score */
+    OUTPUT_SAM,    /* A minimal SAM record per pair, without the sequences */
+    OUTPUT_BINARY, /* Fixed-width records at the index of their pair in a mapped file, followed by the CIGARs */
+} output_format_t;
+
+#define OUTPUT_FORMAT_USAGE "text|paf|sam|binary"
+
+// The binary output starts with a header, then holds the record of each pair at its index and the run-length encoded CIGARs of the
+// pairs, each byte is a run decoded by CIGAR_RUN_OP and CIGAR_RUN_LENGTH
+#define OUTPUT_BINARY_MAGIC "AIMRES01"
+#define OUTPUT_BINARY_SPAN 1  /* Header flag, the spans are the ones of ends-free or local alignments */
+#define OUTPUT_BINARY_CIGAR 2 /* Header flag, the records have a CIGAR */
+#define OUTPUT_RECORD_REJECTED 1 /* Record flag, the alignment is above the max score */
+
+typedef struct output_header_t
+{
+    char magic[8];
+    uint32_t record_size;
+    uint32_t flags;
+    uint64_t nb_records;
+    uint64_t cigars_offset; /* Offset of the CIGARs in the file, right after the records */
+    uint64_t cigars_size;
+} output_header_t;
+
+typedef struct output_record_t
+{
+    uint32_t idx;
+    int32_t score;
+    int32_t pattern_begin;
+    int32_t pattern_end;
+    int32_t text_begin;
+    int32_t text_end;
+    uint32_t cigar_length; /* Number of runs of the CIGAR */
+    uint32_t flags;
+    uint64_t cigar_offset; /* Offset of the CIGAR from the beginning of the CIGARs */
+} output_record_t;
+
+// Output file of the alignments. The lines of a batch are formatted in parallel into one buffer per thread and the buffers are written
+// in the order of the input, the binary records are written in parallel at the index of their pair in the mapped file
+typedef struct output_t
+{
+    output_format_t format;
+    FILE *file;
+    uint32_t nb_threads; /* Number of formatting threads */
+    char **buffers;      /* Lines formatted by each thread */
+    size_t *capacities;  /* Size of the buffer of each thread */
+    size_t *sizes;       /* Bytes of the lines of the batch in the buffer of each thread */
+    bool span;           /* Whether the span of an alignment isn't the whole sequences */
+    bool cigar;          /* Whether the alignments have a CIGAR */
+    int max_score;
+    int fd;                 /* Binary output file */
+    uint8_t *map;           /* Mapping of the binary output file */
+    size_t map_size;        /* Size of the binary output file and of its mapping, it grows with the CIGARs */
+    uint64_t nb_records;    /* Number of pairs of the binary output */
+    uint64_t cigars_offset; /* Offset of the CIGARs in the binary output file */
+    uint64_t cigars_size;   /* Bytes of the CIGARs written so far */
+    uint64_t bytes_written;
+    char error[256];        /* Reason the output couldn't be opened or written */
+} output_t;
+
+// Parses the format of -f, returns false when it is unknown
+bool parse_output_format(const char *arg, output_format_t *format);
+
+// Opens the output file, the lines are formatted by NR_HOST_THREADS threads, or one per online core when it is 0. The output holds the
+// first nb_records pairs: the binary output is sized for them, the index of a pair must be below it, and the SAM header has a reference
+// of the length of the text of each of them. Returns false, with the reason in output->error, when the file can't be opened
+bool open_output(output_t *output, const char *path, output_format_t format, bool span, bool cigar, uint32_t max_score, const pair_index_t *pairs,
+                 uint64_t nb_records);
+
+// Writes the results of a batch, batch_order[k] is where the k-th pair of the batch was placed. With cigar, the run-length encoded CIGAR
+// of a result is read at its offset in dpu_cigars[dpu]. Returns false, with the reason in output->error, when the batch can't be written,
+// the output must still be closed
+bool write_output_batch(output_t *output, request_t **dpu_requests, result_t **dpu_results, uint8_t **dpu_cigars, const pair_slot_t *batch_order,
+                        uint32_t batch_nb_reads);
+
+void close_output(output_t *output);
+
+#endif
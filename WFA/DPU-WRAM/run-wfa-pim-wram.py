@@ -24,13 +24,27 @@ ap.add_argument("-a", "--gap_extending", type=int,
 ap.add_argument("-b", "--backtrace", action='store_true',
                 help="Enable backtracing")
 ap.add_argument("-r", "--reduced", action='store_true',
-                help="Enable WFA-Adaptive")
+                help="Enable WFA-Adaptive, same as -H adaptive,10,50")
+ap.add_argument("-H", "--heuristic", type=str,
+                help="WFA heuristic: none, adaptive,min_len,max_dist, xdrop,x, zdrop,z or banded,min_k,max_k, each followed by an optional ,steps")
+ap.add_argument("-S", "--span", type=str, default="global",
+                help="Span of the alignments: global, or ends-free,pattern_begin,pattern_end,text_begin,text_end for the bases of the ends of the sequences left out for free")
+ap.add_argument("-F", "--format", type=str, default="text",
+                help="Format of the output file: text, paf, sam (with -b) or binary")
+ap.add_argument("-T", "--texts", type=str,
+                help="FASTA or FASTQ file of the texts, the input file then holds the patterns (optional)")
+ap.add_argument("-X", "--index", type=str,
+                help="Index file of the pairs, written on the first run and loaded by the next ones (optional)")
 ap.add_argument("-t", "--nr_of_tasklets", type=int,
                 help="NR_TASKLETS (optional)")
 ap.add_argument("-d", "--nr_of_dpus", type=int,
                 help="NR_DPUs to allocate (default=1)")
 args = vars(ap.parse_args())
 
+if args["format"] not in ["text", "paf", "sam", "binary"] or (args["format"] in ["paf", "sam"] and not args["backtrace"]):
+    print("Wrong format " + args["format"] + ", it must be text, binary, or paf or sam with -b\n")
+    exit(-1)
+
 
 match_cost = args["match_cost"]
 mismatch_cost = args["mismatch_cost"]
@@ -38,8 +52,19 @@ gap_opening = args["gap_opening"]
 gap_extending = args["gap_extending"]
 
 
-if match_cost > 0 or mismatch_cost <= 0 or gap_opening <= 0 or gap_extending <= 0:
-    print("Wrong affine gap penalties must be  m <= 0 and g, a, x > 0\n")
+if match_cost != 0 or mismatch_cost <= 0 or gap_opening <= 0 or gap_extending <= 0:
+    print("Wrong affine gap penalties must be  m = 0 and g, a, x > 0\n")
+    exit(-1)
+
+heuristic = args["heuristic"]
+if args["reduced"]:
+    if heuristic is not None:
+        print("-r is a shorthand of -H adaptive,10,50, they are not combined")
+        exit(-1)
+    heuristic = "adaptive,10,50"
+heuristic_params = heuristic.split(",") if heuristic is not None else ["none"]
+if heuristic_params[0] not in ["none", "adaptive", "xdrop", "zdrop", "banded"]:
+    print("Unknown WFA heuristic " + heuristic_params[0])
     exit(-1)
 
 read_length = args["read_length"]
@@ -47,6 +72,19 @@ if read_length <= 0:
     print("Undefined input read length")
     exit(-1)
 
+span = args["span"]
+span_params = span.split(",")
+if not (span_params[0] in ["global", "local"] and len(span_params) == 1) and not (span_params[0] == "ends-free" and len(span_params) == 5):
+    print("Wrong span " + span + ", it must be global, local or ends-free,pattern_begin,pattern_end,text_begin,text_end")
+    exit(-1)
+if span_params[0] == "local":
+    print("The WFA computes global and ends-free alignments, not local ones")
+    exit(-1)
+# the wavefront of score 0 of an ends-free alignment starts on the diagonals of the free begins, the next ones are wider by as many diagonals
+begin_diagonals = 0
+if span_params[0] == "ends-free":
+    begin_diagonals = int(span_params[1]) + int(span_params[3])
+
 number_reads = args["number_reads"]
 if number_reads <= 0:
     print("Undefined number of input reads")
@@ -66,15 +104,21 @@ else:
     sizeof_offset = 4
 
 read_length = math.ceil((((read_length + nr_of_wrong_bases) + 7)/8))*8
+# patterns and texts are 2-bit packed and followed by a 1-bit N-mask
+packed_length = math.ceil(read_length/32)*8 + math.ceil(read_length/64)*8 + 8
 # memory upper limit is estimated according to the max wavefront length which depend on the max_score and including the size of the WRAM allocated memory
 memory_upper_limit = math.ceil(
-    ((max_score+1)/2)*(2*3 + (max_score)*6))*sizeof_offset + 2*read_length + max_score*31 + 624
+    ((max_score+1)/2)*(2*3 + (max_score)*6) + (max_score+1)*3*begin_diagonals)*sizeof_offset + 2*packed_length + max_score*31 + 624
 
 
-if args["reduced"]:
-    # used a heuristic to estimate the max wavefront length when applying WFA-Adaptive
+if heuristic_params[0] in ["adaptive", "banded"]:
+    # used a heuristic to estimate the max wavefront length when applying WFA-Adaptive, banded-adaptive keeps its band and the diagonals
+    # reached from it since it was applied
+    wavefront_length = 60+1+begin_diagonals
+    if heuristic_params[0] == "banded":
+        wavefront_length = int(heuristic_params[2]) - int(heuristic_params[1]) + 1 + 2*max(mismatch_cost, gap_opening + gap_extending)
     memory_upper_limit_red = math.ceil(
-        60+1)*(max_score+1)*sizeof_offset + 9*32 + 2*read_length + max_score*31 + 624
+        wavefront_length)*(max_score+1)*sizeof_offset + 9*32 + 2*packed_length + max_score*31 + 624
     if memory_upper_limit_red < memory_upper_limit:
         memory_upper_limit = memory_upper_limit_red
 
@@ -116,8 +160,6 @@ print("Number of allocated tasklets: ", str(NR_TASKLETS))
 print("Number of allocated bytes per tasklets: ", str(memory_upper_limit))
 
 options = ""
-if args["reduced"]:
-    options = options + " -DREDUCE"
 if args["backtrace"]:
     options = options + " -DBACKTRACE"
 NR_DPUs = 1
@@ -125,15 +167,13 @@ if args["nr_of_dpus"]:
     NR_DPUs = args["nr_of_dpus"]
 
 
-os.system("make clean")
-cmd = "make NR_DPUS="+str(NR_DPUs)+" NR_TASKLETS="+str(NR_TASKLETS)+" FLAGS=\"-DMAX_SCORE="+str(int(max_score))+" -DREAD_SIZE="+str(int(read_length))+" -DWRAM_SEGMENT=" + \
-    str(memory_upper_limit)+" -DMATCH="+str(match_cost)+" -DMISMATCH="+str(mismatch_cost) + \
-    " -DGAP_O="+str(gap_opening)+" -DGAP_E="+str(gap_extending) + options+"\""
+# The DPU binaries only depend on the number of tasklets and the build flags, they are built once and the alignment parameters are passed at run time
+cmd = "make prebuilt PREBUILT_TASKLETS="+str(NR_TASKLETS)+" FLAGS=\""+options.strip()+"\""
 
 os.system("echo "+str(cmd))
 os.system(cmd)
 
 
-cmd = "./build/host " + args["input"] + " " + \
-    args["output"] + " " + str(number_reads)
+cmd = "./build/host -t "+str(NR_TASKLETS)+" -d "+str(NR_DPUs)+" -l "+str(int(read_length))+" -s "+str(int(max_score))+" -w "+str(memory_upper_limit) + \
+    " -p "+str(match_cost)+","+str(mismatch_cost)+","+str(gap_opening)+","+str(gap_extending)+" -H "+",".join(heuristic_params)+" -a "+span+" -f "+args["format"]+(" -T "+args["texts"] if args["texts"] else "")+(" -x "+args["index"] if args["index"] else "")+" " + args["input"] + " " + args["output"] + " " + str(number_reads)
 os.system(cmd)